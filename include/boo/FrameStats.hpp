@@ -0,0 +1,168 @@
+#ifndef BOO_FRAMESTATS_HPP
+#define BOO_FRAMESTATS_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace boo
+{
+
+/** Clock shared by all frame telemetry; monotonic nanoseconds */
+static inline uint64_t FrameStatsNow()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/** Milliseconds from begin to end; 0 when either stamp was not recorded */
+static inline double FrameStatsMs(uint64_t begin, uint64_t end)
+{
+    return (begin && end > begin) ? (end - begin) / 1000000.0 : 0.0;
+}
+
+/** CPU-side timeline of one frame through a command queue.
+ *  Stamps come from FrameStatsNow() and are 0 when not recorded */
+struct FrameStats
+{
+    uint64_t frame = 0;       /**< Serial of the execute() that submitted the frame */
+    uint64_t recordStart = 0; /**< Client began recording (previous execute() returned) */
+    uint64_t execute = 0;     /**< Client called execute() */
+    uint64_t renderBegin = 0; /**< Playback to the API began (GL render thread, Vulkan execute()) */
+    uint64_t renderEnd = 0;   /**< Playback finished */
+    uint64_t present = 0;     /**< Present/swap returned; 0 for frames that presented nothing */
+
+    double recordMs() const {return FrameStatsMs(recordStart, execute);}
+    double queuedMs() const {return FrameStatsMs(execute, renderBegin);}
+    double renderMs() const {return FrameStatsMs(renderBegin, renderEnd);}
+    double latencyMs() const {return FrameStatsMs(recordStart, present);}
+};
+
+/** One IWindow::waitForRetrace() call */
+struct RetraceStats
+{
+    uint64_t waitBegin = 0; /**< waitForRetrace() entered */
+    uint64_t vsync = 0;     /**< Retrace signalled by the platform */
+    uint64_t wake = 0;      /**< waitForRetrace() returned */
+
+    double waitMs() const {return FrameStatsMs(waitBegin, wake);}
+};
+
+/** Fixed-size history of the newest N records; push() and copy() may be
+ *  called from different threads */
+template <class T, size_t N=128>
+class FrameStatsRing
+{
+    mutable std::mutex m_mt;
+    T m_entries[N];
+    size_t m_next = 0;
+    size_t m_count = 0;
+
+public:
+    void push(const T& entry)
+    {
+        std::unique_lock<std::mutex> lk(m_mt);
+        m_entries[m_next] = entry;
+        m_next = (m_next + 1) % N;
+        if (m_count < N)
+            ++m_count;
+    }
+
+    /** Copy up to maxCount of the newest records into out, oldest first */
+    size_t copy(T* out, size_t maxCount) const
+    {
+        std::unique_lock<std::mutex> lk(m_mt);
+        size_t count = std::min(maxCount, m_count);
+        size_t first = (m_next + N - count) % N;
+        for (size_t i=0 ; i<count ; ++i)
+            out[i] = m_entries[(first + i) % N];
+        return count;
+    }
+
+    void clear()
+    {
+        std::unique_lock<std::mutex> lk(m_mt);
+        m_next = 0;
+        m_count = 0;
+    }
+};
+
+/** Nearest-rank percentile (p in [0,100]) of count samples; reorders samples */
+static inline double FrameStatsPercentile(double* samples, size_t count, double p)
+{
+    if (!count)
+        return 0.0;
+    p = std::min(std::max(p, 0.0), 100.0);
+    size_t rank = size_t(std::ceil(p / 100.0 * count));
+    size_t idx = rank ? rank - 1 : 0;
+    std::nth_element(samples, samples + idx, samples + count);
+    return samples[idx];
+}
+
+/** Distribution of one metric over a window of frames, in milliseconds */
+struct FrameStatsSummary
+{
+    size_t count = 0;
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+static inline FrameStatsSummary SummarizeFrameStats(std::vector<double>& samples)
+{
+    FrameStatsSummary ret;
+    ret.count = samples.size();
+    if (!ret.count)
+        return ret;
+    ret.max = *std::max_element(samples.begin(), samples.end());
+    ret.p50 = FrameStatsPercentile(samples.data(), ret.count, 50.0);
+    ret.p90 = FrameStatsPercentile(samples.data(), ret.count, 90.0);
+    ret.p99 = FrameStatsPercentile(samples.data(), ret.count, 99.0);
+    return ret;
+}
+
+/** Summarize metric(record) over records, e.g. [](const FrameStats& f) {return f.renderMs();}.
+ *  Zero samples (unrecorded stamps) are skipped */
+template <class T, class Metric>
+FrameStatsSummary SummarizeFrameStats(const T* records, size_t count, Metric metric)
+{
+    std::vector<double> samples;
+    samples.reserve(count);
+    for (size_t i=0 ; i<count ; ++i)
+    {
+        double v = metric(records[i]);
+        if (v > 0.0)
+            samples.push_back(v);
+    }
+    return SummarizeFrameStats(samples);
+}
+
+/** Summarize the interval between consecutive records' stamps,
+ *  e.g. &FrameStats::present for present-to-present time */
+template <class T>
+FrameStatsSummary SummarizeFrameIntervals(const T* records, size_t count, uint64_t T::*stamp)
+{
+    std::vector<double> samples;
+    samples.reserve(count);
+    uint64_t prev = 0;
+    for (size_t i=0 ; i<count ; ++i)
+    {
+        uint64_t cur = records[i].*stamp;
+        if (!cur)
+            continue;
+        double v = FrameStatsMs(prev, cur);
+        if (v > 0.0)
+            samples.push_back(v);
+        prev = cur;
+    }
+    return SummarizeFrameStats(samples);
+}
+
+}
+
+#endif // BOO_FRAMESTATS_HPP
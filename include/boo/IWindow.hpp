@@ -2,6 +2,7 @@
 #define IWINDOW_HPP
 
 #include "System.hpp"
+#include "FrameStats.hpp"
 #include <memory>
 #include <algorithm>
 #include <cstring>
@@ -295,6 +296,10 @@ public:
     virtual std::unique_ptr<uint8_t[]> clipboardPaste(EClipboardType type, size_t& sz)=0;
 
     virtual void waitForRetrace()=0;
+
+    /** Copy up to maxCount of the newest waitForRetrace() timings into out, oldest first;
+     *  returns the count copied (0 on platforms that don't record them) */
+    virtual size_t getRetraceStats(RetraceStats* out, size_t maxCount) const {return 0;}
     
     virtual uintptr_t getPlatformHandle() const=0;
     virtual void _incomingEvent(void* event) {(void)event;}
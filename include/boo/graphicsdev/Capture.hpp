@@ -0,0 +1,219 @@
+#ifndef GDEV_CAPTURE_HPP
+#define GDEV_CAPTURE_HPP
+
+#include "IGraphicsDataFactory.hpp"
+#include "IGraphicsCommandQueue.hpp"
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <stdio.h>
+
+namespace boo
+{
+struct CaptureData;
+class CaptureGraphicsBufferD;
+class CaptureTextureD;
+
+/** Data factory layer that forwards every transaction to a backend factory and
+ *  writes the resources it creates to a capture file, followed by the frames
+ *  of a paired CaptureCommandQueue; CaptureReplay re-executes the file.
+ *
+ *  Transactions receive a CaptureDataFactory::Context instead of the backend's,
+ *  so pipelines must come from its GLSL newShaderPipeline (OpenGL, Vulkan and
+ *  Null backends). Dynamic buffers and textures are proxies that record each
+ *  load; every other object handed out is the backend's own.
+ *  The backend factory must outlive this one */
+class CaptureDataFactory : public IGraphicsDataFactory
+{
+    friend class CaptureCommandQueue;
+    friend class CaptureCommandList;
+    friend class CaptureGraphicsBufferD;
+    friend class CaptureTextureD;
+    IGraphicsDataFactory* m_backend;
+    std::unordered_set<CaptureData*> m_committedData;
+    std::mutex m_committedMutex;
+
+    /* Capture ids (0 is null) of live objects, keyed by the pointer clients hold */
+    std::unordered_map<const void*, uint32_t> m_ids;
+    std::mutex m_idMt;
+    uint32_t m_nextObjectId = 1;
+    uint32_t m_nextDataId = 1;
+    bool m_warnedUnknown = false;
+
+    /* Records waiting for the next frame: creations and loads go ahead of
+     * its commands, destructions after them */
+    FILE* m_fp = nullptr;
+    std::vector<uint8_t> m_pending;
+    std::vector<uint8_t> m_pendingDestroys;
+    std::mutex m_streamMt;
+
+    uint32_t registerObject(CaptureData& data, const void* obj);
+    uint32_t objectId(const void* obj);
+    uint32_t bufferId(const IGraphicsBuffer* buf) {return objectId(buf);}
+    uint32_t textureId(const ITexture* tex) {return objectId(tex);}
+    IGraphicsBuffer* backendBuffer(IGraphicsBuffer* buf);
+    ITexture* backendTexture(ITexture* tex);
+    void recordLoad(CaptureData& owner, uint8_t op, uint32_t id, const void* data, size_t sz);
+    void writeFrame(const std::vector<uint8_t>& frame);
+    void forgetObjects(CaptureData& data);
+
+    void destroyData(IGraphicsData*);
+    void destroyAllData();
+    bool isDataReady(IGraphicsData*);
+public:
+    /** Starts capturing into path (replacing any file there); when the file cannot
+     *  be written, transactions are still forwarded but nothing is recorded */
+    CaptureDataFactory(IGraphicsDataFactory* backend, const SystemString& path);
+    ~CaptureDataFactory();
+
+    IGraphicsDataFactory* backend() const {return m_backend;}
+    bool capturing() const {return m_fp != nullptr;}
+
+    Platform platform() const {return m_backend->platform();}
+    const SystemChar* platformName() const {return m_backend->platformName();}
+
+    class Context : public IGraphicsDataFactory::Context
+    {
+        friend class CaptureDataFactory;
+        CaptureDataFactory& m_parent;
+        IGraphicsDataFactory::Context& m_backend;
+        CaptureData& m_data;
+        std::vector<uint8_t>& m_rec;
+        Context(CaptureDataFactory& parent, IGraphicsDataFactory::Context& backend,
+                CaptureData& data, std::vector<uint8_t>& rec)
+        : m_parent(parent), m_backend(backend), m_data(data), m_rec(rec) {}
+    public:
+        Platform platform() const {return m_backend.platform();}
+        const SystemChar* platformName() const {return m_backend.platformName();}
+
+        IGraphicsBufferS* newStaticBuffer(BufferUse use, const void* data, size_t stride, size_t count);
+        IGraphicsBufferD* newDynamicBuffer(BufferUse use, size_t stride, size_t count);
+
+        ITextureS* newStaticTexture(size_t width, size_t height, size_t mips, TextureFormat fmt,
+                                    const void* data, size_t sz);
+        ITextureSA* newStaticArrayTexture(size_t width, size_t height, size_t layers, TextureFormat fmt,
+                                          const void* data, size_t sz);
+        ITextureD* newDynamicTexture(size_t width, size_t height, TextureFormat fmt);
+        ITextureR* newRenderTexture(size_t width, size_t height,
+                                    bool enableShaderColorBinding, bool enableShaderDepthBinding);
+
+        bool bindingNeedsVertexFormat() const {return m_backend.bindingNeedsVertexFormat();}
+        IVertexFormat* newVertexFormat(size_t elementCount, const VertexElementDescriptor* elements);
+
+        /* GL-style parameters; vtxFmt is required by Vulkan and ignored elsewhere.
+         * Returns null on backends without GLSL pipelines */
+        IShaderPipeline* newShaderPipeline(const char* vertSource, const char* fragSource,
+                                           size_t texCount, const char** texNames,
+                                           size_t uniformBlockCount, const char** uniformBlockNames,
+                                           IVertexFormat* vtxFmt,
+                                           BlendFactor srcFac, BlendFactor dstFac, Primitive prim,
+                                           bool depthTest, bool depthWrite, bool backfaceCulling);
+
+        IShaderDataBinding*
+        newShaderDataBinding(IShaderPipeline* pipeline,
+                             IVertexFormat* vtxFormat,
+                             IGraphicsBuffer* vbo, IGraphicsBuffer* instVbo, IGraphicsBuffer* ibo,
+                             size_t ubufCount, IGraphicsBuffer** ubufs, const PipelineStage* ubufStages,
+                             const size_t* ubufOffs, const size_t* ubufSizes,
+                             size_t texCount, ITexture** texs);
+    };
+
+    GraphicsDataToken commitTransaction(const FactoryCommitFunc&);
+};
+
+/** Command queue layer that records every command into the capture of its
+ *  CaptureDataFactory and forwards it to the backend queue. Each execute()
+ *  appends one frame to the file. Post-frame handlers, pacing and timing
+ *  controls are forwarded without being recorded */
+class CaptureCommandQueue : public IGraphicsCommandQueue
+{
+    IGraphicsCommandQueue* m_backend;
+    CaptureDataFactory* m_factory;
+    std::vector<uint8_t> m_frame; /* Commands recorded since the last execute() */
+    std::vector<IGraphicsCommandList*> m_backendLists;
+
+public:
+    CaptureCommandQueue(IGraphicsCommandQueue* backend, CaptureDataFactory* factory);
+
+    IGraphicsCommandQueue* backend() const {return m_backend;}
+
+    Platform platform() const {return m_backend->platform();}
+    const SystemChar* platformName() const {return m_backend->platformName();}
+
+    void setShaderDataBinding(IShaderDataBinding* binding);
+    void setRenderTarget(ITextureR* target);
+    void setViewport(const SWindowRect& rect, float znear=0.f, float zfar=1.f);
+    void setScissor(const SWindowRect& rect);
+
+    void resizeRenderTexture(ITextureR* tex, size_t width, size_t height);
+    void schedulePostFrameHandler(std::function<void(void)>&& func)
+    {m_backend->schedulePostFrameHandler(std::move(func));}
+
+    void setClearColor(const float rgba[4]);
+    void clearTarget(bool render=true, bool depth=true);
+
+    void draw(size_t start, size_t count);
+    void drawIndexed(size_t start, size_t count);
+    void drawInstances(size_t start, size_t count, size_t instCount);
+    void drawInstancesIndexed(size_t start, size_t count, size_t instCount);
+    void drawIndirect(IGraphicsBuffer* buf, size_t offset, size_t drawCount=1);
+    void drawIndexedIndirect(IGraphicsBuffer* buf, size_t offset, size_t drawCount=1);
+
+    void resolveBindTexture(ITextureR* texture, const SWindowRect& rect, bool tlOrigin, bool color, bool depth);
+    void resolveDisplay(ITextureR* source);
+    void readback(ITextureR* texture, const SWindowRect& rect, ReadbackFunc&& callback);
+    void execute();
+
+    void stopRenderer() {m_backend->stopRenderer();}
+
+    std::unique_ptr<IGraphicsCommandList> newCommandList();
+    void executeCommandLists(IGraphicsCommandList* const* lists, size_t count);
+
+    FrameCounters getFrameCounters() const {return m_backend->getFrameCounters();}
+    void setPacingMode(PacingMode mode) {m_backend->setPacingMode(mode);}
+    PacingMode pacingMode() const {return m_backend->pacingMode();}
+
+    size_t getFrameStats(FrameStats* out, size_t maxCount) const {return m_backend->getFrameStats(out, maxCount);}
+    void setGPUTimingEnabled(bool enabled) {m_backend->setGPUTimingEnabled(enabled);}
+    bool gpuTimingEnabled() const {return m_backend->gpuTimingEnabled();}
+    void beginTimer(const char* name);
+    void endTimer();
+    bool getGPUTimings(GPUFrameTimings& out) const {return m_backend->getGPUTimings(out);}
+};
+
+/** Totals and CPU timings of one CaptureReplay::run() */
+struct CaptureReplayStats
+{
+    size_t frames = 0;
+    size_t transactions = 0;
+    size_t draws = 0; /**< Indirect draws count once per call */
+    size_t uploadBytes = 0; /**< Loaded into dynamic buffers and textures */
+    std::vector<double> frameMs; /**< Per frame, from its first record through execute() returning */
+};
+
+/** Re-executes a capture's transactions and frames, in their original order,
+ *  on any data factory and command queue pair */
+class CaptureReplay
+{
+    std::vector<uint8_t> m_file;
+    size_t m_bodyOffset = 0;
+    IGraphicsDataFactory::Platform m_platform = IGraphicsDataFactory::Platform::Null;
+
+public:
+    /** Load a whole capture into memory; false if unreadable or not a capture */
+    bool open(const SystemString& path);
+
+    /** Backend the capture was recorded on */
+    IGraphicsDataFactory::Platform capturedPlatform() const {return m_platform;}
+
+    /** Replay every record; frameDone (optional) runs after each execute() and is not
+     *  timed. Resources are released on return. False if the capture is truncated or
+     *  malformed; stats then cover the frames replayed before the bad record */
+    bool run(IGraphicsDataFactory* factory, IGraphicsCommandQueue* queue, CaptureReplayStats& stats,
+             const std::function<void(size_t frame)>& frameDone={}) const;
+};
+
+}
+
+#endif // GDEV_CAPTURE_HPP
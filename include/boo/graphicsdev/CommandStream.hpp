@@ -0,0 +1,116 @@
+#ifndef GDEV_COMMANDSTREAM_HPP
+#define GDEV_COMMANDSTREAM_HPP
+
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <string.h>
+#include <stdint.h>
+
+namespace boo
+{
+
+/** Packed, variable-length command recording for backends that replay on
+ *  another thread.
+ *
+ *  Each command is an 8-byte header (opcode and record size) followed by its
+ *  payload, padded to 8 bytes; payloads must be trivially copyable. The bytes
+ *  live in one linear arena that only grows, so clear() and re-recording a
+ *  frame of similar size never allocate. */
+class CommandStream
+{
+public:
+    struct Command
+    {
+        uint32_t m_op;
+        uint32_t m_size; /* Header included */
+
+        template <class Op>
+        Op op() const {return Op(m_op);}
+
+        template <class T>
+        const T& get() const {return *reinterpret_cast<const T*>(this + 1);}
+    };
+
+    class Iterator
+    {
+        const uint8_t* m_cur;
+    public:
+        explicit Iterator(const uint8_t* cur) : m_cur(cur) {}
+        const Command& operator*() const {return *reinterpret_cast<const Command*>(m_cur);}
+        Iterator& operator++() {m_cur += reinterpret_cast<const Command*>(m_cur)->m_size; return *this;}
+        bool operator!=(const Iterator& other) const {return m_cur != other.m_cur;}
+    };
+
+private:
+    static const size_t Align = 8;
+    static_assert(sizeof(Command) == Align, "command header must keep payloads aligned");
+
+    std::unique_ptr<uint64_t[]> m_data;
+    size_t m_size = 0;
+    size_t m_capacity = 0;
+
+    uint8_t* bytes() const {return reinterpret_cast<uint8_t*>(m_data.get());}
+
+    void grow(size_t need)
+    {
+        size_t cap = m_capacity ? m_capacity * 2 : 4096;
+        while (cap < need)
+            cap *= 2;
+        std::unique_ptr<uint64_t[]> data(new uint64_t[cap / Align]);
+        if (m_size)
+            memcpy(data.get(), m_data.get(), m_size);
+        m_data = std::move(data);
+        m_capacity = cap;
+    }
+
+    Command* alloc(uint32_t op, size_t payloadSz)
+    {
+        size_t sz = sizeof(Command) + (payloadSz + Align - 1) / Align * Align;
+        if (m_size + sz > m_capacity)
+            grow(m_size + sz);
+        Command* cmd = reinterpret_cast<Command*>(bytes() + m_size);
+        cmd->m_op = op;
+        cmd->m_size = uint32_t(sz);
+        m_size += sz;
+        return cmd;
+    }
+
+public:
+    /** Append a command and return its payload for filling in */
+    template <class T, class Op>
+    T& push(Op op)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "command payloads are copied as bytes");
+        return *new (alloc(uint32_t(op), sizeof(T)) + 1) T;
+    }
+
+    /** Append a command without a payload */
+    template <class Op>
+    void push(Op op) {alloc(uint32_t(op), 0);}
+
+    /** Append every command of other, e.g. a worker thread's command list */
+    void append(const CommandStream& other)
+    {
+        if (!other.m_size)
+            return;
+        if (m_size + other.m_size > m_capacity)
+            grow(m_size + other.m_size);
+        memcpy(bytes() + m_size, other.bytes(), other.m_size);
+        m_size += other.m_size;
+    }
+
+    /** Forget the recorded commands; the arena is kept for the next frame */
+    void clear() {m_size = 0;}
+
+    bool empty() const {return m_size == 0;}
+    size_t size() const {return m_size;}
+    size_t capacity() const {return m_capacity;}
+
+    Iterator begin() const {return Iterator(bytes());}
+    Iterator end() const {return Iterator(bytes() + m_size);}
+};
+
+}
+
+#endif // GDEV_COMMANDSTREAM_HPP
@@ -0,0 +1,78 @@
+#ifndef GDEV_DEFERREDDESTROYQUEUE_HPP
+#define GDEV_DEFERREDDESTROYQUEUE_HPP
+
+#include "IGraphicsDataFactory.hpp"
+#include <atomic>
+#include <deque>
+#include <stdint.h>
+
+namespace boo
+{
+
+/** Holds destroyed IGraphicsData until every frame that may have referenced it
+ *  has completed on the GPU.
+ *
+ *  push() is lock-free and may be called from any thread. collect() and retire()
+ *  belong to the thread that submits frames and never block. Frame serials are
+ *  backend-defined and must not decrease between calls. */
+class DeferredDestroyQueue
+{
+    std::atomic<IGraphicsData*> m_incoming = {nullptr};
+
+    struct Entry
+    {
+        uint64_t frame;
+        IGraphicsData* data;
+    };
+    std::deque<Entry> m_pending; /* Ordered by frame */
+
+public:
+    void push(IGraphicsData* data)
+    {
+        IGraphicsData* head = m_incoming.load(std::memory_order_relaxed);
+        do
+            data->m_nextDead = head;
+        while (!m_incoming.compare_exchange_weak(head, data, std::memory_order_release,
+                                                 std::memory_order_relaxed));
+    }
+
+    /** Take everything pushed so far; lastFrame is the newest frame that could
+     *  still reference it (normally the one the client is recording) */
+    void collect(uint64_t lastFrame)
+    {
+        IGraphicsData* data = m_incoming.exchange(nullptr, std::memory_order_acquire);
+        while (data)
+        {
+            IGraphicsData* next = data->m_nextDead;
+            m_pending.push_back({lastFrame, data});
+            data = next;
+        }
+    }
+
+    /** Hand entries whose frame has completed to destroy(IGraphicsData*); it may
+     *  return false to keep that entry (and all later ones) for another call */
+    template <class Func>
+    size_t retire(uint64_t completedFrame, Func destroy)
+    {
+        size_t count = 0;
+        while (m_pending.size() && m_pending.front().frame <= completedFrame)
+        {
+            if (!destroy(m_pending.front().data))
+                break;
+            m_pending.pop_front();
+            ++count;
+        }
+        return count;
+    }
+
+    /** Drop every entry without destroying it; for owners tearing down all data */
+    void clear()
+    {
+        m_incoming.store(nullptr, std::memory_order_relaxed);
+        m_pending.clear();
+    }
+};
+
+}
+
+#endif // GDEV_DEFERREDDESTROYQUEUE_HPP
@@ -5,6 +5,7 @@
 #include "IGraphicsCommandQueue.hpp"
 #include "boo/IGraphicsContext.hpp"
 #include "GLSLMacros.hpp"
+#include "DeferredDestroyQueue.hpp"
 #include <vector>
 #include <unordered_set>
 #include <mutex>
@@ -20,12 +21,28 @@ class GLDataFactory : public IGraphicsDataFactory
     static ThreadLocalPtr<struct GLData> m_deferredData;
     std::unordered_set<struct GLData*> m_committedData;
     std::mutex m_committedMutex;
+    DeferredDestroyQueue m_deadData; /* Retired by the command queue's render thread */
+    SystemString m_programCacheDir;
+    bool m_parallelCompileEnabled = false;
+    size_t m_frameDepth;
     void destroyData(IGraphicsData*);
     void destroyAllData();
 public:
     GLDataFactory(IGraphicsContext* parent, uint32_t drawSamples);
     ~GLDataFactory() {destroyAllData();}
 
+    /** Frames a GL command queue keeps in flight (1-3, default 3); 1 gives the
+     *  lowest input-to-display latency, 3 the most CPU/GPU overlap. Dynamic
+     *  resources hold one copy per frame. Each factory takes the default when
+     *  its window or headless context is created and keeps it from then on */
+    static void SetDefaultFrameDepth(size_t depth);
+    static size_t DefaultFrameDepth();
+    size_t frameDepth() const {return m_frameDepth;}
+
+    /** Directory where linked program binaries persist between runs; empty disables */
+    void setProgramCacheDirectory(const SystemString& dir) {m_programCacheDir = dir;}
+    const SystemString& programCacheDirectory() const {return m_programCacheDir;}
+
     Platform platform() const {return Platform::OpenGL;}
     const SystemChar* platformName() const {return _S("OpenGL");}
 
@@ -52,12 +69,30 @@ public:
         bool bindingNeedsVertexFormat() const {return true;}
         IVertexFormat* newVertexFormat(size_t elementCount, const VertexElementDescriptor* elements);
 
+        /* programBlob carries a program binary in and out: a valid blob skips compilation,
+         * while an empty or rejected one is replaced with the freshly linked binary */
         IShaderPipeline* newShaderPipeline(const char* vertSource, const char* fragSource,
+                                           std::vector<unsigned char>& programBlob,
                                            size_t texCount, const char** texNames,
                                            size_t uniformBlockCount, const char** uniformBlockNames,
                                            BlendFactor srcFac, BlendFactor dstFac, Primitive prim,
                                            bool depthTest, bool depthWrite, bool backfaceCulling);
 
+        /* Uses the factory's program cache directory when one is set */
+        IShaderPipeline* newShaderPipeline(const char* vertSource, const char* fragSource,
+                                           size_t texCount, const char** texNames,
+                                           size_t uniformBlockCount, const char** uniformBlockNames,
+                                           BlendFactor srcFac, BlendFactor dstFac, Primitive prim,
+                                           bool depthTest, bool depthWrite, bool backfaceCulling);
+
+        /* Issues compile and link without waiting on the result, letting the driver
+         * build programs in parallel (ARB_parallel_shader_compile) */
+        IShaderPipeline* newShaderPipelineAsync(const char* vertSource, const char* fragSource,
+                                                size_t texCount, const char** texNames,
+                                                size_t uniformBlockCount, const char** uniformBlockNames,
+                                                BlendFactor srcFac, BlendFactor dstFac, Primitive prim,
+                                                bool depthTest, bool depthWrite, bool backfaceCulling);
+
         IShaderDataBinding*
         newShaderDataBinding(IShaderPipeline* pipeline,
                              IVertexFormat* vtxFormat,
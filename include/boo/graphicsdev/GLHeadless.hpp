@@ -0,0 +1,27 @@
+#ifndef GDEV_GLHEADLESS_HPP
+#define GDEV_GLHEADLESS_HPP
+
+#include "boo/IGraphicsContext.hpp"
+#include <memory>
+#include <stddef.h>
+
+namespace boo
+{
+
+/** Create and initialize an OpenGL context that needs no window system.
+ *
+ *  The context lives on an EGL display from EGL_MESA_platform_surfaceless when
+ *  the EGL client supports it (the default display otherwise) and draws into a
+ *  width x height pbuffer. Configs without pbuffer support fall back to
+ *  EGL_KHR_surfaceless_context; resolveDisplay() then has no destination, so
+ *  results are fetched with IGraphicsCommandQueue::readback() instead.
+ *
+ *  getDataFactory() and getCommandQueue() return a regular GLDataFactory and GL
+ *  command queue; clients render into ITextureR targets as they would in a window.
+ *  There is no retrace, so execute() is paced by the GPU alone.
+ *  Returns empty if EGL or a suitable GL context is unavailable */
+std::unique_ptr<IGraphicsContext> NewGLHeadlessContext(size_t width, size_t height, uint32_t drawSamples=1);
+
+}
+
+#endif // GDEV_GLHEADLESS_HPP
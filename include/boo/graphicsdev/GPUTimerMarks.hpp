@@ -0,0 +1,66 @@
+#ifndef GDEV_GPUTIMERMARKS_HPP
+#define GDEV_GPUTIMERMARKS_HPP
+
+#include "IGraphicsCommandQueue.hpp"
+#include <vector>
+#include <stdint.h>
+
+namespace boo
+{
+
+/** Timestamp marks taken through one frame for backend GPU timing.
+ *
+ *  Each mark call returns the index of the timestamp query the backend must
+ *  write next, or -1 when the mark is dropped because the frame's query budget
+ *  is spent. Room for closing open scopes and the frame end is always kept.
+ *  resolve() turns the resulting timestamps into a GPUFrameTimings summary. */
+class GPUTimerMarks
+{
+    enum class Type : uint8_t
+    {
+        Target,
+        ScopeBegin,
+        ScopeEnd,
+        FrameEnd
+    };
+
+    struct Mark
+    {
+        Type type;
+        const char* name;
+        const ITextureR* target;
+        size_t drawCount; /* Draws issued before the mark */
+    };
+
+    std::vector<Mark> m_marks;
+    size_t m_maxMarks;
+    size_t m_drawCount = 0;
+    size_t m_openScopes = 0;
+    size_t m_markedScopes = 0; /* Outermost open scopes whose begin was marked */
+    uint64_t m_frame = 0;
+    bool m_ended = false;
+
+    int push(Type type, const char* name, const ITextureR* target, size_t reserve);
+
+public:
+    explicit GPUTimerMarks(size_t maxMarks=256) : m_maxMarks(maxMarks) {}
+
+    int beginFrame(uint64_t frame, const ITextureR* target);
+    int target(const ITextureR* target);
+    int beginScope(const char* name);
+    int endScope();
+    int endFrame();
+    void countDraws(size_t count=1) {m_drawCount += count;}
+
+    size_t count() const {return m_marks.size();}
+    size_t maxMarks() const {return m_maxMarks;}
+    uint64_t frame() const {return m_frame;}
+    bool ended() const {return m_ended;}
+
+    /** stamps[i] is the GPU time of query i in nanoseconds */
+    void resolve(const uint64_t* stamps, GPUFrameTimings& out) const;
+};
+
+}
+
+#endif // GDEV_GPUTIMERMARKS_HPP
@@ -4,10 +4,90 @@
 #include "IGraphicsDataFactory.hpp"
 #include "boo/IWindow.hpp"
 #include <functional>
+#include <memory>
+#include <vector>
+#include <stddef.h>
 
 namespace boo
 {
 
+/** Argument record consumed by drawIndirect (matches GL and Vulkan layouts) */
+struct DrawIndirectArgs
+{
+    uint32_t count;
+    uint32_t instCount;
+    uint32_t start;
+    uint32_t baseInstance;
+};
+
+/** Argument record consumed by drawIndexedIndirect (matches GL and Vulkan layouts) */
+struct DrawIndexedIndirectArgs
+{
+    uint32_t count;
+    uint32_t instCount;
+    uint32_t start;
+    int32_t baseVertex;
+    uint32_t baseInstance;
+};
+
+/** Pixels delivered to a readback callback; only valid while the callback runs */
+struct ReadbackData
+{
+    const uint8_t* pixels; /**< Bottom row of the requested rect */
+    ptrdiff_t rowPitch; /**< Byte step from one row to the row above it (negative when stored top-down) */
+    size_t width;
+    size_t height;
+    bool bgra; /**< 8-bit components ordered B,G,R,A rather than R,G,B,A */
+};
+using ReadbackFunc = std::function<void(const ReadbackData& data)>;
+
+/** GPU time of one beginTimer()/endTimer() scope */
+struct GPUTimerScope
+{
+    const char* name;
+    size_t depth; /**< Nesting level; 0 for outermost scopes */
+    double ms;
+};
+
+/** GPU time and draws spent on one render target, summed over the frame */
+struct GPUTargetTiming
+{
+    const ITextureR* target; /**< Identity only; the texture may be gone by the time results arrive */
+    double ms;
+    size_t drawCount;
+};
+
+/** GPU-side summary of one completed frame */
+struct GPUFrameTimings
+{
+    uint64_t frame = 0; /**< Matches FrameStats::frame */
+    double totalMs = 0.0;
+    size_t drawCount = 0;
+    std::vector<GPUTargetTiming> targets;
+    std::vector<GPUTimerScope> scopes; /**< In the order the scopes began */
+};
+
+/** Draw-level command recorder that a worker thread fills in parallel with others.
+ *  A list is begun against the render target it will be spliced into and inherits
+ *  no binding, viewport or scissor state; each list must only be touched by one
+ *  thread at a time and must be recorded between two execute() calls */
+struct IGraphicsCommandList
+{
+    virtual ~IGraphicsCommandList() {}
+
+    virtual void begin(ITextureR* target)=0;
+    virtual void end()=0;
+
+    virtual void setShaderDataBinding(IShaderDataBinding* binding)=0;
+    virtual void setViewport(const SWindowRect& rect, float znear=0.f, float zfar=1.f)=0;
+    virtual void setScissor(const SWindowRect& rect)=0;
+
+    virtual void draw(size_t start, size_t count)=0;
+    virtual void drawIndexed(size_t start, size_t count)=0;
+    virtual void drawInstances(size_t start, size_t count, size_t instCount)=0;
+    virtual void drawInstancesIndexed(size_t start, size_t count, size_t instCount)=0;
+};
+
 struct IGraphicsCommandQueue
 {
     virtual ~IGraphicsCommandQueue() {}
@@ -32,11 +112,71 @@ struct IGraphicsCommandQueue
     virtual void drawInstances(size_t start, size_t count, size_t instCount)=0;
     virtual void drawInstancesIndexed(size_t start, size_t count, size_t instCount)=0;
 
+    /** Issue drawCount draws whose tightly-packed argument records are read from a
+     *  BufferUse::Indirect buffer at the given byte offset; no-op on backends lacking support */
+    virtual void drawIndirect(IGraphicsBuffer* buf, size_t offset, size_t drawCount=1) {}
+    virtual void drawIndexedIndirect(IGraphicsBuffer* buf, size_t offset, size_t drawCount=1) {}
+
     virtual void resolveBindTexture(ITextureR* texture, const SWindowRect& rect, bool tlOrigin, bool color, bool depth)=0;
     virtual void resolveDisplay(ITextureR* source)=0;
+
+    /** Copy rect (bottom-left origin, like setViewport) of texture's color at this point in
+     *  the frame without stalling. callback fires during a later frame, once the GPU has
+     *  written the pixels, on the thread that submits frames to the API (the render thread
+     *  on GL, the execute() caller on Vulkan). A rect that is empty once clipped to the
+     *  texture, or a texture never rendered to, fires the same way with empty data
+     *  (0x0, null pixels). Readbacks of a frame that is dropped, or still pending at
+     *  shutdown, never fire; no-op on backends lacking support */
+    virtual void readback(ITextureR* texture, const SWindowRect& rect, ReadbackFunc&& callback) {}
+
     virtual void execute()=0;
 
     virtual void stopRenderer()=0;
+
+    /** Create a list for worker-thread recording; empty if the backend lacks support */
+    virtual std::unique_ptr<IGraphicsCommandList> newCommandList() {return {};}
+
+    /** Splice ended lists into the current frame in array order (client thread only).
+     *  Binding, viewport and scissor state must be set again afterwards */
+    virtual void executeCommandLists(IGraphicsCommandList* const* lists, size_t count) {}
+
+    /** Counters gathered while recording and submitting the most recent frame */
+    struct FrameCounters
+    {
+        size_t dynamicUploads = 0; /**< Dynamic buffers/textures uploaded by the last execute() */
+        size_t stateChangesIssued = 0; /**< Binding/state calls sent to the API in the last drawn frame */
+        size_t stateChangesElided = 0; /**< Binding/state calls skipped as redundant in the last drawn frame */
+        size_t throttledFrames = 0; /**< execute() calls that blocked on the GPU since the queue was created */
+    };
+    virtual FrameCounters getFrameCounters() const {return {};}
+
+    /** Throughput keeps every frame slot busy; Latency lets execute() return only
+     *  once all but the just-submitted frame have retired */
+    enum class PacingMode
+    {
+        Throughput,
+        Latency
+    };
+    virtual void setPacingMode(PacingMode mode) {}
+    virtual PacingMode pacingMode() const {return PacingMode::Throughput;}
+
+    /** Copy up to maxCount of the newest frame timelines into out, oldest first;
+     *  returns the count copied. Frames dropped on resize are not recorded */
+    virtual size_t getFrameStats(FrameStats* out, size_t maxCount) const {return 0;}
+
+    /** GPU timing (off by default) brackets every render target pass and timer scope
+     *  with timestamp queries; it takes effect from the next frame */
+    virtual void setGPUTimingEnabled(bool enabled) {}
+    virtual bool gpuTimingEnabled() const {return false;}
+
+    /** Nestable GPU timer scope within the current frame; name must outlive the
+     *  results (string literals are ideal). Scopes left open close with the frame */
+    virtual void beginTimer(const char* name) {}
+    virtual void endTimer() {}
+
+    /** Copy the newest frame whose GPU timings have been resolved, a few frames
+     *  after it was submitted; false if none is available */
+    virtual bool getGPUTimings(GPUFrameTimings& out) const {return false;}
 };
 
 }
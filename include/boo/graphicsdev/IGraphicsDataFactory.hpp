@@ -31,6 +31,10 @@ protected:
 struct IGraphicsBufferD : IGraphicsBuffer
 {
     virtual void load(const void* data, size_t sz)=0;
+
+    /** Write-discard: the returned memory may not hold the buffer's current
+     *  contents (GL hands out GPU-visible storage directly), so every byte
+     *  the buffer's draws use must be written before unmap() */
     virtual void* map(size_t sz)=0;
     virtual void unmap()=0;
 protected:
@@ -43,7 +47,8 @@ enum class BufferUse
     Null,
     Vertex,
     Index,
-    Uniform
+    Uniform,
+    Indirect
 };
 
 enum class TextureType
@@ -140,8 +145,15 @@ struct VertexElementDescriptor
 };
 
 /** Opaque token for referencing a complete graphics pipeline state necessary
- *  to rasterize geometry (shaders and blending modes mainly) */
-struct IShaderPipeline {};
+ *  to rasterize geometry (shaders and blending modes mainly)
+ *
+ *  Pipelines from a backend's newShaderPipelineAsync may still be compiling;
+ *  binding one that is not ready blocks until it is */
+struct IShaderPipeline
+{
+    virtual bool isReady() const {return true;}
+    virtual void waitReady() const {}
+};
 
 /** Opaque token serving as indirection table for shader resources
  *  and IShaderPipeline reference. Each renderable surface-material holds one
@@ -149,7 +161,10 @@ struct IShaderPipeline {};
 struct IShaderDataBinding {};
 
 /** Opaque object for maintaining ownership of factory-created resources */
-struct IGraphicsData {};
+struct IGraphicsData
+{
+    IGraphicsData* m_nextDead = nullptr; /* Link while queued for deferred destruction */
+};
 class GraphicsDataToken;
 
 /** Used wherever distinction of pipeline stages is needed */
@@ -209,6 +224,18 @@ struct IGraphicsDataFactory
 
         virtual IGraphicsBufferS*
         newStaticBuffer(BufferUse use, const void* data, size_t stride, size_t count)=0;
+
+        /** Static buffer whose contents fill writes directly into upload memory
+         *  (stride * count bytes); backends without mapped staging fall back to
+         *  an intermediate copy */
+        virtual IGraphicsBufferS*
+        newStaticBufferInPlace(BufferUse use, size_t stride, size_t count,
+                               const std::function<void(void* data)>& fill)
+        {
+            std::unique_ptr<uint8_t[]> data(new uint8_t[stride * count]);
+            fill(data.get());
+            return newStaticBuffer(use, data.get(), stride, count);
+        }
         virtual IGraphicsBufferD*
         newDynamicBuffer(BufferUse use, size_t stride, size_t count)=0;
 
@@ -254,13 +281,16 @@ private:
     friend class GraphicsDataToken;
     virtual void destroyData(IGraphicsData*)=0;
     virtual void destroyAllData()=0;
+    virtual bool isDataReady(IGraphicsData*) {return true;}
 };
 
 using FactoryCommitFunc = std::function<bool(IGraphicsDataFactory::Context& ctx)>;
 
 /** Ownership token for maintaining lifetime of factory-created resources
  *  deletion of this token triggers mass-deallocation of the factory's
- *  IGraphicsData (please don't delete and draw contained resources in the same frame). */
+ *  IGraphicsData. GL and Vulkan defer the deallocation until frames already
+ *  recorded with the resources have completed; other backends free immediately
+ *  (please don't delete and draw contained resources in the same frame there). */
 class GraphicsDataToken
 {
     friend class GLDataFactory;
@@ -268,6 +298,8 @@ class GraphicsDataToken
     friend class D3D11DataFactory;
     friend class MetalDataFactory;
     friend class VulkanDataFactory;
+    friend class NullDataFactory;
+    friend class CaptureDataFactory;
     IGraphicsDataFactory* m_factory = nullptr;
     IGraphicsData* m_data = nullptr;
     GraphicsDataToken(IGraphicsDataFactory* factory, IGraphicsData* data)
@@ -303,6 +335,10 @@ public:
     }
     ~GraphicsDataToken() {doDestroy();}
     operator bool() const {return m_factory && m_data;}
+
+    /** True once the GPU has received all of the transaction's initial data.
+     *  Resources may be drawn before then; their draws are queued behind the upload */
+    bool isReady() const {return !m_factory || !m_data || m_factory->isDataReady(m_data);}
 };
 
 }
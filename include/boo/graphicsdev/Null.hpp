@@ -0,0 +1,222 @@
+#ifndef GDEV_NULL_HPP
+#define GDEV_NULL_HPP
+
+#include "IGraphicsDataFactory.hpp"
+#include "IGraphicsCommandQueue.hpp"
+#include "DeferredDestroyQueue.hpp"
+#include <vector>
+#include <unordered_set>
+#include <mutex>
+
+namespace boo
+{
+struct NullData;
+class NullGraphicsBufferD;
+class NullTextureD;
+
+/** Resources held by a NullDataFactory's live transactions */
+struct NullResourceCounts
+{
+    size_t transactions = 0;
+    size_t staticBuffers = 0;
+    size_t dynamicBuffers = 0;
+    size_t staticTextures = 0; /**< Including array textures */
+    size_t dynamicTextures = 0;
+    size_t renderTextures = 0;
+    size_t vertexFormats = 0;
+    size_t pipelines = 0;
+    size_t bindings = 0;
+    size_t staticBytes = 0; /**< Initial data handed to static buffers and textures */
+    size_t dynamicBytes = 0; /**< CPU storage behind dynamic buffers and textures */
+
+    NullResourceCounts& operator+=(const NullResourceCounts& other);
+    NullResourceCounts& operator-=(const NullResourceCounts& other);
+};
+
+/** Data factory that keeps every resource in CPU memory and never touches a GPU;
+ *  for benchmarking client-side recording and for headless simulation runs.
+ *  Destroyed transactions are freed by the paired NullCommandQueue's execute() */
+class NullDataFactory : public IGraphicsDataFactory
+{
+    friend class NullCommandQueue;
+    friend class NullGraphicsBufferD;
+    friend class NullTextureD;
+    static ThreadLocalPtr<NullData> m_deferredData;
+    std::unordered_set<NullData*> m_committedData;
+    mutable std::mutex m_committedMutex;
+    NullResourceCounts m_counts; /* Guarded by m_committedMutex */
+    DeferredDestroyQueue m_deadData;
+
+    /* Dynamic resources written since the last execute() */
+    std::mutex m_dirtyMt;
+    std::unordered_set<NullGraphicsBufferD*> m_dirtyBufs;
+    std::unordered_set<NullTextureD*> m_dirtyTexs;
+
+    void destroyData(IGraphicsData*);
+    void destroyAllData();
+    void deleteData(NullData* data);
+public:
+    NullDataFactory() = default;
+    ~NullDataFactory() {destroyAllData();}
+
+    Platform platform() const {return Platform::Null;}
+    const SystemChar* platformName() const {return _S("Null");}
+
+    NullResourceCounts resourceCounts() const;
+
+    class Context : public IGraphicsDataFactory::Context
+    {
+        friend class NullDataFactory;
+        NullDataFactory& m_parent;
+        Context(NullDataFactory& parent) : m_parent(parent) {}
+    public:
+        Platform platform() const {return Platform::Null;}
+        const SystemChar* platformName() const {return _S("Null");}
+
+        IGraphicsBufferS* newStaticBuffer(BufferUse use, const void* data, size_t stride, size_t count);
+        IGraphicsBufferD* newDynamicBuffer(BufferUse use, size_t stride, size_t count);
+
+        ITextureS* newStaticTexture(size_t width, size_t height, size_t mips, TextureFormat fmt,
+                                    const void* data, size_t sz);
+        ITextureSA* newStaticArrayTexture(size_t width, size_t height, size_t layers, TextureFormat fmt,
+                                          const void* data, size_t sz);
+        ITextureD* newDynamicTexture(size_t width, size_t height, TextureFormat fmt);
+        ITextureR* newRenderTexture(size_t width, size_t height,
+                                    bool enableShaderColorBinding, bool enableShaderDepthBinding);
+
+        /* Formats are accepted but never required */
+        bool bindingNeedsVertexFormat() const {return false;}
+        IVertexFormat* newVertexFormat(size_t elementCount, const VertexElementDescriptor* elements);
+
+        /* Same parameters as the GL backend so GLSL client paths run unchanged;
+         * sources are not compiled */
+        IShaderPipeline* newShaderPipeline(const char* vertSource, const char* fragSource,
+                                           size_t texCount, const char** texNames,
+                                           size_t uniformBlockCount, const char** uniformBlockNames,
+                                           BlendFactor srcFac, BlendFactor dstFac, Primitive prim,
+                                           bool depthTest, bool depthWrite, bool backfaceCulling);
+
+        IShaderDataBinding*
+        newShaderDataBinding(IShaderPipeline* pipeline,
+                             IVertexFormat* vtxFormat,
+                             IGraphicsBuffer* vbo, IGraphicsBuffer* instVbo, IGraphicsBuffer* ibo,
+                             size_t ubufCount, IGraphicsBuffer** ubufs, const PipelineStage* ubufStages,
+                             const size_t* ubufOffs, const size_t* ubufSizes,
+                             size_t texCount, ITexture** texs);
+    };
+
+    GraphicsDataToken commitTransaction(const FactoryCommitFunc&);
+};
+
+/** Commands accepted by a NullCommandQueue */
+struct NullCommandCounts
+{
+    size_t frames = 0;
+    size_t draws = 0; /**< Indirect draws count once per argument record */
+    size_t vertices = 0; /**< Vertices or indices of direct draws, times their instances */
+    size_t instances = 0;
+    size_t bindingChanges = 0;
+    size_t redundantBindings = 0; /**< Binding calls that rebound the current binding */
+    size_t targetChanges = 0;
+    size_t viewports = 0;
+    size_t scissors = 0;
+    size_t clears = 0;
+    size_t resolveBinds = 0;
+    size_t presents = 0;
+    size_t readbacks = 0;
+    size_t commandLists = 0;
+    size_t timerScopes = 0;
+    size_t textureResizes = 0;
+    size_t dynamicUploads = 0;
+    size_t dynamicUploadBytes = 0;
+
+    NullCommandCounts& operator+=(const NullCommandCounts& other);
+};
+
+/** Command queue that tracks state and counts every command without making
+ *  API calls. execute() stages dirty dynamic resources, delivers readbacks
+ *  (zero-filled) a frame later and frees transactions destroyed before it */
+class NullCommandQueue : public IGraphicsCommandQueue
+{
+    NullDataFactory* m_factory;
+    uint64_t m_frame = 1; /* Frame being recorded */
+
+    IShaderDataBinding* m_curBinding = nullptr;
+    ITextureR* m_curTarget = nullptr;
+    NullCommandCounts m_counts; /* Frame being recorded */
+    NullCommandCounts m_lastFrame;
+    NullCommandCounts m_totals;
+    FrameCounters m_frameCounters;
+
+    struct RenderTextureResize
+    {
+        ITextureR* tex;
+        size_t width;
+        size_t height;
+    };
+    std::vector<RenderTextureResize> m_pendingResizes;
+    std::vector<std::function<void(void)>> m_pendingPosts;
+
+    struct Readback
+    {
+        size_t width;
+        size_t height;
+        ReadbackFunc func;
+    };
+    std::vector<Readback> m_recordedReadbacks;
+    std::vector<Readback> m_readbacks; /* Recorded last frame; delivered this one */
+    std::vector<uint8_t> m_readbackPixels;
+
+    bool m_presented = false;
+    uint64_t m_recordStart;
+    FrameStatsRing<FrameStats> m_frameStats;
+
+    void deliverReadbacks();
+
+public:
+    NullCommandQueue(NullDataFactory* factory);
+
+    Platform platform() const {return IGraphicsDataFactory::Platform::Null;}
+    const SystemChar* platformName() const {return _S("Null");}
+
+    /** Counts of the last executed frame and of every frame so far */
+    const NullCommandCounts& lastFrameCounts() const {return m_lastFrame;}
+    const NullCommandCounts& totalCounts() const {return m_totals;}
+
+    void setShaderDataBinding(IShaderDataBinding* binding);
+    void setRenderTarget(ITextureR* target);
+    void setViewport(const SWindowRect& rect, float znear=0.f, float zfar=1.f);
+    void setScissor(const SWindowRect& rect);
+
+    void resizeRenderTexture(ITextureR* tex, size_t width, size_t height);
+    void schedulePostFrameHandler(std::function<void(void)>&& func);
+
+    void setClearColor(const float rgba[4]) {}
+    void clearTarget(bool render=true, bool depth=true);
+
+    void draw(size_t start, size_t count);
+    void drawIndexed(size_t start, size_t count);
+    void drawInstances(size_t start, size_t count, size_t instCount);
+    void drawInstancesIndexed(size_t start, size_t count, size_t instCount);
+    void drawIndirect(IGraphicsBuffer* buf, size_t offset, size_t drawCount=1);
+    void drawIndexedIndirect(IGraphicsBuffer* buf, size_t offset, size_t drawCount=1);
+
+    void resolveBindTexture(ITextureR* texture, const SWindowRect& rect, bool tlOrigin, bool color, bool depth);
+    void resolveDisplay(ITextureR* source);
+    void readback(ITextureR* texture, const SWindowRect& rect, ReadbackFunc&& callback);
+    void execute();
+
+    void stopRenderer() {}
+
+    std::unique_ptr<IGraphicsCommandList> newCommandList();
+    void executeCommandLists(IGraphicsCommandList* const* lists, size_t count);
+
+    FrameCounters getFrameCounters() const {return m_frameCounters;}
+    size_t getFrameStats(FrameStats* out, size_t maxCount) const {return m_frameStats.copy(out, maxCount);}
+
+    void beginTimer(const char* name) {++m_counts.timerScopes;}
+};
+
+}
+
+#endif // GDEV_NULL_HPP
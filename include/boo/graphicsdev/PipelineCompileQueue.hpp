@@ -0,0 +1,44 @@
+#ifndef GDEV_PIPELINECOMPILEQUEUE_HPP
+#define GDEV_PIPELINECOMPILEQUEUE_HPP
+
+#include <functional>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <queue>
+
+namespace boo
+{
+
+/** Worker pool used by data factories to build shader pipelines off the
+ *  client thread. Threads are started on the first post() */
+class PipelineCompileQueue
+{
+    size_t m_threadCount;
+    std::vector<std::thread> m_threads;
+    std::queue<std::packaged_task<void()>> m_tasks;
+    std::mutex m_mt;
+    std::condition_variable m_cv;
+    size_t m_busy = 0;
+    std::condition_variable m_idleCv;
+    bool m_running = true;
+
+    void worker();
+public:
+    /** threadCount of 0 picks one less than the hardware concurrency */
+    PipelineCompileQueue(size_t threadCount=0);
+    ~PipelineCompileQueue();
+
+    std::shared_future<void> post(std::function<void()>&& task);
+
+    /** Blocks until every posted task has finished */
+    void waitIdle();
+
+    size_t threadCount() const {return m_threadCount;}
+};
+
+}
+
+#endif // GDEV_PIPELINECOMPILEQUEUE_HPP
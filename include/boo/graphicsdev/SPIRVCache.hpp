@@ -0,0 +1,67 @@
+#ifndef GDEV_SPIRVCACHE_HPP
+#define GDEV_SPIRVCACHE_HPP
+
+#include "boo/System.hpp"
+#include <vector>
+#include <mutex>
+#include <stdint.h>
+
+namespace boo
+{
+
+/** Content-addressed on-disk store of compiled SPIR-V programs.
+ *
+ *  Each entry holds the vertex and fragment modules of one GLSL program
+ *  under the hash of both sources and the front-end options. Entries are
+ *  published with an atomic rename and their modification time serves as
+ *  the LRU stamp, so several processes may share one directory. */
+class SPIRVCache
+{
+public:
+    struct Stats
+    {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t stores = 0;
+        size_t evictions = 0;
+        uint64_t bytes = 0; /**< Approximate size of the directory's entries */
+    };
+
+    /** The hash names the entry; the independent check hash and the source
+     *  lengths are stored in it and compared on load, so a colliding hash
+     *  misses instead of returning another program's SPIR-V */
+    struct Key
+    {
+        uint64_t hash = 0;
+        uint64_t check = 0;
+        uint32_t vertLen = 0;
+        uint32_t fragLen = 0;
+    };
+
+private:
+    mutable std::mutex m_mt;
+    SystemString m_dir;
+    uint64_t m_maxBytes = 0;
+    bool m_evicting = false;
+    Stats m_stats;
+
+    SystemString entryPath(uint64_t hash) const;
+    void maybeEvict(std::unique_lock<std::mutex>& lk);
+    void evict(const SystemString& dir, uint64_t maxBytes);
+
+public:
+    /** Empty dir disables the cache; maxBytes of 0 means unbounded */
+    void setDirectory(const SystemString& dir, uint64_t maxBytes=64*1024*1024);
+    bool enabled() const;
+
+    static Key MakeKey(const char* vertSource, const char* fragSource, const char* options);
+
+    bool load(const Key& key, std::vector<unsigned int>& vertOut, std::vector<unsigned int>& fragOut);
+    void store(const Key& key, const std::vector<unsigned int>& vert, const std::vector<unsigned int>& frag);
+
+    Stats getStats() const;
+};
+
+}
+
+#endif // GDEV_SPIRVCACHE_HPP
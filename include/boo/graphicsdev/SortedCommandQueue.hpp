@@ -0,0 +1,137 @@
+#ifndef GDEV_SORTEDCOMMANDQUEUE_HPP
+#define GDEV_SORTEDCOMMANDQUEUE_HPP
+
+#include "IGraphicsCommandQueue.hpp"
+#include <vector>
+#include <stdint.h>
+
+namespace boo
+{
+
+/** Command queue layer that records draws with a 64-bit sort key and hands
+ *  them to the wrapped backend queue in key order.
+ *
+ *  Draws between two ordering fences (setRenderTarget, clearTarget, resolveBindTexture,
+ *  resolveDisplay, readback, beginTimer, endTimer and executeCommandLists) are
+ *  radix-sorted by key; draws with equal keys keep their submission order. Each
+ *  draw carries the binding, viewport and scissor that were current when it was
+ *  recorded. */
+class SortedCommandQueue : public IGraphicsCommandQueue
+{
+public:
+    /** Key layout, most significant first: pass (8), pipeline (16), binding (16), depth (24) */
+    static uint64_t MakeSortKey(uint8_t pass, uint16_t pipeline, uint16_t binding, float depth);
+
+private:
+    IGraphicsCommandQueue* m_backend;
+    bool m_sorting = true;
+    uint64_t m_sortKey = 0;
+
+    struct Viewport
+    {
+        SWindowRect rect;
+        float znear, zfar;
+    };
+
+    struct Draw
+    {
+        enum class Op : uint8_t
+        {
+            Draw,
+            DrawIndexed,
+            DrawInstances,
+            DrawInstancesIndexed,
+            DrawIndirect,
+            DrawIndexedIndirect
+        } m_op;
+        IShaderDataBinding* m_binding;
+        IGraphicsBuffer* m_indirectBuf; /* Indirect ops reuse m_start/m_count as offset/drawCount */
+        uint32_t m_viewport;
+        uint32_t m_scissor;
+        size_t m_start;
+        size_t m_count;
+        size_t m_instCount;
+    };
+
+    /* Recorded (client-visible) state */
+    IShaderDataBinding* m_curBinding = nullptr;
+    std::vector<Viewport> m_viewports;
+    std::vector<SWindowRect> m_scissors;
+
+    /* State last handed to the backend (~0 when unknown) */
+    IShaderDataBinding* m_emitBinding = nullptr;
+    uint32_t m_emitViewport = ~uint32_t(0);
+    uint32_t m_emitScissor = ~uint32_t(0);
+
+    /* Draws of the current fence segment with their keys; sorted via m_order */
+    std::vector<Draw> m_draws;
+    std::vector<uint64_t> m_keys;
+    std::vector<uint32_t> m_order;
+    std::vector<uint32_t> m_orderTmp;
+
+    void recordDraw(Draw::Op op, size_t start, size_t count, size_t instCount,
+                    IGraphicsBuffer* indirectBuf=nullptr);
+    void emitDraw(const Draw& draw);
+    void syncViewportScissor();
+    void invalidateEmitted();
+    void flush();
+    void radixSort();
+
+public:
+    SortedCommandQueue(IGraphicsCommandQueue* backend);
+
+    IGraphicsCommandQueue* backend() const {return m_backend;}
+
+    /** When disabled, every command is forwarded to the backend immediately */
+    void setSorting(bool enabled);
+    bool sorting() const {return m_sorting;}
+
+    /** Key attached to all subsequently recorded draws */
+    void setSortKey(uint64_t key) {m_sortKey = key;}
+
+    Platform platform() const {return m_backend->platform();}
+    const SystemChar* platformName() const {return m_backend->platformName();}
+
+    void setShaderDataBinding(IShaderDataBinding* binding);
+    void setRenderTarget(ITextureR* target);
+    void setViewport(const SWindowRect& rect, float znear=0.f, float zfar=1.f);
+    void setScissor(const SWindowRect& rect);
+
+    void resizeRenderTexture(ITextureR* tex, size_t width, size_t height);
+    void schedulePostFrameHandler(std::function<void(void)>&& func);
+
+    void setClearColor(const float rgba[4]);
+    void clearTarget(bool render=true, bool depth=true);
+
+    void draw(size_t start, size_t count);
+    void drawIndexed(size_t start, size_t count);
+    void drawInstances(size_t start, size_t count, size_t instCount);
+    void drawInstancesIndexed(size_t start, size_t count, size_t instCount);
+    void drawIndirect(IGraphicsBuffer* buf, size_t offset, size_t drawCount=1);
+    void drawIndexedIndirect(IGraphicsBuffer* buf, size_t offset, size_t drawCount=1);
+
+    void resolveBindTexture(ITextureR* texture, const SWindowRect& rect, bool tlOrigin, bool color, bool depth);
+    void resolveDisplay(ITextureR* source);
+    void readback(ITextureR* texture, const SWindowRect& rect, ReadbackFunc&& callback);
+    void execute();
+
+    void stopRenderer() {m_backend->stopRenderer();}
+
+    std::unique_ptr<IGraphicsCommandList> newCommandList() {return m_backend->newCommandList();}
+    void executeCommandLists(IGraphicsCommandList* const* lists, size_t count);
+
+    FrameCounters getFrameCounters() const {return m_backend->getFrameCounters();}
+    void setPacingMode(PacingMode mode) {m_backend->setPacingMode(mode);}
+    PacingMode pacingMode() const {return m_backend->pacingMode();}
+
+    size_t getFrameStats(FrameStats* out, size_t maxCount) const {return m_backend->getFrameStats(out, maxCount);}
+    void setGPUTimingEnabled(bool enabled) {m_backend->setGPUTimingEnabled(enabled);}
+    bool gpuTimingEnabled() const {return m_backend->gpuTimingEnabled();}
+    void beginTimer(const char* name);
+    void endTimer();
+    bool getGPUTimings(GPUFrameTimings& out) const {return m_backend->getGPUTimings(out);}
+};
+
+}
+
+#endif // GDEV_SORTEDCOMMANDQUEUE_HPP
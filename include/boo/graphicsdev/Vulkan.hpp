@@ -6,10 +6,14 @@
 #include "IGraphicsCommandQueue.hpp"
 #include "boo/IGraphicsContext.hpp"
 #include "GLSLMacros.hpp"
+#include "PipelineCompileQueue.hpp"
+#include "DeferredDestroyQueue.hpp"
+#include "SPIRVCache.hpp"
 #include <vector>
 #include <unordered_set>
 #include <unordered_map>
 #include <mutex>
+#include <shared_mutex>
 #include "boo/graphicsdev/VulkanDispatchTable.hpp"
 
 namespace boo
@@ -30,6 +34,7 @@ struct VulkanContext
     std::vector<const char*> m_deviceExtensionNames;
     std::vector<VkPhysicalDevice> m_gpus;
     VkPhysicalDeviceProperties m_gpuProps;
+    VkPhysicalDeviceFeatures m_features = {}; /* Optional features enabled on m_dev */
     VkPhysicalDeviceMemoryProperties m_memoryProperties;
     VkDevice m_dev;
     uint32_t m_queueCount;
@@ -40,11 +45,18 @@ struct VulkanContext
     VkDescriptorSetLayout m_descSetLayout;
     VkPipelineLayout m_pipelinelayout;
     VkRenderPass m_pass;
-    VkCommandPool m_loadPool;
-    VkCommandBuffer m_loadCmdBuf;
     VkSampler m_linearSampler;
     VkFormat m_displayFormat;
 
+    /* Set before initVulkan() to drive a device with no surface or swapchain
+     * (see VulkanHeadless.hpp); such an instance cannot host windows later */
+    bool m_headless = false;
+
+    /* Frames the CPU may record ahead of the GPU; set before initDevice(),
+     * which clamps it to [1, MaxFramesInFlight]. Fixed once queues exist */
+    static const uint32_t MaxFramesInFlight = 4;
+    uint32_t m_framesInFlight = 2;
+
     struct Window
     {
         struct SwapChain
@@ -76,26 +88,77 @@ struct VulkanContext
     void initVulkan(const char* appName);
     bool enumerateDevices();
     void initDevice();
+    void initLoadResources();
+    void initHeadless();
     void initSwapChain(Window& windowCtx, VkSurfaceKHR surface, VkFormat format, VkColorSpaceKHR colorspace);
     void resizeSwapChain(Window& windowCtx, VkSurfaceKHR surface, VkFormat format, VkColorSpaceKHR colorspace);
 };
 extern VulkanContext g_VulkanContext;
+class VulkanDeviceAllocator;
+class VulkanDescriptorAllocator;
+class VulkanUploadManager;
 
 class VulkanDataFactory : public IGraphicsDataFactory
 {
     friend struct VulkanCommandQueue;
+    friend class VulkanShaderPipeline;
     IGraphicsContext* m_parent;
     VulkanContext* m_ctx;
     uint32_t m_drawSamples;
     static ThreadLocalPtr<struct VulkanData> m_deferredData;
     std::unordered_set<struct VulkanData*> m_committedData;
     std::mutex m_committedMutex;
+    DeferredDestroyQueue m_deadData; /* Retired by VulkanCommandQueue::execute() */
     std::vector<int> m_texUnis;
+    PipelineCompileQueue m_compileQueue;
+    VkPipelineCache m_pipelineCache = VK_NULL_HANDLE; /* Shared by every pipeline this factory builds */
+    std::shared_timed_mutex m_pipelineCacheMt;
+    SystemString m_pipelineCachePath;
+    std::unordered_set<uint64_t> m_mergedBlobs; /* Hashes of per-pipeline blobs already merged */
+    std::mutex m_mergedBlobsMt;
+    SPIRVCache m_spirvCache;
+    std::unique_ptr<VulkanDeviceAllocator> m_allocator;
+    std::unique_ptr<VulkanDescriptorAllocator> m_descAllocator;
+    std::unique_ptr<VulkanUploadManager> m_uploader;
+    bool mergePipelineCacheData(const unsigned char* data, size_t sz);
+    void mergePipelineBlob(const std::vector<unsigned char>& blob);
     void destroyData(IGraphicsData*);
     void destroyAllData();
+    bool isDataReady(IGraphicsData*);
 public:
     VulkanDataFactory(IGraphicsContext* parent, VulkanContext* ctx, uint32_t drawSamples);
-    ~VulkanDataFactory() {destroyAllData();}
+    ~VulkanDataFactory();
+
+    /** Merges the pipeline cache stored at path (if it was written for this device)
+     *  and remembers path for savePipelineCache() and shutdown */
+    bool loadPipelineCache(const SystemString& path);
+    bool savePipelineCache();
+    std::vector<unsigned char> getPipelineCacheData();
+
+    /** Compiled SPIR-V for pipelines created without vertex/fragment blobs;
+     *  disabled until given a directory */
+    SPIRVCache& spirvCache() {return m_spirvCache;}
+
+    /** Snapshot of the device-memory sub-allocator backing committed transactions */
+    struct MemoryStats
+    {
+        size_t blockCount = 0;         /**< Live vkAllocateMemory allocations */
+        size_t allocationCount = 0;    /**< Live transaction sub-allocations */
+        uint64_t reservedBytes = 0;    /**< Device memory held by all blocks */
+        uint64_t usedBytes = 0;        /**< Bytes handed out, rounded to buddy sizes */
+        uint64_t requestedBytes = 0;   /**< Bytes actually requested by transactions */
+        uint64_t largestFreeRange = 0; /**< Largest range a new transaction could get without a new block */
+        float fragmentation = 0.f;     /**< 1 - largestFreeRange / free bytes */
+    };
+    MemoryStats getMemoryStats() const;
+
+    struct DescriptorStats
+    {
+        size_t livePools = 0; /**< Descriptor pools in existence, idle ones included */
+        size_t idlePools = 0; /**< Pools with no live sets, kept for later transactions */
+        size_t liveSets = 0;  /**< Sets held by committed transactions */
+    };
+    DescriptorStats getDescriptorStats() const;
 
     Platform platform() const {return Platform::Vulkan;}
     const SystemChar* platformName() const {return _S("Vulkan");}
@@ -110,6 +173,8 @@ public:
         const SystemChar* platformName() const {return _S("Vulkan");}
 
         IGraphicsBufferS* newStaticBuffer(BufferUse use, const void* data, size_t stride, size_t count);
+        IGraphicsBufferS* newStaticBufferInPlace(BufferUse use, size_t stride, size_t count,
+                                                 const std::function<void(void* data)>& fill);
         IGraphicsBufferD* newDynamicBuffer(BufferUse use, size_t stride, size_t count);
 
         ITextureS* newStaticTexture(size_t width, size_t height, size_t mips, TextureFormat fmt,
@@ -123,9 +188,13 @@ public:
         bool bindingNeedsVertexFormat() const {return false;}
         IVertexFormat* newVertexFormat(size_t elementCount, const VertexElementDescriptor* elements);
 
+        /** A non-empty pipelineBlob is merged once into the factory's shared
+         *  pipeline cache; repeats of the same blob are skipped. Pipelines are
+         *  created against the shared cache, so there is no per-pipeline blob
+         *  to hand back: persist getPipelineCacheData() or use loadPipelineCache() */
         IShaderPipeline* newShaderPipeline(const char* vertSource, const char* fragSource,
                                            std::vector<unsigned int>& vertBlobOut, std::vector<unsigned int>& fragBlobOut,
-                                           std::vector<unsigned char>& pipelineBlob, IVertexFormat* vtxFmt,
+                                           const std::vector<unsigned char>& pipelineBlob, IVertexFormat* vtxFmt,
                                            BlendFactor srcFac, BlendFactor dstFac, Primitive prim,
                                            bool depthTest, bool depthWrite, bool backfaceCulling);
 
@@ -135,11 +204,16 @@ public:
         {
             std::vector<unsigned int> vertBlob;
             std::vector<unsigned int> fragBlob;
-            std::vector<unsigned char> pipelineBlob;
-            return newShaderPipeline(vertSource, fragSource, vertBlob, fragBlob, pipelineBlob,
+            return newShaderPipeline(vertSource, fragSource, vertBlob, fragBlob, {},
                                      vtxFmt, srcFac, dstFac, prim, depthTest, depthWrite, backfaceCulling);
         }
 
+        /* Returns immediately; SPIR-V generation and pipeline creation run on the
+         * factory's compile queue. Sources are copied, vtxFmt must outlive the build */
+        IShaderPipeline* newShaderPipelineAsync(const char* vertSource, const char* fragSource, IVertexFormat* vtxFmt,
+                                                BlendFactor srcFac, BlendFactor dstFac, Primitive prim,
+                                                bool depthTest, bool depthWrite, bool backfaceCulling);
+
         IShaderDataBinding*
         newShaderDataBinding(IShaderPipeline* pipeline,
                              IVertexFormat* vtxFormat,
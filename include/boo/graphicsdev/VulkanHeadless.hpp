@@ -0,0 +1,33 @@
+#ifndef GDEV_VULKANHEADLESS_HPP
+#define GDEV_VULKANHEADLESS_HPP
+#if BOO_HAS_VULKAN
+
+#include "IGraphicsCommandQueue.hpp"
+#include "boo/IGraphicsContext.hpp"
+#include "boo/graphicsdev/VulkanDispatchTable.hpp"
+#include <memory>
+
+namespace boo
+{
+struct VulkanContext;
+
+/** Create and initialize a Vulkan context with no surface or swapchain.
+ *
+ *  ctx (normally &g_VulkanContext) must not have an instance yet, or must have
+ *  been set up headless by an earlier call; a headless instance cannot host
+ *  windows. getVkProc may be null to load the system Vulkan loader.
+ *
+ *  Clients render into ITextureR targets through the regular VulkanDataFactory
+ *  and command queue. resolveDisplay() becomes a readback of the whole source,
+ *  delivered to displayReadback (nothing when empty) like any readback() a few
+ *  frames later. There is no retrace, so execute() is paced by the GPU alone.
+ *  Returns empty if no Vulkan device is available */
+std::unique_ptr<IGraphicsContext> NewVulkanHeadlessContext(VulkanContext* ctx,
+                                                           PFN_vkGetInstanceProcAddr getVkProc=nullptr,
+                                                           uint32_t drawSamples=1,
+                                                           ReadbackFunc&& displayReadback={});
+
+}
+
+#endif
+#endif // GDEV_VULKANHEADLESS_HPP
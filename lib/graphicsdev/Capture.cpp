@@ -0,0 +1,1522 @@
+#include "boo/graphicsdev/Capture.hpp"
+#include "boo/graphicsdev/GL.hpp"
+#include "boo/graphicsdev/Vulkan.hpp"
+#include "boo/graphicsdev/Null.hpp"
+#include "boo/FrameStats.hpp"
+#include <string.h>
+#include <string>
+
+#include "logvisor/logvisor.hpp"
+
+namespace boo
+{
+static logvisor::Module Log("boo::Capture");
+
+/* File layout: magic, format version and the captured platform, then records
+ * of a one-byte op followed by LEB128 integers (zigzagged when signed), raw
+ * little-endian floats and length-prefixed blobs. Objects are named by ids
+ * unique over the whole capture; 0 stands for null */
+static const uint8_t CaptureMagic[4] = {'B', 'O', 'O', 'C'};
+static const uint64_t CaptureVersion = 1;
+
+/* Sanity limit on ids so a corrupt file cannot drive huge allocations */
+static const uint64_t MaxCaptureId = 1 << 26;
+
+enum class CaptureOp : uint8_t
+{
+    /* Resources */
+    TransactionBegin = 1,
+    TransactionEnd,
+    DestroyData,
+    NewStaticBuffer,
+    NewDynamicBuffer,
+    NewStaticTexture,
+    NewStaticArrayTexture,
+    NewDynamicTexture,
+    NewRenderTexture,
+    NewVertexFormat,
+    NewShaderPipeline,
+    NewShaderDataBinding,
+    BufferLoad,
+    TextureLoad,
+
+    /* Commands (the first six are also valid inside command lists) */
+    SetShaderDataBinding = 32,
+    SetViewport,
+    SetScissor,
+    Draw,
+    DrawIndexed,
+    DrawInstances,
+    DrawInstancesIndexed,
+    SetRenderTarget,
+    ResizeRenderTexture,
+    SetClearColor,
+    ClearTarget,
+    DrawIndirect,
+    DrawIndexedIndirect,
+    ResolveBindTexture,
+    ResolveDisplay,
+    Readback,
+    BeginTimer,
+    EndTimer,
+    ExecuteCommandLists,
+    Execute
+};
+
+enum class CaptureKind : uint8_t
+{
+    None,
+    Buffer,
+    Texture,
+    VertexFormat,
+    Pipeline,
+    Binding
+};
+
+static void PutOp(std::vector<uint8_t>& s, CaptureOp op)
+{
+    s.push_back(uint8_t(op));
+}
+
+static void PutUInt(std::vector<uint8_t>& s, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        s.push_back(uint8_t(v) | 0x80);
+        v >>= 7;
+    }
+    s.push_back(uint8_t(v));
+}
+
+static void PutInt(std::vector<uint8_t>& s, int64_t v)
+{
+    PutUInt(s, (uint64_t(v) << 1) ^ uint64_t(v >> 63));
+}
+
+static void PutFloat(std::vector<uint8_t>& s, float v)
+{
+    uint8_t bytes[4];
+    memcpy(bytes, &v, 4);
+    s.insert(s.end(), bytes, bytes + 4);
+}
+
+static void PutBytes(std::vector<uint8_t>& s, const void* data, size_t sz)
+{
+    PutUInt(s, sz);
+    if (sz)
+        s.insert(s.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + sz);
+}
+
+static void PutString(std::vector<uint8_t>& s, const char* str)
+{
+    PutBytes(s, str, str ? strlen(str) : 0);
+}
+
+static void PutRect(std::vector<uint8_t>& s, const SWindowRect& rect)
+{
+    PutInt(s, rect.location[0]);
+    PutInt(s, rect.location[1]);
+    PutInt(s, rect.size[0]);
+    PutInt(s, rect.size[1]);
+}
+
+/* Bounds-checked decoder; once a read overruns, every later read yields zero */
+class CaptureReader
+{
+    const uint8_t* m_cur;
+    const uint8_t* m_end;
+    bool m_ok = true;
+
+    bool fail()
+    {
+        m_ok = false;
+        m_cur = m_end;
+        return false;
+    }
+
+public:
+    CaptureReader(const uint8_t* data, size_t sz) : m_cur(data), m_end(data + sz) {}
+
+    bool ok() const {return m_ok;}
+    bool atEnd() const {return m_cur >= m_end;}
+    const uint8_t* position() const {return m_cur;}
+
+    uint8_t readU8()
+    {
+        if (m_cur >= m_end)
+            return fail(), 0;
+        return *m_cur++;
+    }
+
+    uint64_t readUInt()
+    {
+        uint64_t ret = 0;
+        for (unsigned shift=0 ; shift<64 ; shift+=7)
+        {
+            if (m_cur >= m_end)
+                return fail(), 0;
+            uint8_t b = *m_cur++;
+            ret |= uint64_t(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return ret;
+        }
+        return fail(), 0;
+    }
+
+    int64_t readInt()
+    {
+        uint64_t v = readUInt();
+        return int64_t(v >> 1) ^ -int64_t(v & 1);
+    }
+
+    float readFloat()
+    {
+        if (m_end - m_cur < 4)
+            return fail(), 0.f;
+        float ret;
+        memcpy(&ret, m_cur, 4);
+        m_cur += 4;
+        return ret;
+    }
+
+    const uint8_t* readBytes(size_t& sz)
+    {
+        uint64_t len = readUInt();
+        if (len > uint64_t(m_end - m_cur))
+        {
+            sz = 0;
+            return fail(), nullptr;
+        }
+        const uint8_t* ret = m_cur;
+        m_cur += len;
+        sz = size_t(len);
+        return ret;
+    }
+
+    std::string readString()
+    {
+        size_t sz;
+        const uint8_t* str = readBytes(sz);
+        return str ? std::string(reinterpret_cast<const char*>(str), sz) : std::string();
+    }
+
+    SWindowRect readRect()
+    {
+        SWindowRect ret;
+        ret.location[0] = int(readInt());
+        ret.location[1] = int(readInt());
+        ret.size[0] = int(readInt());
+        ret.size[1] = int(readInt());
+        return ret;
+    }
+};
+
+static FILE* OpenCaptureFile(const SystemString& path, const SystemChar* mode)
+{
+#if _WIN32
+    return _wfopen(path.c_str(), mode);
+#else
+    return fopen(path.c_str(), mode);
+#endif
+}
+
+static bool WriteRecords(FILE* fp, const std::vector<uint8_t>& recs)
+{
+    return recs.empty() || fwrite(recs.data(), 1, recs.size(), fp) == recs.size();
+}
+
+/* Pipelines are captured from GLSL, which every backend taking it compiles
+ * through the same GL-style parameters (Vulkan also needs the vertex format) */
+static IShaderPipeline* NewGLSLShaderPipeline(IGraphicsDataFactory::Context& ctx,
+                                              const char* vertSource, const char* fragSource,
+                                              size_t texCount, const char** texNames,
+                                              size_t uniformBlockCount, const char** uniformBlockNames,
+                                              IVertexFormat* vtxFmt,
+                                              BlendFactor srcFac, BlendFactor dstFac, Primitive prim,
+                                              bool depthTest, bool depthWrite, bool backfaceCulling)
+{
+    switch (ctx.platform())
+    {
+    case IGraphicsDataFactory::Platform::OpenGL:
+        return static_cast<GLDataFactory::Context&>(ctx).newShaderPipeline(
+            vertSource, fragSource, texCount, texNames, uniformBlockCount, uniformBlockNames,
+            srcFac, dstFac, prim, depthTest, depthWrite, backfaceCulling);
+#if BOO_HAS_VULKAN
+    case IGraphicsDataFactory::Platform::Vulkan:
+        return static_cast<VulkanDataFactory::Context&>(ctx).newShaderPipeline(
+            vertSource, fragSource, vtxFmt, srcFac, dstFac, prim, depthTest, depthWrite, backfaceCulling);
+#endif
+    case IGraphicsDataFactory::Platform::Null:
+        return static_cast<NullDataFactory::Context&>(ctx).newShaderPipeline(
+            vertSource, fragSource, texCount, texNames, uniformBlockCount, uniformBlockNames,
+            srcFac, dstFac, prim, depthTest, depthWrite, backfaceCulling);
+    default:
+        Log.report(logvisor::Error, "GLSL pipelines are not supported by this backend");
+        return nullptr;
+    }
+}
+
+/* Records every load; map() hands out CPU storage that unmap() loads */
+class CaptureGraphicsBufferD : public IGraphicsBufferD
+{
+    friend class CaptureDataFactory;
+    CaptureDataFactory& m_parent;
+    CaptureData& m_owner;
+    IGraphicsBufferD* m_backend;
+    uint32_t m_id = 0;
+    std::unique_ptr<uint8_t[]> m_shadow;
+    size_t m_shadowSz = 0;
+    size_t m_mapSz = 0;
+
+public:
+    CaptureGraphicsBufferD(CaptureDataFactory& parent, CaptureData& owner, IGraphicsBufferD* backend)
+    : m_parent(parent), m_owner(owner), m_backend(backend) {}
+
+    IGraphicsBufferD* backend() const {return m_backend;}
+
+    void load(const void* data, size_t sz)
+    {
+        m_backend->load(data, sz);
+        m_parent.recordLoad(m_owner, uint8_t(CaptureOp::BufferLoad), m_id, data, sz);
+    }
+    void* map(size_t sz)
+    {
+        if (sz > m_shadowSz)
+        {
+            m_shadow.reset(new uint8_t[sz]);
+            m_shadowSz = sz;
+        }
+        m_mapSz = sz;
+        return m_shadow.get();
+    }
+    void unmap()
+    {
+        load(m_shadow.get(), m_mapSz);
+    }
+};
+
+class CaptureTextureD : public ITextureD
+{
+    friend class CaptureDataFactory;
+    CaptureDataFactory& m_parent;
+    CaptureData& m_owner;
+    ITextureD* m_backend;
+    uint32_t m_id = 0;
+    std::unique_ptr<uint8_t[]> m_shadow;
+    size_t m_shadowSz = 0;
+    size_t m_mapSz = 0;
+
+public:
+    CaptureTextureD(CaptureDataFactory& parent, CaptureData& owner, ITextureD* backend)
+    : m_parent(parent), m_owner(owner), m_backend(backend) {}
+
+    ITextureD* backend() const {return m_backend;}
+
+    void load(const void* data, size_t sz)
+    {
+        m_backend->load(data, sz);
+        m_parent.recordLoad(m_owner, uint8_t(CaptureOp::TextureLoad), m_id, data, sz);
+    }
+    void* map(size_t sz)
+    {
+        if (sz > m_shadowSz)
+        {
+            m_shadow.reset(new uint8_t[sz]);
+            m_shadowSz = sz;
+        }
+        m_mapSz = sz;
+        return m_shadow.get();
+    }
+    void unmap()
+    {
+        load(m_shadow.get(), m_mapSz);
+    }
+};
+
+struct CaptureData : IGraphicsData
+{
+    uint32_t m_id = 0;
+    GraphicsDataToken m_token;
+    std::vector<const void*> m_objects; /* Keys in CaptureDataFactory::m_ids */
+    std::vector<std::unique_ptr<CaptureGraphicsBufferD>> m_dynBufs;
+    std::vector<std::unique_ptr<CaptureTextureD>> m_dynTexs;
+
+    /* The transaction's own record stream while it is being committed; loads
+     * of its objects made meanwhile must follow their creation records */
+    std::vector<uint8_t>* m_openRec = nullptr;
+};
+
+CaptureDataFactory::CaptureDataFactory(IGraphicsDataFactory* backend, const SystemString& path)
+: m_backend(backend)
+{
+    m_fp = OpenCaptureFile(path, _S("wb"));
+    if (!m_fp)
+    {
+        Log.report(logvisor::Error, "unable to open capture file for writing");
+        return;
+    }
+    std::vector<uint8_t> header(CaptureMagic, CaptureMagic + 4);
+    PutUInt(header, CaptureVersion);
+    PutUInt(header, uint64_t(backend->platform()));
+    fwrite(header.data(), 1, header.size(), m_fp);
+}
+
+CaptureDataFactory::~CaptureDataFactory()
+{
+    destroyAllData();
+    if (m_fp)
+    {
+        /* Loads and destructions after the last frame are still replayed */
+        WriteRecords(m_fp, m_pending);
+        WriteRecords(m_fp, m_pendingDestroys);
+        fclose(m_fp);
+    }
+}
+
+uint32_t CaptureDataFactory::registerObject(CaptureData& data, const void* obj)
+{
+    std::unique_lock<std::mutex> lk(m_idMt);
+    uint32_t id = m_nextObjectId++;
+    m_ids[obj] = id;
+    data.m_objects.push_back(obj);
+    return id;
+}
+
+uint32_t CaptureDataFactory::objectId(const void* obj)
+{
+    if (!obj)
+        return 0;
+    std::unique_lock<std::mutex> lk(m_idMt);
+    auto search = m_ids.find(obj);
+    if (search == m_ids.end())
+    {
+        if (!m_warnedUnknown)
+            Log.report(logvisor::Warning, "objects created outside of the capture are recorded as null");
+        m_warnedUnknown = true;
+        return 0;
+    }
+    return search->second;
+}
+
+void CaptureDataFactory::forgetObjects(CaptureData& data)
+{
+    std::unique_lock<std::mutex> lk(m_idMt);
+    for (const void* obj : data.m_objects)
+        m_ids.erase(obj);
+    data.m_objects.clear();
+}
+
+/* Only registered dynamic objects are proxies; ones made outside the capture pass through */
+IGraphicsBuffer* CaptureDataFactory::backendBuffer(IGraphicsBuffer* buf)
+{
+    if (!buf || !buf->dynamic())
+        return buf;
+    std::unique_lock<std::mutex> lk(m_idMt);
+    if (m_ids.find(static_cast<const IGraphicsBuffer*>(buf)) == m_ids.end())
+        return buf;
+    return static_cast<CaptureGraphicsBufferD*>(buf)->backend();
+}
+
+ITexture* CaptureDataFactory::backendTexture(ITexture* tex)
+{
+    if (!tex || tex->type() != TextureType::Dynamic)
+        return tex;
+    std::unique_lock<std::mutex> lk(m_idMt);
+    if (m_ids.find(static_cast<const ITexture*>(tex)) == m_ids.end())
+        return tex;
+    return static_cast<CaptureTextureD*>(tex)->backend();
+}
+
+void CaptureDataFactory::recordLoad(CaptureData& owner, uint8_t op, uint32_t id, const void* data, size_t sz)
+{
+    /* Only the committing thread can reach objects of an open transaction */
+    std::vector<uint8_t>* stream = owner.m_openRec;
+    std::unique_lock<std::mutex> lk(m_streamMt, std::defer_lock);
+    if (!stream)
+    {
+        lk.lock();
+        if (!m_fp)
+            return;
+        stream = &m_pending;
+    }
+    stream->push_back(op);
+    PutUInt(*stream, id);
+    PutBytes(*stream, data, sz);
+}
+
+void CaptureDataFactory::writeFrame(const std::vector<uint8_t>& frame)
+{
+    std::unique_lock<std::mutex> lk(m_streamMt);
+    if (!m_fp)
+        return;
+    bool ok = WriteRecords(m_fp, m_pending) && WriteRecords(m_fp, frame) && WriteRecords(m_fp, m_pendingDestroys);
+    m_pending.clear();
+    m_pendingDestroys.clear();
+
+    /* Whole frames reach the file, so a crashed run leaves a replayable capture */
+    if (!ok || fflush(m_fp))
+    {
+        Log.report(logvisor::Error, "unable to write capture file; capture stopped");
+        fclose(m_fp);
+        m_fp = nullptr;
+    }
+}
+
+IGraphicsBufferS*
+CaptureDataFactory::Context::newStaticBuffer(BufferUse use, const void* data, size_t stride, size_t count)
+{
+    IGraphicsBufferS* ret = m_backend.newStaticBuffer(use, data, stride, count);
+    if (!ret)
+        return nullptr;
+    PutOp(m_rec, CaptureOp::NewStaticBuffer);
+    PutUInt(m_rec, m_parent.registerObject(m_data, static_cast<IGraphicsBuffer*>(ret)));
+    PutUInt(m_rec, uint64_t(use));
+    PutUInt(m_rec, stride);
+    PutUInt(m_rec, count);
+    PutBytes(m_rec, data, stride * count);
+    return ret;
+}
+
+IGraphicsBufferD*
+CaptureDataFactory::Context::newDynamicBuffer(BufferUse use, size_t stride, size_t count)
+{
+    IGraphicsBufferD* backend = m_backend.newDynamicBuffer(use, stride, count);
+    if (!backend)
+        return nullptr;
+    CaptureGraphicsBufferD* ret = new CaptureGraphicsBufferD(m_parent, m_data, backend);
+    m_data.m_dynBufs.emplace_back(ret);
+    ret->m_id = m_parent.registerObject(m_data, static_cast<IGraphicsBuffer*>(ret));
+    PutOp(m_rec, CaptureOp::NewDynamicBuffer);
+    PutUInt(m_rec, ret->m_id);
+    PutUInt(m_rec, uint64_t(use));
+    PutUInt(m_rec, stride);
+    PutUInt(m_rec, count);
+    return ret;
+}
+
+ITextureS*
+CaptureDataFactory::Context::newStaticTexture(size_t width, size_t height, size_t mips, TextureFormat fmt,
+                                              const void* data, size_t sz)
+{
+    ITextureS* ret = m_backend.newStaticTexture(width, height, mips, fmt, data, sz);
+    if (!ret)
+        return nullptr;
+    PutOp(m_rec, CaptureOp::NewStaticTexture);
+    PutUInt(m_rec, m_parent.registerObject(m_data, static_cast<ITexture*>(ret)));
+    PutUInt(m_rec, width);
+    PutUInt(m_rec, height);
+    PutUInt(m_rec, mips);
+    PutUInt(m_rec, uint64_t(fmt));
+    PutBytes(m_rec, data, sz);
+    return ret;
+}
+
+ITextureSA*
+CaptureDataFactory::Context::newStaticArrayTexture(size_t width, size_t height, size_t layers, TextureFormat fmt,
+                                                   const void* data, size_t sz)
+{
+    ITextureSA* ret = m_backend.newStaticArrayTexture(width, height, layers, fmt, data, sz);
+    if (!ret)
+        return nullptr;
+    PutOp(m_rec, CaptureOp::NewStaticArrayTexture);
+    PutUInt(m_rec, m_parent.registerObject(m_data, static_cast<ITexture*>(ret)));
+    PutUInt(m_rec, width);
+    PutUInt(m_rec, height);
+    PutUInt(m_rec, layers);
+    PutUInt(m_rec, uint64_t(fmt));
+    PutBytes(m_rec, data, sz);
+    return ret;
+}
+
+ITextureD*
+CaptureDataFactory::Context::newDynamicTexture(size_t width, size_t height, TextureFormat fmt)
+{
+    ITextureD* backend = m_backend.newDynamicTexture(width, height, fmt);
+    if (!backend)
+        return nullptr;
+    CaptureTextureD* ret = new CaptureTextureD(m_parent, m_data, backend);
+    m_data.m_dynTexs.emplace_back(ret);
+    ret->m_id = m_parent.registerObject(m_data, static_cast<ITexture*>(ret));
+    PutOp(m_rec, CaptureOp::NewDynamicTexture);
+    PutUInt(m_rec, ret->m_id);
+    PutUInt(m_rec, width);
+    PutUInt(m_rec, height);
+    PutUInt(m_rec, uint64_t(fmt));
+    return ret;
+}
+
+ITextureR*
+CaptureDataFactory::Context::newRenderTexture(size_t width, size_t height,
+                                              bool enableShaderColorBinding, bool enableShaderDepthBinding)
+{
+    ITextureR* ret = m_backend.newRenderTexture(width, height, enableShaderColorBinding, enableShaderDepthBinding);
+    if (!ret)
+        return nullptr;
+    PutOp(m_rec, CaptureOp::NewRenderTexture);
+    PutUInt(m_rec, m_parent.registerObject(m_data, static_cast<ITexture*>(ret)));
+    PutUInt(m_rec, width);
+    PutUInt(m_rec, height);
+    PutUInt(m_rec, (enableShaderColorBinding ? 1 : 0) | (enableShaderDepthBinding ? 2 : 0));
+    return ret;
+}
+
+IVertexFormat*
+CaptureDataFactory::Context::newVertexFormat(size_t elementCount, const VertexElementDescriptor* elements)
+{
+    std::unique_ptr<VertexElementDescriptor[]> backendElements(new VertexElementDescriptor[elementCount]);
+    for (size_t i=0 ; i<elementCount ; ++i)
+    {
+        backendElements[i] = elements[i];
+        backendElements[i].vertBuffer = m_parent.backendBuffer(elements[i].vertBuffer);
+        backendElements[i].indexBuffer = m_parent.backendBuffer(elements[i].indexBuffer);
+    }
+    IVertexFormat* ret = m_backend.newVertexFormat(elementCount, backendElements.get());
+    if (!ret)
+        return nullptr;
+    PutOp(m_rec, CaptureOp::NewVertexFormat);
+    PutUInt(m_rec, m_parent.registerObject(m_data, ret));
+    PutUInt(m_rec, elementCount);
+    for (size_t i=0 ; i<elementCount ; ++i)
+    {
+        PutUInt(m_rec, m_parent.bufferId(elements[i].vertBuffer));
+        PutUInt(m_rec, m_parent.bufferId(elements[i].indexBuffer));
+        PutUInt(m_rec, uint64_t(elements[i].semantic));
+        PutInt(m_rec, elements[i].semanticIdx);
+    }
+    return ret;
+}
+
+IShaderPipeline*
+CaptureDataFactory::Context::newShaderPipeline(const char* vertSource, const char* fragSource,
+                                               size_t texCount, const char** texNames,
+                                               size_t uniformBlockCount, const char** uniformBlockNames,
+                                               IVertexFormat* vtxFmt,
+                                               BlendFactor srcFac, BlendFactor dstFac, Primitive prim,
+                                               bool depthTest, bool depthWrite, bool backfaceCulling)
+{
+    IShaderPipeline* ret = NewGLSLShaderPipeline(m_backend, vertSource, fragSource,
+                                                 texCount, texNames, uniformBlockCount, uniformBlockNames,
+                                                 vtxFmt, srcFac, dstFac, prim,
+                                                 depthTest, depthWrite, backfaceCulling);
+    if (!ret)
+        return nullptr;
+    PutOp(m_rec, CaptureOp::NewShaderPipeline);
+    PutUInt(m_rec, m_parent.registerObject(m_data, ret));
+    PutString(m_rec, vertSource);
+    PutString(m_rec, fragSource);
+    PutUInt(m_rec, texCount);
+    for (size_t i=0 ; i<texCount ; ++i)
+        PutString(m_rec, texNames ? texNames[i] : nullptr);
+    PutUInt(m_rec, uniformBlockCount);
+    for (size_t i=0 ; i<uniformBlockCount ; ++i)
+        PutString(m_rec, uniformBlockNames ? uniformBlockNames[i] : nullptr);
+    PutUInt(m_rec, m_parent.objectId(vtxFmt));
+    PutUInt(m_rec, uint64_t(srcFac));
+    PutUInt(m_rec, uint64_t(dstFac));
+    PutUInt(m_rec, uint64_t(prim));
+    PutUInt(m_rec, (depthTest ? 1 : 0) | (depthWrite ? 2 : 0) | (backfaceCulling ? 4 : 0));
+    return ret;
+}
+
+IShaderDataBinding*
+CaptureDataFactory::Context::newShaderDataBinding(IShaderPipeline* pipeline,
+                                                  IVertexFormat* vtxFormat,
+                                                  IGraphicsBuffer* vbo, IGraphicsBuffer* instVbo, IGraphicsBuffer* ibo,
+                                                  size_t ubufCount, IGraphicsBuffer** ubufs, const PipelineStage* ubufStages,
+                                                  const size_t* ubufOffs, const size_t* ubufSizes,
+                                                  size_t texCount, ITexture** texs)
+{
+    std::unique_ptr<IGraphicsBuffer*[]> backendUbufs(new IGraphicsBuffer*[ubufCount]);
+    for (size_t i=0 ; i<ubufCount ; ++i)
+        backendUbufs[i] = m_parent.backendBuffer(ubufs[i]);
+    std::unique_ptr<ITexture*[]> backendTexs(new ITexture*[texCount]);
+    for (size_t i=0 ; i<texCount ; ++i)
+        backendTexs[i] = m_parent.backendTexture(texs[i]);
+
+    IShaderDataBinding* ret =
+    m_backend.newShaderDataBinding(pipeline, vtxFormat, m_parent.backendBuffer(vbo),
+                                   m_parent.backendBuffer(instVbo), m_parent.backendBuffer(ibo),
+                                   ubufCount, backendUbufs.get(), ubufStages, ubufOffs, ubufSizes,
+                                   texCount, backendTexs.get());
+    if (!ret)
+        return nullptr;
+    PutOp(m_rec, CaptureOp::NewShaderDataBinding);
+    PutUInt(m_rec, m_parent.registerObject(m_data, ret));
+    PutUInt(m_rec, m_parent.objectId(pipeline));
+    PutUInt(m_rec, m_parent.objectId(vtxFormat));
+    PutUInt(m_rec, m_parent.bufferId(vbo));
+    PutUInt(m_rec, m_parent.bufferId(instVbo));
+    PutUInt(m_rec, m_parent.bufferId(ibo));
+    PutUInt(m_rec, ubufCount);
+    PutUInt(m_rec, (ubufStages ? 1 : 0) | (ubufOffs ? 2 : 0) | (ubufSizes ? 4 : 0));
+    for (size_t i=0 ; i<ubufCount ; ++i)
+    {
+        PutUInt(m_rec, m_parent.bufferId(ubufs[i]));
+        if (ubufStages)
+            PutUInt(m_rec, uint64_t(ubufStages[i]));
+        if (ubufOffs)
+            PutUInt(m_rec, ubufOffs[i]);
+        if (ubufSizes)
+            PutUInt(m_rec, ubufSizes[i]);
+    }
+    PutUInt(m_rec, texCount);
+    for (size_t i=0 ; i<texCount ; ++i)
+        PutUInt(m_rec, m_parent.textureId(texs[i]));
+    return ret;
+}
+
+GraphicsDataToken CaptureDataFactory::commitTransaction(const FactoryCommitFunc& trans)
+{
+    std::unique_ptr<CaptureData> data(new CaptureData);
+    {
+        std::unique_lock<std::mutex> lk(m_idMt);
+        data->m_id = m_nextDataId++;
+    }
+
+    /* Assembled privately so transactions on loader threads land in one piece */
+    std::vector<uint8_t> rec;
+    PutOp(rec, CaptureOp::TransactionBegin);
+    PutUInt(rec, data->m_id);
+    data->m_openRec = &rec;
+    data->m_token = m_backend->commitTransaction([&](IGraphicsDataFactory::Context& backendCtx) -> bool
+    {
+        Context ctx(*this, backendCtx, *data, rec);
+        return trans(ctx);
+    });
+    data->m_openRec = nullptr;
+    if (!data->m_token)
+    {
+        forgetObjects(*data);
+        return GraphicsDataToken(this, nullptr);
+    }
+    PutOp(rec, CaptureOp::TransactionEnd);
+
+    {
+        std::unique_lock<std::mutex> lk(m_streamMt);
+        if (m_fp)
+            m_pending.insert(m_pending.end(), rec.begin(), rec.end());
+    }
+
+    std::unique_lock<std::mutex> lk(m_committedMutex);
+    CaptureData* retval = data.release();
+    m_committedData.insert(retval);
+    return GraphicsDataToken(this, retval);
+}
+
+/* The backend token defers its own destruction as usual */
+void CaptureDataFactory::destroyData(IGraphicsData* d)
+{
+    CaptureData* data = static_cast<CaptureData*>(d);
+    forgetObjects(*data);
+    {
+        std::unique_lock<std::mutex> lk(m_streamMt);
+        if (m_fp)
+        {
+            PutOp(m_pendingDestroys, CaptureOp::DestroyData);
+            PutUInt(m_pendingDestroys, data->m_id);
+        }
+    }
+    std::unique_lock<std::mutex> lk(m_committedMutex);
+    m_committedData.erase(data);
+    lk.unlock();
+    delete data;
+}
+
+void CaptureDataFactory::destroyAllData()
+{
+    std::unique_lock<std::mutex> lk(m_committedMutex);
+    for (CaptureData* data : m_committedData)
+    {
+        forgetObjects(*data);
+        delete data;
+    }
+    m_committedData.clear();
+}
+
+bool CaptureDataFactory::isDataReady(IGraphicsData* d)
+{
+    return static_cast<CaptureData*>(d)->m_token.isReady();
+}
+
+/* Records into a private stream that executeCommandLists() splices into the frame */
+class CaptureCommandList : public IGraphicsCommandList
+{
+    friend class CaptureCommandQueue;
+    CaptureDataFactory& m_factory;
+    std::unique_ptr<IGraphicsCommandList> m_backend;
+    std::vector<uint8_t> m_stream;
+
+public:
+    CaptureCommandList(CaptureDataFactory& factory, std::unique_ptr<IGraphicsCommandList>&& backend)
+    : m_factory(factory), m_backend(std::move(backend)) {}
+
+    void begin(ITextureR* target)
+    {
+        m_stream.clear();
+        PutUInt(m_stream, m_factory.textureId(target));
+        m_backend->begin(target);
+    }
+    void end() {m_backend->end();}
+
+    void setShaderDataBinding(IShaderDataBinding* binding)
+    {
+        PutOp(m_stream, CaptureOp::SetShaderDataBinding);
+        PutUInt(m_stream, m_factory.objectId(binding));
+        m_backend->setShaderDataBinding(binding);
+    }
+    void setViewport(const SWindowRect& rect, float znear, float zfar)
+    {
+        PutOp(m_stream, CaptureOp::SetViewport);
+        PutRect(m_stream, rect);
+        PutFloat(m_stream, znear);
+        PutFloat(m_stream, zfar);
+        m_backend->setViewport(rect, znear, zfar);
+    }
+    void setScissor(const SWindowRect& rect)
+    {
+        PutOp(m_stream, CaptureOp::SetScissor);
+        PutRect(m_stream, rect);
+        m_backend->setScissor(rect);
+    }
+
+    void draw(size_t start, size_t count)
+    {
+        PutOp(m_stream, CaptureOp::Draw);
+        PutUInt(m_stream, start);
+        PutUInt(m_stream, count);
+        m_backend->draw(start, count);
+    }
+    void drawIndexed(size_t start, size_t count)
+    {
+        PutOp(m_stream, CaptureOp::DrawIndexed);
+        PutUInt(m_stream, start);
+        PutUInt(m_stream, count);
+        m_backend->drawIndexed(start, count);
+    }
+    void drawInstances(size_t start, size_t count, size_t instCount)
+    {
+        PutOp(m_stream, CaptureOp::DrawInstances);
+        PutUInt(m_stream, start);
+        PutUInt(m_stream, count);
+        PutUInt(m_stream, instCount);
+        m_backend->drawInstances(start, count, instCount);
+    }
+    void drawInstancesIndexed(size_t start, size_t count, size_t instCount)
+    {
+        PutOp(m_stream, CaptureOp::DrawInstancesIndexed);
+        PutUInt(m_stream, start);
+        PutUInt(m_stream, count);
+        PutUInt(m_stream, instCount);
+        m_backend->drawInstancesIndexed(start, count, instCount);
+    }
+};
+
+CaptureCommandQueue::CaptureCommandQueue(IGraphicsCommandQueue* backend, CaptureDataFactory* factory)
+: m_backend(backend), m_factory(factory) {}
+
+void CaptureCommandQueue::setShaderDataBinding(IShaderDataBinding* binding)
+{
+    PutOp(m_frame, CaptureOp::SetShaderDataBinding);
+    PutUInt(m_frame, m_factory->objectId(binding));
+    m_backend->setShaderDataBinding(binding);
+}
+
+void CaptureCommandQueue::setRenderTarget(ITextureR* target)
+{
+    PutOp(m_frame, CaptureOp::SetRenderTarget);
+    PutUInt(m_frame, m_factory->textureId(target));
+    m_backend->setRenderTarget(target);
+}
+
+void CaptureCommandQueue::setViewport(const SWindowRect& rect, float znear, float zfar)
+{
+    PutOp(m_frame, CaptureOp::SetViewport);
+    PutRect(m_frame, rect);
+    PutFloat(m_frame, znear);
+    PutFloat(m_frame, zfar);
+    m_backend->setViewport(rect, znear, zfar);
+}
+
+void CaptureCommandQueue::setScissor(const SWindowRect& rect)
+{
+    PutOp(m_frame, CaptureOp::SetScissor);
+    PutRect(m_frame, rect);
+    m_backend->setScissor(rect);
+}
+
+void CaptureCommandQueue::resizeRenderTexture(ITextureR* tex, size_t width, size_t height)
+{
+    PutOp(m_frame, CaptureOp::ResizeRenderTexture);
+    PutUInt(m_frame, m_factory->textureId(tex));
+    PutUInt(m_frame, width);
+    PutUInt(m_frame, height);
+    m_backend->resizeRenderTexture(tex, width, height);
+}
+
+void CaptureCommandQueue::setClearColor(const float rgba[4])
+{
+    PutOp(m_frame, CaptureOp::SetClearColor);
+    for (int i=0 ; i<4 ; ++i)
+        PutFloat(m_frame, rgba[i]);
+    m_backend->setClearColor(rgba);
+}
+
+void CaptureCommandQueue::clearTarget(bool render, bool depth)
+{
+    PutOp(m_frame, CaptureOp::ClearTarget);
+    PutUInt(m_frame, (render ? 1 : 0) | (depth ? 2 : 0));
+    m_backend->clearTarget(render, depth);
+}
+
+void CaptureCommandQueue::draw(size_t start, size_t count)
+{
+    PutOp(m_frame, CaptureOp::Draw);
+    PutUInt(m_frame, start);
+    PutUInt(m_frame, count);
+    m_backend->draw(start, count);
+}
+
+void CaptureCommandQueue::drawIndexed(size_t start, size_t count)
+{
+    PutOp(m_frame, CaptureOp::DrawIndexed);
+    PutUInt(m_frame, start);
+    PutUInt(m_frame, count);
+    m_backend->drawIndexed(start, count);
+}
+
+void CaptureCommandQueue::drawInstances(size_t start, size_t count, size_t instCount)
+{
+    PutOp(m_frame, CaptureOp::DrawInstances);
+    PutUInt(m_frame, start);
+    PutUInt(m_frame, count);
+    PutUInt(m_frame, instCount);
+    m_backend->drawInstances(start, count, instCount);
+}
+
+void CaptureCommandQueue::drawInstancesIndexed(size_t start, size_t count, size_t instCount)
+{
+    PutOp(m_frame, CaptureOp::DrawInstancesIndexed);
+    PutUInt(m_frame, start);
+    PutUInt(m_frame, count);
+    PutUInt(m_frame, instCount);
+    m_backend->drawInstancesIndexed(start, count, instCount);
+}
+
+void CaptureCommandQueue::drawIndirect(IGraphicsBuffer* buf, size_t offset, size_t drawCount)
+{
+    PutOp(m_frame, CaptureOp::DrawIndirect);
+    PutUInt(m_frame, m_factory->bufferId(buf));
+    PutUInt(m_frame, offset);
+    PutUInt(m_frame, drawCount);
+    m_backend->drawIndirect(m_factory->backendBuffer(buf), offset, drawCount);
+}
+
+void CaptureCommandQueue::drawIndexedIndirect(IGraphicsBuffer* buf, size_t offset, size_t drawCount)
+{
+    PutOp(m_frame, CaptureOp::DrawIndexedIndirect);
+    PutUInt(m_frame, m_factory->bufferId(buf));
+    PutUInt(m_frame, offset);
+    PutUInt(m_frame, drawCount);
+    m_backend->drawIndexedIndirect(m_factory->backendBuffer(buf), offset, drawCount);
+}
+
+void CaptureCommandQueue::resolveBindTexture(ITextureR* texture, const SWindowRect& rect,
+                                             bool tlOrigin, bool color, bool depth)
+{
+    PutOp(m_frame, CaptureOp::ResolveBindTexture);
+    PutUInt(m_frame, m_factory->textureId(texture));
+    PutRect(m_frame, rect);
+    PutUInt(m_frame, (tlOrigin ? 1 : 0) | (color ? 2 : 0) | (depth ? 4 : 0));
+    m_backend->resolveBindTexture(texture, rect, tlOrigin, color, depth);
+}
+
+void CaptureCommandQueue::resolveDisplay(ITextureR* source)
+{
+    PutOp(m_frame, CaptureOp::ResolveDisplay);
+    PutUInt(m_frame, m_factory->textureId(source));
+    m_backend->resolveDisplay(source);
+}
+
+/* The copy is replayed; the callback is not */
+void CaptureCommandQueue::readback(ITextureR* texture, const SWindowRect& rect, ReadbackFunc&& callback)
+{
+    PutOp(m_frame, CaptureOp::Readback);
+    PutUInt(m_frame, m_factory->textureId(texture));
+    PutRect(m_frame, rect);
+    m_backend->readback(texture, rect, std::move(callback));
+}
+
+void CaptureCommandQueue::execute()
+{
+    PutOp(m_frame, CaptureOp::Execute);
+    m_factory->writeFrame(m_frame);
+    m_frame.clear();
+    m_backend->execute();
+}
+
+std::unique_ptr<IGraphicsCommandList> CaptureCommandQueue::newCommandList()
+{
+    std::unique_ptr<IGraphicsCommandList> backend = m_backend->newCommandList();
+    if (!backend)
+        return {};
+    return std::unique_ptr<IGraphicsCommandList>(new CaptureCommandList(*m_factory, std::move(backend)));
+}
+
+void CaptureCommandQueue::executeCommandLists(IGraphicsCommandList* const* lists, size_t count)
+{
+    PutOp(m_frame, CaptureOp::ExecuteCommandLists);
+    PutUInt(m_frame, count);
+    m_backendLists.clear();
+    for (size_t i=0 ; i<count ; ++i)
+    {
+        CaptureCommandList* list = static_cast<CaptureCommandList*>(lists[i]);
+        PutBytes(m_frame, list->m_stream.data(), list->m_stream.size());
+        m_backendLists.push_back(list->m_backend.get());
+    }
+    m_backend->executeCommandLists(m_backendLists.data(), count);
+}
+
+void CaptureCommandQueue::beginTimer(const char* name)
+{
+    PutOp(m_frame, CaptureOp::BeginTimer);
+    PutString(m_frame, name);
+    m_backend->beginTimer(name);
+}
+
+void CaptureCommandQueue::endTimer()
+{
+    PutOp(m_frame, CaptureOp::EndTimer);
+    m_backend->endTimer();
+}
+
+bool CaptureReplay::open(const SystemString& path)
+{
+    m_file.clear();
+    FILE* fp = OpenCaptureFile(path, _S("rb"));
+    if (!fp)
+        return false;
+    uint8_t buf[65536];
+    size_t rd;
+    while ((rd = fread(buf, 1, sizeof(buf), fp)))
+        m_file.insert(m_file.end(), buf, buf + rd);
+    fclose(fp);
+
+    if (m_file.size() < 4 || memcmp(m_file.data(), CaptureMagic, 4))
+    {
+        Log.report(logvisor::Error, "not a boo capture file");
+        return false;
+    }
+    CaptureReader r(m_file.data() + 4, m_file.size() - 4);
+    uint64_t version = r.readUInt();
+    uint64_t platform = r.readUInt();
+    if (!r.ok() || version != CaptureVersion)
+    {
+        Log.report(logvisor::Error, "unsupported capture version %d", int(version));
+        return false;
+    }
+    m_platform = IGraphicsDataFactory::Platform(platform);
+    m_bodyOffset = r.position() - m_file.data();
+    return true;
+}
+
+namespace
+{
+
+struct ReplayObject
+{
+    CaptureKind kind = CaptureKind::None;
+    void* ptr = nullptr;
+};
+
+class CaptureReplayer
+{
+    IGraphicsDataFactory* m_factory;
+    IGraphicsCommandQueue* m_queue;
+    CaptureReplayStats& m_stats;
+    std::vector<ReplayObject> m_objects;
+    std::unordered_map<uint64_t, GraphicsDataToken> m_data;
+    std::unordered_set<std::string> m_timerNames; /* Must outlive the queue's results */
+    std::vector<std::unique_ptr<IGraphicsCommandList>> m_lists;
+    std::vector<IGraphicsCommandList*> m_executeLists;
+    bool m_listsSupported = true;
+
+    bool store(uint64_t id, CaptureKind kind, void* ptr)
+    {
+        if (!id || id > MaxCaptureId)
+            return false;
+        if (id >= m_objects.size())
+            m_objects.resize(id + 1);
+        m_objects[id].kind = kind;
+        m_objects[id].ptr = ptr;
+        return true;
+    }
+
+    template <class T>
+    T* lookup(uint64_t id, CaptureKind kind) const
+    {
+        if (id >= m_objects.size() || m_objects[id].kind != kind)
+            return nullptr;
+        return static_cast<T*>(m_objects[id].ptr);
+    }
+
+    IGraphicsBuffer* buffer(uint64_t id) const {return lookup<IGraphicsBuffer>(id, CaptureKind::Buffer);}
+    ITexture* texture(uint64_t id) const {return lookup<ITexture>(id, CaptureKind::Texture);}
+    ITextureR* renderTexture(uint64_t id) const
+    {
+        ITexture* tex = texture(id);
+        return (tex && tex->type() == TextureType::Render) ? static_cast<ITextureR*>(tex) : nullptr;
+    }
+
+    bool replayResource(CaptureReader& r, CaptureOp op, IGraphicsDataFactory::Context& ctx);
+    void replayLoad(CaptureReader& r, CaptureOp op, uint64_t id);
+    template <class Sink>
+    bool replayDrawCommand(CaptureReader& r, CaptureOp op, Sink& sink);
+    bool replayCommandLists(CaptureReader& r);
+
+public:
+    CaptureReplayer(IGraphicsDataFactory* factory, IGraphicsCommandQueue* queue, CaptureReplayStats& stats)
+    : m_factory(factory), m_queue(queue), m_stats(stats) {}
+
+    bool replayTransaction(CaptureReader& r);
+    bool replayCommand(CaptureReader& r, CaptureOp op);
+};
+
+bool CaptureReplayer::replayResource(CaptureReader& r, CaptureOp op, IGraphicsDataFactory::Context& ctx)
+{
+    uint64_t id = r.readUInt();
+    switch (op)
+    {
+    case CaptureOp::NewStaticBuffer:
+    {
+        BufferUse use = BufferUse(r.readUInt());
+        size_t stride = r.readUInt();
+        size_t count = r.readUInt();
+        size_t sz;
+        const uint8_t* data = r.readBytes(sz);
+        if (!r.ok() || sz != stride * count)
+            return false;
+        return store(id, CaptureKind::Buffer,
+                     static_cast<IGraphicsBuffer*>(ctx.newStaticBuffer(use, data, stride, count)));
+    }
+    case CaptureOp::NewDynamicBuffer:
+    {
+        BufferUse use = BufferUse(r.readUInt());
+        size_t stride = r.readUInt();
+        size_t count = r.readUInt();
+        if (!r.ok())
+            return false;
+        return store(id, CaptureKind::Buffer,
+                     static_cast<IGraphicsBuffer*>(ctx.newDynamicBuffer(use, stride, count)));
+    }
+    case CaptureOp::NewStaticTexture:
+    case CaptureOp::NewStaticArrayTexture:
+    {
+        size_t width = r.readUInt();
+        size_t height = r.readUInt();
+        size_t depth = r.readUInt();
+        TextureFormat fmt = TextureFormat(r.readUInt());
+        size_t sz;
+        const uint8_t* data = r.readBytes(sz);
+        if (!r.ok())
+            return false;
+        ITexture* tex;
+        if (op == CaptureOp::NewStaticTexture)
+            tex = ctx.newStaticTexture(width, height, depth, fmt, data, sz);
+        else
+            tex = ctx.newStaticArrayTexture(width, height, depth, fmt, data, sz);
+        return store(id, CaptureKind::Texture, tex);
+    }
+    case CaptureOp::NewDynamicTexture:
+    {
+        size_t width = r.readUInt();
+        size_t height = r.readUInt();
+        TextureFormat fmt = TextureFormat(r.readUInt());
+        if (!r.ok())
+            return false;
+        return store(id, CaptureKind::Texture,
+                     static_cast<ITexture*>(ctx.newDynamicTexture(width, height, fmt)));
+    }
+    case CaptureOp::NewRenderTexture:
+    {
+        size_t width = r.readUInt();
+        size_t height = r.readUInt();
+        uint64_t flags = r.readUInt();
+        if (!r.ok())
+            return false;
+        return store(id, CaptureKind::Texture,
+                     static_cast<ITexture*>(ctx.newRenderTexture(width, height, flags & 1, (flags & 2) != 0)));
+    }
+    case CaptureOp::NewVertexFormat:
+    {
+        size_t count = r.readUInt();
+        if (count > MaxCaptureId)
+            return false;
+        std::vector<VertexElementDescriptor> elements(count);
+        for (VertexElementDescriptor& elem : elements)
+        {
+            elem.vertBuffer = buffer(r.readUInt());
+            elem.indexBuffer = buffer(r.readUInt());
+            elem.semantic = VertexSemantic(r.readUInt());
+            elem.semanticIdx = int(r.readInt());
+        }
+        if (!r.ok())
+            return false;
+        return store(id, CaptureKind::VertexFormat, ctx.newVertexFormat(count, elements.data()));
+    }
+    case CaptureOp::NewShaderPipeline:
+    {
+        std::string vert = r.readString();
+        std::string frag = r.readString();
+        size_t texCount = r.readUInt();
+        if (texCount > MaxCaptureId)
+            return false;
+        std::vector<std::string> texNames(texCount);
+        for (std::string& name : texNames)
+            name = r.readString();
+        size_t uboCount = r.readUInt();
+        if (uboCount > MaxCaptureId)
+            return false;
+        std::vector<std::string> uboNames(uboCount);
+        for (std::string& name : uboNames)
+            name = r.readString();
+        IVertexFormat* vtxFmt = lookup<IVertexFormat>(r.readUInt(), CaptureKind::VertexFormat);
+        BlendFactor srcFac = BlendFactor(r.readUInt());
+        BlendFactor dstFac = BlendFactor(r.readUInt());
+        Primitive prim = Primitive(r.readUInt());
+        uint64_t flags = r.readUInt();
+        if (!r.ok())
+            return false;
+
+        std::vector<const char*> texNamePtrs;
+        for (const std::string& name : texNames)
+            texNamePtrs.push_back(name.c_str());
+        std::vector<const char*> uboNamePtrs;
+        for (const std::string& name : uboNames)
+            uboNamePtrs.push_back(name.c_str());
+        IShaderPipeline* pipeline =
+        NewGLSLShaderPipeline(ctx, vert.c_str(), frag.c_str(),
+                              texCount, texNamePtrs.data(), uboCount, uboNamePtrs.data(), vtxFmt,
+                              srcFac, dstFac, prim, flags & 1, (flags & 2) != 0, (flags & 4) != 0);
+        return store(id, CaptureKind::Pipeline, pipeline);
+    }
+    case CaptureOp::NewShaderDataBinding:
+    {
+        IShaderPipeline* pipeline = lookup<IShaderPipeline>(r.readUInt(), CaptureKind::Pipeline);
+        IVertexFormat* vtxFmt = lookup<IVertexFormat>(r.readUInt(), CaptureKind::VertexFormat);
+        IGraphicsBuffer* vbo = buffer(r.readUInt());
+        IGraphicsBuffer* instVbo = buffer(r.readUInt());
+        IGraphicsBuffer* ibo = buffer(r.readUInt());
+        size_t ubufCount = r.readUInt();
+        uint64_t flags = r.readUInt();
+        if (ubufCount > MaxCaptureId)
+            return false;
+        std::vector<IGraphicsBuffer*> ubufs(ubufCount);
+        std::vector<PipelineStage> ubufStages(ubufCount);
+        std::vector<size_t> ubufOffs(ubufCount);
+        std::vector<size_t> ubufSizes(ubufCount);
+        for (size_t i=0 ; i<ubufCount ; ++i)
+        {
+            ubufs[i] = buffer(r.readUInt());
+            if (flags & 1)
+                ubufStages[i] = PipelineStage(r.readUInt());
+            if (flags & 2)
+                ubufOffs[i] = r.readUInt();
+            if (flags & 4)
+                ubufSizes[i] = r.readUInt();
+        }
+        size_t texCount = r.readUInt();
+        if (texCount > MaxCaptureId)
+            return false;
+        std::vector<ITexture*> texs(texCount);
+        for (ITexture*& tex : texs)
+            tex = texture(r.readUInt());
+        if (!r.ok())
+            return false;
+        if (!pipeline)
+            return store(id, CaptureKind::Binding, nullptr);
+        IShaderDataBinding* binding =
+        ctx.newShaderDataBinding(pipeline, vtxFmt, vbo, instVbo, ibo, ubufCount, ubufs.data(),
+                                 (flags & 1) ? ubufStages.data() : nullptr,
+                                 (flags & 2) ? ubufOffs.data() : nullptr,
+                                 (flags & 4) ? ubufSizes.data() : nullptr,
+                                 texCount, texs.data());
+        return store(id, CaptureKind::Binding, binding);
+    }
+    case CaptureOp::BufferLoad:
+    case CaptureOp::TextureLoad:
+        replayLoad(r, op, id);
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* Loads follow the transaction that created their object, or appear inside it
+ * when made before the commit returned */
+void CaptureReplayer::replayLoad(CaptureReader& r, CaptureOp op, uint64_t id)
+{
+    size_t sz;
+    const uint8_t* data = r.readBytes(sz);
+    if (!data)
+        return;
+    if (op == CaptureOp::BufferLoad)
+    {
+        IGraphicsBuffer* buf = buffer(id);
+        if (!buf || !buf->dynamic())
+            return;
+        static_cast<IGraphicsBufferD*>(buf)->load(data, sz);
+    }
+    else
+    {
+        ITexture* tex = texture(id);
+        if (!tex || tex->type() != TextureType::Dynamic)
+            return;
+        static_cast<ITextureD*>(tex)->load(data, sz);
+    }
+    m_stats.uploadBytes += sz;
+}
+
+bool CaptureReplayer::replayTransaction(CaptureReader& r)
+{
+    uint64_t dataId = r.readUInt();
+    bool ok = r.ok();
+    GraphicsDataToken token = m_factory->commitTransaction([&](IGraphicsDataFactory::Context& ctx) -> bool
+    {
+        while (ok)
+        {
+            CaptureOp op = CaptureOp(r.readU8());
+            if (op == CaptureOp::TransactionEnd)
+                return true;
+            ok = replayResource(r, op, ctx) && r.ok();
+        }
+        return false;
+    });
+    if (!ok)
+        return false;
+    m_data[dataId] = std::move(token);
+    ++m_stats.transactions;
+    return true;
+}
+
+/* Commands shared by the queue and command lists */
+template <class Sink>
+bool CaptureReplayer::replayDrawCommand(CaptureReader& r, CaptureOp op, Sink& sink)
+{
+    switch (op)
+    {
+    case CaptureOp::SetShaderDataBinding:
+        if (IShaderDataBinding* binding = lookup<IShaderDataBinding>(r.readUInt(), CaptureKind::Binding))
+            sink.setShaderDataBinding(binding);
+        break;
+    case CaptureOp::SetViewport:
+    {
+        SWindowRect rect = r.readRect();
+        float znear = r.readFloat();
+        float zfar = r.readFloat();
+        sink.setViewport(rect, znear, zfar);
+        break;
+    }
+    case CaptureOp::SetScissor:
+        sink.setScissor(r.readRect());
+        break;
+    case CaptureOp::Draw:
+    case CaptureOp::DrawIndexed:
+    {
+        size_t start = r.readUInt();
+        size_t count = r.readUInt();
+        if (op == CaptureOp::Draw)
+            sink.draw(start, count);
+        else
+            sink.drawIndexed(start, count);
+        ++m_stats.draws;
+        break;
+    }
+    case CaptureOp::DrawInstances:
+    case CaptureOp::DrawInstancesIndexed:
+    {
+        size_t start = r.readUInt();
+        size_t count = r.readUInt();
+        size_t instCount = r.readUInt();
+        if (op == CaptureOp::DrawInstances)
+            sink.drawInstances(start, count, instCount);
+        else
+            sink.drawInstancesIndexed(start, count, instCount);
+        ++m_stats.draws;
+        break;
+    }
+    default:
+        return false;
+    }
+    return r.ok();
+}
+
+bool CaptureReplayer::replayCommandLists(CaptureReader& r)
+{
+    size_t count = r.readUInt();
+    if (count > MaxCaptureId)
+        return false;
+    m_executeLists.clear();
+    for (size_t i=0 ; i<count ; ++i)
+    {
+        size_t sz;
+        const uint8_t* stream = r.readBytes(sz);
+        if (!r.ok())
+            return false;
+        CaptureReader lr(stream, sz);
+        ITextureR* target = renderTexture(lr.readUInt());
+
+        /* Backends without lists take the commands inline */
+        if (m_listsSupported && m_lists.size() <= i)
+        {
+            std::unique_ptr<IGraphicsCommandList> list = m_queue->newCommandList();
+            if (list)
+                m_lists.push_back(std::move(list));
+            else
+                m_listsSupported = false;
+        }
+        if (!target)
+            continue;
+        if (m_listsSupported)
+        {
+            IGraphicsCommandList* list = m_lists[i].get();
+            list->begin(target);
+            while (!lr.atEnd())
+                if (!replayDrawCommand(lr, CaptureOp(lr.readU8()), *list))
+                    return false;
+            list->end();
+            m_executeLists.push_back(list);
+        }
+        else
+        {
+            while (!lr.atEnd())
+                if (!replayDrawCommand(lr, CaptureOp(lr.readU8()), *m_queue))
+                    return false;
+        }
+    }
+    if (!m_executeLists.empty())
+        m_queue->executeCommandLists(m_executeLists.data(), m_executeLists.size());
+    return true;
+}
+
+bool CaptureReplayer::replayCommand(CaptureReader& r, CaptureOp op)
+{
+    switch (op)
+    {
+    case CaptureOp::TransactionBegin:
+        return replayTransaction(r);
+    case CaptureOp::DestroyData:
+        m_data.erase(r.readUInt());
+        break;
+    case CaptureOp::BufferLoad:
+    case CaptureOp::TextureLoad:
+        replayLoad(r, op, r.readUInt());
+        break;
+    case CaptureOp::SetRenderTarget:
+        m_queue->setRenderTarget(renderTexture(r.readUInt()));
+        break;
+    case CaptureOp::ResizeRenderTexture:
+    {
+        ITextureR* tex = renderTexture(r.readUInt());
+        size_t width = r.readUInt();
+        size_t height = r.readUInt();
+        if (tex)
+            m_queue->resizeRenderTexture(tex, width, height);
+        break;
+    }
+    case CaptureOp::SetClearColor:
+    {
+        float rgba[4];
+        for (int i=0 ; i<4 ; ++i)
+            rgba[i] = r.readFloat();
+        m_queue->setClearColor(rgba);
+        break;
+    }
+    case CaptureOp::ClearTarget:
+    {
+        uint64_t flags = r.readUInt();
+        m_queue->clearTarget(flags & 1, (flags & 2) != 0);
+        break;
+    }
+    case CaptureOp::DrawIndirect:
+    case CaptureOp::DrawIndexedIndirect:
+    {
+        IGraphicsBuffer* buf = buffer(r.readUInt());
+        size_t offset = r.readUInt();
+        size_t drawCount = r.readUInt();
+        if (!buf)
+            break;
+        if (op == CaptureOp::DrawIndirect)
+            m_queue->drawIndirect(buf, offset, drawCount);
+        else
+            m_queue->drawIndexedIndirect(buf, offset, drawCount);
+        ++m_stats.draws;
+        break;
+    }
+    case CaptureOp::ResolveBindTexture:
+    {
+        ITextureR* tex = renderTexture(r.readUInt());
+        SWindowRect rect = r.readRect();
+        uint64_t flags = r.readUInt();
+        if (tex)
+            m_queue->resolveBindTexture(tex, rect, flags & 1, (flags & 2) != 0, (flags & 4) != 0);
+        break;
+    }
+    case CaptureOp::ResolveDisplay:
+        if (ITextureR* tex = renderTexture(r.readUInt()))
+            m_queue->resolveDisplay(tex);
+        break;
+    case CaptureOp::Readback:
+    {
+        ITextureR* tex = renderTexture(r.readUInt());
+        SWindowRect rect = r.readRect();
+        if (tex)
+            m_queue->readback(tex, rect, [](const ReadbackData&) {});
+        break;
+    }
+    case CaptureOp::BeginTimer:
+        m_queue->beginTimer(m_timerNames.insert(r.readString()).first->c_str());
+        break;
+    case CaptureOp::EndTimer:
+        m_queue->endTimer();
+        break;
+    case CaptureOp::ExecuteCommandLists:
+        return replayCommandLists(r);
+    default:
+        return replayDrawCommand(r, op, *m_queue);
+    }
+    return r.ok();
+}
+
+}
+
+bool CaptureReplay::run(IGraphicsDataFactory* factory, IGraphicsCommandQueue* queue, CaptureReplayStats& stats,
+                        const std::function<void(size_t frame)>& frameDone) const
+{
+    if (m_file.size() < m_bodyOffset || !m_bodyOffset)
+        return false;
+    CaptureReader r(m_file.data() + m_bodyOffset, m_file.size() - m_bodyOffset);
+    CaptureReplayer replayer(factory, queue, stats);
+
+    uint64_t frameStart = FrameStatsNow();
+    while (!r.atEnd())
+    {
+        CaptureOp op = CaptureOp(r.readU8());
+        if (op == CaptureOp::Execute)
+        {
+            queue->execute();
+            stats.frameMs.push_back(FrameStatsMs(frameStart, FrameStatsNow()));
+            if (frameDone)
+                frameDone(stats.frames);
+            ++stats.frames;
+            frameStart = FrameStatsNow();
+        }
+        else if (!replayer.replayCommand(r, op))
+        {
+            Log.report(logvisor::Error, "capture is truncated or malformed after %d frames", int(stats.frames));
+            return false;
+        }
+    }
+    return true;
+}
+
+}
@@ -64,9 +64,16 @@ static const D3D11_BIND_FLAG USE_TABLE[] =
     D3D11_BIND_VERTEX_BUFFER,
     D3D11_BIND_VERTEX_BUFFER,
     D3D11_BIND_INDEX_BUFFER,
-    D3D11_BIND_CONSTANT_BUFFER
+    D3D11_BIND_CONSTANT_BUFFER,
+    D3D11_BIND_SHADER_RESOURCE /* Not bound for drawing; dynamic buffers need some bind flag */
 };
 
+/* Indirect-argument buffers are identified by a misc flag rather than a bind flag */
+static UINT MiscFlagsForUse(BufferUse use)
+{
+    return use == BufferUse::Indirect ? D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS : 0;
+}
+
 class D3D11GraphicsBufferS : public IGraphicsBufferS
 {
     friend class D3D11DataFactory;
@@ -76,7 +83,7 @@ class D3D11GraphicsBufferS : public IGraphicsBufferS
     : m_stride(stride), m_count(count), m_sz(stride * count)
     {
         D3D11_SUBRESOURCE_DATA iData = {data};
-        ThrowIfFailed(ctx->m_dev->CreateBuffer(&CD3D11_BUFFER_DESC(m_sz, USE_TABLE[int(use)], D3D11_USAGE_IMMUTABLE), &iData, &m_buf));
+        ThrowIfFailed(ctx->m_dev->CreateBuffer(&CD3D11_BUFFER_DESC(m_sz, USE_TABLE[int(use)], D3D11_USAGE_IMMUTABLE, 0, MiscFlagsForUse(use)), &iData, &m_buf));
     }
 public:
     size_t m_stride;
@@ -100,7 +107,7 @@ class D3D11GraphicsBufferD : public IGraphicsBufferD
         m_cpuBuf.reset(new uint8_t[m_cpuSz]);
         for (int i=0 ; i<3 ; ++i)
             ThrowIfFailed(ctx->m_dev->CreateBuffer(&CD3D11_BUFFER_DESC(m_cpuSz, USE_TABLE[int(use)],
-                          D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE), nullptr, &m_bufs[i]));
+                          D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE, MiscFlagsForUse(use)), nullptr, &m_bufs[i]));
     }
     void update(ID3D11DeviceContext* ctx, int b);
 public:
@@ -60,7 +60,8 @@ static const D3D12_RESOURCE_STATES USE_TABLE[] =
     D3D12_RESOURCE_STATE_COMMON,
     D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER,
     D3D12_RESOURCE_STATE_INDEX_BUFFER,
-    D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER
+    D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER,
+    D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT
 };
 
 class D3D12GraphicsBufferS : public IGraphicsBufferS
@@ -1,4 +1,7 @@
 #include "boo/graphicsdev/GL.hpp"
+#include "boo/graphicsdev/GPUTimerMarks.hpp"
+#include "boo/graphicsdev/CommandStream.hpp"
+#include "GLCommands.hpp"
 #include "boo/graphicsdev/glew.h"
 #include "boo/IGraphicsContext.hpp"
 #include <vector>
@@ -6,6 +9,12 @@
 #include <mutex>
 #include <condition_variable>
 #include <array>
+#include <unordered_set>
+#include <atomic>
+#include <deque>
+#if !_WIN32
+#include <unistd.h>
+#endif
 
 #include "logvisor/logvisor.hpp"
 
@@ -16,6 +25,10 @@ namespace boo
 {
 static logvisor::Module Log("boo::GL");
 
+/* Upper bound of GLDataFactory::frameDepth(); sizes per-slot object arrays */
+static const size_t GLMaxFrameDepth = 3;
+static std::atomic_size_t g_defaultFrameDepth(GLMaxFrameDepth);
+
 ThreadLocalPtr<struct GLData> GLDataFactory::m_deferredData;
 struct GLData : IGraphicsData
 {
@@ -35,7 +48,192 @@ static const GLenum USE_TABLE[] =
     GL_INVALID_ENUM,
     GL_ARRAY_BUFFER,
     GL_ELEMENT_ARRAY_BUFFER,
-    GL_UNIFORM_BUFFER
+    GL_UNIFORM_BUFFER,
+    GL_DRAW_INDIRECT_BUFFER
+};
+
+/** Render-thread shadow of the GL state touched by shader data bindings;
+ *  calls that would not change the bound state are dropped and counted */
+struct GLStateCache
+{
+    static const size_t MaxUnits = 32;
+    size_t m_issued = 0;
+    size_t m_elided = 0;
+
+    GLuint m_program;
+    GLuint m_vao;
+    GLenum m_activeTexture;
+    struct TextureBinding
+    {
+        GLenum target;
+        GLuint tex;
+    } m_textures[MaxUnits];
+    struct UniformBinding
+    {
+        GLuint buf;
+        GLintptr off;
+        GLsizeiptr size; /* -1 for a whole-buffer glBindBufferBase */
+    } m_uniforms[MaxUnits];
+    int m_blend;
+    GLenum m_sfactor, m_dfactor;
+    int m_depthTest;
+    int m_depthMask;
+    GLenum m_depthFunc;
+    int m_cullFace;
+
+    GLStateCache() {invalidate();}
+
+    /* Forget everything; used whenever GL state may have been changed outside the cache */
+    void invalidate()
+    {
+        m_program = ~GLuint(0);
+        m_vao = ~GLuint(0);
+        m_activeTexture = GL_INVALID_ENUM;
+        for (size_t i=0 ; i<MaxUnits ; ++i)
+        {
+            m_textures[i] = {GL_INVALID_ENUM, ~GLuint(0)};
+            m_uniforms[i] = {~GLuint(0), 0, 0};
+        }
+        m_blend = -1;
+        m_sfactor = GL_INVALID_ENUM;
+        m_dfactor = GL_INVALID_ENUM;
+        m_depthTest = -1;
+        m_depthMask = -1;
+        m_depthFunc = GL_INVALID_ENUM;
+        m_cullFace = -1;
+    }
+
+    void resetCounters()
+    {
+        m_issued = 0;
+        m_elided = 0;
+    }
+
+    bool changed(bool differs)
+    {
+        if (differs)
+            ++m_issued;
+        else
+            ++m_elided;
+        return differs;
+    }
+
+    void useProgram(GLuint prog)
+    {
+        if (changed(m_program != prog))
+        {
+            glUseProgram(prog);
+            m_program = prog;
+        }
+    }
+
+    void bindVertexArray(GLuint vao)
+    {
+        if (changed(m_vao != vao))
+        {
+            glBindVertexArray(vao);
+            m_vao = vao;
+        }
+    }
+
+    void bindTexture(size_t unit, GLenum target, GLuint tex)
+    {
+        if (unit >= MaxUnits)
+        {
+            ++m_issued;
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(target, tex);
+            m_activeTexture = GL_TEXTURE0 + unit;
+            return;
+        }
+        TextureBinding& binding = m_textures[unit];
+        if (changed(binding.target != target || binding.tex != tex))
+        {
+            if (m_activeTexture != GL_TEXTURE0 + unit)
+            {
+                glActiveTexture(GL_TEXTURE0 + unit);
+                m_activeTexture = GL_TEXTURE0 + unit;
+            }
+            glBindTexture(target, tex);
+            binding = {target, tex};
+        }
+    }
+
+    void bindUniformBase(size_t idx, GLuint buf)
+    {
+        if (idx >= MaxUnits)
+        {
+            ++m_issued;
+            glBindBufferBase(GL_UNIFORM_BUFFER, idx, buf);
+            return;
+        }
+        UniformBinding& binding = m_uniforms[idx];
+        if (changed(binding.buf != buf || binding.size != -1))
+        {
+            glBindBufferBase(GL_UNIFORM_BUFFER, idx, buf);
+            binding = {buf, 0, -1};
+        }
+    }
+
+    void bindUniformRange(size_t idx, GLuint buf, GLintptr off, GLsizeiptr size)
+    {
+        if (idx >= MaxUnits)
+        {
+            ++m_issued;
+            glBindBufferRange(GL_UNIFORM_BUFFER, idx, buf, off, size);
+            return;
+        }
+        UniformBinding& binding = m_uniforms[idx];
+        if (changed(binding.buf != buf || binding.off != off || binding.size != size))
+        {
+            glBindBufferRange(GL_UNIFORM_BUFFER, idx, buf, off, size);
+            binding = {buf, off, size};
+        }
+    }
+
+    void setCapability(int& cached, GLenum cap, bool enable)
+    {
+        if (changed(cached != int(enable)))
+        {
+            if (enable)
+                glEnable(cap);
+            else
+                glDisable(cap);
+            cached = enable;
+        }
+    }
+
+    void blend(GLenum sfactor, GLenum dfactor)
+    {
+        setCapability(m_blend, GL_BLEND, dfactor != GL_ZERO);
+        if (dfactor != GL_ZERO && changed(m_sfactor != sfactor || m_dfactor != dfactor))
+        {
+            glBlendFunc(sfactor, dfactor);
+            m_sfactor = sfactor;
+            m_dfactor = dfactor;
+        }
+    }
+
+    void depthTest(bool enable) {setCapability(m_depthTest, GL_DEPTH_TEST, enable);}
+    void cullFace(bool enable) {setCapability(m_cullFace, GL_CULL_FACE, enable);}
+
+    void depthMask(bool write)
+    {
+        if (changed(m_depthMask != int(write)))
+        {
+            glDepthMask(write);
+            m_depthMask = write;
+        }
+    }
+
+    void depthFunc(GLenum func)
+    {
+        if (changed(m_depthFunc != func))
+        {
+            glDepthFunc(func);
+            m_depthFunc = func;
+        }
+    }
 };
 
 class GLGraphicsBufferS : public IGraphicsBufferS
@@ -58,34 +256,39 @@ public:
     {glBindBuffer(GL_ARRAY_BUFFER, m_buf);}
     void bindIndex() const
     {glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_buf);}
-    void bindUniform(size_t idx) const
-    {glBindBufferBase(GL_UNIFORM_BUFFER, idx, m_buf);}
-    void bindUniformRange(size_t idx, GLintptr off, GLsizeiptr size) const
-    {glBindBufferRange(GL_UNIFORM_BUFFER, idx, m_buf, off, size);}
+    void bindUniform(GLStateCache& cache, size_t idx) const
+    {cache.bindUniformBase(idx, m_buf);}
+    void bindUniformRange(GLStateCache& cache, size_t idx, GLintptr off, GLsizeiptr size) const
+    {cache.bindUniformRange(idx, m_buf, off, size);}
 };
 
 class GLGraphicsBufferD : public IGraphicsBufferD
 {
     friend class GLDataFactory;
     friend struct GLCommandQueue;
-    GLuint m_bufs[3];
+    struct GLCommandQueue* m_q;
+    GLuint m_bufs[GLMaxFrameDepth] = {};
+    size_t m_slotCount;
     GLenum m_target;
     std::unique_ptr<uint8_t[]> m_cpuBuf;
     size_t m_cpuSz = 0;
     int m_validMask = 0;
-    GLGraphicsBufferD(BufferUse use, size_t sz)
-    : m_target(USE_TABLE[int(use)]), m_cpuBuf(new uint8_t[sz]), m_cpuSz(sz)
-    {
-        glGenBuffers(3, m_bufs);
-        for (int i=0 ; i<3 ; ++i)
-        {
-            glBindBuffer(m_target, m_bufs[i]);
-            glBufferData(m_target, m_cpuSz, nullptr, GL_STREAM_DRAW);
-        }
-    }
+    bool m_dirty = false;
+
+    /* ARB_buffer_storage path: one persistently-mapped buffer holding one
+     * region of m_regionSz bytes per frame slot (all m_bufs alias the same name).
+     * m_regionSz stays 0 on the fallback path so region offsets vanish.
+     * Index buffers always take the fallback path since draws (indirect
+     * ones in particular) address indices from the start of the buffer */
+    uint8_t* m_persistentPtr = nullptr;
+    size_t m_regionSz = 0;
+    int m_latestRegion = -1; /* Region written by the last map(); -1 when m_cpuBuf is newest */
+
+    GLGraphicsBufferD(GLCommandQueue* q, BufferUse use, size_t sz);
     void update(int b);
+    size_t regionOffset(int b) const {return b * m_regionSz;}
 public:
-    ~GLGraphicsBufferD() {glDeleteBuffers(3, m_bufs);}
+    ~GLGraphicsBufferD();
 
     void load(const void* data, size_t sz);
     void* map(size_t sz);
@@ -93,8 +296,8 @@ public:
 
     void bindVertex(int b);
     void bindIndex(int b);
-    void bindUniform(size_t idx, int b);
-    void bindUniformRange(size_t idx, GLintptr off, GLsizeiptr size, int b);
+    void bindUniform(GLStateCache& cache, size_t idx, int b);
+    void bindUniformRange(GLStateCache& cache, size_t idx, GLintptr off, GLsizeiptr size, int b);
 };
 
 IGraphicsBufferS*
@@ -172,11 +375,8 @@ class GLTextureS : public ITextureS
 public:
     ~GLTextureS() {glDeleteTextures(1, &m_tex);}
 
-    void bind(size_t idx) const
-    {
-        glActiveTexture(GL_TEXTURE0 + idx);
-        glBindTexture(GL_TEXTURE_2D, m_tex);
-    }
+    void bind(GLStateCache& cache, size_t idx) const
+    {cache.bindTexture(idx, GL_TEXTURE_2D, m_tex);}
 };
 
 class GLTextureSA : public ITextureSA
@@ -198,25 +398,25 @@ class GLTextureSA : public ITextureSA
 public:
     ~GLTextureSA() {glDeleteTextures(1, &m_tex);}
 
-    void bind(size_t idx) const
-    {
-        glActiveTexture(GL_TEXTURE0 + idx);
-        glBindTexture(GL_TEXTURE_2D_ARRAY, m_tex);
-    }
+    void bind(GLStateCache& cache, size_t idx) const
+    {cache.bindTexture(idx, GL_TEXTURE_2D_ARRAY, m_tex);}
 };
 
 class GLTextureD : public ITextureD
 {
     friend class GLDataFactory;
     friend struct GLCommandQueue;
-    GLuint m_texs[3];
+    struct GLCommandQueue* m_q;
+    GLuint m_texs[GLMaxFrameDepth] = {};
+    size_t m_slotCount;
     std::unique_ptr<uint8_t[]> m_cpuBuf;
     size_t m_cpuSz = 0;
     GLenum m_intFormat, m_format;
     size_t m_width = 0;
     size_t m_height = 0;
     int m_validMask = 0;
-    GLTextureD(size_t width, size_t height, TextureFormat fmt);
+    bool m_dirty = false;
+    GLTextureD(GLCommandQueue* q, size_t width, size_t height, TextureFormat fmt);
     void update(int b);
 public:
     ~GLTextureD();
@@ -225,7 +425,7 @@ public:
     void* map(size_t sz);
     void unmap();
 
-    void bind(size_t idx, int b);
+    void bind(GLStateCache& cache, size_t idx, int b);
 };
 
 class GLTextureR : public ITextureR
@@ -245,11 +445,8 @@ class GLTextureR : public ITextureR
 public:
     ~GLTextureR();
 
-    void bind(size_t idx) const
-    {
-        glActiveTexture(GL_TEXTURE0 + idx);
-        glBindTexture(m_target, m_bindTexs[0]);
-    }
+    void bind(GLStateCache& cache, size_t idx) const
+    {cache.bindTexture(idx, m_target, m_bindTexs[0]);}
 
     void resize(size_t width, size_t height)
     {
@@ -331,7 +528,23 @@ class GLShaderPipeline : public IShaderPipeline
     bool m_depthTest = true;
     bool m_depthWrite = true;
     bool m_backfaceCulling = true;
-    std::vector<GLint> m_uniLocs;
+    mutable std::vector<GLint> m_uniLocs;
+    mutable uint32_t m_uniBlocksBound = 0; /* Blocks already given their glUniformBlockBinding */
+
+    /* Link issued by newShaderPipelineAsync whose result hasn't been collected yet;
+     * whichever thread needs the program first finishes it */
+    struct PendingLink
+    {
+        std::mutex m_mt;
+        std::atomic_bool m_done = {false};
+        std::string m_vertSource;
+        std::string m_fragSource;
+        std::vector<std::string> m_texNames;
+        std::vector<std::string> m_blockNames;
+        uint64_t m_key = 0;
+        SystemString m_cachePath;
+    };
+    std::unique_ptr<PendingLink> m_pending;
     bool initObjects()
     {
         m_vert = glCreateShader(GL_VERTEX_SHADER);
@@ -360,6 +573,21 @@ class GLShaderPipeline : public IShaderPipeline
         if (m_prog)
             glDeleteProgram(m_prog);
     }
+    void issueCompileAndLink(const char* vertSource, const char* fragSource);
+    bool checkCompileAndLink(const char* vertSource, const char* fragSource) const;
+    bool compileAndLink(const char* vertSource, const char* fragSource)
+    {
+        issueCompileAndLink(vertSource, fragSource);
+        return checkCompileAndLink(vertSource, fragSource);
+    }
+    void setupInterface(size_t texCount, const char** texNames,
+                        size_t uniformBlockCount, const char** uniformBlockNames,
+                        GLStateCache* cache) const;
+    void finishLink(GLStateCache* cache) const;
+    bool linkPending() const
+    {
+        return m_pending && !m_pending->m_done.load(std::memory_order_acquire);
+    }
     GLShaderPipeline() = default;
 public:
     operator bool() const {return m_prog != 0;}
@@ -380,37 +608,61 @@ public:
         m_depthWrite = other.m_depthWrite;
         m_backfaceCulling = other.m_backfaceCulling;
         m_uniLocs = std::move(other.m_uniLocs);
+        m_uniBlocksBound = other.m_uniBlocksBound;
         m_drawPrim = other.m_drawPrim;
+        m_pending = std::move(other.m_pending);
         return *this;
     }
     GLShaderPipeline(GLShaderPipeline&& other) {*this = std::move(other);}
 
-    GLuint bind() const
+    bool isReady() const
     {
-        glUseProgram(m_prog);
-
-        if (m_dfactor != GL_ZERO)
+        if (!linkPending())
+            return true;
+        if (GLEW_ARB_parallel_shader_compile)
         {
-            glEnable(GL_BLEND);
-            glBlendFunc(m_sfactor, m_dfactor);
+            GLint complete = GL_FALSE;
+            glGetProgramiv(m_prog, GL_COMPLETION_STATUS_ARB, &complete);
+            if (!complete)
+                return false;
         }
-        else
-            glDisable(GL_BLEND);
-
-        if (m_depthTest)
-            glEnable(GL_DEPTH_TEST);
-        else
-            glDisable(GL_DEPTH_TEST);
-        glDepthMask(m_depthWrite);
-        glDepthFunc(GL_LEQUAL);
-
-        if (m_backfaceCulling)
-            glEnable(GL_CULL_FACE);
-        else
-            glDisable(GL_CULL_FACE);
+        finishLink(nullptr);
+        return true;
+    }
+    void waitReady() const
+    {
+        if (linkPending())
+            finishLink(nullptr);
+    }
 
+    GLuint bind(GLStateCache& cache) const
+    {
+        if (linkPending())
+            finishLink(&cache);
+        cache.useProgram(m_prog);
+        cache.blend(m_sfactor, m_dfactor);
+        cache.depthTest(m_depthTest);
+        cache.depthMask(m_depthWrite);
+        cache.depthFunc(GL_LEQUAL);
+        cache.cullFace(m_backfaceCulling);
         return m_prog;
     }
+
+    /* Block-to-binding-point assignments are program state and never change */
+    void bindUniformBlock(GLStateCache& cache, GLint loc, size_t idx) const
+    {
+        if (idx >= 32)
+        {
+            ++cache.m_issued;
+            glUniformBlockBinding(m_prog, loc, idx);
+            return;
+        }
+        if (cache.changed((m_uniBlocksBound & (1 << idx)) == 0))
+        {
+            glUniformBlockBinding(m_prog, loc, idx);
+            m_uniBlocksBound |= 1 << idx;
+        }
+    }
 };
 
 static const GLenum PRIMITIVE_TABLE[] =
@@ -435,79 +687,77 @@ static const GLenum BLEND_FACTOR_TABLE[] =
     GL_ONE_MINUS_SRC1_COLOR
 };
 
-IShaderPipeline* GLDataFactory::Context::newShaderPipeline
-(const char* vertSource, const char* fragSource,
- size_t texCount, const char** texNames,
- size_t uniformBlockCount, const char** uniformBlockNames,
- BlendFactor srcFac, BlendFactor dstFac, Primitive prim,
- bool depthTest, bool depthWrite, bool backfaceCulling)
+void GLShaderPipeline::issueCompileAndLink(const char* vertSource, const char* fragSource)
 {
-    GLShaderPipeline shader;
-    if (!shader.initObjects())
-    {
-        Log.report(logvisor::Error, "unable to create shader objects\n");
-        return nullptr;
-    }
-    shader.m_sfactor = BLEND_FACTOR_TABLE[int(srcFac)];
-    shader.m_dfactor = BLEND_FACTOR_TABLE[int(dstFac)];
-    shader.m_depthTest = depthTest;
-    shader.m_depthWrite = depthWrite;
-    shader.m_backfaceCulling = backfaceCulling;
-    shader.m_drawPrim = PRIMITIVE_TABLE[int(prim)];
+    glShaderSource(m_vert, 1, &vertSource, nullptr);
+    glCompileShader(m_vert);
+    glShaderSource(m_frag, 1, &fragSource, nullptr);
+    glCompileShader(m_frag);
+    if (GLEW_ARB_get_program_binary)
+        glProgramParameteri(m_prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(m_prog);
+}
 
-    glShaderSource(shader.m_vert, 1, &vertSource, nullptr);
-    glCompileShader(shader.m_vert);
+/* Querying status waits for any compile still running on driver threads */
+bool GLShaderPipeline::checkCompileAndLink(const char* vertSource, const char* fragSource) const
+{
     GLint status;
-    glGetShaderiv(shader.m_vert, GL_COMPILE_STATUS, &status);
+    glGetShaderiv(m_vert, GL_COMPILE_STATUS, &status);
     if (status != GL_TRUE)
     {
         GLint logLen;
-        glGetShaderiv(shader.m_vert, GL_INFO_LOG_LENGTH, &logLen);
+        glGetShaderiv(m_vert, GL_INFO_LOG_LENGTH, &logLen);
         char* log = (char*)malloc(logLen);
-        glGetShaderInfoLog(shader.m_vert, logLen, nullptr, log);
+        glGetShaderInfoLog(m_vert, logLen, nullptr, log);
         Log.report(logvisor::Error, "unable to compile vert source\n%s\n%s\n", log, vertSource);
         free(log);
-        return nullptr;
+        return false;
     }
 
-    glShaderSource(shader.m_frag, 1, &fragSource, nullptr);
-    glCompileShader(shader.m_frag);
-    glGetShaderiv(shader.m_frag, GL_COMPILE_STATUS, &status);
+    glGetShaderiv(m_frag, GL_COMPILE_STATUS, &status);
     if (status != GL_TRUE)
     {
         GLint logLen;
-        glGetShaderiv(shader.m_frag, GL_INFO_LOG_LENGTH, &logLen);
+        glGetShaderiv(m_frag, GL_INFO_LOG_LENGTH, &logLen);
         char* log = (char*)malloc(logLen);
-        glGetShaderInfoLog(shader.m_frag, logLen, nullptr, log);
+        glGetShaderInfoLog(m_frag, logLen, nullptr, log);
         Log.report(logvisor::Error, "unable to compile frag source\n%s\n%s\n", log, fragSource);
         free(log);
-        return nullptr;
+        return false;
     }
 
-    glLinkProgram(shader.m_prog);
-    glGetProgramiv(shader.m_prog, GL_LINK_STATUS, &status);
+    glGetProgramiv(m_prog, GL_LINK_STATUS, &status);
     if (status != GL_TRUE)
     {
         GLint logLen;
-        glGetProgramiv(shader.m_prog, GL_INFO_LOG_LENGTH, &logLen);
+        glGetProgramiv(m_prog, GL_INFO_LOG_LENGTH, &logLen);
         char* log = (char*)malloc(logLen);
-        glGetProgramInfoLog(shader.m_prog, logLen, nullptr, log);
+        glGetProgramInfoLog(m_prog, logLen, nullptr, log);
         Log.report(logvisor::Error, "unable to link shader program\n%s\n", log);
         free(log);
-        return nullptr;
+        return false;
     }
+    return true;
+}
 
-    glUseProgram(shader.m_prog);
+void GLShaderPipeline::setupInterface(size_t texCount, const char** texNames,
+                                      size_t uniformBlockCount, const char** uniformBlockNames,
+                                      GLStateCache* cache) const
+{
+    if (cache)
+        cache->useProgram(m_prog);
+    else
+        glUseProgram(m_prog);
 
     if (uniformBlockCount)
     {
-        shader.m_uniLocs.reserve(uniformBlockCount);
+        m_uniLocs.reserve(uniformBlockCount);
         for (size_t i=0 ; i<uniformBlockCount ; ++i)
         {
-            GLint uniLoc = glGetUniformBlockIndex(shader.m_prog, uniformBlockNames[i]);
+            GLint uniLoc = glGetUniformBlockIndex(m_prog, uniformBlockNames[i]);
             //if (uniLoc < 0)
             //    Log.report(logvisor::Warning, "unable to find uniform block '%s'", uniformBlockNames[i]);
-            shader.m_uniLocs.push_back(uniLoc);
+            m_uniLocs.push_back(uniLoc);
         }
     }
 
@@ -515,153 +765,501 @@ IShaderPipeline* GLDataFactory::Context::newShaderPipeline
     {
         for (int i=0 ; i<texCount ; ++i)
         {
-            GLint texLoc = glGetUniformLocation(shader.m_prog, texNames[i]);
+            GLint texLoc = glGetUniformLocation(m_prog, texNames[i]);
             if (texLoc < 0)
             { /* Log.report(logvisor::Warning, "unable to find sampler variable '%s'", texNames[i]); */ }
             else
                 glUniform1i(texLoc, i);
         }
     }
-
-    GLShaderPipeline* retval = new GLShaderPipeline(std::move(shader));
-    m_deferredData->m_SPs.emplace_back(retval);
-    return retval;
 }
 
-struct GLVertexFormat : IVertexFormat
+/* Program binaries are prefixed with the key they were built for, so blobs
+ * from other sources, pipeline states or drivers are never handed to GL */
+struct ProgramBinaryHeader
 {
-    GLCommandQueue* m_q;
-    GLuint m_vao[3] = {};
-    size_t m_elementCount;
-    std::unique_ptr<VertexElementDescriptor[]> m_elements;
-    GLVertexFormat(GLCommandQueue* q, size_t elementCount,
-                   const VertexElementDescriptor* elements);
-    ~GLVertexFormat();
-    void bind(int idx) const {glBindVertexArray(m_vao[idx]);}
+    uint64_t key;
+    uint32_t format;
+    uint32_t length;
 };
 
-struct GLShaderDataBinding : IShaderDataBinding
+static void HashBytes(uint64_t& hash, const void* data, size_t sz)
 {
-    const GLShaderPipeline* m_pipeline;
-    const GLVertexFormat* m_vtxFormat;
-    size_t m_ubufCount;
-    std::unique_ptr<IGraphicsBuffer*[]> m_ubufs;
-    std::vector<std::pair<size_t,size_t>> m_ubufOffs;
-    size_t m_texCount;
-    std::unique_ptr<ITexture*[]> m_texs;
-
-    GLShaderDataBinding(IShaderPipeline* pipeline,
-                        IVertexFormat* vtxFormat,
-                        size_t ubufCount, IGraphicsBuffer** ubufs,
-                        const size_t* ubufOffs, const size_t* ubufSizes,
-                        size_t texCount, ITexture** texs)
-    : m_pipeline(static_cast<GLShaderPipeline*>(pipeline)),
-      m_vtxFormat(static_cast<GLVertexFormat*>(vtxFormat)),
-      m_ubufCount(ubufCount),
-      m_ubufs(new IGraphicsBuffer*[ubufCount]),
-      m_texCount(texCount),
-      m_texs(new ITexture*[texCount])
-    {
-        if (ubufOffs && ubufSizes)
-        {
-            m_ubufOffs.reserve(ubufCount);
-            for (size_t i=0 ; i<ubufCount ; ++i)
-            {
-#ifndef NDEBUG
-                if (ubufOffs[i] % 256)
-                    Log.report(logvisor::Fatal, "non-256-byte-aligned uniform-offset %d provided to newShaderDataBinding", int(i));
-#endif
-                m_ubufOffs.emplace_back(ubufOffs[i], (ubufSizes[i] + 255) & ~255);
-            }
-        }
-        for (size_t i=0 ; i<ubufCount ; ++i)
-        {
-#ifndef NDEBUG
-            if (!ubufs[i])
-                Log.report(logvisor::Fatal, "null uniform-buffer %d provided to newShaderDataBinding", int(i));
-#endif
-            m_ubufs[i] = ubufs[i];
-        }
-        for (size_t i=0 ; i<texCount ; ++i)
-            m_texs[i] = texs[i];
-    }
-    void bind(int b) const
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i=0 ; i<sz ; ++i)
     {
-        GLuint prog = m_pipeline->bind();
-        m_vtxFormat->bind(b);
-        if (m_ubufOffs.size())
-        {
-            for (size_t i=0 ; i<m_ubufCount && i<m_pipeline->m_uniLocs.size() ; ++i)
-            {
-                GLint loc = m_pipeline->m_uniLocs[i];
-                if (loc < 0)
-                    continue;
-                IGraphicsBuffer* ubuf = m_ubufs[i];
-                const std::pair<size_t,size_t>& offset = m_ubufOffs[i];
-                if (ubuf->dynamic())
-                    static_cast<GLGraphicsBufferD*>(ubuf)->bindUniformRange(i, offset.first, offset.second, b);
-                else
-                    static_cast<GLGraphicsBufferS*>(ubuf)->bindUniformRange(i, offset.first, offset.second);
-                glUniformBlockBinding(prog, loc, i);
-            }
-        }
-        else
-        {
-            for (size_t i=0 ; i<m_ubufCount && i<m_pipeline->m_uniLocs.size() ; ++i)
-            {
-                GLint loc = m_pipeline->m_uniLocs[i];
-                if (loc < 0)
-                    continue;
-                IGraphicsBuffer* ubuf = m_ubufs[i];
-                if (ubuf->dynamic())
-                    static_cast<GLGraphicsBufferD*>(ubuf)->bindUniform(i, b);
-                else
-                    static_cast<GLGraphicsBufferS*>(ubuf)->bindUniform(i);
-                glUniformBlockBinding(prog, loc, i);
-            }
-        }
-        for (size_t i=0 ; i<m_texCount ; ++i)
-        {
-            ITexture* tex = m_texs[i];
-            if (tex)
-            {
-                switch (tex->type())
-                {
-                case TextureType::Dynamic:
-                    static_cast<GLTextureD*>(tex)->bind(i, b);
-                    break;
-                case TextureType::Static:
-                    static_cast<GLTextureS*>(tex)->bind(i);
-                    break;
-                case TextureType::StaticArray:
-                    static_cast<GLTextureSA*>(tex)->bind(i);
-                    break;
-                case TextureType::Render:
-                    static_cast<GLTextureR*>(tex)->bind(i);
-                    break;
-                default: break;
-                }
-            }
-        }
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
     }
-};
+}
 
-IShaderDataBinding*
-GLDataFactory::Context::newShaderDataBinding(IShaderPipeline* pipeline,
-                                             IVertexFormat* vtxFormat,
-                                             IGraphicsBuffer*, IGraphicsBuffer*, IGraphicsBuffer*,
-                                             size_t ubufCount, IGraphicsBuffer** ubufs, const PipelineStage* ubufStages,
-                                             const size_t* ubufOffs, const size_t* ubufSizes,
-                                             size_t texCount, ITexture** texs)
+static void HashString(uint64_t& hash, const char* str)
 {
-    GLShaderDataBinding* retval =
-    new GLShaderDataBinding(pipeline, vtxFormat, ubufCount, ubufs, ubufOffs, ubufSizes, texCount, texs);
-    m_deferredData->m_SBinds.emplace_back(retval);
-    return retval;
+    if (str)
+        HashBytes(hash, str, strlen(str) + 1);
+    else
+        HashBytes(hash, "", 1);
 }
 
-GLDataFactory::GLDataFactory(IGraphicsContext* parent, uint32_t drawSamples)
-: m_parent(parent), m_drawSamples(drawSamples) {}
+static uint64_t ProgramBinaryKey(const char* vertSource, const char* fragSource,
+                                 size_t texCount, const char** texNames,
+                                 size_t uniformBlockCount, const char** uniformBlockNames,
+                                 BlendFactor srcFac, BlendFactor dstFac, Primitive prim,
+                                 bool depthTest, bool depthWrite, bool backfaceCulling)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    HashString(hash, vertSource);
+    HashString(hash, fragSource);
+    for (size_t i=0 ; i<texCount && texNames ; ++i)
+        HashString(hash, texNames[i]);
+    for (size_t i=0 ; i<uniformBlockCount ; ++i)
+        HashString(hash, uniformBlockNames[i]);
+    uint8_t state[] = {uint8_t(srcFac), uint8_t(dstFac), uint8_t(prim),
+                       uint8_t(depthTest), uint8_t(depthWrite), uint8_t(backfaceCulling)};
+    HashBytes(hash, state, sizeof(state));
+    HashString(hash, reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+    HashString(hash, reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+    HashString(hash, reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+    return hash;
+}
+
+static bool LoadProgramBinary(GLuint prog, uint64_t key, const std::vector<unsigned char>& blob)
+{
+    if (blob.size() < sizeof(ProgramBinaryHeader))
+        return false;
+    ProgramBinaryHeader header;
+    memcpy(&header, blob.data(), sizeof(header));
+    if (header.key != key || header.length != blob.size() - sizeof(header))
+        return false;
+    glProgramBinary(prog, header.format, blob.data() + sizeof(header), header.length);
+    GLint status;
+    glGetProgramiv(prog, GL_LINK_STATUS, &status);
+    return status == GL_TRUE;
+}
+
+static void StoreProgramBinary(GLuint prog, uint64_t key, std::vector<unsigned char>& blob)
+{
+    blob.clear();
+    GLint length = 0;
+    glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    ProgramBinaryHeader header = {key, 0, uint32_t(length)};
+    blob.resize(sizeof(header) + length);
+    GLenum format;
+    GLsizei written = 0;
+    glGetProgramBinary(prog, length, &written, &format, blob.data() + sizeof(header));
+    if (written != length)
+    {
+        blob.clear();
+        return;
+    }
+    header.format = format;
+    memcpy(blob.data(), &header, sizeof(header));
+}
+
+static FILE* OpenProgramCacheFile(const SystemString& path, const SystemChar* mode)
+{
+#if _WIN32
+    return _wfopen(path.c_str(), mode);
+#else
+    return fopen(path.c_str(), mode);
+#endif
+}
+
+static SystemString ProgramCachePath(const SystemString& dir, uint64_t key)
+{
+    SystemChar name[32];
+#if _WIN32
+    _snwprintf(name, 32, L"/%016llX.glprog", (unsigned long long)key);
+#else
+    snprintf(name, 32, "/%016llX.glprog", (unsigned long long)key);
+#endif
+    return dir + name;
+}
+
+IShaderPipeline* GLDataFactory::Context::newShaderPipeline
+(const char* vertSource, const char* fragSource,
+ std::vector<unsigned char>& programBlob,
+ size_t texCount, const char** texNames,
+ size_t uniformBlockCount, const char** uniformBlockNames,
+ BlendFactor srcFac, BlendFactor dstFac, Primitive prim,
+ bool depthTest, bool depthWrite, bool backfaceCulling)
+{
+    GLShaderPipeline shader;
+    if (!shader.initObjects())
+    {
+        Log.report(logvisor::Error, "unable to create shader objects\n");
+        return nullptr;
+    }
+    shader.m_sfactor = BLEND_FACTOR_TABLE[int(srcFac)];
+    shader.m_dfactor = BLEND_FACTOR_TABLE[int(dstFac)];
+    shader.m_depthTest = depthTest;
+    shader.m_depthWrite = depthWrite;
+    shader.m_backfaceCulling = backfaceCulling;
+    shader.m_drawPrim = PRIMITIVE_TABLE[int(prim)];
+
+    bool binarySupported = GLEW_ARB_get_program_binary;
+    uint64_t key = 0;
+    bool loaded = false;
+    if (binarySupported)
+    {
+        key = ProgramBinaryKey(vertSource, fragSource, texCount, texNames,
+                               uniformBlockCount, uniformBlockNames,
+                               srcFac, dstFac, prim, depthTest, depthWrite, backfaceCulling);
+        loaded = LoadProgramBinary(shader.m_prog, key, programBlob);
+        if (!loaded && programBlob.size())
+            Log.report(logvisor::Info, "program binary rejected; recompiling");
+    }
+
+    if (!loaded)
+    {
+        if (!shader.compileAndLink(vertSource, fragSource))
+            return nullptr;
+        if (binarySupported)
+            StoreProgramBinary(shader.m_prog, key, programBlob);
+        else
+            programBlob.clear();
+    }
+
+    shader.setupInterface(texCount, texNames, uniformBlockCount, uniformBlockNames, nullptr);
+
+    GLShaderPipeline* retval = new GLShaderPipeline(std::move(shader));
+    m_deferredData->m_SPs.emplace_back(retval);
+    return retval;
+}
+
+static void ReadProgramCacheFile(const SystemString& path, std::vector<unsigned char>& blob)
+{
+    if (FILE* fp = OpenProgramCacheFile(path, _S("rb")))
+    {
+        fseek(fp, 0, SEEK_END);
+        long sz = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        if (sz > 0)
+        {
+            blob.resize(sz);
+            if (fread(blob.data(), 1, sz, fp) != size_t(sz))
+                blob.clear();
+        }
+        fclose(fp);
+    }
+}
+
+static void RemoveProgramCacheFile(const SystemString& path)
+{
+#if _WIN32
+    _wremove(path.c_str());
+#else
+    remove(path.c_str());
+#endif
+}
+
+/* Each write goes through its own temporary file (process id and serial), and
+ * the rename publishes it in one step, so concurrent writers never truncate
+ * each other's data and readers never see a partial blob */
+static void WriteProgramCacheFile(const SystemString& path, const std::vector<unsigned char>& blob)
+{
+    static std::atomic_uint TmpSerial(0);
+    unsigned serial = TmpSerial++;
+    SystemChar suffix[48];
+#if _WIN32
+    _snwprintf(suffix, 48, L".%lu.%u.tmp", GetCurrentProcessId(), serial);
+#else
+    snprintf(suffix, 48, ".%ld.%u.tmp", long(getpid()), serial);
+#endif
+    SystemString tmpPath = path + suffix;
+    FILE* fp = OpenProgramCacheFile(tmpPath, _S("wb"));
+    if (!fp)
+        return;
+    bool ok = fwrite(blob.data(), 1, blob.size(), fp) == blob.size();
+    ok &= fclose(fp) == 0;
+#if _WIN32
+    ok = ok && MoveFileExW(tmpPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+    ok = ok && rename(tmpPath.c_str(), path.c_str()) == 0;
+#endif
+    if (!ok)
+    {
+        RemoveProgramCacheFile(tmpPath);
+        Log.report(logvisor::Warning, "unable to write program cache entry");
+    }
+}
+
+IShaderPipeline* GLDataFactory::Context::newShaderPipeline
+(const char* vertSource, const char* fragSource,
+ size_t texCount, const char** texNames,
+ size_t uniformBlockCount, const char** uniformBlockNames,
+ BlendFactor srcFac, BlendFactor dstFac, Primitive prim,
+ bool depthTest, bool depthWrite, bool backfaceCulling)
+{
+    std::vector<unsigned char> blob;
+    const SystemString& cacheDir = m_parent.m_programCacheDir;
+    if (cacheDir.empty() || !GLEW_ARB_get_program_binary)
+        return newShaderPipeline(vertSource, fragSource, blob, texCount, texNames,
+                                 uniformBlockCount, uniformBlockNames,
+                                 srcFac, dstFac, prim, depthTest, depthWrite, backfaceCulling);
+
+    uint64_t key = ProgramBinaryKey(vertSource, fragSource, texCount, texNames,
+                                    uniformBlockCount, uniformBlockNames,
+                                    srcFac, dstFac, prim, depthTest, depthWrite, backfaceCulling);
+    SystemString path = ProgramCachePath(cacheDir, key);
+    ReadProgramCacheFile(path, blob);
+
+    std::vector<unsigned char> loadedBlob = blob;
+    IShaderPipeline* ret = newShaderPipeline(vertSource, fragSource, blob, texCount, texNames,
+                                             uniformBlockCount, uniformBlockNames,
+                                             srcFac, dstFac, prim, depthTest, depthWrite, backfaceCulling);
+
+    /* Write through when the cache missed or the driver rejected the stored binary */
+    if (ret && blob.size() && blob != loadedBlob)
+        WriteProgramCacheFile(path, blob);
+    else if (!ret && loadedBlob.size())
+        RemoveProgramCacheFile(path); /* Don't keep serving a binary for a program that no longer builds */
+    return ret;
+}
+
+void GLShaderPipeline::finishLink(GLStateCache* cache) const
+{
+    PendingLink& pending = *m_pending;
+    std::unique_lock<std::mutex> lk(pending.m_mt);
+    if (pending.m_done.load(std::memory_order_relaxed))
+        return;
+
+    if (checkCompileAndLink(pending.m_vertSource.c_str(), pending.m_fragSource.c_str()))
+    {
+        std::vector<const char*> texNames;
+        texNames.reserve(pending.m_texNames.size());
+        for (const std::string& name : pending.m_texNames)
+            texNames.push_back(name.c_str());
+        std::vector<const char*> blockNames;
+        blockNames.reserve(pending.m_blockNames.size());
+        for (const std::string& name : pending.m_blockNames)
+            blockNames.push_back(name.c_str());
+        setupInterface(texNames.size(), texNames.data(), blockNames.size(), blockNames.data(), cache);
+
+        if (pending.m_cachePath.size())
+        {
+            std::vector<unsigned char> blob;
+            StoreProgramBinary(m_prog, pending.m_key, blob);
+            if (blob.size())
+                WriteProgramCacheFile(pending.m_cachePath, blob);
+        }
+    }
+    else if (pending.m_cachePath.size())
+        RemoveProgramCacheFile(pending.m_cachePath);
+
+    /* Make program state set from the client context visible to the render thread */
+    if (!cache)
+        glFlush();
+    pending.m_done.store(true, std::memory_order_release);
+}
+
+IShaderPipeline* GLDataFactory::Context::newShaderPipelineAsync
+(const char* vertSource, const char* fragSource,
+ size_t texCount, const char** texNames,
+ size_t uniformBlockCount, const char** uniformBlockNames,
+ BlendFactor srcFac, BlendFactor dstFac, Primitive prim,
+ bool depthTest, bool depthWrite, bool backfaceCulling)
+{
+    GLShaderPipeline shader;
+    if (!shader.initObjects())
+    {
+        Log.report(logvisor::Error, "unable to create shader objects\n");
+        return nullptr;
+    }
+    shader.m_sfactor = BLEND_FACTOR_TABLE[int(srcFac)];
+    shader.m_dfactor = BLEND_FACTOR_TABLE[int(dstFac)];
+    shader.m_depthTest = depthTest;
+    shader.m_depthWrite = depthWrite;
+    shader.m_backfaceCulling = backfaceCulling;
+    shader.m_drawPrim = PRIMITIVE_TABLE[int(prim)];
+
+    /* Cached binaries load quickly enough to take synchronously */
+    std::unique_ptr<GLShaderPipeline::PendingLink> pending(new GLShaderPipeline::PendingLink);
+    const SystemString& cacheDir = m_parent.m_programCacheDir;
+    if (cacheDir.size() && GLEW_ARB_get_program_binary)
+    {
+        pending->m_key = ProgramBinaryKey(vertSource, fragSource, texCount, texNames,
+                                          uniformBlockCount, uniformBlockNames,
+                                          srcFac, dstFac, prim, depthTest, depthWrite, backfaceCulling);
+        pending->m_cachePath = ProgramCachePath(cacheDir, pending->m_key);
+        std::vector<unsigned char> blob;
+        ReadProgramCacheFile(pending->m_cachePath, blob);
+        if (LoadProgramBinary(shader.m_prog, pending->m_key, blob))
+        {
+            shader.setupInterface(texCount, texNames, uniformBlockCount, uniformBlockNames, nullptr);
+            GLShaderPipeline* retval = new GLShaderPipeline(std::move(shader));
+            m_deferredData->m_SPs.emplace_back(retval);
+            return retval;
+        }
+    }
+
+    if (GLEW_ARB_parallel_shader_compile && !m_parent.m_parallelCompileEnabled)
+    {
+        glMaxShaderCompilerThreadsARB(0xffffffff);
+        m_parent.m_parallelCompileEnabled = true;
+    }
+
+    /* Results are collected by whichever of isReady(), waitReady() or the
+     * first bind on the render thread gets there first. The flush makes the
+     * issued compile and link visible to that thread's shared context */
+    shader.issueCompileAndLink(vertSource, fragSource);
+    glFlush();
+    pending->m_vertSource = vertSource;
+    pending->m_fragSource = fragSource;
+    for (size_t i=0 ; i<texCount && texNames ; ++i)
+        pending->m_texNames.push_back(texNames[i]);
+    for (size_t i=0 ; i<uniformBlockCount ; ++i)
+        pending->m_blockNames.push_back(uniformBlockNames[i]);
+    shader.m_pending = std::move(pending);
+
+    GLShaderPipeline* retval = new GLShaderPipeline(std::move(shader));
+    m_deferredData->m_SPs.emplace_back(retval);
+    return retval;
+}
+
+struct GLVertexFormat : IVertexFormat
+{
+    GLCommandQueue* m_q;
+    GLuint m_vao[GLMaxFrameDepth] = {};
+    size_t m_elementCount;
+    std::unique_ptr<VertexElementDescriptor[]> m_elements;
+    GLVertexFormat(GLCommandQueue* q, size_t elementCount,
+                   const VertexElementDescriptor* elements);
+    ~GLVertexFormat();
+    void bind(GLStateCache& cache, int idx) const {cache.bindVertexArray(m_vao[idx]);}
+};
+
+struct GLShaderDataBinding : IShaderDataBinding
+{
+    const GLShaderPipeline* m_pipeline;
+    const GLVertexFormat* m_vtxFormat;
+    size_t m_ubufCount;
+    std::unique_ptr<IGraphicsBuffer*[]> m_ubufs;
+    std::vector<std::pair<size_t,size_t>> m_ubufOffs;
+    size_t m_texCount;
+    std::unique_ptr<ITexture*[]> m_texs;
+
+    GLShaderDataBinding(IShaderPipeline* pipeline,
+                        IVertexFormat* vtxFormat,
+                        size_t ubufCount, IGraphicsBuffer** ubufs,
+                        const size_t* ubufOffs, const size_t* ubufSizes,
+                        size_t texCount, ITexture** texs)
+    : m_pipeline(static_cast<GLShaderPipeline*>(pipeline)),
+      m_vtxFormat(static_cast<GLVertexFormat*>(vtxFormat)),
+      m_ubufCount(ubufCount),
+      m_ubufs(new IGraphicsBuffer*[ubufCount]),
+      m_texCount(texCount),
+      m_texs(new ITexture*[texCount])
+    {
+        if (ubufOffs && ubufSizes)
+        {
+            m_ubufOffs.reserve(ubufCount);
+            for (size_t i=0 ; i<ubufCount ; ++i)
+            {
+#ifndef NDEBUG
+                if (ubufOffs[i] % 256)
+                    Log.report(logvisor::Fatal, "non-256-byte-aligned uniform-offset %d provided to newShaderDataBinding", int(i));
+#endif
+                m_ubufOffs.emplace_back(ubufOffs[i], (ubufSizes[i] + 255) & ~255);
+            }
+        }
+        for (size_t i=0 ; i<ubufCount ; ++i)
+        {
+#ifndef NDEBUG
+            if (!ubufs[i])
+                Log.report(logvisor::Fatal, "null uniform-buffer %d provided to newShaderDataBinding", int(i));
+#endif
+            m_ubufs[i] = ubufs[i];
+        }
+        for (size_t i=0 ; i<texCount ; ++i)
+            m_texs[i] = texs[i];
+    }
+    void bind(GLStateCache& cache, int b) const
+    {
+        m_pipeline->bind(cache);
+        m_vtxFormat->bind(cache, b);
+        if (m_ubufOffs.size())
+        {
+            for (size_t i=0 ; i<m_ubufCount && i<m_pipeline->m_uniLocs.size() ; ++i)
+            {
+                GLint loc = m_pipeline->m_uniLocs[i];
+                if (loc < 0)
+                    continue;
+                IGraphicsBuffer* ubuf = m_ubufs[i];
+                const std::pair<size_t,size_t>& offset = m_ubufOffs[i];
+                if (ubuf->dynamic())
+                    static_cast<GLGraphicsBufferD*>(ubuf)->bindUniformRange(cache, i, offset.first, offset.second, b);
+                else
+                    static_cast<GLGraphicsBufferS*>(ubuf)->bindUniformRange(cache, i, offset.first, offset.second);
+                m_pipeline->bindUniformBlock(cache, loc, i);
+            }
+        }
+        else
+        {
+            for (size_t i=0 ; i<m_ubufCount && i<m_pipeline->m_uniLocs.size() ; ++i)
+            {
+                GLint loc = m_pipeline->m_uniLocs[i];
+                if (loc < 0)
+                    continue;
+                IGraphicsBuffer* ubuf = m_ubufs[i];
+                if (ubuf->dynamic())
+                    static_cast<GLGraphicsBufferD*>(ubuf)->bindUniform(cache, i, b);
+                else
+                    static_cast<GLGraphicsBufferS*>(ubuf)->bindUniform(cache, i);
+                m_pipeline->bindUniformBlock(cache, loc, i);
+            }
+        }
+        for (size_t i=0 ; i<m_texCount ; ++i)
+        {
+            ITexture* tex = m_texs[i];
+            if (tex)
+            {
+                switch (tex->type())
+                {
+                case TextureType::Dynamic:
+                    static_cast<GLTextureD*>(tex)->bind(cache, i, b);
+                    break;
+                case TextureType::Static:
+                    static_cast<GLTextureS*>(tex)->bind(cache, i);
+                    break;
+                case TextureType::StaticArray:
+                    static_cast<GLTextureSA*>(tex)->bind(cache, i);
+                    break;
+                case TextureType::Render:
+                    static_cast<GLTextureR*>(tex)->bind(cache, i);
+                    break;
+                default: break;
+                }
+            }
+        }
+    }
+};
+
+IShaderDataBinding*
+GLDataFactory::Context::newShaderDataBinding(IShaderPipeline* pipeline,
+                                             IVertexFormat* vtxFormat,
+                                             IGraphicsBuffer*, IGraphicsBuffer*, IGraphicsBuffer*,
+                                             size_t ubufCount, IGraphicsBuffer** ubufs, const PipelineStage* ubufStages,
+                                             const size_t* ubufOffs, const size_t* ubufSizes,
+                                             size_t texCount, ITexture** texs)
+{
+    GLShaderDataBinding* retval =
+    new GLShaderDataBinding(pipeline, vtxFormat, ubufCount, ubufs, ubufOffs, ubufSizes, texCount, texs);
+    m_deferredData->m_SBinds.emplace_back(retval);
+    return retval;
+}
+
+GLDataFactory::GLDataFactory(IGraphicsContext* parent, uint32_t drawSamples)
+: m_parent(parent), m_drawSamples(drawSamples), m_frameDepth(g_defaultFrameDepth) {}
+
+void GLDataFactory::SetDefaultFrameDepth(size_t depth)
+{
+    g_defaultFrameDepth = std::min(std::max(depth, size_t(1)), GLMaxFrameDepth);
+}
+
+size_t GLDataFactory::DefaultFrameDepth() {return g_defaultFrameDepth;}
 
 
 GraphicsDataToken GLDataFactory::commitTransaction(const FactoryCommitFunc& trans)
@@ -692,15 +1290,13 @@ GraphicsDataToken GLDataFactory::commitTransaction(const FactoryCommitFunc& tran
 
 void GLDataFactory::destroyData(IGraphicsData* d)
 {
-    std::unique_lock<std::mutex> lk(m_committedMutex);
-    GLData* data = static_cast<GLData*>(d);
-    m_committedData.erase(data);
-    delete data;
+    m_deadData.push(d);
 }
 
 void GLDataFactory::destroyAllData()
 {
     std::unique_lock<std::mutex> lk(m_committedMutex);
+    m_deadData.clear();
     for (IGraphicsData* data : m_committedData)
         delete static_cast<GLData*>(data);
     m_committedData.clear();
@@ -757,55 +1353,25 @@ struct GLCommandQueue : IGraphicsCommandQueue
     const SystemChar* platformName() const {return _S("OpenGL");}
     IGraphicsContext* m_parent = nullptr;
 
-    struct Command
-    {
-        enum class Op
-        {
-            SetShaderDataBinding,
-            SetRenderTarget,
-            SetViewport,
-            SetScissor,
-            SetClearColor,
-            ClearTarget,
-            Draw,
-            DrawIndexed,
-            DrawInstances,
-            DrawInstancesIndexed,
-            ResolveBindTexture,
-            Present
-        } m_op;
-        union
-        {
-            const IShaderDataBinding* binding;
-            const ITextureR* target;
-            const ITextureR* source;
-            struct
-            {
-                SWindowRect rect;
-                float znear, zfar;
-            } viewport;
-            float rgba[4];
-            GLbitfield flags;
-            struct
-            {
-                size_t start;
-                size_t count;
-                size_t instCount;
-            };
-        };
-        const ITextureR* resolveTex;
-        bool resolveColor : 1;
-        bool resolveDepth : 1;
-        Command(Op op) : m_op(op) {}
-    };
-    std::vector<Command> m_cmdBufs[3];
+    /* Recorded commands are packed into a CommandStream (ops and payloads in GLCommands.hpp) */
+    using Command = CommandStream::Command;
+    using Op = GLCommandOp;
+    /* Frame k is recorded into and drawn from slot k % m_frameDepth. The client
+     * may only refill a slot once the render thread has drawn it, and the render
+     * thread only draws into a slot once the GPU has retired its previous frame */
+    size_t m_frameDepth;
+    CommandStream m_cmdBufs[GLMaxFrameDepth]; /* Arenas kept across frames */
+    std::vector<ReadbackFunc> m_readbackFuncs[GLMaxFrameDepth]; /* Consumed in order by Readback commands */
     size_t m_fillBuf = 0;
-    size_t m_completeBuf = 0;
     size_t m_drawBuf = 0;
+    uint64_t m_submittedFrames = 0;
+    uint64_t m_drawnFrames = 0;
+    size_t m_throttledFrames = 0;
     bool m_running = true;
 
     std::mutex m_mt;
     std::condition_variable m_cv;
+    std::condition_variable m_drawnCv;
     std::mutex m_initmt;
     std::condition_variable m_initcv;
     std::unique_lock<std::mutex> m_initlk;
@@ -823,13 +1389,87 @@ struct GLCommandQueue : IGraphicsCommandQueue
     std::vector<std::function<void(void)>> m_pendingPosts1;
     std::vector<std::function<void(void)>> m_pendingPosts2;
     std::vector<GLVertexFormat*> m_pendingFmtAdds;
-    std::vector<std::array<GLuint, 3>> m_pendingFmtDels;
+    std::vector<std::array<GLuint, GLMaxFrameDepth>> m_pendingFmtDels;
     std::vector<GLTextureR*> m_pendingFboAdds;
     std::vector<GLuint> m_pendingFboDels;
 
+    /* Render thread only: pixel-pack buffers awaiting their fence (oldest first)
+     * and idle ones kept for reuse, plus an FBO for resolving multisampled targets */
+    struct Readback
+    {
+        GLuint m_pbo = 0;
+        size_t m_capacity = 0;
+        GLsync m_fence = 0;
+        size_t m_width = 0;
+        size_t m_height = 0;
+        ReadbackFunc m_func;
+    };
+    std::deque<Readback> m_readbacks;
+    std::vector<Readback> m_idleReadbacks;
+    GLuint m_readbackFbo = 0;
+    GLuint m_readbackRbo = 0;
+    size_t m_readbackRboWidth = 0;
+    size_t m_readbackRboHeight = 0;
+
+    /* Render thread only: timestamp queries of frames awaiting results (oldest
+     * first, the back one being drawn when timing) and idle ones kept for reuse */
+    struct TimerFrame
+    {
+        GPUTimerMarks m_marks;
+        std::vector<GLuint> m_queries;
+    };
+    std::deque<TimerFrame> m_timerFrames;
+    std::vector<TimerFrame> m_idleTimerFrames;
+    std::vector<GLuint> m_idleQueries;
+    std::vector<uint64_t> m_timerStamps;
+    bool m_hasTimerQuery = false;
+    std::atomic_bool m_gpuTiming = {false};
+
+    /* Newest resolved GPU timings, read by any thread */
+    mutable std::mutex m_gpuTimingsMt;
+    GPUFrameTimings m_gpuTimings;
+    bool m_hasGPUTimings = false;
+
+    /* Client stamps of each slot's frame, completed by the render thread */
+    uint64_t m_recordStart = 0;
+    FrameStats m_slotStats[GLMaxFrameDepth];
+    FrameStatsRing<FrameStats> m_frameStats;
+
+    /* Dynamic resources touched by load()/unmap() since their last full upload;
+     * execute() walks only these instead of every committed resource */
+    std::mutex m_dirtyMt;
+    std::unordered_set<GLGraphicsBufferD*> m_dirtyBufs;
+    std::unordered_set<GLTextureD*> m_dirtyTexs;
+    /* Set while execute() uploads a swapped-out batch without m_dirtyMt;
+     * clearDirty() waits it out so a dying resource is never touched */
+    bool m_dirtyWalking = false;
+    std::condition_variable m_dirtyWalkCv;
+
+    FrameCounters m_frameCounters;
+
+    /* Owned by the render thread; its per-frame counters are handed
+     * back through m_stateIssued/m_stateElided under m_mt */
+    GLStateCache m_stateCache;
+    size_t m_stateIssued = 0;
+    size_t m_stateElided = 0;
+
+    /* Slots (and their persistent buffer regions) may only be reused once
+     * the GPU has retired the last frame drawn from them */
+    bool m_hasBufferStorage = false;
+    bool m_hasDrawIndirect = false;
+    bool m_hasMultiDrawIndirect = false;
+    bool m_hasBaseInstance = false;
+    std::vector<uint8_t> m_indirectScratch; /* Argument records read back without ARB_draw_indirect */
+    size_t m_uniformAlignment = 256;
+    std::mutex m_fenceMt;
+    GLsync m_slotFences[GLMaxFrameDepth] = {};
+    size_t m_fenceWaiters = 0;
+    std::vector<GLsync> m_retiredFences;
+
     static void ConfigureVertexFormat(GLVertexFormat* fmt)
     {
-        glGenVertexArrays(3, fmt->m_vao);
+        size_t slots = fmt->m_q->m_frameDepth;
+        glGenVertexArrays(slots, fmt->m_vao);
 
         size_t stride = 0;
         size_t instStride = 0;
@@ -842,10 +1482,11 @@ struct GLCommandQueue : IGraphicsCommandQueue
                 stride += SEMANTIC_SIZE_TABLE[int(desc->semantic & VertexSemantic::SemanticMask)];
         }
 
-        for (int b=0 ; b<3 ; ++b)
+        for (size_t b=0 ; b<slots ; ++b)
         {
             size_t offset = 0;
             size_t instOffset = 0;
+            size_t vboBase = 0;
             glBindVertexArray(fmt->m_vao[b]);
             IGraphicsBuffer* lastVBO = nullptr;
             IGraphicsBuffer* lastEBO = nullptr;
@@ -856,9 +1497,15 @@ struct GLCommandQueue : IGraphicsCommandQueue
                 {
                     lastVBO = desc->vertBuffer;
                     if (lastVBO->dynamic())
+                    {
                         static_cast<GLGraphicsBufferD*>(lastVBO)->bindVertex(b);
+                        vboBase = static_cast<GLGraphicsBufferD*>(lastVBO)->regionOffset(b);
+                    }
                     else
+                    {
                         static_cast<GLGraphicsBufferS*>(lastVBO)->bindVertex();
+                        vboBase = 0;
+                    }
                 }
                 if (desc->indexBuffer != lastEBO)
                 {
@@ -873,14 +1520,14 @@ struct GLCommandQueue : IGraphicsCommandQueue
                 if ((desc->semantic & VertexSemantic::Instanced) != VertexSemantic::None)
                 {
                     glVertexAttribPointer(i, SEMANTIC_COUNT_TABLE[maskedSem],
-                            SEMANTIC_TYPE_TABLE[maskedSem], GL_TRUE, instStride, (void*)instOffset);
+                            SEMANTIC_TYPE_TABLE[maskedSem], GL_TRUE, instStride, (void*)(vboBase + instOffset));
                     glVertexAttribDivisor(i, 1);
                     instOffset += SEMANTIC_SIZE_TABLE[maskedSem];
                 }
                 else
                 {
                     glVertexAttribPointer(i, SEMANTIC_COUNT_TABLE[maskedSem],
-                            SEMANTIC_TYPE_TABLE[maskedSem], GL_TRUE, stride, (void*)offset);
+                            SEMANTIC_TYPE_TABLE[maskedSem], GL_TRUE, stride, (void*)(vboBase + offset));
                     offset += SEMANTIC_SIZE_TABLE[maskedSem];
                 }
             }
@@ -895,27 +1542,123 @@ struct GLCommandQueue : IGraphicsCommandQueue
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, tex->m_texs[1], 0);
     }
 
+    /* Without ARB_draw_indirect the argument records are read back and issued
+     * as plain draws; this waits on the buffer but keeps the draws */
+    void drawIndirectFallback(GLuint buf, size_t offset, size_t drawCount, bool indexed, GLenum prim)
+    {
+        size_t stride = indexed ? sizeof(DrawIndexedIndirectArgs) : sizeof(DrawIndirectArgs);
+        m_indirectScratch.resize(stride * drawCount);
+        glBindBuffer(GL_COPY_READ_BUFFER, buf);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, offset, m_indirectScratch.size(), m_indirectScratch.data());
+
+        const uint8_t* rec = m_indirectScratch.data();
+        for (size_t i=0 ; i<drawCount ; ++i, rec += stride)
+        {
+            if (indexed)
+            {
+                DrawIndexedIndirectArgs args;
+                memcpy(&args, rec, stride);
+                void* first = reinterpret_cast<void*>(size_t(args.start) * 4);
+                if (args.baseInstance && m_hasBaseInstance)
+                    glDrawElementsInstancedBaseVertexBaseInstance(prim, args.count, GL_UNSIGNED_INT, first,
+                                                                  args.instCount, args.baseVertex, args.baseInstance);
+                else
+                    glDrawElementsInstancedBaseVertex(prim, args.count, GL_UNSIGNED_INT, first,
+                                                      args.instCount, args.baseVertex);
+            }
+            else
+            {
+                DrawIndirectArgs args;
+                memcpy(&args, rec, stride);
+                if (args.baseInstance && m_hasBaseInstance)
+                    glDrawArraysInstancedBaseInstance(prim, args.start, args.count, args.instCount, args.baseInstance);
+                else
+                    glDrawArraysInstanced(prim, args.start, args.count, args.instCount);
+            }
+        }
+    }
+
+    void drawIndirect(const Command& cmd, GLenum prim)
+    {
+        const GLIndirectCmd& indirect = cmd.get<GLIndirectCmd>();
+        size_t offset = indirect.offset;
+        GLuint buf;
+        if (indirect.buf->dynamic())
+        {
+            const GLGraphicsBufferD* dbuf = static_cast<const GLGraphicsBufferD*>(indirect.buf);
+            buf = dbuf->m_bufs[m_drawBuf];
+            offset += dbuf->regionOffset(m_drawBuf);
+        }
+        else
+            buf = static_cast<const GLGraphicsBufferS*>(indirect.buf)->m_buf;
+
+        size_t drawCount = indirect.drawCount;
+        if (!m_hasDrawIndirect)
+        {
+            drawIndirectFallback(buf, offset, drawCount, cmd.op<Op>() == Op::DrawIndexedIndirect, prim);
+            return;
+        }
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buf);
+        if (cmd.op<Op>() == Op::DrawIndirect)
+        {
+            if (drawCount > 1 && m_hasMultiDrawIndirect)
+                glMultiDrawArraysIndirect(prim, reinterpret_cast<void*>(offset), drawCount, 0);
+            else
+                for (size_t i=0 ; i<drawCount ; ++i, offset += sizeof(DrawIndirectArgs))
+                    glDrawArraysIndirect(prim, reinterpret_cast<void*>(offset));
+        }
+        else
+        {
+            if (drawCount > 1 && m_hasMultiDrawIndirect)
+                glMultiDrawElementsIndirect(prim, GL_UNSIGNED_INT, reinterpret_cast<void*>(offset), drawCount, 0);
+            else
+                for (size_t i=0 ; i<drawCount ; ++i, offset += sizeof(DrawIndexedIndirectArgs))
+                    glDrawElementsIndirect(prim, GL_UNSIGNED_INT, reinterpret_cast<void*>(offset));
+        }
+    }
+
     static void RenderingWorker(GLCommandQueue* self)
     {
         {
             std::unique_lock<std::mutex> lk(self->m_initmt);
             self->m_parent->makeCurrent();
-            if (glewInit() != GLEW_OK)
+            /* GL entry points are resolved before GLX; EGL contexts lack a GLX display */
+            GLenum glewErr = glewInit();
+            if (glewErr != GLEW_OK && glewErr != GLEW_ERROR_NO_GLX_DISPLAY)
                 Log.report(logvisor::Fatal, "unable to init glew");
             const GLubyte* version = glGetString(GL_VERSION);
             Log.report(logvisor::Info, "OpenGL Version: %s", version);
+            self->m_hasBufferStorage = GLEW_ARB_buffer_storage;
+            self->m_hasDrawIndirect = GLEW_ARB_draw_indirect;
+            self->m_hasMultiDrawIndirect = GLEW_ARB_draw_indirect && GLEW_ARB_multi_draw_indirect;
+            self->m_hasBaseInstance = GLEW_ARB_base_instance;
+            self->m_hasTimerQuery = GLEW_ARB_timer_query || GLEW_VERSION_3_3;
+            if (self->m_hasBufferStorage)
+            {
+                GLint align = 256;
+                glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+                self->m_uniformAlignment = std::max(size_t(align), size_t(256));
+            }
             self->m_parent->postInit();
         }
         self->m_initcv.notify_one();
         while (self->m_running)
         {
             std::vector<std::function<void(void)>> posts;
+            uint64_t recordingFrame;
+            FrameStats stats;
             {
                 std::unique_lock<std::mutex> lk(self->m_mt);
-                self->m_cv.wait(lk);
+                self->m_cv.wait(lk, [self]()
+                {
+                    return !self->m_running || self->m_drawnFrames < self->m_submittedFrames;
+                });
                 if (!self->m_running)
                     break;
-                self->m_drawBuf = self->m_completeBuf;
+                self->m_drawBuf = self->m_drawnFrames % self->m_frameDepth;
+                recordingFrame = self->m_submittedFrames;
+                stats = self->m_slotStats[self->m_drawBuf];
 
                 glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
@@ -943,7 +1686,7 @@ struct GLCommandQueue : IGraphicsCommandQueue
                 if (self->m_pendingFmtDels.size())
                 {
                     for (const auto& fmt : self->m_pendingFmtDels)
-                        glDeleteVertexArrays(3, fmt.data());
+                        glDeleteVertexArrays(fmt.size(), fmt.data());
                     self->m_pendingFmtDels.clear();
                 }
 
@@ -957,90 +1700,162 @@ struct GLCommandQueue : IGraphicsCommandQueue
                 if (self->m_pendingPosts2.size())
                     posts.swap(self->m_pendingPosts2);
             }
-            std::vector<Command>& cmds = self->m_cmdBufs[self->m_drawBuf];
+            /* Pending work above and post handlers may have touched any state */
+            GLStateCache& cache = self->m_stateCache;
+            cache.invalidate();
+            cache.resetCounters();
+
+            /* Bound how far this thread runs ahead of the GPU */
+            self->waitForSlot(self->m_drawBuf);
+
+            /* Deliver readbacks and timings the GPU finished since the last frame */
+            self->pollReadbacks();
+            self->pollTimers();
+            stats.renderBegin = FrameStatsNow();
+
+            GPUTimerMarks* marks = nullptr;
+            if (self->m_hasTimerQuery && self->m_gpuTiming.load(std::memory_order_relaxed))
+                marks = self->beginTimerFrame(stats.frame);
+
+            CommandStream& cmds = self->m_cmdBufs[self->m_drawBuf];
+            size_t nextReadback = 0;
             GLenum currentPrim = GL_TRIANGLES;
             for (const Command& cmd : cmds)
             {
-                switch (cmd.m_op)
+                switch (cmd.op<Op>())
                 {
-                case Command::Op::SetShaderDataBinding:
+                case Op::SetShaderDataBinding:
                 {
-                    const GLShaderDataBinding* binding = static_cast<const GLShaderDataBinding*>(cmd.binding);
-                    binding->bind(self->m_drawBuf);
+                    const GLShaderDataBinding* binding = static_cast<const GLShaderDataBinding*>(cmd.get<const IShaderDataBinding*>());
+                    binding->bind(cache, self->m_drawBuf);
                     currentPrim = binding->m_pipeline->m_drawPrim;
                     break;
                 }
-                case Command::Op::SetRenderTarget:
+                case Op::SetRenderTarget:
                 {
-                    const GLTextureR* tex = static_cast<const GLTextureR*>(cmd.target);
+                    const GLTextureR* tex = static_cast<const GLTextureR*>(cmd.get<const ITextureR*>());
+                    if (marks)
+                        self->stampTimer(marks->target(tex));
                     if (!tex)
                         glBindFramebuffer(GL_FRAMEBUFFER, 0);
                     else
                         glBindFramebuffer(GL_FRAMEBUFFER, tex->m_fbo);
                     break;
                 }
-                case Command::Op::SetViewport:
-                    glViewport(cmd.viewport.rect.location[0], cmd.viewport.rect.location[1],
-                               cmd.viewport.rect.size[0], cmd.viewport.rect.size[1]);
-                    glDepthRange(cmd.viewport.znear, cmd.viewport.zfar);
+                case Op::SetViewport:
+                {
+                    const GLViewportCmd& vp = cmd.get<GLViewportCmd>();
+                    glViewport(vp.rect.location[0], vp.rect.location[1], vp.rect.size[0], vp.rect.size[1]);
+                    glDepthRange(vp.znear, vp.zfar);
                     break;
-                case Command::Op::SetScissor:
-                    if (cmd.viewport.rect.size[0] == 0 && cmd.viewport.rect.size[1] == 0)
+                }
+                case Op::SetScissor:
+                {
+                    const SWindowRect& rect = cmd.get<SWindowRect>();
+                    if (rect.size[0] == 0 && rect.size[1] == 0)
                         glDisable(GL_SCISSOR_TEST);
                     else
                     {
                         glEnable(GL_SCISSOR_TEST);
-                        glScissor(cmd.viewport.rect.location[0], cmd.viewport.rect.location[1],
-                                  cmd.viewport.rect.size[0], cmd.viewport.rect.size[1]);
+                        glScissor(rect.location[0], rect.location[1], rect.size[0], rect.size[1]);
                     }
                     break;
-                case Command::Op::SetClearColor:
-                    glClearColor(cmd.rgba[0], cmd.rgba[1], cmd.rgba[2], cmd.rgba[3]);
+                }
+                case Op::SetClearColor:
+                {
+                    const float* rgba = cmd.get<GLClearColorCmd>().rgba;
+                    glClearColor(rgba[0], rgba[1], rgba[2], rgba[3]);
+                    break;
+                }
+                case Op::ClearTarget:
+                {
+                    GLbitfield flags = cmd.get<GLbitfield>();
+                    if (flags & GL_DEPTH_BUFFER_BIT)
+                        cache.depthMask(true);
+                    glClear(flags);
                     break;
-                case Command::Op::ClearTarget:
-                    if (cmd.flags & GL_DEPTH_BUFFER_BIT)
-                        glDepthMask(GL_TRUE);
-                    glClear(cmd.flags);
+                }
+                case Op::Draw:
+                {
+                    const GLDrawCmd& draw = cmd.get<GLDrawCmd>();
+                    glDrawArrays(currentPrim, draw.start, draw.count);
+                    if (marks)
+                        marks->countDraws();
                     break;
-                case Command::Op::Draw:
-                    glDrawArrays(currentPrim, cmd.start, cmd.count);
+                }
+                case Op::DrawIndexed:
+                {
+                    const GLDrawCmd& draw = cmd.get<GLDrawCmd>();
+                    glDrawElements(currentPrim, draw.count, GL_UNSIGNED_INT,
+                                   reinterpret_cast<void*>(draw.start * 4));
+                    if (marks)
+                        marks->countDraws();
                     break;
-                case Command::Op::DrawIndexed:
-                    glDrawElements(currentPrim, cmd.count, GL_UNSIGNED_INT,
-                                   reinterpret_cast<void*>(cmd.start * 4));
+                }
+                case Op::DrawInstances:
+                {
+                    const GLDrawInstancesCmd& draw = cmd.get<GLDrawInstancesCmd>();
+                    glDrawArraysInstanced(currentPrim, draw.start, draw.count, draw.instCount);
+                    if (marks)
+                        marks->countDraws();
                     break;
-                case Command::Op::DrawInstances:
-                    glDrawArraysInstanced(currentPrim, cmd.start, cmd.count, cmd.instCount);
+                }
+                case Op::DrawInstancesIndexed:
+                {
+                    const GLDrawInstancesCmd& draw = cmd.get<GLDrawInstancesCmd>();
+                    glDrawElementsInstanced(currentPrim, draw.count, GL_UNSIGNED_INT,
+                                            reinterpret_cast<void*>(draw.start * 4), draw.instCount);
+                    if (marks)
+                        marks->countDraws();
                     break;
-                case Command::Op::DrawInstancesIndexed:
-                    glDrawElementsInstanced(currentPrim, cmd.count, GL_UNSIGNED_INT,
-                                            reinterpret_cast<void*>(cmd.start * 4), cmd.instCount);
+                }
+                case Op::DrawIndirect:
+                case Op::DrawIndexedIndirect:
+                    self->drawIndirect(cmd, currentPrim);
+                    if (marks)
+                        marks->countDraws(cmd.get<GLIndirectCmd>().drawCount);
                     break;
-                case Command::Op::ResolveBindTexture:
+                case Op::ResolveBindTexture:
                 {
-                    const GLTextureR* tex = static_cast<const GLTextureR*>(cmd.resolveTex);
+                    const GLResolveCmd& resolve = cmd.get<GLResolveCmd>();
+                    const SWindowRect& rect = resolve.rect;
+                    const GLTextureR* tex = static_cast<const GLTextureR*>(resolve.tex);
                     GLenum target = (tex->m_samples > 1) ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
                     glBindFramebuffer(GL_READ_FRAMEBUFFER, tex->m_fbo);
-                    glActiveTexture(GL_TEXTURE9);
-                    if (cmd.resolveColor && tex->m_bindTexs[0])
+                    if (resolve.color && tex->m_bindTexs[0])
                     {
-                        glBindTexture(target, tex->m_bindTexs[0]);
-                        glCopyTexSubImage2D(target, 0, cmd.viewport.rect.location[0], cmd.viewport.rect.location[1],
-                                            cmd.viewport.rect.location[0], cmd.viewport.rect.location[1],
-                                            cmd.viewport.rect.size[0], cmd.viewport.rect.size[1]);
+                        cache.bindTexture(9, target, tex->m_bindTexs[0]);
+                        glCopyTexSubImage2D(target, 0, rect.location[0], rect.location[1],
+                                            rect.location[0], rect.location[1],
+                                            rect.size[0], rect.size[1]);
                     }
-                    if (cmd.resolveDepth && tex->m_bindTexs[1])
+                    if (resolve.depth && tex->m_bindTexs[1])
                     {
-                        glBindTexture(target, tex->m_bindTexs[1]);
-                        glCopyTexSubImage2D(target, 0, cmd.viewport.rect.location[0], cmd.viewport.rect.location[1],
-                                            cmd.viewport.rect.location[0], cmd.viewport.rect.location[1],
-                                            cmd.viewport.rect.size[0], cmd.viewport.rect.size[1]);
+                        cache.bindTexture(9, target, tex->m_bindTexs[1]);
+                        glCopyTexSubImage2D(target, 0, rect.location[0], rect.location[1],
+                                            rect.location[0], rect.location[1],
+                                            rect.size[0], rect.size[1]);
                     }
                     break;
                 }
-                case Command::Op::Present:
+                case Op::Readback:
+                {
+                    const GLReadbackCmd& readback = cmd.get<GLReadbackCmd>();
+                    self->issueReadback(static_cast<const GLTextureR*>(readback.tex), readback.rect,
+                                        std::move(self->m_readbackFuncs[self->m_drawBuf][nextReadback++]));
+                    break;
+                }
+                case Op::BeginTimer:
+                    if (marks)
+                        self->stampTimer(marks->beginScope(cmd.get<const char*>()));
+                    break;
+                case Op::EndTimer:
+                    if (marks)
+                        self->stampTimer(marks->endScope());
+                    break;
+                case Op::Present:
                 {
-                    const GLTextureR* tex = static_cast<const GLTextureR*>(cmd.source);
+                    const GLTextureR* tex = static_cast<const GLTextureR*>(cmd.get<const ITextureR*>());
                     if (tex)
                     {
                         glBindFramebuffer(GL_READ_FRAMEBUFFER, tex->m_fbo);
@@ -1049,66 +1864,311 @@ struct GLCommandQueue : IGraphicsCommandQueue
                                           tex->m_width, tex->m_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
                     }
                     self->m_parent->present();
+                    stats.present = FrameStatsNow();
                     break;
                 }
                 default: break;
                 }
             }
+            if (marks)
+                self->stampTimer(marks->endFrame());
+            stats.renderEnd = FrameStatsNow();
             cmds.clear();
+            self->m_readbackFuncs[self->m_drawBuf].clear();
+            self->fenceSlot(self->m_drawBuf);
+            {
+                std::unique_lock<std::mutex> lk(self->m_mt);
+                self->m_stateIssued = cache.m_issued;
+                self->m_stateElided = cache.m_elided;
+                ++self->m_drawnFrames;
+            }
+            self->m_drawnCv.notify_one();
+            self->m_frameStats.push(stats);
+            self->retireDeadData(recordingFrame);
             for (auto& p : posts)
                 p();
         }
+        self->destroyReadbacks();
+        self->destroyTimers();
+    }
+
+    GPUTimerMarks* beginTimerFrame(uint64_t frame)
+    {
+        if (m_idleTimerFrames.size())
+        {
+            m_timerFrames.push_back(std::move(m_idleTimerFrames.back()));
+            m_idleTimerFrames.pop_back();
+        }
+        else
+            m_timerFrames.emplace_back();
+        GPUTimerMarks& marks = m_timerFrames.back().m_marks;
+        stampTimer(marks.beginFrame(frame, nullptr));
+        return &marks;
+    }
+
+    /* Queries are issued in mark order, so a mark's index is its query's */
+    void stampTimer(int idx)
+    {
+        if (idx < 0)
+            return;
+        GLuint query;
+        if (m_idleQueries.size())
+        {
+            query = m_idleQueries.back();
+            m_idleQueries.pop_back();
+        }
+        else
+            glGenQueries(1, &query);
+        glQueryCounter(query, GL_TIMESTAMP);
+        m_timerFrames.back().m_queries.push_back(query);
+    }
+
+    /* Resolve finished frames in order; a frame's last query lands after all others */
+    void pollTimers()
+    {
+        while (m_timerFrames.size())
+        {
+            TimerFrame& tf = m_timerFrames.front();
+            GLint available = 0;
+            glGetQueryObjectiv(tf.m_queries.back(), GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+
+            m_timerStamps.resize(tf.m_queries.size());
+            for (size_t i=0 ; i<tf.m_queries.size() ; ++i)
+            {
+                GLuint64 stamp = 0;
+                glGetQueryObjectui64v(tf.m_queries[i], GL_QUERY_RESULT, &stamp);
+                m_timerStamps[i] = stamp;
+            }
+            {
+                std::unique_lock<std::mutex> lk(m_gpuTimingsMt);
+                tf.m_marks.resolve(m_timerStamps.data(), m_gpuTimings);
+                m_hasGPUTimings = true;
+            }
+
+            m_idleQueries.insert(m_idleQueries.end(), tf.m_queries.cbegin(), tf.m_queries.cend());
+            tf.m_queries.clear();
+            m_idleTimerFrames.push_back(std::move(tf));
+            m_timerFrames.pop_front();
+        }
+    }
+
+    void destroyTimers()
+    {
+        for (TimerFrame& tf : m_timerFrames)
+            if (tf.m_queries.size())
+                glDeleteQueries(tf.m_queries.size(), tf.m_queries.data());
+        m_timerFrames.clear();
+        if (m_idleQueries.size())
+            glDeleteQueries(m_idleQueries.size(), m_idleQueries.data());
+        m_idleQueries.clear();
+    }
+
+    void issueReadback(const GLTextureR* tex, const SWindowRect& rect, ReadbackFunc&& func)
+    {
+        Readback rb;
+        if (rect.size[0] <= 0 || rect.size[1] <= 0)
+        {
+            /* Nothing to copy; queued without a fence so it fires empty, in order */
+            rb.m_func = std::move(func);
+            m_readbacks.push_back(std::move(rb));
+            return;
+        }
+        if (m_idleReadbacks.size())
+        {
+            rb = std::move(m_idleReadbacks.back());
+            m_idleReadbacks.pop_back();
+        }
+        else
+            glGenBuffers(1, &rb.m_pbo);
+        rb.m_width = rect.size[0];
+        rb.m_height = rect.size[1];
+        rb.m_func = std::move(func);
+
+        size_t sz = rb.m_width * rb.m_height * 4;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, rb.m_pbo);
+        if (rb.m_capacity < sz)
+        {
+            glBufferData(GL_PIXEL_PACK_BUFFER, sz, nullptr, GL_STREAM_READ);
+            rb.m_capacity = sz;
+        }
+
+        GLint prevDrawFbo, prevReadFbo;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prevDrawFbo);
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &prevReadFbo);
+        GLint x = rect.location[0];
+        GLint y = rect.location[1];
+        if (tex->m_samples > 1)
+        {
+            /* glReadPixels can't read multisampled buffers; resolve the rect first */
+            if (!m_readbackFbo)
+            {
+                glGenFramebuffers(1, &m_readbackFbo);
+                glGenRenderbuffers(1, &m_readbackRbo);
+            }
+            if (m_readbackRboWidth < rb.m_width || m_readbackRboHeight < rb.m_height)
+            {
+                m_readbackRboWidth = std::max(m_readbackRboWidth, rb.m_width);
+                m_readbackRboHeight = std::max(m_readbackRboHeight, rb.m_height);
+                glBindRenderbuffer(GL_RENDERBUFFER, m_readbackRbo);
+                glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, m_readbackRboWidth, m_readbackRboHeight);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_readbackFbo);
+                glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_readbackRbo);
+            }
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, tex->m_fbo);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_readbackFbo);
+            glBlitFramebuffer(x, y, x + rb.m_width, y + rb.m_height, 0, 0, rb.m_width, rb.m_height,
+                              GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, m_readbackFbo);
+            x = 0;
+            y = 0;
+        }
+        else
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, tex->m_fbo);
+
+        /* With a pack buffer bound this only queues the copy */
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(x, y, rb.m_width, rb.m_height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, prevDrawFbo);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, prevReadFbo);
+        rb.m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        m_readbacks.push_back(std::move(rb));
+    }
+
+    void pollReadbacks()
+    {
+        while (m_readbacks.size())
+        {
+            Readback& rb = m_readbacks.front();
+            if (!rb.m_fence)
+            {
+                ReadbackData data = {nullptr, 0, 0, 0, false};
+                rb.m_func(data);
+                m_readbacks.pop_front();
+                continue;
+            }
+            GLenum res = glClientWaitSync(rb.m_fence, 0, 0);
+            if (res == GL_TIMEOUT_EXPIRED)
+                break;
+            glDeleteSync(rb.m_fence);
+            rb.m_fence = 0;
+            if (res == GL_WAIT_FAILED)
+                Log.report(logvisor::Error, "unable to wait on readback fence");
+            else
+            {
+                size_t sz = rb.m_width * rb.m_height * 4;
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, rb.m_pbo);
+                const uint8_t* pixels =
+                    static_cast<const uint8_t*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sz, GL_MAP_READ_BIT));
+                if (pixels)
+                {
+                    ReadbackData data = {pixels, ptrdiff_t(rb.m_width * 4), rb.m_width, rb.m_height, false};
+                    rb.m_func(data);
+                    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                }
+                else
+                    Log.report(logvisor::Error, "unable to map readback buffer");
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            }
+            rb.m_func = {};
+            m_idleReadbacks.push_back(std::move(rb));
+            m_readbacks.pop_front();
+        }
+    }
+
+    void destroyReadbacks()
+    {
+        for (Readback& rb : m_readbacks)
+        {
+            glDeleteSync(rb.m_fence);
+            glDeleteBuffers(1, &rb.m_pbo);
+        }
+        m_readbacks.clear();
+        for (Readback& rb : m_idleReadbacks)
+            glDeleteBuffers(1, &rb.m_pbo);
+        m_idleReadbacks.clear();
+        if (m_readbackFbo)
+        {
+            glDeleteFramebuffers(1, &m_readbackFbo);
+            glDeleteRenderbuffers(1, &m_readbackRbo);
+        }
+    }
+
+    /* Render thread, after a frame has been issued. Frames up to one full
+     * pipeline behind the frame just drawn have retired on the GPU; destroyed
+     * data no frame in flight can reference is freed without waiting */
+    void retireDeadData(uint64_t recordingFrame)
+    {
+        GLDataFactory* gfxF = static_cast<GLDataFactory*>(m_parent->getDataFactory());
+        gfxF->m_deadData.collect(recordingFrame);
+        uint64_t drawnFrame = m_drawnFrames - 1;
+        if (drawnFrame < m_frameDepth)
+            return;
+        gfxF->m_deadData.retire(drawnFrame - m_frameDepth, [gfxF](IGraphicsData* d)
+        {
+            GLData* data = static_cast<GLData*>(d);
+            {
+                std::unique_lock<std::mutex> lk(gfxF->m_committedMutex);
+                gfxF->m_committedData.erase(data);
+            }
+            delete data;
+            return true;
+        });
     }
 
     GLCommandQueue(IGraphicsContext* parent)
     : m_parent(parent),
+      m_frameDepth(static_cast<GLDataFactory*>(parent->getDataFactory())->m_frameDepth),
       m_initlk(m_initmt),
       m_thr(RenderingWorker, this)
     {
         m_initcv.wait(m_initlk);
         m_initlk.unlock();
+        m_recordStart = FrameStatsNow();
     }
 
     void stopRenderer()
     {
-        m_running = false;
+        {
+            std::unique_lock<std::mutex> lk(m_mt);
+            m_running = false;
+        }
         m_cv.notify_one();
+        m_drawnCv.notify_all(); /* Releases a client waiting for a free slot */
         m_thr.join();
     }
 
     ~GLCommandQueue()
     {
         if (m_running) stopRenderer();
+        for (size_t i=0 ; i<GLMaxFrameDepth ; ++i)
+            if (m_slotFences[i])
+                glDeleteSync(m_slotFences[i]);
     }
 
     void setShaderDataBinding(IShaderDataBinding* binding)
     {
-        std::vector<Command>& cmds = m_cmdBufs[m_fillBuf];
-        cmds.emplace_back(Command::Op::SetShaderDataBinding);
-        cmds.back().binding = binding;
+        m_cmdBufs[m_fillBuf].push<const IShaderDataBinding*>(Op::SetShaderDataBinding) = binding;
     }
 
     void setRenderTarget(ITextureR* target)
     {
-        std::vector<Command>& cmds = m_cmdBufs[m_fillBuf];
-        cmds.emplace_back(Command::Op::SetRenderTarget);
-        cmds.back().target = target;
+        m_cmdBufs[m_fillBuf].push<const ITextureR*>(Op::SetRenderTarget) = target;
     }
 
     void setViewport(const SWindowRect& rect, float znear, float zfar)
     {
-        std::vector<Command>& cmds = m_cmdBufs[m_fillBuf];
-        cmds.emplace_back(Command::Op::SetViewport);
-        cmds.back().viewport.rect = rect;
-        cmds.back().viewport.znear = znear;
-        cmds.back().viewport.zfar = zfar;
+        GLViewportCmd& vp = m_cmdBufs[m_fillBuf].push<GLViewportCmd>(Op::SetViewport);
+        vp.rect = rect;
+        vp.znear = znear;
+        vp.zfar = zfar;
     }
 
     void setScissor(const SWindowRect& rect)
     {
-        std::vector<Command>& cmds = m_cmdBufs[m_fillBuf];
-        cmds.emplace_back(Command::Op::SetScissor);
-        cmds.back().viewport.rect = rect;
+        m_cmdBufs[m_fillBuf].push<SWindowRect>(Op::SetScissor) = rect;
     }
 
     void resizeRenderTexture(ITextureR* tex, size_t width, size_t height)
@@ -1125,69 +2185,62 @@ struct GLCommandQueue : IGraphicsCommandQueue
 
     void setClearColor(const float rgba[4])
     {
-        std::vector<Command>& cmds = m_cmdBufs[m_fillBuf];
-        cmds.emplace_back(Command::Op::SetClearColor);
-        cmds.back().rgba[0] = rgba[0];
-        cmds.back().rgba[1] = rgba[1];
-        cmds.back().rgba[2] = rgba[2];
-        cmds.back().rgba[3] = rgba[3];
+        GLClearColorCmd& clear = m_cmdBufs[m_fillBuf].push<GLClearColorCmd>(Op::SetClearColor);
+        clear.rgba[0] = rgba[0];
+        clear.rgba[1] = rgba[1];
+        clear.rgba[2] = rgba[2];
+        clear.rgba[3] = rgba[3];
     }
 
     void clearTarget(bool render=true, bool depth=true)
     {
-        std::vector<Command>& cmds = m_cmdBufs[m_fillBuf];
-        cmds.emplace_back(Command::Op::ClearTarget);
-        cmds.back().flags = 0;
+        GLbitfield& flags = m_cmdBufs[m_fillBuf].push<GLbitfield>(Op::ClearTarget);
+        flags = 0;
         if (render)
-            cmds.back().flags |= GL_COLOR_BUFFER_BIT;
+            flags |= GL_COLOR_BUFFER_BIT;
         if (depth)
-            cmds.back().flags |= GL_DEPTH_BUFFER_BIT;
+            flags |= GL_DEPTH_BUFFER_BIT;
     }
 
     void draw(size_t start, size_t count)
     {
-        std::vector<Command>& cmds = m_cmdBufs[m_fillBuf];
-        cmds.emplace_back(Command::Op::Draw);
-        cmds.back().start = start;
-        cmds.back().count = count;
+        m_cmdBufs[m_fillBuf].push<GLDrawCmd>(Op::Draw) = {start, count};
     }
 
     void drawIndexed(size_t start, size_t count)
     {
-        std::vector<Command>& cmds = m_cmdBufs[m_fillBuf];
-        cmds.emplace_back(Command::Op::DrawIndexed);
-        cmds.back().start = start;
-        cmds.back().count = count;
+        m_cmdBufs[m_fillBuf].push<GLDrawCmd>(Op::DrawIndexed) = {start, count};
     }
 
     void drawInstances(size_t start, size_t count, size_t instCount)
     {
-        std::vector<Command>& cmds = m_cmdBufs[m_fillBuf];
-        cmds.emplace_back(Command::Op::DrawInstances);
-        cmds.back().start = start;
-        cmds.back().count = count;
-        cmds.back().instCount = instCount;
+        m_cmdBufs[m_fillBuf].push<GLDrawInstancesCmd>(Op::DrawInstances) = {start, count, instCount};
     }
 
     void drawInstancesIndexed(size_t start, size_t count, size_t instCount)
     {
-        std::vector<Command>& cmds = m_cmdBufs[m_fillBuf];
-        cmds.emplace_back(Command::Op::DrawInstancesIndexed);
-        cmds.back().start = start;
-        cmds.back().count = count;
-        cmds.back().instCount = instCount;
+        m_cmdBufs[m_fillBuf].push<GLDrawInstancesCmd>(Op::DrawInstancesIndexed) = {start, count, instCount};
+    }
+
+    void drawIndirect(IGraphicsBuffer* buf, size_t offset, size_t drawCount)
+    {
+        m_cmdBufs[m_fillBuf].push<GLIndirectCmd>(Op::DrawIndirect) = {buf, offset, drawCount};
+    }
+
+    void drawIndexedIndirect(IGraphicsBuffer* buf, size_t offset, size_t drawCount)
+    {
+        m_cmdBufs[m_fillBuf].push<GLIndirectCmd>(Op::DrawIndexedIndirect) = {buf, offset, drawCount};
     }
 
     void resolveBindTexture(ITextureR* texture, const SWindowRect& rect, bool tlOrigin, bool color, bool depth)
     {
         GLTextureR* tex = static_cast<GLTextureR*>(texture);
-        std::vector<Command>& cmds = m_cmdBufs[m_fillBuf];
-        cmds.emplace_back(Command::Op::ResolveBindTexture);
-        cmds.back().resolveTex = texture;
-        cmds.back().resolveColor = color;
-        cmds.back().resolveDepth = depth;
+        GLResolveCmd& resolve = m_cmdBufs[m_fillBuf].push<GLResolveCmd>(Op::ResolveBindTexture);
+        resolve.tex = texture;
+        resolve.color = color;
+        resolve.depth = depth;
         SWindowRect intersectRect = rect.intersect(SWindowRect(0, 0, tex->m_width, tex->m_height));
-        SWindowRect& targetRect = cmds.back().viewport.rect;
+        SWindowRect& targetRect = resolve.rect;
         targetRect.location[0] = intersectRect.location[0];
         if (tlOrigin)
             targetRect.location[1] = tex->m_height - intersectRect.location[1] - intersectRect.size[1];
@@ -1199,9 +2252,43 @@ struct GLCommandQueue : IGraphicsCommandQueue
 
     void resolveDisplay(ITextureR* source)
     {
-        std::vector<Command>& cmds = m_cmdBufs[m_fillBuf];
-        cmds.emplace_back(Command::Op::Present);
-        cmds.back().source = source;
+        m_cmdBufs[m_fillBuf].push<const ITextureR*>(Op::Present) = source;
+    }
+
+    void readback(ITextureR* texture, const SWindowRect& rect, ReadbackFunc&& callback)
+    {
+        GLTextureR* tex = static_cast<GLTextureR*>(texture);
+        GLReadbackCmd& readback = m_cmdBufs[m_fillBuf].push<GLReadbackCmd>(Op::Readback);
+        readback.tex = texture;
+        readback.rect = rect.intersect(SWindowRect(0, 0, tex->m_width, tex->m_height));
+        m_readbackFuncs[m_fillBuf].push_back(std::move(callback));
+    }
+
+    void setGPUTimingEnabled(bool enabled) {m_gpuTiming.store(enabled);}
+    bool gpuTimingEnabled() const {return m_gpuTiming.load();}
+
+    void beginTimer(const char* name)
+    {
+        m_cmdBufs[m_fillBuf].push<const char*>(Op::BeginTimer) = name;
+    }
+
+    void endTimer()
+    {
+        m_cmdBufs[m_fillBuf].push(Op::EndTimer);
+    }
+
+    bool getGPUTimings(GPUFrameTimings& out) const
+    {
+        std::unique_lock<std::mutex> lk(m_gpuTimingsMt);
+        if (!m_hasGPUTimings)
+            return false;
+        out = m_gpuTimings;
+        return true;
+    }
+
+    size_t getFrameStats(FrameStats* out, size_t maxCount) const
+    {
+        return m_frameStats.copy(out, maxCount);
     }
 
     void addVertexFormat(GLVertexFormat* fmt)
@@ -1222,7 +2309,11 @@ struct GLCommandQueue : IGraphicsCommandQueue
                 break;
             }
         if (!foundAdd)
-            m_pendingFmtDels.push_back({fmt->m_vao[0], fmt->m_vao[1], fmt->m_vao[2]});
+        {
+            std::array<GLuint, GLMaxFrameDepth> vaos;
+            std::copy(std::begin(fmt->m_vao), std::end(fmt->m_vao), vaos.begin());
+            m_pendingFmtDels.push_back(vaos);
+        }
     }
 
     void addFBO(GLTextureR* tex)
@@ -1237,87 +2328,361 @@ struct GLCommandQueue : IGraphicsCommandQueue
         m_pendingFboDels.push_back(tex->m_fbo);
     }
 
+    void markDirty(GLGraphicsBufferD* buf)
+    {
+        std::unique_lock<std::mutex> lk(m_dirtyMt);
+        if (!buf->m_dirty)
+        {
+            buf->m_dirty = true;
+            m_dirtyBufs.insert(buf);
+        }
+    }
+
+    void markDirty(GLTextureD* tex)
+    {
+        std::unique_lock<std::mutex> lk(m_dirtyMt);
+        if (!tex->m_dirty)
+        {
+            tex->m_dirty = true;
+            m_dirtyTexs.insert(tex);
+        }
+    }
+
+    void clearDirty(GLGraphicsBufferD* buf)
+    {
+        std::unique_lock<std::mutex> lk(m_dirtyMt);
+        m_dirtyWalkCv.wait(lk, [this]() {return !m_dirtyWalking;});
+        if (buf->m_dirty)
+            m_dirtyBufs.erase(buf);
+    }
+
+    void clearDirty(GLTextureD* tex)
+    {
+        std::unique_lock<std::mutex> lk(m_dirtyMt);
+        m_dirtyWalkCv.wait(lk, [this]() {return !m_dirtyWalking;});
+        if (tex->m_dirty)
+            m_dirtyTexs.erase(tex);
+    }
+
+    void fenceSlot(size_t b)
+    {
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        /* Other contexts wait on this fence; make sure it reaches the GPU */
+        glFlush();
+        std::unique_lock<std::mutex> lk(m_fenceMt);
+        if (m_slotFences[b])
+            retireFence(m_slotFences[b]);
+        m_slotFences[b] = fence;
+    }
+
+    /* Called with m_fenceMt held; a fence another thread is waiting on stays
+     * alive until every waiter has returned */
+    void retireFence(GLsync fence)
+    {
+        if (m_fenceWaiters)
+            m_retiredFences.push_back(fence);
+        else
+            glDeleteSync(fence);
+    }
+
+    /* Waits without m_fenceMt so the client and render thread don't queue
+     * behind each other's GPU waits */
+    void waitForSlot(size_t b)
+    {
+        std::unique_lock<std::mutex> lk(m_fenceMt);
+        GLsync fence = m_slotFences[b];
+        if (!fence)
+            return;
+        ++m_fenceWaiters;
+        lk.unlock();
+
+        GLenum res;
+        while ((res = glClientWaitSync(fence, 0, 1000000)) == GL_TIMEOUT_EXPIRED) {}
+        if (res == GL_WAIT_FAILED)
+            Log.report(logvisor::Error, "unable to wait on buffer region fence");
+
+        lk.lock();
+        if (m_slotFences[b] == fence)
+        {
+            m_slotFences[b] = 0;
+            retireFence(fence);
+        }
+        if (!--m_fenceWaiters)
+        {
+            for (GLsync retired : m_retiredFences)
+                glDeleteSync(retired);
+            m_retiredFences.clear();
+        }
+    }
+
     void execute()
     {
-        std::unique_lock<std::mutex> lk(m_mt);
-        m_completeBuf = m_fillBuf;
-        for (size_t i=0 ; i<3 ; ++i)
+        uint64_t executeStamp = FrameStatsNow();
+        /* m_fillBuf is only written by this thread */
+        size_t completeBuf = m_fillBuf;
+
+        /* Update dynamic data here, with no lock held since update() may
+         * wait on the GPU; resources stay listed until every frame slot
+         * has received the latest contents */
+        int allSlots = (1 << m_frameDepth) - 1;
+        std::unordered_set<GLGraphicsBufferD*> dirtyBufs;
+        std::unordered_set<GLTextureD*> dirtyTexs;
+        std::unique_lock<std::mutex> dirtylk(m_dirtyMt);
+        dirtyBufs.swap(m_dirtyBufs);
+        dirtyTexs.swap(m_dirtyTexs);
+        m_dirtyWalking = true;
+        dirtylk.unlock();
+
+        size_t uploads = 0;
+        for (GLGraphicsBufferD* b : dirtyBufs)
         {
-            if (i == m_completeBuf || i == m_drawBuf)
-                continue;
-            m_fillBuf = i;
-            break;
+            if ((b->m_validMask & (1 << completeBuf)) == 0)
+                ++uploads;
+            b->update(completeBuf);
+        }
+        for (GLTextureD* t : dirtyTexs)
+        {
+            if ((t->m_validMask & (1 << completeBuf)) == 0)
+                ++uploads;
+            t->update(completeBuf);
         }
 
-        /* Update dynamic data here */
-        GLDataFactory* gfxF = static_cast<GLDataFactory*>(m_parent->getDataFactory());
-        std::unique_lock<std::mutex> datalk(gfxF->m_committedMutex);
-        for (GLData* d : gfxF->m_committedData)
+        /* Put back whatever still has stale slots (or was reloaded meanwhile) */
+        dirtylk.lock();
+        for (GLGraphicsBufferD* b : dirtyBufs)
+        {
+            if (b->m_validMask == allSlots)
+                b->m_dirty = false;
+            else
+                m_dirtyBufs.insert(b);
+        }
+        for (GLTextureD* t : dirtyTexs)
         {
-            for (std::unique_ptr<GLGraphicsBufferD>& b : d->m_DBufs)
-                b->update(m_completeBuf);
-            for (std::unique_ptr<GLTextureD>& t : d->m_DTexs)
-                t->update(m_completeBuf);
+            if (t->m_validMask == allSlots)
+                t->m_dirty = false;
+            else
+                m_dirtyTexs.insert(t);
         }
-        datalk.unlock();
+        m_dirtyWalking = false;
+        dirtylk.unlock();
+        m_dirtyWalkCv.notify_all();
+
+        std::unique_lock<std::mutex> lk(m_mt);
+        m_frameCounters.dynamicUploads = uploads;
+        m_frameCounters.stateChangesIssued = m_stateIssued;
+        m_frameCounters.stateChangesElided = m_stateElided;
         glFlush();
 
         for (auto& p : m_pendingPosts1)
             m_pendingPosts2.push_back(std::move(p));
         m_pendingPosts1.clear();
 
-        lk.unlock();
+        FrameStats& stats = m_slotStats[completeBuf];
+        stats = FrameStats();
+        stats.frame = m_submittedFrames + 1;
+        stats.recordStart = m_recordStart;
+        stats.execute = executeStamp;
+
+        ++m_submittedFrames;
+        m_fillBuf = m_submittedFrames % m_frameDepth;
         m_cv.notify_one();
+
+        /* Back-pressure: the next slot is free once the render thread has
+         * drawn the frame last recorded into it */
+        auto slotFree = [this]() {return m_drawnFrames + m_frameDepth > m_submittedFrames || !m_running;};
+        if (!slotFree())
+        {
+            ++m_throttledFrames;
+            m_drawnCv.wait(lk, slotFree);
+        }
+        lk.unlock();
         m_cmdBufs[m_fillBuf].clear();
+        m_recordStart = FrameStatsNow();
+    }
+
+    FrameCounters getFrameCounters() const
+    {
+        FrameCounters ret = m_frameCounters;
+        ret.throttledFrames = m_throttledFrames;
+        return ret;
+    }
+
+    std::unique_ptr<IGraphicsCommandList> newCommandList();
+    void executeCommandLists(IGraphicsCommandList* const* lists, size_t count);
+};
+
+/* Worker-thread command list; its commands are copied into the
+ * queue's fill buffer by executeCommandLists() */
+struct GLCommandList : IGraphicsCommandList
+{
+    using Op = GLCommandOp;
+    CommandStream m_cmds;
+
+    void begin(ITextureR*) {m_cmds.clear();}
+    void end() {}
+
+    void setShaderDataBinding(IShaderDataBinding* binding)
+    {
+        m_cmds.push<const IShaderDataBinding*>(Op::SetShaderDataBinding) = binding;
+    }
+
+    void setViewport(const SWindowRect& rect, float znear, float zfar)
+    {
+        GLViewportCmd& vp = m_cmds.push<GLViewportCmd>(Op::SetViewport);
+        vp.rect = rect;
+        vp.znear = znear;
+        vp.zfar = zfar;
+    }
+
+    void setScissor(const SWindowRect& rect)
+    {
+        m_cmds.push<SWindowRect>(Op::SetScissor) = rect;
+    }
+
+    void draw(size_t start, size_t count)
+    {
+        m_cmds.push<GLDrawCmd>(Op::Draw) = {start, count};
+    }
+
+    void drawIndexed(size_t start, size_t count)
+    {
+        m_cmds.push<GLDrawCmd>(Op::DrawIndexed) = {start, count};
+    }
+
+    void drawInstances(size_t start, size_t count, size_t instCount)
+    {
+        m_cmds.push<GLDrawInstancesCmd>(Op::DrawInstances) = {start, count, instCount};
+    }
+
+    void drawInstancesIndexed(size_t start, size_t count, size_t instCount)
+    {
+        m_cmds.push<GLDrawInstancesCmd>(Op::DrawInstancesIndexed) = {start, count, instCount};
     }
 };
 
+std::unique_ptr<IGraphicsCommandList> GLCommandQueue::newCommandList()
+{
+    return std::unique_ptr<IGraphicsCommandList>(new GLCommandList);
+}
+
+void GLCommandQueue::executeCommandLists(IGraphicsCommandList* const* lists, size_t count)
+{
+    CommandStream& cmds = m_cmdBufs[m_fillBuf];
+    for (size_t i=0 ; i<count ; ++i)
+        cmds.append(static_cast<GLCommandList*>(lists[i])->m_cmds);
+}
+
+GLGraphicsBufferD::GLGraphicsBufferD(GLCommandQueue* q, BufferUse use, size_t sz)
+: m_q(q), m_slotCount(q->m_frameDepth), m_target(USE_TABLE[int(use)]), m_cpuBuf(new uint8_t[sz]), m_cpuSz(sz)
+{
+    if (q->m_hasBufferStorage && use != BufferUse::Index)
+    {
+        size_t align = q->m_uniformAlignment;
+        m_regionSz = (m_cpuSz + align - 1) / align * align;
+        /* Readable so slots the client skipped can be refreshed from the last mapped region */
+        const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glGenBuffers(1, m_bufs);
+        glBindBuffer(m_target, m_bufs[0]);
+        glBufferStorage(m_target, m_regionSz * m_slotCount, nullptr, flags);
+        m_persistentPtr = static_cast<uint8_t*>(glMapBufferRange(m_target, 0, m_regionSz * m_slotCount, flags));
+        if (m_persistentPtr)
+        {
+            for (size_t i=1 ; i<m_slotCount ; ++i)
+                m_bufs[i] = m_bufs[0];
+            return;
+        }
+        Log.report(logvisor::Warning, "unable to persistently map dynamic buffer; using fallback");
+        glDeleteBuffers(1, m_bufs);
+        m_regionSz = 0;
+    }
+
+    glGenBuffers(m_slotCount, m_bufs);
+    for (size_t i=0 ; i<m_slotCount ; ++i)
+    {
+        glBindBuffer(m_target, m_bufs[i]);
+        glBufferData(m_target, m_cpuSz, nullptr, GL_STREAM_DRAW);
+    }
+}
+
 void GLGraphicsBufferD::update(int b)
 {
     int slot = 1 << b;
     if ((slot & m_validMask) == 0)
     {
-        glBindBuffer(m_target, m_bufs[b]);
-        glBufferSubData(m_target, 0, m_cpuSz, m_cpuBuf.get());
+        if (m_persistentPtr)
+        {
+            m_q->waitForSlot(b);
+            const uint8_t* src = m_latestRegion < 0 ? m_cpuBuf.get() : m_persistentPtr + regionOffset(m_latestRegion);
+            memcpy(m_persistentPtr + regionOffset(b), src, m_cpuSz);
+        }
+        else
+        {
+            glBindBuffer(m_target, m_bufs[b]);
+            glBufferSubData(m_target, 0, m_cpuSz, m_cpuBuf.get());
+        }
         m_validMask |= slot;
     }
 }
 
+GLGraphicsBufferD::~GLGraphicsBufferD()
+{
+    m_q->clearDirty(this);
+    /* Deleting the persistent buffer implicitly unmaps it */
+    glDeleteBuffers(m_persistentPtr ? 1 : m_slotCount, m_bufs);
+}
+
 void GLGraphicsBufferD::load(const void* data, size_t sz)
 {
     size_t bufSz = std::min(sz, m_cpuSz);
     memcpy(m_cpuBuf.get(), data, bufSz);
+    m_latestRegion = -1;
     m_validMask = 0;
+    m_q->markDirty(this);
 }
+/* With persistent storage the client writes straight into the region of the
+ * frame being recorded, once the GPU has retired that region's last frame;
+ * slots of frames recorded without a map() are refreshed from it in update() */
 void* GLGraphicsBufferD::map(size_t sz)
 {
     if (sz < m_cpuSz)
         return nullptr;
-    return m_cpuBuf.get();
+    if (!m_persistentPtr)
+        return m_cpuBuf.get();
+    int b = int(m_q->m_fillBuf);
+    m_q->waitForSlot(b);
+    m_latestRegion = b;
+    return m_persistentPtr + regionOffset(b);
 }
 void GLGraphicsBufferD::unmap()
 {
-    m_validMask = 0;
+    m_validMask = m_latestRegion >= 0 ? 1 << m_latestRegion : 0;
+    m_q->markDirty(this);
 }
 void GLGraphicsBufferD::bindVertex(int b)
 {glBindBuffer(GL_ARRAY_BUFFER, m_bufs[b]);}
 void GLGraphicsBufferD::bindIndex(int b)
 {glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufs[b]);}
-void GLGraphicsBufferD::bindUniform(size_t idx, int b)
-{glBindBufferBase(GL_UNIFORM_BUFFER, idx, m_bufs[b]);}
-void GLGraphicsBufferD::bindUniformRange(size_t idx, GLintptr off, GLsizeiptr size, int b)
-{glBindBufferRange(GL_UNIFORM_BUFFER, idx, m_bufs[b], off, size);}
+void GLGraphicsBufferD::bindUniform(GLStateCache& cache, size_t idx, int b)
+{
+    if (m_persistentPtr)
+        cache.bindUniformRange(idx, m_bufs[b], regionOffset(b), m_cpuSz);
+    else
+        cache.bindUniformBase(idx, m_bufs[b]);
+}
+void GLGraphicsBufferD::bindUniformRange(GLStateCache& cache, size_t idx, GLintptr off, GLsizeiptr size, int b)
+{cache.bindUniformRange(idx, m_bufs[b], regionOffset(b) + off, size);}
 
 IGraphicsBufferD*
 GLDataFactory::Context::newDynamicBuffer(BufferUse use, size_t stride, size_t count)
 {
-    GLGraphicsBufferD* retval = new GLGraphicsBufferD(use, stride * count);
+    GLCommandQueue* q = static_cast<GLCommandQueue*>(m_parent.m_parent->getCommandQueue());
+    GLGraphicsBufferD* retval = new GLGraphicsBufferD(q, use, stride * count);
     m_deferredData->m_DBufs.emplace_back(retval);
     return retval;
 }
 
-GLTextureD::GLTextureD(size_t width, size_t height, TextureFormat fmt)
-: m_width(width), m_height(height)
+GLTextureD::GLTextureD(GLCommandQueue* q, size_t width, size_t height, TextureFormat fmt)
+: m_q(q), m_slotCount(q->m_frameDepth), m_width(width), m_height(height)
 {
     int pxPitch = 4;
     switch (fmt)
@@ -1338,8 +2703,8 @@ GLTextureD::GLTextureD(size_t width, size_t height, TextureFormat fmt)
     m_cpuSz = width * height * pxPitch;
     m_cpuBuf.reset(new uint8_t[m_cpuSz]);
 
-    glGenTextures(3, m_texs);
-    for (int i=0 ; i<3 ; ++i)
+    glGenTextures(m_slotCount, m_texs);
+    for (size_t i=0 ; i<m_slotCount ; ++i)
     {
         glBindTexture(GL_TEXTURE_2D, m_texs[i]);
         glTexImage2D(GL_TEXTURE_2D, 0, m_intFormat, width, height, 0, m_format, GL_UNSIGNED_BYTE, nullptr);
@@ -1347,7 +2712,11 @@ GLTextureD::GLTextureD(size_t width, size_t height, TextureFormat fmt)
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     }
 }
-GLTextureD::~GLTextureD() {glDeleteTextures(3, m_texs);}
+GLTextureD::~GLTextureD()
+{
+    m_q->clearDirty(this);
+    glDeleteTextures(m_slotCount, m_texs);
+}
 
 void GLTextureD::update(int b)
 {
@@ -1365,6 +2734,7 @@ void GLTextureD::load(const void* data, size_t sz)
     size_t bufSz = std::min(sz, m_cpuSz);
     memcpy(m_cpuBuf.get(), data, bufSz);
     m_validMask = 0;
+    m_q->markDirty(this);
 }
 void* GLTextureD::map(size_t sz)
 {
@@ -1375,18 +2745,17 @@ void* GLTextureD::map(size_t sz)
 void GLTextureD::unmap()
 {
     m_validMask = 0;
+    m_q->markDirty(this);
 }
 
-void GLTextureD::bind(size_t idx, int b)
-{
-    glActiveTexture(GL_TEXTURE0 + idx);
-    glBindTexture(GL_TEXTURE_2D, m_texs[b]);
-}
+void GLTextureD::bind(GLStateCache& cache, size_t idx, int b)
+{cache.bindTexture(idx, GL_TEXTURE_2D, m_texs[b]);}
 
 ITextureD*
 GLDataFactory::Context::newDynamicTexture(size_t width, size_t height, TextureFormat fmt)
 {
-    GLTextureD* retval = new GLTextureD(width, height, fmt);
+    GLCommandQueue* q = static_cast<GLCommandQueue*>(m_parent.m_parent->getCommandQueue());
+    GLTextureD* retval = new GLTextureD(q, width, height, fmt);
     m_deferredData->m_DTexs.emplace_back(retval);
     return retval;
 }
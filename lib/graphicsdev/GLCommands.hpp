@@ -0,0 +1,83 @@
+#ifndef GDEV_GLCOMMANDS_HPP
+#define GDEV_GLCOMMANDS_HPP
+
+#include "boo/IWindow.hpp"
+#include "boo/graphicsdev/IGraphicsDataFactory.hpp"
+#include <stddef.h>
+#include <stdint.h>
+
+namespace boo
+{
+
+/* Ops and payloads the GL command queue packs into its CommandStream, shared
+ * with the encoding benchmark (tools/cmdbench.cpp). The payload each op
+ * carries is noted beside it */
+enum class GLCommandOp : uint32_t
+{
+    SetShaderDataBinding, /* const IShaderDataBinding* */
+    SetRenderTarget,      /* const ITextureR* */
+    SetViewport,          /* GLViewportCmd */
+    SetScissor,           /* SWindowRect */
+    SetClearColor,        /* GLClearColorCmd */
+    ClearTarget,          /* GLbitfield */
+    Draw,                 /* GLDrawCmd */
+    DrawIndexed,          /* GLDrawCmd */
+    DrawInstances,        /* GLDrawInstancesCmd */
+    DrawInstancesIndexed, /* GLDrawInstancesCmd */
+    DrawIndirect,         /* GLIndirectCmd */
+    DrawIndexedIndirect,  /* GLIndirectCmd */
+    ResolveBindTexture,   /* GLResolveCmd */
+    Readback,             /* GLReadbackCmd */
+    BeginTimer,           /* const char* */
+    EndTimer,
+    Present               /* const ITextureR* */
+};
+
+struct GLViewportCmd
+{
+    SWindowRect rect;
+    float znear, zfar;
+};
+
+struct GLClearColorCmd
+{
+    float rgba[4];
+};
+
+struct GLDrawCmd
+{
+    size_t start;
+    size_t count;
+};
+
+struct GLDrawInstancesCmd
+{
+    size_t start;
+    size_t count;
+    size_t instCount;
+};
+
+struct GLIndirectCmd
+{
+    const IGraphicsBuffer* buf;
+    size_t offset;
+    size_t drawCount;
+};
+
+struct GLResolveCmd
+{
+    const ITextureR* tex;
+    SWindowRect rect;
+    bool color;
+    bool depth;
+};
+
+struct GLReadbackCmd
+{
+    const ITextureR* tex;
+    SWindowRect rect;
+};
+
+}
+
+#endif // GDEV_GLCOMMANDS_HPP
@@ -0,0 +1,307 @@
+#include "boo/graphicsdev/GLHeadless.hpp"
+#include "boo/graphicsdev/GL.hpp"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <string.h>
+#include <type_traits>
+#include <initializer_list>
+
+#include "logvisor/logvisor.hpp"
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+namespace boo
+{
+static logvisor::Module Log("boo::GLHeadless");
+
+IGraphicsCommandQueue* _NewGLCommandQueue(IGraphicsContext* parent);
+
+/* Same version ladder the GLX contexts walk down */
+static const EGLint ContextVersionList[][2] =
+{
+    {4, 5},
+    {4, 4},
+    {4, 3},
+    {4, 2},
+    {4, 1},
+    {4, 0},
+    {3, 3}
+};
+
+static bool HasExtension(const char* extensions, const char* name)
+{
+    if (!extensions)
+        return false;
+    size_t len = strlen(name);
+    for (const char* it = strstr(extensions, name) ; it ; it = strstr(it + len, name))
+        if ((it == extensions || it[-1] == ' ') && (it[len] == ' ' || it[len] == '\0'))
+            return true;
+    return false;
+}
+
+class GraphicsContextEGLHeadless : public IGraphicsContext
+{
+    EGraphicsAPI m_api = EGraphicsAPI::OpenGL3_3;
+    EPixelFormat m_pf = EPixelFormat::RGBA8;
+    size_t m_width;
+    size_t m_height;
+
+    EGLDisplay m_display = EGL_NO_DISPLAY;
+    EGLConfig m_config = nullptr;
+    EGLSurface m_surface = EGL_NO_SURFACE; /* Stays EGL_NO_SURFACE on the surfaceless fallback */
+    bool m_surfacelessCtx = false;
+    bool m_versionedCtx = false; /* EGL_KHR_create_context or EGL 1.5 */
+    size_t m_versionIdx = 0;
+    EGLContext m_ctx = EGL_NO_CONTEXT;
+
+    /* Client-thread contexts each need their own drawable unless surfaceless
+     * contexts are supported; an EGL surface is current on one thread at most */
+    EGLContext m_mainCtx = EGL_NO_CONTEXT;
+    EGLSurface m_mainSurface = EGL_NO_SURFACE;
+    EGLContext m_loadCtx = EGL_NO_CONTEXT;
+    EGLSurface m_loadSurface = EGL_NO_SURFACE;
+
+    IGraphicsCommandQueue* m_commandQueue = nullptr;
+    IGraphicsDataFactory* m_dataFactory = nullptr;
+
+    EGLContext createContext(size_t versionIdx)
+    {
+        if (!m_versionedCtx)
+            return eglCreateContext(m_display, m_config, m_ctx, nullptr);
+        const EGLint attribs[] =
+        {
+            EGL_CONTEXT_MAJOR_VERSION_KHR, ContextVersionList[versionIdx][0],
+            EGL_CONTEXT_MINOR_VERSION_KHR, ContextVersionList[versionIdx][1],
+            EGL_NONE
+        };
+        return eglCreateContext(m_display, m_config, m_ctx, attribs);
+    }
+
+    EGLSurface createAuxSurface()
+    {
+        if (m_surfacelessCtx)
+            return EGL_NO_SURFACE;
+        const EGLint attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+        EGLSurface surface = eglCreatePbufferSurface(m_display, m_config, attribs);
+        if (surface == EGL_NO_SURFACE)
+            Log.report(logvisor::Fatal, "unable to make auxiliary EGL pbuffer");
+        return surface;
+    }
+
+    IGraphicsDataFactory* makeAuxCurrent(EGLContext& ctx, EGLSurface& surface, const char* name)
+    {
+        eglBindAPI(EGL_OPENGL_API);
+        if (ctx == EGL_NO_CONTEXT)
+        {
+            ctx = createContext(m_versionIdx);
+            if (ctx == EGL_NO_CONTEXT)
+                Log.report(logvisor::Fatal, "unable to make %s EGL context", name);
+            surface = createAuxSurface();
+        }
+        if (!eglMakeCurrent(m_display, surface, surface, ctx))
+            Log.report(logvisor::Fatal, "unable to make %s EGL context current", name);
+        return getDataFactory();
+    }
+
+    bool openDisplay()
+    {
+        const char* clientExts = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        if (HasExtension(clientExts, "EGL_MESA_platform_surfaceless") &&
+            HasExtension(clientExts, "EGL_EXT_platform_base"))
+        {
+            auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+                eglGetProcAddress("eglGetPlatformDisplayEXT"));
+            if (getPlatformDisplay)
+                m_display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        }
+        if (m_display == EGL_NO_DISPLAY)
+            m_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (m_display == EGL_NO_DISPLAY)
+        {
+            Log.report(logvisor::Error, "no EGL display available");
+            return false;
+        }
+
+        EGLint major, minor;
+        if (!eglInitialize(m_display, &major, &minor))
+        {
+            Log.report(logvisor::Error, "unable to initialize EGL display");
+            m_display = EGL_NO_DISPLAY;
+            return false;
+        }
+        Log.report(logvisor::Info, "EGL Version: %d.%d (%s)", major, minor,
+                   eglQueryString(m_display, EGL_VENDOR));
+        m_versionedCtx = major > 1 || minor >= 5 ||
+                         HasExtension(eglQueryString(m_display, EGL_EXTENSIONS), "EGL_KHR_create_context");
+        return true;
+    }
+
+    bool chooseConfig(bool pbuffer)
+    {
+        const EGLint attribs[] =
+        {
+            EGL_SURFACE_TYPE, pbuffer ? EGL_PBUFFER_BIT : 0,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8,
+            EGL_GREEN_SIZE, 8,
+            EGL_BLUE_SIZE, 8,
+            EGL_ALPHA_SIZE, 8,
+            EGL_DEPTH_SIZE, (m_pf == EPixelFormat::RGBA8_Z24 || m_pf == EPixelFormat::RGBAF32_Z24) ? 24 : 0,
+            EGL_NONE
+        };
+        EGLint numConfigs = 0;
+        return eglChooseConfig(m_display, attribs, &m_config, 1, &numConfigs) && numConfigs > 0;
+    }
+
+public:
+    GraphicsContextEGLHeadless(size_t width, size_t height, uint32_t drawSamples)
+    : m_width(width), m_height(height)
+    {
+        m_dataFactory = new class GLDataFactory(this, drawSamples);
+    }
+
+    ~GraphicsContextEGLHeadless()
+    {
+        /* Stops the render thread, which releases the primary context */
+        delete m_commandQueue;
+        if (m_display == EGL_NO_DISPLAY)
+        {
+            delete m_dataFactory;
+            return;
+        }
+        if (m_mainCtx != EGL_NO_CONTEXT)
+            eglMakeCurrent(m_display, m_mainSurface, m_mainSurface, m_mainCtx);
+        delete m_dataFactory;
+        eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+        for (EGLContext ctx : {m_loadCtx, m_mainCtx, m_ctx})
+            if (ctx != EGL_NO_CONTEXT)
+                eglDestroyContext(m_display, ctx);
+        for (EGLSurface surface : {m_loadSurface, m_mainSurface, m_surface})
+            if (surface != EGL_NO_SURFACE)
+                eglDestroySurface(m_display, surface);
+        eglTerminate(m_display);
+    }
+
+    EGraphicsAPI getAPI() const
+    {
+        return m_api;
+    }
+
+    EPixelFormat getPixelFormat() const
+    {
+        return m_pf;
+    }
+
+    void setPixelFormat(EPixelFormat pf)
+    {
+        if (pf > EPixelFormat::RGBAF32_Z24)
+            return;
+        m_pf = pf;
+    }
+
+    bool initializeContext(void*)
+    {
+        if (!openDisplay())
+            return false;
+
+        const char* exts = eglQueryString(m_display, EGL_EXTENSIONS);
+        m_surfacelessCtx = HasExtension(exts, "EGL_KHR_surfaceless_context");
+
+        bool pbuffer = chooseConfig(true);
+        if (!pbuffer && (!m_surfacelessCtx || !chooseConfig(false)))
+        {
+            Log.report(logvisor::Error, "no EGL config renders OpenGL offscreen");
+            return false;
+        }
+
+        if (!eglBindAPI(EGL_OPENGL_API))
+        {
+            Log.report(logvisor::Error, "EGL display does not support desktop OpenGL");
+            return false;
+        }
+        for (m_versionIdx=0 ; m_versionIdx<std::extent<decltype(ContextVersionList)>::value ; ++m_versionIdx)
+        {
+            m_ctx = createContext(m_versionIdx);
+            if (m_ctx != EGL_NO_CONTEXT || !m_versionedCtx)
+                break;
+        }
+        if (m_ctx == EGL_NO_CONTEXT)
+        {
+            Log.report(logvisor::Error, "unable to make new EGL context");
+            return false;
+        }
+
+        if (pbuffer)
+        {
+            const EGLint attribs[] =
+            {
+                EGL_WIDTH, EGLint(m_width),
+                EGL_HEIGHT, EGLint(m_height),
+                EGL_NONE
+            };
+            m_surface = eglCreatePbufferSurface(m_display, m_config, attribs);
+            if (m_surface == EGL_NO_SURFACE && !m_surfacelessCtx)
+            {
+                Log.report(logvisor::Error, "unable to make %dx%d EGL pbuffer", int(m_width), int(m_height));
+                return false;
+            }
+        }
+        if (m_surface == EGL_NO_SURFACE)
+            Log.report(logvisor::Warning, "rendering surfaceless; resolveDisplay() has no destination");
+
+        m_commandQueue = _NewGLCommandQueue(this);
+        return true;
+    }
+
+    /* Render thread only */
+    void makeCurrent()
+    {
+        eglBindAPI(EGL_OPENGL_API);
+        if (!eglMakeCurrent(m_display, m_surface, m_surface, m_ctx))
+            Log.report(logvisor::Fatal, "unable to make EGL context current");
+    }
+
+    /* No swap interval to set; frames are only ever paced by the GPU */
+    void postInit()
+    {
+    }
+
+    IGraphicsCommandQueue* getCommandQueue()
+    {
+        return m_commandQueue;
+    }
+
+    IGraphicsDataFactory* getDataFactory()
+    {
+        return m_dataFactory;
+    }
+
+    IGraphicsDataFactory* getMainContextDataFactory()
+    {
+        return makeAuxCurrent(m_mainCtx, m_mainSurface, "main");
+    }
+
+    IGraphicsDataFactory* getLoadContextDataFactory()
+    {
+        return makeAuxCurrent(m_loadCtx, m_loadSurface, "load");
+    }
+
+    void present()
+    {
+        if (m_surface != EGL_NO_SURFACE)
+            eglSwapBuffers(m_display, m_surface);
+    }
+};
+
+std::unique_ptr<IGraphicsContext> NewGLHeadlessContext(size_t width, size_t height, uint32_t drawSamples)
+{
+    std::unique_ptr<IGraphicsContext> ctx(new GraphicsContextEGLHeadless(width, height, drawSamples));
+    if (!ctx->initializeContext(nullptr))
+        return {};
+    return ctx;
+}
+
+}
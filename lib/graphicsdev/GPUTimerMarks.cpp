@@ -0,0 +1,127 @@
+#include "boo/graphicsdev/GPUTimerMarks.hpp"
+#include <algorithm>
+
+namespace boo
+{
+
+int GPUTimerMarks::push(Type type, const char* name, const ITextureR* target, size_t reserve)
+{
+    if (m_ended || m_marks.size() + reserve > m_maxMarks)
+        return -1;
+    m_marks.push_back({type, name, target, m_drawCount});
+    return int(m_marks.size() - 1);
+}
+
+int GPUTimerMarks::beginFrame(uint64_t frame, const ITextureR* target)
+{
+    m_marks.clear();
+    m_drawCount = 0;
+    m_openScopes = 0;
+    m_markedScopes = 0;
+    m_frame = frame;
+    m_ended = false;
+    return push(Type::Target, nullptr, target, 2);
+}
+
+/* Reserve covers this mark, the frame end and one end per marked scope */
+int GPUTimerMarks::target(const ITextureR* target)
+{
+    return push(Type::Target, nullptr, target, 2 + m_markedScopes);
+}
+
+int GPUTimerMarks::beginScope(const char* name)
+{
+    /* Once a scope is dropped, everything nested inside it is too */
+    if (m_openScopes++ != m_markedScopes)
+        return -1;
+    int idx = push(Type::ScopeBegin, name, nullptr, 3 + m_markedScopes);
+    if (idx >= 0)
+        ++m_markedScopes;
+    return idx;
+}
+
+int GPUTimerMarks::endScope()
+{
+    if (!m_openScopes)
+        return -1;
+    if (m_openScopes-- > m_markedScopes)
+        return -1;
+    --m_markedScopes;
+    return push(Type::ScopeEnd, nullptr, nullptr, 1);
+}
+
+int GPUTimerMarks::endFrame()
+{
+    int idx = push(Type::FrameEnd, nullptr, nullptr, 1);
+    m_ended = true;
+    return idx;
+}
+
+static double StampMs(uint64_t begin, uint64_t end)
+{
+    return end > begin ? (end - begin) / 1000000.0 : 0.0;
+}
+
+void GPUTimerMarks::resolve(const uint64_t* stamps, GPUFrameTimings& out) const
+{
+    out.frame = m_frame;
+    out.totalMs = 0.0;
+    out.drawCount = 0;
+    out.targets.clear();
+    out.scopes.clear();
+    if (m_marks.empty())
+        return;
+
+    size_t last = m_marks.size() - 1;
+    out.totalMs = StampMs(stamps[0], stamps[last]);
+    out.drawCount = m_marks[last].drawCount;
+
+    size_t segment = 0;
+    std::vector<std::pair<size_t, size_t>> open; /* Scope index, begin mark */
+    for (size_t i=0 ; i<m_marks.size() ; ++i)
+    {
+        const Mark& mark = m_marks[i];
+        switch (mark.type)
+        {
+        case Type::Target:
+        case Type::FrameEnd:
+        {
+            /* Close the pass begun at the previous target mark */
+            const Mark& begin = m_marks[segment];
+            if (i && begin.target)
+            {
+                double ms = StampMs(stamps[segment], stamps[i]);
+                size_t draws = mark.drawCount - begin.drawCount;
+                auto it = std::find_if(out.targets.begin(), out.targets.end(),
+                                       [&](const GPUTargetTiming& t) {return t.target == begin.target;});
+                if (it != out.targets.end())
+                {
+                    it->ms += ms;
+                    it->drawCount += draws;
+                }
+                else
+                    out.targets.push_back({begin.target, ms, draws});
+            }
+            segment = i;
+            break;
+        }
+        case Type::ScopeBegin:
+            out.scopes.push_back({mark.name, open.size(), 0.0});
+            open.push_back({out.scopes.size() - 1, i});
+            break;
+        case Type::ScopeEnd:
+            if (open.size())
+            {
+                out.scopes[open.back().first].ms = StampMs(stamps[open.back().second], stamps[i]);
+                open.pop_back();
+            }
+            break;
+        }
+    }
+
+    /* Scopes left open close with the frame */
+    for (const auto& scope : open)
+        out.scopes[scope.first].ms = StampMs(stamps[scope.second], stamps[last]);
+}
+
+}
@@ -0,0 +1,721 @@
+#include "boo/graphicsdev/Null.hpp"
+#include <string.h>
+
+#include "logvisor/logvisor.hpp"
+
+#undef min
+#undef max
+
+namespace boo
+{
+static logvisor::Module Log("boo::Null");
+
+NullResourceCounts& NullResourceCounts::operator+=(const NullResourceCounts& other)
+{
+    transactions += other.transactions;
+    staticBuffers += other.staticBuffers;
+    dynamicBuffers += other.dynamicBuffers;
+    staticTextures += other.staticTextures;
+    dynamicTextures += other.dynamicTextures;
+    renderTextures += other.renderTextures;
+    vertexFormats += other.vertexFormats;
+    pipelines += other.pipelines;
+    bindings += other.bindings;
+    staticBytes += other.staticBytes;
+    dynamicBytes += other.dynamicBytes;
+    return *this;
+}
+
+NullResourceCounts& NullResourceCounts::operator-=(const NullResourceCounts& other)
+{
+    transactions -= other.transactions;
+    staticBuffers -= other.staticBuffers;
+    dynamicBuffers -= other.dynamicBuffers;
+    staticTextures -= other.staticTextures;
+    dynamicTextures -= other.dynamicTextures;
+    renderTextures -= other.renderTextures;
+    vertexFormats -= other.vertexFormats;
+    pipelines -= other.pipelines;
+    bindings -= other.bindings;
+    staticBytes -= other.staticBytes;
+    dynamicBytes -= other.dynamicBytes;
+    return *this;
+}
+
+NullCommandCounts& NullCommandCounts::operator+=(const NullCommandCounts& other)
+{
+    frames += other.frames;
+    draws += other.draws;
+    vertices += other.vertices;
+    instances += other.instances;
+    bindingChanges += other.bindingChanges;
+    redundantBindings += other.redundantBindings;
+    targetChanges += other.targetChanges;
+    viewports += other.viewports;
+    scissors += other.scissors;
+    clears += other.clears;
+    resolveBinds += other.resolveBinds;
+    presents += other.presents;
+    readbacks += other.readbacks;
+    commandLists += other.commandLists;
+    timerScopes += other.timerScopes;
+    textureResizes += other.textureResizes;
+    dynamicUploads += other.dynamicUploads;
+    dynamicUploadBytes += other.dynamicUploadBytes;
+    return *this;
+}
+
+ThreadLocalPtr<NullData> NullDataFactory::m_deferredData;
+struct NullData : IGraphicsData
+{
+    std::vector<std::unique_ptr<struct NullShaderPipeline>> m_SPs;
+    std::vector<std::unique_ptr<struct NullShaderDataBinding>> m_SBinds;
+    std::vector<std::unique_ptr<class NullGraphicsBufferS>> m_SBufs;
+    std::vector<std::unique_ptr<class NullGraphicsBufferD>> m_DBufs;
+    std::vector<std::unique_ptr<class NullTextureS>> m_STexs;
+    std::vector<std::unique_ptr<class NullTextureSA>> m_SATexs;
+    std::vector<std::unique_ptr<class NullTextureD>> m_DTexs;
+    std::vector<std::unique_ptr<class NullTextureR>> m_RTexs;
+    std::vector<std::unique_ptr<struct NullVertexFormat>> m_VFmts;
+    NullResourceCounts m_counts;
+};
+
+/* Bytes per pixel scaled by 2, so the 4bpp block formats stay integral */
+static size_t TextureHalfBytesPerPixel(TextureFormat fmt)
+{
+    switch (fmt)
+    {
+    case TextureFormat::RGBA8:
+        return 8;
+    case TextureFormat::I8:
+        return 2;
+    case TextureFormat::DXT1:
+    case TextureFormat::PVRTC4:
+        return 1;
+    default: break;
+    }
+    return 8;
+}
+
+class NullGraphicsBufferS : public IGraphicsBufferS
+{
+    friend class NullDataFactory;
+    BufferUse m_use;
+    size_t m_sz;
+    NullGraphicsBufferS(BufferUse use, size_t sz)
+    : m_use(use), m_sz(sz) {}
+public:
+    ~NullGraphicsBufferS() = default;
+};
+
+class NullGraphicsBufferD : public IGraphicsBufferD
+{
+    friend class NullDataFactory;
+    friend class NullCommandQueue;
+    NullDataFactory& m_factory;
+    BufferUse m_use;
+    std::unique_ptr<uint8_t[]> m_cpuBuf;
+    size_t m_cpuSz;
+    bool m_dirty = false;
+    NullGraphicsBufferD(NullDataFactory& factory, BufferUse use, size_t sz)
+    : m_factory(factory), m_use(use), m_cpuBuf(new uint8_t[sz]), m_cpuSz(sz)
+    {
+        memset(m_cpuBuf.get(), 0, m_cpuSz);
+    }
+public:
+    ~NullGraphicsBufferD();
+
+    void load(const void* data, size_t sz);
+    void* map(size_t sz);
+    void unmap();
+};
+
+IGraphicsBufferS*
+NullDataFactory::Context::newStaticBuffer(BufferUse use, const void* data, size_t stride, size_t count)
+{
+    NullGraphicsBufferS* retval = new NullGraphicsBufferS(use, stride * count);
+    m_deferredData->m_SBufs.emplace_back(retval);
+    ++m_deferredData->m_counts.staticBuffers;
+    m_deferredData->m_counts.staticBytes += stride * count;
+    return retval;
+}
+
+IGraphicsBufferD*
+NullDataFactory::Context::newDynamicBuffer(BufferUse use, size_t stride, size_t count)
+{
+    NullGraphicsBufferD* retval = new NullGraphicsBufferD(m_parent, use, stride * count);
+    m_deferredData->m_DBufs.emplace_back(retval);
+    ++m_deferredData->m_counts.dynamicBuffers;
+    m_deferredData->m_counts.dynamicBytes += stride * count;
+    return retval;
+}
+
+class NullTextureS : public ITextureS
+{
+    friend class NullDataFactory;
+    size_t m_width;
+    size_t m_height;
+    size_t m_mips;
+    TextureFormat m_fmt;
+    NullTextureS(size_t width, size_t height, size_t mips, TextureFormat fmt)
+    : m_width(width), m_height(height), m_mips(mips), m_fmt(fmt) {}
+public:
+    ~NullTextureS() = default;
+};
+
+class NullTextureSA : public ITextureSA
+{
+    friend class NullDataFactory;
+    size_t m_width;
+    size_t m_height;
+    size_t m_layers;
+    TextureFormat m_fmt;
+    NullTextureSA(size_t width, size_t height, size_t layers, TextureFormat fmt)
+    : m_width(width), m_height(height), m_layers(layers), m_fmt(fmt) {}
+public:
+    ~NullTextureSA() = default;
+};
+
+class NullTextureD : public ITextureD
+{
+    friend class NullDataFactory;
+    friend class NullCommandQueue;
+    NullDataFactory& m_factory;
+    size_t m_width;
+    size_t m_height;
+    TextureFormat m_fmt;
+    std::unique_ptr<uint8_t[]> m_cpuBuf;
+    size_t m_cpuSz;
+    bool m_dirty = false;
+    NullTextureD(NullDataFactory& factory, size_t width, size_t height, TextureFormat fmt)
+    : m_factory(factory), m_width(width), m_height(height), m_fmt(fmt)
+    {
+        m_cpuSz = (width * height * TextureHalfBytesPerPixel(fmt) + 1) / 2;
+        m_cpuBuf.reset(new uint8_t[m_cpuSz]);
+        memset(m_cpuBuf.get(), 0, m_cpuSz);
+    }
+public:
+    ~NullTextureD();
+
+    void load(const void* data, size_t sz);
+    void* map(size_t sz);
+    void unmap();
+};
+
+class NullTextureR : public ITextureR
+{
+    friend class NullDataFactory;
+    friend class NullCommandQueue;
+    size_t m_width;
+    size_t m_height;
+    bool m_colorBindable;
+    bool m_depthBindable;
+    bool m_rendered = false; /* Bound as a target at least once; readbacks of others are skipped */
+    NullTextureR(size_t width, size_t height, bool enableShaderColorBinding, bool enableShaderDepthBinding)
+    : m_width(width), m_height(height),
+      m_colorBindable(enableShaderColorBinding), m_depthBindable(enableShaderDepthBinding) {}
+public:
+    ~NullTextureR() = default;
+};
+
+ITextureS*
+NullDataFactory::Context::newStaticTexture(size_t width, size_t height, size_t mips, TextureFormat fmt,
+                                           const void* data, size_t sz)
+{
+    NullTextureS* retval = new NullTextureS(width, height, mips, fmt);
+    m_deferredData->m_STexs.emplace_back(retval);
+    ++m_deferredData->m_counts.staticTextures;
+    m_deferredData->m_counts.staticBytes += sz;
+    return retval;
+}
+
+ITextureSA*
+NullDataFactory::Context::newStaticArrayTexture(size_t width, size_t height, size_t layers, TextureFormat fmt,
+                                                const void* data, size_t sz)
+{
+    NullTextureSA* retval = new NullTextureSA(width, height, layers, fmt);
+    m_deferredData->m_SATexs.emplace_back(retval);
+    ++m_deferredData->m_counts.staticTextures;
+    m_deferredData->m_counts.staticBytes += sz;
+    return retval;
+}
+
+ITextureD*
+NullDataFactory::Context::newDynamicTexture(size_t width, size_t height, TextureFormat fmt)
+{
+    NullTextureD* retval = new NullTextureD(m_parent, width, height, fmt);
+    m_deferredData->m_DTexs.emplace_back(retval);
+    ++m_deferredData->m_counts.dynamicTextures;
+    m_deferredData->m_counts.dynamicBytes += retval->m_cpuSz;
+    return retval;
+}
+
+ITextureR*
+NullDataFactory::Context::newRenderTexture(size_t width, size_t height,
+                                           bool enableShaderColorBinding, bool enableShaderDepthBinding)
+{
+    NullTextureR* retval = new NullTextureR(width, height, enableShaderColorBinding, enableShaderDepthBinding);
+    m_deferredData->m_RTexs.emplace_back(retval);
+    ++m_deferredData->m_counts.renderTextures;
+    return retval;
+}
+
+struct NullVertexFormat : IVertexFormat
+{
+    std::vector<VertexElementDescriptor> m_elements;
+    NullVertexFormat(size_t elementCount, const VertexElementDescriptor* elements)
+    : m_elements(elements, elements + elementCount) {}
+};
+
+IVertexFormat* NullDataFactory::Context::newVertexFormat(size_t elementCount,
+                                                         const VertexElementDescriptor* elements)
+{
+    NullVertexFormat* retval = new NullVertexFormat(elementCount, elements);
+    m_deferredData->m_VFmts.emplace_back(retval);
+    ++m_deferredData->m_counts.vertexFormats;
+    return retval;
+}
+
+struct NullShaderPipeline : IShaderPipeline
+{
+    size_t m_texCount;
+    size_t m_uniformBlockCount;
+    BlendFactor m_srcFac;
+    BlendFactor m_dstFac;
+    Primitive m_prim;
+    bool m_depthTest;
+    bool m_depthWrite;
+    bool m_backfaceCulling;
+};
+
+IShaderPipeline* NullDataFactory::Context::newShaderPipeline(const char* vertSource, const char* fragSource,
+                                                             size_t texCount, const char** texNames,
+                                                             size_t uniformBlockCount, const char** uniformBlockNames,
+                                                             BlendFactor srcFac, BlendFactor dstFac, Primitive prim,
+                                                             bool depthTest, bool depthWrite, bool backfaceCulling)
+{
+    NullShaderPipeline* retval = new NullShaderPipeline;
+    retval->m_texCount = texCount;
+    retval->m_uniformBlockCount = uniformBlockCount;
+    retval->m_srcFac = srcFac;
+    retval->m_dstFac = dstFac;
+    retval->m_prim = prim;
+    retval->m_depthTest = depthTest;
+    retval->m_depthWrite = depthWrite;
+    retval->m_backfaceCulling = backfaceCulling;
+    m_deferredData->m_SPs.emplace_back(retval);
+    ++m_deferredData->m_counts.pipelines;
+    return retval;
+}
+
+struct NullShaderDataBinding : IShaderDataBinding
+{
+    IShaderPipeline* m_pipeline;
+    IVertexFormat* m_vtxFormat;
+    IGraphicsBuffer* m_vbo;
+    IGraphicsBuffer* m_instVbo;
+    IGraphicsBuffer* m_ibo;
+    std::vector<IGraphicsBuffer*> m_ubufs;
+    std::vector<ITexture*> m_texs;
+};
+
+IShaderDataBinding*
+NullDataFactory::Context::newShaderDataBinding(IShaderPipeline* pipeline,
+                                               IVertexFormat* vtxFormat,
+                                               IGraphicsBuffer* vbo, IGraphicsBuffer* instVbo, IGraphicsBuffer* ibo,
+                                               size_t ubufCount, IGraphicsBuffer** ubufs, const PipelineStage* ubufStages,
+                                               const size_t* ubufOffs, const size_t* ubufSizes,
+                                               size_t texCount, ITexture** texs)
+{
+    NullShaderDataBinding* retval = new NullShaderDataBinding;
+    retval->m_pipeline = pipeline;
+    retval->m_vtxFormat = vtxFormat;
+    retval->m_vbo = vbo;
+    retval->m_instVbo = instVbo;
+    retval->m_ibo = ibo;
+    retval->m_ubufs.assign(ubufs, ubufs + ubufCount);
+    retval->m_texs.assign(texs, texs + texCount);
+    m_deferredData->m_SBinds.emplace_back(retval);
+    ++m_deferredData->m_counts.bindings;
+    return retval;
+}
+
+NullGraphicsBufferD::~NullGraphicsBufferD()
+{
+    std::unique_lock<std::mutex> lk(m_factory.m_dirtyMt);
+    if (m_dirty)
+        m_factory.m_dirtyBufs.erase(this);
+}
+
+void NullGraphicsBufferD::load(const void* data, size_t sz)
+{
+    size_t bufSz = std::min(sz, m_cpuSz);
+    memcpy(m_cpuBuf.get(), data, bufSz);
+    unmap();
+}
+void* NullGraphicsBufferD::map(size_t sz)
+{
+    if (sz > m_cpuSz)
+        return nullptr;
+    return m_cpuBuf.get();
+}
+void NullGraphicsBufferD::unmap()
+{
+    std::unique_lock<std::mutex> lk(m_factory.m_dirtyMt);
+    if (!m_dirty)
+    {
+        m_dirty = true;
+        m_factory.m_dirtyBufs.insert(this);
+    }
+}
+
+NullTextureD::~NullTextureD()
+{
+    std::unique_lock<std::mutex> lk(m_factory.m_dirtyMt);
+    if (m_dirty)
+        m_factory.m_dirtyTexs.erase(this);
+}
+
+void NullTextureD::load(const void* data, size_t sz)
+{
+    size_t bufSz = std::min(sz, m_cpuSz);
+    memcpy(m_cpuBuf.get(), data, bufSz);
+    unmap();
+}
+void* NullTextureD::map(size_t sz)
+{
+    if (sz > m_cpuSz)
+        return nullptr;
+    return m_cpuBuf.get();
+}
+void NullTextureD::unmap()
+{
+    std::unique_lock<std::mutex> lk(m_factory.m_dirtyMt);
+    if (!m_dirty)
+    {
+        m_dirty = true;
+        m_factory.m_dirtyTexs.insert(this);
+    }
+}
+
+GraphicsDataToken NullDataFactory::commitTransaction(const FactoryCommitFunc& trans)
+{
+    if (m_deferredData.get())
+        Log.report(logvisor::Fatal, "nested commitTransaction usage detected");
+    m_deferredData.reset(new NullData());
+
+    NullDataFactory::Context ctx(*this);
+    if (!trans(ctx))
+    {
+        delete m_deferredData.get();
+        m_deferredData.reset();
+        return GraphicsDataToken(this, nullptr);
+    }
+
+    std::unique_lock<std::mutex> lk(m_committedMutex);
+    NullData* retval = m_deferredData.get();
+    m_deferredData.reset();
+    retval->m_counts.transactions = 1;
+    m_counts += retval->m_counts;
+    m_committedData.insert(retval);
+    return GraphicsDataToken(this, retval);
+}
+
+void NullDataFactory::destroyData(IGraphicsData* d)
+{
+    m_deadData.push(d);
+}
+
+void NullDataFactory::deleteData(NullData* data)
+{
+    std::unique_lock<std::mutex> lk(m_committedMutex);
+    m_counts -= data->m_counts;
+    m_committedData.erase(data);
+    lk.unlock();
+    delete data;
+}
+
+void NullDataFactory::destroyAllData()
+{
+    std::unique_lock<std::mutex> lk(m_committedMutex);
+    m_deadData.clear();
+    for (NullData* data : m_committedData)
+        delete data;
+    m_committedData.clear();
+    m_counts = NullResourceCounts();
+}
+
+NullResourceCounts NullDataFactory::resourceCounts() const
+{
+    std::unique_lock<std::mutex> lk(m_committedMutex);
+    return m_counts;
+}
+
+class NullCommandList : public IGraphicsCommandList
+{
+    friend class NullCommandQueue;
+    NullCommandCounts m_counts;
+    IShaderDataBinding* m_curBinding = nullptr;
+    ITextureR* m_target = nullptr;
+    bool m_recording = false;
+
+public:
+    void begin(ITextureR* target)
+    {
+        if (m_recording)
+            Log.report(logvisor::Fatal, "begin() on a command list that is still recording");
+        m_counts = NullCommandCounts();
+        m_curBinding = nullptr;
+        m_target = target;
+        m_recording = true;
+    }
+    void end() {m_recording = false;}
+
+    void setShaderDataBinding(IShaderDataBinding* binding)
+    {
+        if (binding == m_curBinding)
+            ++m_counts.redundantBindings;
+        else
+            ++m_counts.bindingChanges;
+        m_curBinding = binding;
+    }
+    void setViewport(const SWindowRect& rect, float znear, float zfar) {++m_counts.viewports;}
+    void setScissor(const SWindowRect& rect) {++m_counts.scissors;}
+
+    void draw(size_t start, size_t count) {drawInstances(start, count, 1);}
+    void drawIndexed(size_t start, size_t count) {drawInstances(start, count, 1);}
+    void drawInstances(size_t start, size_t count, size_t instCount)
+    {
+        ++m_counts.draws;
+        m_counts.vertices += count * instCount;
+        m_counts.instances += instCount;
+    }
+    void drawInstancesIndexed(size_t start, size_t count, size_t instCount)
+    {drawInstances(start, count, instCount);}
+};
+
+NullCommandQueue::NullCommandQueue(NullDataFactory* factory)
+: m_factory(factory), m_recordStart(FrameStatsNow()) {}
+
+void NullCommandQueue::setShaderDataBinding(IShaderDataBinding* binding)
+{
+    if (binding == m_curBinding)
+        ++m_counts.redundantBindings;
+    else
+        ++m_counts.bindingChanges;
+    m_curBinding = binding;
+}
+
+void NullCommandQueue::setRenderTarget(ITextureR* target)
+{
+    ++m_counts.targetChanges;
+    m_curTarget = target;
+    if (target)
+        static_cast<NullTextureR*>(target)->m_rendered = true;
+}
+
+void NullCommandQueue::setViewport(const SWindowRect& rect, float znear, float zfar)
+{
+    ++m_counts.viewports;
+}
+
+void NullCommandQueue::setScissor(const SWindowRect& rect)
+{
+    ++m_counts.scissors;
+}
+
+void NullCommandQueue::resizeRenderTexture(ITextureR* tex, size_t width, size_t height)
+{
+    m_pendingResizes.push_back({tex, width, height});
+}
+
+void NullCommandQueue::schedulePostFrameHandler(std::function<void(void)>&& func)
+{
+    m_pendingPosts.push_back(std::move(func));
+}
+
+void NullCommandQueue::clearTarget(bool render, bool depth)
+{
+    ++m_counts.clears;
+}
+
+void NullCommandQueue::draw(size_t start, size_t count)
+{
+    drawInstances(start, count, 1);
+}
+
+void NullCommandQueue::drawIndexed(size_t start, size_t count)
+{
+    drawInstances(start, count, 1);
+}
+
+void NullCommandQueue::drawInstances(size_t start, size_t count, size_t instCount)
+{
+    ++m_counts.draws;
+    m_counts.vertices += count * instCount;
+    m_counts.instances += instCount;
+}
+
+void NullCommandQueue::drawInstancesIndexed(size_t start, size_t count, size_t instCount)
+{
+    drawInstances(start, count, instCount);
+}
+
+/* Argument records live in buffers the queue never reads back,
+ * so indirect draws add to the draw count only */
+void NullCommandQueue::drawIndirect(IGraphicsBuffer* buf, size_t offset, size_t drawCount)
+{
+    m_counts.draws += drawCount;
+}
+
+void NullCommandQueue::drawIndexedIndirect(IGraphicsBuffer* buf, size_t offset, size_t drawCount)
+{
+    m_counts.draws += drawCount;
+}
+
+void NullCommandQueue::resolveBindTexture(ITextureR* texture, const SWindowRect& rect,
+                                          bool tlOrigin, bool color, bool depth)
+{
+    ++m_counts.resolveBinds;
+}
+
+void NullCommandQueue::resolveDisplay(ITextureR* source)
+{
+    ++m_counts.presents;
+    m_presented = true;
+}
+
+void NullCommandQueue::readback(ITextureR* texture, const SWindowRect& rect, ReadbackFunc&& callback)
+{
+    NullTextureR* tex = static_cast<NullTextureR*>(texture);
+    SWindowRect clipped = rect.intersect(SWindowRect(0, 0, tex->m_width, tex->m_height));
+    if (!tex->m_rendered || clipped.size[0] <= 0 || clipped.size[1] <= 0)
+    {
+        /* Delivered empty, like the GPU backends */
+        m_recordedReadbacks.push_back({0, 0, std::move(callback)});
+        return;
+    }
+    ++m_counts.readbacks;
+    m_recordedReadbacks.push_back({size_t(clipped.size[0]), size_t(clipped.size[1]), std::move(callback)});
+}
+
+void NullCommandQueue::deliverReadbacks()
+{
+    for (Readback& rb : m_readbacks)
+    {
+        if (!rb.width)
+        {
+            ReadbackData data = {nullptr, 0, 0, 0, false};
+            rb.func(data);
+            continue;
+        }
+        size_t pitch = rb.width * 4;
+        if (m_readbackPixels.size() < pitch * rb.height)
+            m_readbackPixels.resize(pitch * rb.height);
+        ReadbackData data;
+        data.pixels = m_readbackPixels.data();
+        data.rowPitch = ptrdiff_t(pitch);
+        data.width = rb.width;
+        data.height = rb.height;
+        data.bgra = false;
+        rb.func(data);
+    }
+    m_readbacks.clear();
+    m_readbacks.swap(m_recordedReadbacks);
+}
+
+std::unique_ptr<IGraphicsCommandList> NullCommandQueue::newCommandList()
+{
+    return std::unique_ptr<IGraphicsCommandList>(new NullCommandList);
+}
+
+void NullCommandQueue::executeCommandLists(IGraphicsCommandList* const* lists, size_t count)
+{
+    for (size_t i=0 ; i<count ; ++i)
+    {
+        NullCommandList* list = static_cast<NullCommandList*>(lists[i]);
+        if (list->m_recording)
+            Log.report(logvisor::Fatal, "executeCommandLists() given a list that was not ended");
+        m_counts += list->m_counts;
+        ++m_counts.commandLists;
+    }
+    m_curBinding = nullptr;
+}
+
+void NullCommandQueue::execute()
+{
+    FrameStats stats;
+    stats.frame = m_frame;
+    stats.recordStart = m_recordStart;
+    stats.execute = FrameStatsNow();
+    stats.renderBegin = stats.execute;
+
+    /* Stage dynamic resources written this frame; the shadow copies are
+     * the only storage, so staging just accounts for the transfer */
+    if (m_factory)
+    {
+        std::unique_lock<std::mutex> lk(m_factory->m_dirtyMt);
+        for (NullGraphicsBufferD* buf : m_factory->m_dirtyBufs)
+        {
+            buf->m_dirty = false;
+            ++m_counts.dynamicUploads;
+            m_counts.dynamicUploadBytes += buf->m_cpuSz;
+        }
+        m_factory->m_dirtyBufs.clear();
+        for (NullTextureD* tex : m_factory->m_dirtyTexs)
+        {
+            tex->m_dirty = false;
+            ++m_counts.dynamicUploads;
+            m_counts.dynamicUploadBytes += tex->m_cpuSz;
+        }
+        m_factory->m_dirtyTexs.clear();
+    }
+
+    for (const RenderTextureResize& resize : m_pendingResizes)
+    {
+        NullTextureR* tex = static_cast<NullTextureR*>(resize.tex);
+        tex->m_width = resize.width;
+        tex->m_height = resize.height;
+        ++m_counts.textureResizes;
+    }
+    m_pendingResizes.clear();
+
+    /* Nothing is in flight once execute() returns, so data destroyed
+     * before this point is free to go */
+    if (m_factory)
+    {
+        m_factory->m_deadData.collect(m_frame);
+        m_factory->m_deadData.retire(m_frame, [this](IGraphicsData* data)
+        {
+            m_factory->deleteData(static_cast<NullData*>(data));
+            return true;
+        });
+    }
+
+    deliverReadbacks();
+
+    for (auto& func : m_pendingPosts)
+        func();
+    m_pendingPosts.clear();
+
+    ++m_counts.frames;
+    m_lastFrame = m_counts;
+    m_totals += m_counts;
+    m_frameCounters.dynamicUploads = m_counts.dynamicUploads;
+    m_frameCounters.stateChangesIssued = m_counts.bindingChanges;
+    m_frameCounters.stateChangesElided = m_counts.redundantBindings;
+    m_counts = NullCommandCounts();
+
+    stats.renderEnd = FrameStatsNow();
+    if (m_presented)
+        stats.present = stats.renderEnd;
+    m_frameStats.push(stats);
+
+    m_presented = false;
+    m_curBinding = nullptr;
+    m_curTarget = nullptr;
+    ++m_frame;
+    m_recordStart = FrameStatsNow();
+}
+
+}
@@ -0,0 +1,71 @@
+#include "boo/graphicsdev/PipelineCompileQueue.hpp"
+
+namespace boo
+{
+
+PipelineCompileQueue::PipelineCompileQueue(size_t threadCount)
+: m_threadCount(threadCount)
+{
+    if (!m_threadCount)
+    {
+        unsigned hw = std::thread::hardware_concurrency();
+        m_threadCount = hw > 1 ? hw - 1 : 1;
+    }
+}
+
+PipelineCompileQueue::~PipelineCompileQueue()
+{
+    std::unique_lock<std::mutex> lk(m_mt);
+    m_running = false;
+    lk.unlock();
+    m_cv.notify_all();
+    for (std::thread& th : m_threads)
+        th.join();
+}
+
+void PipelineCompileQueue::worker()
+{
+    std::unique_lock<std::mutex> lk(m_mt);
+    for (;;)
+    {
+        m_cv.wait(lk, [this]() {return !m_running || !m_tasks.empty();});
+        /* Drain outstanding work before exiting; pipelines waiting on it
+         * would otherwise never become ready */
+        if (m_tasks.empty())
+            return;
+        std::packaged_task<void()> task = std::move(m_tasks.front());
+        m_tasks.pop();
+        ++m_busy;
+        lk.unlock();
+        task();
+        lk.lock();
+        --m_busy;
+        if (m_tasks.empty() && !m_busy)
+            m_idleCv.notify_all();
+    }
+}
+
+std::shared_future<void> PipelineCompileQueue::post(std::function<void()>&& task)
+{
+    std::packaged_task<void()> ptask(std::move(task));
+    std::shared_future<void> ret = ptask.get_future().share();
+    std::unique_lock<std::mutex> lk(m_mt);
+    if (m_threads.empty())
+    {
+        m_threads.reserve(m_threadCount);
+        for (size_t i=0 ; i<m_threadCount ; ++i)
+            m_threads.emplace_back(std::bind(&PipelineCompileQueue::worker, this));
+    }
+    m_tasks.push(std::move(ptask));
+    lk.unlock();
+    m_cv.notify_one();
+    return ret;
+}
+
+void PipelineCompileQueue::waitIdle()
+{
+    std::unique_lock<std::mutex> lk(m_mt);
+    m_idleCv.wait(lk, [this]() {return m_tasks.empty() && !m_busy;});
+}
+
+}
@@ -0,0 +1,360 @@
+#include "boo/graphicsdev/SPIRVCache.hpp"
+#include <algorithm>
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#if _WIN32
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <utime.h>
+#include <unistd.h>
+#endif
+
+namespace boo
+{
+
+static const uint32_t SPIRVCacheMagic = 0x56505342; /* 'BSPV' */
+static const uint32_t SPIRVCacheVersion = 2;
+
+struct SPIRVCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t hash;
+    uint64_t check;
+    uint32_t vertLen;
+    uint32_t fragLen;
+    uint32_t vertWords;
+    uint32_t fragWords;
+};
+
+static FILE* OpenCacheFile(const SystemString& path, const SystemChar* mode)
+{
+#if _WIN32
+    return _wfopen(path.c_str(), mode);
+#else
+    return fopen(path.c_str(), mode);
+#endif
+}
+
+static bool RenameCacheFile(const SystemString& from, const SystemString& to)
+{
+#if _WIN32
+    return MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+static void RemoveCacheFile(const SystemString& path)
+{
+#if _WIN32
+    _wremove(path.c_str());
+#else
+    remove(path.c_str());
+#endif
+}
+
+/* 0 when missing */
+static uint64_t CacheFileSize(const SystemString& path)
+{
+#if _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA attrs;
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &attrs))
+        return 0;
+    return (uint64_t(attrs.nFileSizeHigh) << 32) | attrs.nFileSizeLow;
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st))
+        return 0;
+    return st.st_size;
+#endif
+}
+
+/* Bumps the entry's modification time, which orders LRU eviction */
+static void TouchCacheFile(const SystemString& path)
+{
+#if _WIN32
+    HANDLE fh = CreateFileW(path.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fh == INVALID_HANDLE_VALUE)
+        return;
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    SetFileTime(fh, nullptr, nullptr, &ft);
+    CloseHandle(fh);
+#else
+    utime(path.c_str(), nullptr);
+#endif
+}
+
+struct SPIRVCacheEntry
+{
+    SystemString path;
+    uint64_t size;
+    int64_t mtime;
+};
+
+static void ListCacheEntries(const SystemString& dir, std::vector<SPIRVCacheEntry>& entries)
+{
+#if _WIN32
+    WIN32_FIND_DATAW d;
+    HANDLE fh = FindFirstFileW((dir + L"/*.spv").c_str(), &d);
+    if (fh == INVALID_HANDLE_VALUE)
+        return;
+    do
+    {
+        SPIRVCacheEntry ent;
+        ent.path = dir + L"/" + d.cFileName;
+        ent.size = (uint64_t(d.nFileSizeHigh) << 32) | d.nFileSizeLow;
+        ent.mtime = (int64_t(d.ftLastWriteTime.dwHighDateTime) << 32) | d.ftLastWriteTime.dwLowDateTime;
+        entries.push_back(std::move(ent));
+    } while (FindNextFileW(fh, &d));
+    FindClose(fh);
+#else
+    DIR* dp = opendir(dir.c_str());
+    if (!dp)
+        return;
+    while (dirent* d = readdir(dp))
+    {
+        size_t len = strlen(d->d_name);
+        if (len < 4 || strcmp(d->d_name + len - 4, ".spv"))
+            continue;
+        SPIRVCacheEntry ent;
+        ent.path = dir + "/" + d->d_name;
+        struct stat st;
+        if (stat(ent.path.c_str(), &st))
+            continue;
+        ent.size = st.st_size;
+        ent.mtime = st.st_mtime;
+        entries.push_back(std::move(ent));
+    }
+    closedir(dp);
+#endif
+}
+
+void SPIRVCache::setDirectory(const SystemString& dir, uint64_t maxBytes)
+{
+    std::unique_lock<std::mutex> lk(m_mt);
+    m_dir = dir;
+    m_maxBytes = maxBytes;
+    m_stats.bytes = 0;
+    if (dir.empty())
+        return;
+    lk.unlock();
+
+#if _WIN32
+    CreateDirectoryW(dir.c_str(), nullptr);
+#else
+    mkdir(dir.c_str(), 0755);
+#endif
+    std::vector<SPIRVCacheEntry> entries;
+    ListCacheEntries(dir, entries);
+    uint64_t total = 0;
+    for (const SPIRVCacheEntry& ent : entries)
+        total += ent.size;
+
+    lk.lock();
+    if (m_dir != dir)
+        return;
+    m_stats.bytes = total;
+    maybeEvict(lk);
+}
+
+bool SPIRVCache::enabled() const
+{
+    std::unique_lock<std::mutex> lk(m_mt);
+    return m_dir.size() != 0;
+}
+
+/* FNV-1a names the entry; the check is a multiply-rotate hash over the same
+ * bytes, so one colliding input is very unlikely to collide in both */
+SPIRVCache::Key SPIRVCache::MakeKey(const char* vertSource, const char* fragSource, const char* options)
+{
+    Key key;
+    key.hash = 0xcbf29ce484222325ull;
+    key.check = 0x9e3779b97f4a7c15ull;
+    auto hashStr = [&key](const char* str)
+    {
+        for (const char* c = str ; ; ++c)
+        {
+            key.hash ^= uint8_t(*c);
+            key.hash *= 0x100000001b3ull;
+            key.check = (key.check ^ uint8_t(*c)) * 0xff51afd7ed558ccdull;
+            key.check = (key.check << 31) | (key.check >> 33);
+            if (!*c)
+                break;
+        }
+    };
+    hashStr(vertSource);
+    hashStr(fragSource);
+    hashStr(options);
+    key.vertLen = uint32_t(strlen(vertSource));
+    key.fragLen = uint32_t(strlen(fragSource));
+    return key;
+}
+
+SystemString SPIRVCache::entryPath(uint64_t hash) const
+{
+    SystemChar name[32];
+#if _WIN32
+    _snwprintf(name, 32, L"/%016llX.spv", (unsigned long long)hash);
+#else
+    snprintf(name, 32, "/%016llX.spv", (unsigned long long)hash);
+#endif
+    return m_dir + name;
+}
+
+bool SPIRVCache::load(const Key& key, std::vector<unsigned int>& vertOut, std::vector<unsigned int>& fragOut)
+{
+    std::unique_lock<std::mutex> lk(m_mt);
+    if (m_dir.empty())
+        return false;
+    SystemString path = entryPath(key.hash);
+    lk.unlock();
+
+    bool ok = false;
+    uint64_t removed = 0;
+    if (FILE* fp = OpenCacheFile(path, _S("rb")))
+    {
+        SPIRVCacheHeader header;
+        bool valid = fread(&header, 1, sizeof(header), fp) == sizeof(header) &&
+                     header.magic == SPIRVCacheMagic && header.version == SPIRVCacheVersion &&
+                     header.hash == key.hash && header.vertWords && header.fragWords;
+
+        /* Another program whose hash collides with this one; a miss, but the entry stays */
+        bool collision = valid && (header.check != key.check ||
+                                   header.vertLen != key.vertLen || header.fragLen != key.fragLen);
+        if (valid && !collision)
+        {
+            vertOut.resize(header.vertWords);
+            fragOut.resize(header.fragWords);
+            ok = fread(vertOut.data(), 4, header.vertWords, fp) == header.vertWords &&
+                 fread(fragOut.data(), 4, header.fragWords, fp) == header.fragWords;
+        }
+        fclose(fp);
+        if (ok)
+            TouchCacheFile(path);
+        else
+        {
+            vertOut.clear();
+            fragOut.clear();
+            if (!collision)
+            {
+                removed = CacheFileSize(path);
+                RemoveCacheFile(path);
+            }
+        }
+    }
+
+    lk.lock();
+    if (ok)
+        ++m_stats.hits;
+    else
+        ++m_stats.misses;
+    m_stats.bytes -= std::min(m_stats.bytes, removed);
+    return ok;
+}
+
+void SPIRVCache::store(const Key& key, const std::vector<unsigned int>& vert, const std::vector<unsigned int>& frag)
+{
+    std::unique_lock<std::mutex> lk(m_mt);
+    if (m_dir.empty() || vert.empty() || frag.empty())
+        return;
+    SystemString path = entryPath(key.hash);
+    lk.unlock();
+
+    /* Unique temporary per writer; rename publishes the entry in one step */
+    static std::atomic_uint TmpSerial(0);
+    unsigned serial = TmpSerial++;
+    SystemChar suffix[48];
+#if _WIN32
+    _snwprintf(suffix, 48, L".%lu.%u.tmp", GetCurrentProcessId(), serial);
+#else
+    snprintf(suffix, 48, ".%ld.%u.tmp", long(getpid()), serial);
+#endif
+    SystemString tmpPath = path + suffix;
+    FILE* fp = OpenCacheFile(tmpPath, _S("wb"));
+    if (!fp)
+        return;
+    SPIRVCacheHeader header = {SPIRVCacheMagic, SPIRVCacheVersion, key.hash, key.check,
+                               key.vertLen, key.fragLen, uint32_t(vert.size()), uint32_t(frag.size())};
+    bool ok = fwrite(&header, 1, sizeof(header), fp) == sizeof(header) &&
+              fwrite(vert.data(), 4, vert.size(), fp) == vert.size() &&
+              fwrite(frag.data(), 4, frag.size(), fp) == frag.size();
+    ok &= fclose(fp) == 0;
+
+    /* A replaced entry (a collision, or another process's copy) no longer counts */
+    uint64_t replaced = CacheFileSize(path);
+    if (!ok || !RenameCacheFile(tmpPath, path))
+    {
+        RemoveCacheFile(tmpPath);
+        return;
+    }
+
+    lk.lock();
+    ++m_stats.stores;
+    m_stats.bytes -= std::min(m_stats.bytes, replaced);
+    m_stats.bytes += sizeof(header) + (vert.size() + frag.size()) * 4;
+    maybeEvict(lk);
+}
+
+/* Hands eviction to at most one caller at a time; returns with lk released */
+void SPIRVCache::maybeEvict(std::unique_lock<std::mutex>& lk)
+{
+    if (!m_maxBytes || m_stats.bytes <= m_maxBytes || m_evicting)
+    {
+        lk.unlock();
+        return;
+    }
+    m_evicting = true;
+    SystemString dir = m_dir;
+    uint64_t maxBytes = m_maxBytes;
+    lk.unlock();
+    evict(dir, maxBytes);
+}
+
+/* Rescans so entries written by other processes count too. Runs without m_mt,
+ * so loads and stores carry on while the directory is walked */
+void SPIRVCache::evict(const SystemString& dir, uint64_t maxBytes)
+{
+    std::vector<SPIRVCacheEntry> entries;
+    ListCacheEntries(dir, entries);
+    uint64_t total = 0;
+    for (const SPIRVCacheEntry& ent : entries)
+        total += ent.size;
+
+    /* Trim to 3/4 of the limit so eviction doesn't run on every store */
+    uint64_t target = maxBytes - maxBytes / 4;
+    size_t evicted = 0;
+    if (total > maxBytes)
+    {
+        std::sort(entries.begin(), entries.end(),
+                  [](const SPIRVCacheEntry& a, const SPIRVCacheEntry& b) {return a.mtime < b.mtime;});
+        for (const SPIRVCacheEntry& ent : entries)
+        {
+            if (total <= target)
+                break;
+            RemoveCacheFile(ent.path);
+            total -= ent.size;
+            ++evicted;
+        }
+    }
+
+    std::unique_lock<std::mutex> lk(m_mt);
+    m_evicting = false;
+    if (m_dir != dir)
+        return;
+    m_stats.evictions += evicted;
+    m_stats.bytes = total;
+}
+
+SPIRVCache::Stats SPIRVCache::getStats() const
+{
+    std::unique_lock<std::mutex> lk(m_mt);
+    return m_stats;
+}
+
+}
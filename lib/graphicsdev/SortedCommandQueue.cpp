@@ -0,0 +1,335 @@
+#include "boo/graphicsdev/SortedCommandQueue.hpp"
+#include <algorithm>
+#include <string.h>
+
+namespace boo
+{
+
+uint64_t SortedCommandQueue::MakeSortKey(uint8_t pass, uint16_t pipeline, uint16_t binding, float depth)
+{
+    depth = std::min(std::max(depth, 0.f), 1.f);
+    uint64_t qdepth = uint64_t(depth * float(0xffffff));
+    return (uint64_t(pass) << 56) | (uint64_t(pipeline) << 40) | (uint64_t(binding) << 24) | qdepth;
+}
+
+SortedCommandQueue::SortedCommandQueue(IGraphicsCommandQueue* backend)
+: m_backend(backend) {}
+
+void SortedCommandQueue::setSorting(bool enabled)
+{
+    if (!enabled)
+    {
+        flush();
+        if (m_curBinding && m_curBinding != m_emitBinding)
+        {
+            m_backend->setShaderDataBinding(m_curBinding);
+            m_emitBinding = m_curBinding;
+        }
+    }
+    m_sorting = enabled;
+}
+
+/* State is tracked in both modes so sorting may be toggled mid-frame */
+void SortedCommandQueue::setShaderDataBinding(IShaderDataBinding* binding)
+{
+    m_curBinding = binding;
+    if (!m_sorting)
+    {
+        m_backend->setShaderDataBinding(binding);
+        m_emitBinding = binding;
+    }
+}
+
+void SortedCommandQueue::setViewport(const SWindowRect& rect, float znear, float zfar)
+{
+    m_viewports.push_back({rect, znear, zfar});
+    if (!m_sorting)
+    {
+        m_backend->setViewport(rect, znear, zfar);
+        m_emitViewport = uint32_t(m_viewports.size() - 1);
+    }
+}
+
+void SortedCommandQueue::setScissor(const SWindowRect& rect)
+{
+    m_scissors.push_back(rect);
+    if (!m_sorting)
+    {
+        m_backend->setScissor(rect);
+        m_emitScissor = uint32_t(m_scissors.size() - 1);
+    }
+}
+
+void SortedCommandQueue::recordDraw(Draw::Op op, size_t start, size_t count, size_t instCount,
+                                    IGraphicsBuffer* indirectBuf)
+{
+    Draw draw;
+    draw.m_op = op;
+    draw.m_binding = m_curBinding;
+    draw.m_indirectBuf = indirectBuf;
+    draw.m_viewport = m_viewports.size() ? uint32_t(m_viewports.size() - 1) : ~uint32_t(0);
+    draw.m_scissor = m_scissors.size() ? uint32_t(m_scissors.size() - 1) : ~uint32_t(0);
+    draw.m_start = start;
+    draw.m_count = count;
+    draw.m_instCount = instCount;
+    m_draws.push_back(draw);
+    m_keys.push_back(m_sortKey);
+}
+
+void SortedCommandQueue::draw(size_t start, size_t count)
+{
+    if (!m_sorting)
+        m_backend->draw(start, count);
+    else
+        recordDraw(Draw::Op::Draw, start, count, 0);
+}
+
+void SortedCommandQueue::drawIndexed(size_t start, size_t count)
+{
+    if (!m_sorting)
+        m_backend->drawIndexed(start, count);
+    else
+        recordDraw(Draw::Op::DrawIndexed, start, count, 0);
+}
+
+void SortedCommandQueue::drawInstances(size_t start, size_t count, size_t instCount)
+{
+    if (!m_sorting)
+        m_backend->drawInstances(start, count, instCount);
+    else
+        recordDraw(Draw::Op::DrawInstances, start, count, instCount);
+}
+
+void SortedCommandQueue::drawInstancesIndexed(size_t start, size_t count, size_t instCount)
+{
+    if (!m_sorting)
+        m_backend->drawInstancesIndexed(start, count, instCount);
+    else
+        recordDraw(Draw::Op::DrawInstancesIndexed, start, count, instCount);
+}
+
+void SortedCommandQueue::drawIndirect(IGraphicsBuffer* buf, size_t offset, size_t drawCount)
+{
+    if (!m_sorting)
+        m_backend->drawIndirect(buf, offset, drawCount);
+    else
+        recordDraw(Draw::Op::DrawIndirect, offset, drawCount, 0, buf);
+}
+
+void SortedCommandQueue::drawIndexedIndirect(IGraphicsBuffer* buf, size_t offset, size_t drawCount)
+{
+    if (!m_sorting)
+        m_backend->drawIndexedIndirect(buf, offset, drawCount);
+    else
+        recordDraw(Draw::Op::DrawIndexedIndirect, offset, drawCount, 0, buf);
+}
+
+void SortedCommandQueue::radixSort()
+{
+    size_t count = m_keys.size();
+    m_order.resize(count);
+    m_orderTmp.resize(count);
+    for (size_t i=0 ; i<count ; ++i)
+        m_order[i] = uint32_t(i);
+
+    /* Gather all eight digit histograms in a single pass */
+    uint32_t hist[8][256];
+    memset(hist, 0, sizeof(hist));
+    for (uint64_t key : m_keys)
+        for (int d=0 ; d<8 ; ++d)
+            ++hist[d][(key >> (d * 8)) & 0xff];
+
+    /* LSD passes are stable, so equal keys stay in submission order */
+    for (int d=0 ; d<8 ; ++d)
+    {
+        uint32_t* h = hist[d];
+        uint64_t digit0 = (m_keys[m_order[0]] >> (d * 8)) & 0xff;
+        if (h[digit0] == count)
+            continue;
+
+        uint32_t offset = 0;
+        for (int b=0 ; b<256 ; ++b)
+        {
+            uint32_t c = h[b];
+            h[b] = offset;
+            offset += c;
+        }
+        for (uint32_t idx : m_order)
+            m_orderTmp[h[(m_keys[idx] >> (d * 8)) & 0xff]++] = idx;
+        m_order.swap(m_orderTmp);
+    }
+}
+
+void SortedCommandQueue::emitDraw(const Draw& draw)
+{
+    if (draw.m_binding && draw.m_binding != m_emitBinding)
+    {
+        m_backend->setShaderDataBinding(draw.m_binding);
+        m_emitBinding = draw.m_binding;
+    }
+    if (draw.m_viewport != ~uint32_t(0) && draw.m_viewport != m_emitViewport)
+    {
+        const Viewport& vp = m_viewports[draw.m_viewport];
+        m_backend->setViewport(vp.rect, vp.znear, vp.zfar);
+        m_emitViewport = draw.m_viewport;
+    }
+    if (draw.m_scissor != ~uint32_t(0) && draw.m_scissor != m_emitScissor)
+    {
+        m_backend->setScissor(m_scissors[draw.m_scissor]);
+        m_emitScissor = draw.m_scissor;
+    }
+
+    switch (draw.m_op)
+    {
+    case Draw::Op::Draw:
+        m_backend->draw(draw.m_start, draw.m_count);
+        break;
+    case Draw::Op::DrawIndexed:
+        m_backend->drawIndexed(draw.m_start, draw.m_count);
+        break;
+    case Draw::Op::DrawInstances:
+        m_backend->drawInstances(draw.m_start, draw.m_count, draw.m_instCount);
+        break;
+    case Draw::Op::DrawInstancesIndexed:
+        m_backend->drawInstancesIndexed(draw.m_start, draw.m_count, draw.m_instCount);
+        break;
+    case Draw::Op::DrawIndirect:
+        m_backend->drawIndirect(draw.m_indirectBuf, draw.m_start, draw.m_count);
+        break;
+    case Draw::Op::DrawIndexedIndirect:
+        m_backend->drawIndexedIndirect(draw.m_indirectBuf, draw.m_start, draw.m_count);
+        break;
+    default: break;
+    }
+}
+
+void SortedCommandQueue::syncViewportScissor()
+{
+    /* Fence commands (clears in particular) observe the viewport and scissor
+     * the client set last, not whatever the final sorted draw used */
+    if (m_viewports.size() && m_viewports.size() - 1 != m_emitViewport)
+    {
+        const Viewport& vp = m_viewports.back();
+        m_backend->setViewport(vp.rect, vp.znear, vp.zfar);
+        m_emitViewport = uint32_t(m_viewports.size() - 1);
+    }
+    if (m_scissors.size() && m_scissors.size() - 1 != m_emitScissor)
+    {
+        m_backend->setScissor(m_scissors.back());
+        m_emitScissor = uint32_t(m_scissors.size() - 1);
+    }
+}
+
+void SortedCommandQueue::flush()
+{
+    if (m_draws.size())
+    {
+        radixSort();
+        for (uint32_t idx : m_order)
+            emitDraw(m_draws[idx]);
+        m_draws.clear();
+        m_keys.clear();
+    }
+    syncViewportScissor();
+}
+
+void SortedCommandQueue::invalidateEmitted()
+{
+    m_emitBinding = nullptr;
+    m_emitViewport = ~uint32_t(0);
+    m_emitScissor = ~uint32_t(0);
+}
+
+/* Target switches may begin new render passes on the backend;
+ * re-establish state for the draws that follow */
+void SortedCommandQueue::setRenderTarget(ITextureR* target)
+{
+    flush();
+    m_backend->setRenderTarget(target);
+    invalidateEmitted();
+}
+
+void SortedCommandQueue::resizeRenderTexture(ITextureR* tex, size_t width, size_t height)
+{
+    m_backend->resizeRenderTexture(tex, width, height);
+}
+
+void SortedCommandQueue::schedulePostFrameHandler(std::function<void(void)>&& func)
+{
+    m_backend->schedulePostFrameHandler(std::move(func));
+}
+
+void SortedCommandQueue::setClearColor(const float rgba[4])
+{
+    m_backend->setClearColor(rgba);
+}
+
+void SortedCommandQueue::clearTarget(bool render, bool depth)
+{
+    flush();
+    m_backend->clearTarget(render, depth);
+}
+
+void SortedCommandQueue::resolveBindTexture(ITextureR* texture, const SWindowRect& rect,
+                                            bool tlOrigin, bool color, bool depth)
+{
+    flush();
+    m_backend->resolveBindTexture(texture, rect, tlOrigin, color, depth);
+    invalidateEmitted();
+}
+
+void SortedCommandQueue::executeCommandLists(IGraphicsCommandList* const* lists, size_t count)
+{
+    flush();
+    m_backend->executeCommandLists(lists, count);
+    invalidateEmitted();
+}
+
+void SortedCommandQueue::resolveDisplay(ITextureR* source)
+{
+    flush();
+    m_backend->resolveDisplay(source);
+}
+
+void SortedCommandQueue::readback(ITextureR* texture, const SWindowRect& rect, ReadbackFunc&& callback)
+{
+    flush();
+    m_backend->readback(texture, rect, std::move(callback));
+    invalidateEmitted();
+}
+
+void SortedCommandQueue::beginTimer(const char* name)
+{
+    flush();
+    m_backend->beginTimer(name);
+}
+
+void SortedCommandQueue::endTimer()
+{
+    flush();
+    m_backend->endTimer();
+}
+
+void SortedCommandQueue::execute()
+{
+    flush();
+    m_backend->execute();
+
+    /* Backends start each frame from a clean slate; carry only the
+     * current client state forward */
+    if (m_viewports.size())
+    {
+        Viewport vp = m_viewports.back();
+        m_viewports.clear();
+        m_viewports.push_back(vp);
+    }
+    if (m_scissors.size())
+    {
+        SWindowRect sc = m_scissors.back();
+        m_scissors.clear();
+        m_scissors.push_back(sc);
+    }
+    invalidateEmitted();
+}
+
+}
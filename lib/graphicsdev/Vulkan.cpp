@@ -1,8 +1,18 @@
 #include "boo/graphicsdev/Vulkan.hpp"
+#include "boo/graphicsdev/GPUTimerMarks.hpp"
 #include "boo/IGraphicsContext.hpp"
 #include <vector>
 #include <array>
 #include <cmath>
+#include <unordered_set>
+#include <set>
+#include <deque>
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#if !_WIN32
+#include <unistd.h>
+#endif
 #include <glslang/Public/ShaderLang.h>
 #include <StandAlone/ResourceLimits.h>
 #include <SPIRV/GlslangToSpv.h>
@@ -259,23 +269,27 @@ void VulkanContext::initVulkan(const char* appName)
     }
     free(vkProps);
 
-    /* need platform surface extensions */
-    m_instanceExtensionNames.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
+    if (!m_headless)
+    {
+        /* need platform surface extensions */
+        m_instanceExtensionNames.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
 #ifdef _WIN32
-    m_instanceExtensionNames.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+        m_instanceExtensionNames.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
 #else
-    m_instanceExtensionNames.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
+        m_instanceExtensionNames.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
 #endif
 
-    /* need swapchain device extension */
-    m_deviceExtensionNames.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+        /* need swapchain device extension */
+        m_deviceExtensionNames.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
 
 #ifndef NDEBUG
     m_layerNames.push_back("VK_LAYER_LUNARG_core_validation");
     m_layerNames.push_back("VK_LAYER_LUNARG_object_tracker");
     m_layerNames.push_back("VK_LAYER_LUNARG_image");
     m_layerNames.push_back("VK_LAYER_LUNARG_parameter_validation");
-    m_layerNames.push_back("VK_LAYER_LUNARG_swapchain");
+    if (!m_headless)
+        m_layerNames.push_back("VK_LAYER_LUNARG_swapchain");
     m_layerNames.push_back("VK_LAYER_GOOGLE_threading");
 #endif
 
@@ -375,6 +389,8 @@ void VulkanContext::initDevice()
         Log.report(logvisor::Fatal,
                    "VulkanContext::m_graphicsQueueFamilyIndex hasn't been initialized");
 
+    m_framesInFlight = std::min(std::max(m_framesInFlight, uint32_t(1)), uint32_t(MaxFramesInFlight));
+
     /* create the device and queues */
     VkDeviceQueueCreateInfo queueInfo = {};
     float queuePriorities[1] = {0.0};
@@ -395,7 +411,10 @@ void VulkanContext::initDevice()
     deviceInfo.enabledExtensionCount = m_deviceExtensionNames.size();
     deviceInfo.ppEnabledExtensionNames =
         deviceInfo.enabledExtensionCount ? m_deviceExtensionNames.data() : nullptr;
-    deviceInfo.pEnabledFeatures = nullptr;
+    VkPhysicalDeviceFeatures features;
+    vk::GetPhysicalDeviceFeatures(m_gpus[0], &features);
+    m_features.multiDrawIndirect = features.multiDrawIndirect;
+    deviceInfo.pEnabledFeatures = &m_features;
 
     ThrowIfFailed(vk::CreateDevice(m_gpus[0], &deviceInfo, nullptr, &m_dev));
 }
@@ -493,33 +512,29 @@ void VulkanContext::initSwapChain(VulkanContext::Window& windowCtx, VkSurfaceKHR
     std::unique_ptr<VkImage[]> swapchainImages(new VkImage[swapchainImageCount]);
     ThrowIfFailed(vk::GetSwapchainImagesKHR(m_dev, sc.m_swapChain, &swapchainImageCount, swapchainImages.get()));
 
-    // Going to need a command buffer to send the memory barriers in
-    // set_image_layout but we couldn't have created one before we knew
-    // what our graphics_queue_family_index is, but now that we have it,
-    // create the command buffer
-
-    VkCommandPoolCreateInfo cmdPoolInfo = {};
-    cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    cmdPoolInfo.pNext = nullptr;
-    cmdPoolInfo.queueFamilyIndex = m_graphicsQueueFamilyIndex;
-    cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-    ThrowIfFailed(vk::CreateCommandPool(m_dev, &cmdPoolInfo, nullptr, &m_loadPool));
-
-    VkCommandBufferAllocateInfo cmd = {};
-    cmd.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    cmd.pNext = nullptr;
-    cmd.commandPool = m_loadPool;
-    cmd.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    cmd.commandBufferCount = 1;
-    ThrowIfFailed(vk::AllocateCommandBuffers(m_dev, &cmd, &m_loadCmdBuf));
+    initLoadResources();
 
-    vk::GetDeviceQueue(m_dev, m_graphicsQueueFamilyIndex, 0, &m_queue);
+    /* images */
+    sc.m_bufs.resize(swapchainImageCount);
+    for (uint32_t i=0 ; i<swapchainImageCount ; ++i)
+    {
+        Window::SwapChain::Buffer& buf = sc.m_bufs[i];
+        buf.m_image = swapchainImages[i];
+    }
+}
+
+/* Render targets use the swapchain-compatible format either way, so the
+ * same pipelines and render pass serve windowed and headless devices */
+void VulkanContext::initHeadless()
+{
+    m_displayFormat = VK_FORMAT_B8G8R8A8_UNORM;
+    initLoadResources();
+}
 
-    /* Begin load command buffer here */
-    VkCommandBufferBeginInfo cmdBufBeginInfo = {};
-    cmdBufBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    cmdBufBeginInfo.flags = 0;
-    ThrowIfFailed(vk::BeginCommandBuffer(m_loadCmdBuf, &cmdBufBeginInfo));
+void VulkanContext::initLoadResources()
+{
+    /* Uploads record into VulkanUploadManager's own command buffers */
+    vk::GetDeviceQueue(m_dev, m_graphicsQueueFamilyIndex, 0, &m_queue);
 
     /* Create shared linear sampler */
     VkSamplerCreateInfo samplerInfo = {};
@@ -532,14 +547,6 @@ void VulkanContext::initSwapChain(VulkanContext::Window& windowCtx, VkSurfaceKHR
     samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
     samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
     ThrowIfFailed(vk::CreateSampler(m_dev, &samplerInfo, nullptr, &m_linearSampler));
-
-    /* images */
-    sc.m_bufs.resize(swapchainImageCount);
-    for (uint32_t i=0 ; i<swapchainImageCount ; ++i)
-    {
-        Window::SwapChain::Buffer& buf = sc.m_bufs[i];
-        buf.m_image = swapchainImages[i];
-    }
 }
 
 
@@ -645,244 +652,1010 @@ void VulkanContext::resizeSwapChain(VulkanContext::Window& windowCtx, VkSurfaceK
     }
 }
 
-struct VulkanData : IGraphicsData
+/** Power-of-two range inside a VulkanMemoryBlock */
+struct VulkanDeviceAllocation
 {
-    VulkanContext* m_ctx;
-    VkDeviceMemory m_bufMem = VK_NULL_HANDLE;
-    VkDeviceMemory m_texMem = VK_NULL_HANDLE;
-    std::vector<std::unique_ptr<class VulkanShaderPipeline>> m_SPs;
-    std::vector<std::unique_ptr<struct VulkanShaderDataBinding>> m_SBinds;
-    std::vector<std::unique_ptr<class VulkanGraphicsBufferS>> m_SBufs;
-    std::vector<std::unique_ptr<class VulkanGraphicsBufferD>> m_DBufs;
-    std::vector<std::unique_ptr<class VulkanTextureS>> m_STexs;
-    std::vector<std::unique_ptr<class VulkanTextureSA>> m_SATexs;
-    std::vector<std::unique_ptr<class VulkanTextureD>> m_DTexs;
-    std::vector<std::unique_ptr<class VulkanTextureR>> m_RTexs;
-    std::vector<std::unique_ptr<struct VulkanVertexFormat>> m_VFmts;
-    bool m_dead = false;
-    VulkanData(VulkanContext* ctx) : m_ctx(ctx) {}
-    ~VulkanData()
-    {
-        if (m_bufMem)
-            vk::FreeMemory(m_ctx->m_dev, m_bufMem, nullptr);
-        if (m_texMem)
-            vk::FreeMemory(m_ctx->m_dev, m_texMem, nullptr);
-    }
+    struct VulkanMemoryBlock* m_block = nullptr;
+    VkDeviceMemory m_mem = VK_NULL_HANDLE;
+    VkDeviceSize m_offset = 0;
+    VkDeviceSize m_requested = 0;
+    uint8_t* m_blockMap = nullptr; /* Persistent mapping of the whole block (host-visible types) */
+    uint32_t m_order = 0;
+    explicit operator bool() const {return m_block != nullptr;}
 };
 
-static const VkBufferUsageFlagBits USE_TABLE[] =
+struct VulkanMemoryBlock
 {
-    VkBufferUsageFlagBits(0),
-    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-    VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT
+    VkDeviceMemory m_mem = VK_NULL_HANDLE;
+    uint32_t m_typeIdx;
+    bool m_images;
+    bool m_dedicated;
+    uint8_t* m_mapped = nullptr;
+    VkDeviceSize m_size;
+    uint32_t m_maxOrder;
+    std::vector<std::set<VkDeviceSize>> m_free; /* Free range offsets per order */
+    size_t m_allocCount = 0;
+    VkDeviceSize m_used = 0;
+    VkDeviceSize m_requested = 0;
 };
 
-class VulkanGraphicsBufferS : public IGraphicsBufferS
+/** Sub-allocates transaction memory from large blocks with a buddy allocator,
+ *  so the number of live vkAllocateMemory calls tracks memory footprint rather
+ *  than the number of GraphicsDataTokens.
+ *
+ *  Buffers and images never share a block, which keeps bufferImageGranularity
+ *  out of the picture. Requests over half a block get a dedicated allocation. */
+class VulkanDeviceAllocator
 {
-    friend class VulkanDataFactory;
-    friend struct VulkanCommandQueue;
     VulkanContext* m_ctx;
-    size_t m_sz;
-    std::unique_ptr<uint8_t[]> m_stagingBuf;
-    VulkanGraphicsBufferS(BufferUse use, VulkanContext* ctx, const void* data, size_t stride, size_t count)
-    : m_ctx(ctx), m_stride(stride), m_count(count), m_sz(stride * count),
-      m_stagingBuf(new uint8_t[m_sz]), m_uniform(use == BufferUse::Uniform)
+    std::mutex m_mt;
+    std::vector<std::unique_ptr<VulkanMemoryBlock>> m_blocks;
+
+    VulkanMemoryBlock* newBlock(uint32_t typeIdx, bool images, VkDeviceSize size, bool dedicated)
     {
-        memmove(m_stagingBuf.get(), data, m_sz);
+        std::unique_ptr<VulkanMemoryBlock> block(new VulkanMemoryBlock);
+        block->m_typeIdx = typeIdx;
+        block->m_images = images;
+        block->m_dedicated = dedicated;
+        block->m_size = size;
+        block->m_maxOrder = 0;
+        if (!dedicated)
+        {
+            while ((MinAllocSize << block->m_maxOrder) < size)
+                ++block->m_maxOrder;
+            block->m_free.resize(block->m_maxOrder + 1);
+            block->m_free[block->m_maxOrder].insert(0);
+        }
 
-        VkBufferCreateInfo bufInfo = {};
-        bufInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufInfo.pNext = nullptr;
-        bufInfo.usage = USE_TABLE[int(use)];
-        bufInfo.size = m_sz;
-        bufInfo.queueFamilyIndexCount = 0;
-        bufInfo.pQueueFamilyIndices = nullptr;
-        bufInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        bufInfo.flags = 0;
-        ThrowIfFailed(vk::CreateBuffer(ctx->m_dev, &bufInfo, nullptr, &m_bufferInfo.buffer));
-        m_bufferInfo.offset = 0;
-        m_bufferInfo.range = m_sz;
+        VkMemoryAllocateInfo memAlloc = {};
+        memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        memAlloc.allocationSize = size;
+        memAlloc.memoryTypeIndex = typeIdx;
+        ThrowIfFailed(vk::AllocateMemory(m_ctx->m_dev, &memAlloc, nullptr, &block->m_mem));
+        if (m_ctx->m_memoryProperties.memoryTypes[typeIdx].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+            ThrowIfFailed(vk::MapMemory(m_ctx->m_dev, block->m_mem, 0, size, 0,
+                                        reinterpret_cast<void**>(&block->m_mapped)));
+
+        m_blocks.push_back(std::move(block));
+        return m_blocks.back().get();
+    }
+
+    void releaseBlock(VulkanMemoryBlock* block)
+    {
+        if (block->m_mapped)
+            vk::UnmapMemory(m_ctx->m_dev, block->m_mem);
+        vk::FreeMemory(m_ctx->m_dev, block->m_mem, nullptr);
+        for (auto it = m_blocks.begin() ; it != m_blocks.end() ; ++it)
+        {
+            if (it->get() == block)
+            {
+                m_blocks.erase(it);
+                break;
+            }
+        }
+    }
+
+    static bool TakeRange(VulkanMemoryBlock& block, uint32_t order, VkDeviceSize& offsetOut)
+    {
+        if (order > block.m_maxOrder)
+            return false;
+        uint32_t k = order;
+        while (k <= block.m_maxOrder && block.m_free[k].empty())
+            ++k;
+        if (k > block.m_maxOrder)
+            return false;
+        VkDeviceSize offset = *block.m_free[k].begin();
+        block.m_free[k].erase(block.m_free[k].begin());
+        /* Split, returning upper halves to the free lists */
+        while (k > order)
+        {
+            --k;
+            block.m_free[k].insert(offset + (MinAllocSize << k));
+        }
+        offsetOut = offset;
+        return true;
     }
+
 public:
-    size_t size() const {return m_sz;}
-    size_t m_stride;
-    size_t m_count;
-    VkDescriptorBufferInfo m_bufferInfo;
-    VkDeviceSize m_memOffset;
-    bool m_uniform = false;
-    ~VulkanGraphicsBufferS()
+    static const VkDeviceSize BlockSize = 64 * 1024 * 1024;
+    static const VkDeviceSize MinAllocSize = 256;
+
+    VulkanDeviceAllocator(VulkanContext* ctx) : m_ctx(ctx) {}
+    ~VulkanDeviceAllocator()
     {
-        vk::DestroyBuffer(m_ctx->m_dev, m_bufferInfo.buffer, nullptr);
+        while (m_blocks.size())
+            releaseBlock(m_blocks.back().get());
     }
 
-    VkDeviceSize sizeForGPU(VulkanContext* ctx, uint32_t& memTypeBits, VkDeviceSize offset)
+    /* A range's offset is a multiple of its power-of-two size, so taking at
+     * least alignment bytes keeps the range aligned for every resource */
+    VulkanDeviceAllocation allocate(uint32_t typeIdx, bool images, VkDeviceSize size, VkDeviceSize alignment)
     {
-        if (m_uniform)
+        std::unique_lock<std::mutex> lk(m_mt);
+        VulkanDeviceAllocation ret;
+        ret.m_requested = size;
+
+        if (std::max(size, alignment) > BlockSize / 2)
         {
-            size_t minOffset = std::max(VkDeviceSize(256),
-                ctx->m_gpuProps.limits.minUniformBufferOffsetAlignment);
-            offset = (offset + minOffset - 1) & ~(minOffset - 1);
+            ret.m_block = newBlock(typeIdx, images, size, true);
+            ret.m_block->m_allocCount = 1;
+            ret.m_block->m_used = size;
+            ret.m_block->m_requested = size;
+            ret.m_mem = ret.m_block->m_mem;
+            ret.m_blockMap = ret.m_block->m_mapped;
+            return ret;
         }
 
-        VkMemoryRequirements memReqs;
-        vk::GetBufferMemoryRequirements(ctx->m_dev, m_bufferInfo.buffer, &memReqs);
-        memTypeBits &= memReqs.memoryTypeBits;
-        m_memOffset = offset;
+        uint32_t order = 0;
+        while ((MinAllocSize << order) < std::max(size, alignment))
+            ++order;
+        ret.m_order = order;
 
-        offset += m_sz;
-        offset = (offset + memReqs.alignment - 1) & ~(memReqs.alignment - 1);
+        for (std::unique_ptr<VulkanMemoryBlock>& block : m_blocks)
+        {
+            if (block->m_dedicated || block->m_typeIdx != typeIdx || block->m_images != images)
+                continue;
+            if (TakeRange(*block, order, ret.m_offset))
+            {
+                ret.m_block = block.get();
+                break;
+            }
+        }
+        if (!ret.m_block)
+        {
+            ret.m_block = newBlock(typeIdx, images, BlockSize, false);
+            TakeRange(*ret.m_block, order, ret.m_offset);
+        }
 
-        return offset;
+        ++ret.m_block->m_allocCount;
+        ret.m_block->m_used += MinAllocSize << order;
+        ret.m_block->m_requested += size;
+        ret.m_mem = ret.m_block->m_mem;
+        ret.m_blockMap = ret.m_block->m_mapped;
+        return ret;
     }
 
-    void placeForGPU(VulkanContext* ctx, VkDeviceMemory mem, uint8_t* buf)
+    void free(VulkanDeviceAllocation& alloc)
     {
-        memmove(buf + m_memOffset, m_stagingBuf.get(), m_sz);
-        m_stagingBuf.reset();
-        ThrowIfFailed(vk::BindBufferMemory(ctx->m_dev, m_bufferInfo.buffer, mem, m_memOffset));
+        if (!alloc)
+            return;
+        std::unique_lock<std::mutex> lk(m_mt);
+        VulkanMemoryBlock* block = alloc.m_block;
+        alloc.m_block = nullptr;
+        --block->m_allocCount;
+        block->m_requested -= alloc.m_requested;
+
+        if (block->m_dedicated)
+        {
+            releaseBlock(block);
+            return;
+        }
+
+        /* Coalesce with free buddies on the way up */
+        uint32_t k = alloc.m_order;
+        VkDeviceSize offset = alloc.m_offset;
+        block->m_used -= MinAllocSize << k;
+        while (k < block->m_maxOrder)
+        {
+            VkDeviceSize buddy = offset ^ (MinAllocSize << k);
+            auto it = block->m_free[k].find(buddy);
+            if (it == block->m_free[k].end())
+                break;
+            block->m_free[k].erase(it);
+            offset = std::min(offset, buddy);
+            ++k;
+        }
+        block->m_free[k].insert(offset);
+
+        /* Keep one empty block per pool around to absorb churn */
+        if (!block->m_allocCount)
+        {
+            for (std::unique_ptr<VulkanMemoryBlock>& other : m_blocks)
+            {
+                if (other.get() != block && !other->m_dedicated &&
+                    other->m_typeIdx == block->m_typeIdx && other->m_images == block->m_images)
+                {
+                    releaseBlock(block);
+                    break;
+                }
+            }
+        }
+    }
+
+    VulkanDataFactory::MemoryStats getStats()
+    {
+        std::unique_lock<std::mutex> lk(m_mt);
+        VulkanDataFactory::MemoryStats stats;
+        VkDeviceSize freeBytes = 0;
+        for (std::unique_ptr<VulkanMemoryBlock>& block : m_blocks)
+        {
+            ++stats.blockCount;
+            stats.allocationCount += block->m_allocCount;
+            stats.reservedBytes += block->m_size;
+            stats.usedBytes += block->m_used;
+            stats.requestedBytes += block->m_requested;
+            if (block->m_dedicated)
+                continue;
+            freeBytes += block->m_size - block->m_used;
+            for (uint32_t k = block->m_maxOrder + 1 ; k-- > 0 ;)
+            {
+                if (block->m_free[k].size())
+                {
+                    stats.largestFreeRange = std::max(stats.largestFreeRange, uint64_t(MinAllocSize << k));
+                    break;
+                }
+            }
+        }
+        if (freeBytes)
+            stats.fragmentation = 1.f - float(stats.largestFreeRange) / float(freeBytes);
+        return stats;
     }
 };
 
-class VulkanGraphicsBufferD : public IGraphicsBufferD
+/** Sub-allocates descriptor sets for transactions from shared pools.
+ *
+ *  Every pool is created freeable and holds sets of the one shared layout, so
+ *  any freed set can be reused by a later transaction. A pool counts its live
+ *  sets; a transaction's sets go back when its token dies, and pools left
+ *  empty beyond a small idle reserve are destroyed. */
+class VulkanDescriptorAllocator
 {
-    friend class VulkanDataFactory;
-    friend struct VulkanCommandQueue;
-    struct VulkanCommandQueue* m_q;
-    size_t m_cpuSz;
-    std::unique_ptr<uint8_t[]> m_cpuBuf;
-    int m_validSlots = 0;
-    VulkanGraphicsBufferD(VulkanCommandQueue* q, BufferUse use, VulkanContext* ctx, size_t stride, size_t count)
-    : m_q(q), m_stride(stride), m_count(count), m_cpuSz(stride * count), m_cpuBuf(new uint8_t[m_cpuSz]),
-      m_uniform(use == BufferUse::Uniform)
+    struct Pool
     {
-        VkBufferCreateInfo bufInfo = {};
-        bufInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufInfo.pNext = nullptr;
-        bufInfo.usage = USE_TABLE[int(use)];
-        bufInfo.size = m_cpuSz;
-        bufInfo.queueFamilyIndexCount = 0;
-        bufInfo.pQueueFamilyIndices = nullptr;
-        bufInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        bufInfo.flags = 0;
-        ThrowIfFailed(vk::CreateBuffer(ctx->m_dev, &bufInfo, nullptr, &m_bufferInfo[0].buffer));
-        ThrowIfFailed(vk::CreateBuffer(ctx->m_dev, &bufInfo, nullptr, &m_bufferInfo[1].buffer));
-        m_bufferInfo[0].offset = 0;
-        m_bufferInfo[0].range = m_cpuSz;
-        m_bufferInfo[1].offset = 0;
-        m_bufferInfo[1].range = m_cpuSz;
+        VkDescriptorPool m_pool;
+        uint32_t m_liveSets = 0;
+        bool m_full = false; /* Refused an allocation below capacity; cleared by frees */
+    };
+
+    VulkanContext* m_ctx;
+    std::mutex m_mt;
+    std::vector<std::unique_ptr<Pool>> m_pools; /* Pool objects never move */
+    size_t m_liveSets = 0;
+
+    Pool* createPool()
+    {
+        VkDescriptorPoolSize poolSizes[2] = {};
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        poolSizes[0].descriptorCount = BOO_GLSL_MAX_UNIFORM_COUNT * SetsPerPool;
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSizes[1].descriptorCount = BOO_GLSL_MAX_TEXTURE_COUNT * SetsPerPool;
+
+        VkDescriptorPoolCreateInfo descriptorPoolInfo = {};
+        descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        descriptorPoolInfo.pNext = nullptr;
+        descriptorPoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+        descriptorPoolInfo.maxSets = SetsPerPool;
+        descriptorPoolInfo.poolSizeCount = 2;
+        descriptorPoolInfo.pPoolSizes = poolSizes;
+
+        std::unique_ptr<Pool> pool(new Pool);
+        ThrowIfFailed(vk::CreateDescriptorPool(m_ctx->m_dev, &descriptorPoolInfo, nullptr, &pool->m_pool));
+        m_pools.push_back(std::move(pool));
+        return m_pools.back().get();
+    }
+
+    Pool* poolWithRoom()
+    {
+        for (std::unique_ptr<Pool>& pool : m_pools)
+            if (!pool->m_full && pool->m_liveSets < SetsPerPool)
+                return pool.get();
+        return createPool();
     }
-    void update(int b);
 
 public:
-    size_t m_stride;
-    size_t m_count;
-    VkDeviceMemory m_mem;
-    VkDeviceSize m_memOffset[2];
-    VkDescriptorBufferInfo m_bufferInfo[2];
-    bool m_uniform = false;
-    ~VulkanGraphicsBufferD();
-    void load(const void* data, size_t sz);
-    void* map(size_t sz);
-    void unmap();
+    static const uint32_t SetsPerPool = 256;
+    static const size_t MaxIdlePools = 4;
 
-    VkDeviceSize sizeForGPU(VulkanContext* ctx, uint32_t& memTypeBits, VkDeviceSize offset)
+    /** Sets held by one transaction, grouped into runs from the same pool */
+    struct Batch
     {
-        for (int i=0 ; i<2 ; ++i)
+        std::vector<VkDescriptorSet> m_sets;
+        std::vector<std::pair<Pool*, uint32_t>> m_runs;
+    };
+
+    VulkanDescriptorAllocator(VulkanContext* ctx) : m_ctx(ctx) {}
+    ~VulkanDescriptorAllocator()
+    {
+        for (std::unique_ptr<Pool>& pool : m_pools)
+            vk::DestroyDescriptorPool(m_ctx->m_dev, pool->m_pool, nullptr);
+    }
+
+    /* Allocates count sets of the shared layout into the batch, filling
+     * partly used pools before creating new ones */
+    void allocate(Batch& batch, size_t count, VkDescriptorSet* setsOut)
+    {
+        VkDescriptorSetLayout layouts[64];
+        for (size_t i=0 ; i<64 ; ++i)
+            layouts[i] = m_ctx->m_descSetLayout;
+
+        /* Pools are externally synchronized, so allocation holds the lock throughout */
+        std::unique_lock<std::mutex> lk(m_mt);
+        size_t done = 0;
+        while (done < count)
         {
-            if (m_uniform)
+            Pool* pool = poolWithRoom();
+            uint32_t chunk = uint32_t(std::min(count - done, size_t(64)));
+            chunk = std::min(chunk, SetsPerPool - pool->m_liveSets);
+
+            VkDescriptorSetAllocateInfo descAllocInfo;
+            descAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            descAllocInfo.pNext = nullptr;
+            descAllocInfo.descriptorPool = pool->m_pool;
+            descAllocInfo.descriptorSetCount = chunk;
+            descAllocInfo.pSetLayouts = layouts;
+            VkResult res = vk::AllocateDescriptorSets(m_ctx->m_dev, &descAllocInfo, setsOut + done);
+            if (res != VK_SUCCESS && pool->m_liveSets)
             {
-                size_t minOffset = std::max(VkDeviceSize(256),
-                    ctx->m_gpuProps.limits.minUniformBufferOffsetAlignment);
-                offset = (offset + minOffset - 1) & ~(minOffset - 1);
+                /* Fragmented or exhausted early; move on to another pool */
+                pool->m_full = true;
+                continue;
             }
+            ThrowIfFailed(res);
 
-            VkMemoryRequirements memReqs;
-            vk::GetBufferMemoryRequirements(ctx->m_dev, m_bufferInfo[i].buffer, &memReqs);
-            memTypeBits &= memReqs.memoryTypeBits;
-            m_memOffset[i] = offset;
+            pool->m_liveSets += chunk;
+            if (batch.m_runs.size() && batch.m_runs.back().first == pool)
+                batch.m_runs.back().second += chunk;
+            else
+                batch.m_runs.emplace_back(pool, chunk);
+            batch.m_sets.insert(batch.m_sets.end(), setsOut + done, setsOut + done + chunk);
+            done += chunk;
+        }
+        m_liveSets += count;
+    }
 
-            offset += memReqs.size;
-            offset = (offset + memReqs.alignment - 1) & ~(memReqs.alignment - 1);
+    void release(Batch& batch)
+    {
+        if (batch.m_runs.empty())
+            return;
+
+        std::unique_lock<std::mutex> lk(m_mt);
+        const VkDescriptorSet* sets = batch.m_sets.data();
+        for (const std::pair<Pool*, uint32_t>& run : batch.m_runs)
+        {
+            vk::FreeDescriptorSets(m_ctx->m_dev, run.first->m_pool, run.second, sets);
+            sets += run.second;
+            run.first->m_liveSets -= run.second;
+            run.first->m_full = false;
         }
+        m_liveSets -= batch.m_sets.size();
+        batch.m_sets.clear();
+        batch.m_runs.clear();
 
-        return offset;
+        /* Keep a few empty pools for the next transactions and destroy the rest */
+        size_t idle = 0;
+        for (auto it = m_pools.begin() ; it != m_pools.end() ;)
+        {
+            if (!(*it)->m_liveSets && ++idle > MaxIdlePools)
+            {
+                vk::DestroyDescriptorPool(m_ctx->m_dev, (*it)->m_pool, nullptr);
+                it = m_pools.erase(it);
+            }
+            else
+                ++it;
+        }
     }
 
-    void placeForGPU(VulkanContext* ctx, VkDeviceMemory mem)
+    VulkanDataFactory::DescriptorStats getStats()
     {
-        m_mem = mem;
-        ThrowIfFailed(vk::BindBufferMemory(ctx->m_dev, m_bufferInfo[0].buffer, mem, m_memOffset[0]));
-        ThrowIfFailed(vk::BindBufferMemory(ctx->m_dev, m_bufferInfo[1].buffer, mem, m_memOffset[1]));
+        std::unique_lock<std::mutex> lk(m_mt);
+        VulkanDataFactory::DescriptorStats stats;
+        stats.livePools = m_pools.size();
+        for (const std::unique_ptr<Pool>& pool : m_pools)
+            if (!pool->m_liveSets)
+                ++stats.idlePools;
+        stats.liveSets = m_liveSets;
+        return stats;
     }
 };
 
-class VulkanTextureS : public ITextureS
+/** Streams static texture data to the GPU without idling the queue.
+ *
+ *  Texel data is staged in a persistently mapped ring buffer as textures are
+ *  created. Each committed transaction records its copies into a command
+ *  buffer of its own and submits them with a fence; ring space is reclaimed
+ *  as those fences signal. Staging requests larger than the ring get a
+ *  dedicated buffer that lives until its submission completes. */
+class VulkanUploadManager
 {
-    friend class VulkanDataFactory;
-    VulkanContext* m_ctx;
-    TextureFormat m_fmt;
-    size_t m_sz;
-    size_t m_width, m_height, m_mips;
-    VkFormat m_vkFmt;
-    int m_pixelPitchNum = 1;
-    int m_pixelPitchDenom = 1;
+public:
+    static const VkDeviceSize RingSize = 32 * 1024 * 1024;
 
-    VulkanTextureS(VulkanContext* ctx, size_t width, size_t height, size_t mips,
-                   TextureFormat fmt, const void* data, size_t sz)
-    : m_ctx(ctx), m_fmt(fmt), m_sz(sz), m_width(width), m_height(height), m_mips(mips)
+    struct Dedicated
     {
-        VkFormat pfmt;
-        switch (fmt)
-        {
-        case TextureFormat::RGBA8:
-            pfmt = VK_FORMAT_R8G8B8A8_UNORM;
-            m_pixelPitchNum = 4;
-            break;
-        case TextureFormat::I8:
-            pfmt = VK_FORMAT_R8_UNORM;
-            break;
-        case TextureFormat::DXT1:
-            pfmt = VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
-            m_pixelPitchNum = 1;
-            m_pixelPitchDenom = 2;
-            break;
-        default:
-            Log.report(logvisor::Fatal, "unsupported tex format");
-        }
-        m_vkFmt = pfmt;
+        VkBuffer m_buf;
+        VkDeviceMemory m_mem;
+    };
 
-        /* create cpu image buffer */
-        VkBufferCreateInfo bufCreateInfo = {};
-        bufCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufCreateInfo.size = sz;
-        bufCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-        bufCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        ThrowIfFailed(vk::CreateBuffer(ctx->m_dev, &bufCreateInfo, nullptr, &m_cpuBuf));
+    /** Staging state of one transaction */
+    struct Batch
+    {
+        std::vector<uint64_t> m_regions;
+        std::vector<Dedicated> m_dedicated;
+        VkCommandBuffer m_cmdBuf = VK_NULL_HANDLE;
+        uint64_t m_serial = 0; /* Nonzero once submitted */
+    };
 
-        VkMemoryRequirements memReqs;
-        vk::GetBufferMemoryRequirements(ctx->m_dev, m_cpuBuf, &memReqs);
+    struct Staging
+    {
+        VkBuffer m_buf;
+        VkDeviceSize m_offset;
+    };
 
-        VkMemoryAllocateInfo memAlloc = {};
-        memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        memAlloc.pNext = nullptr;
-        memAlloc.memoryTypeIndex = 0;
-        memAlloc.allocationSize = memReqs.size;
-        ThrowIfFalse(MemoryTypeFromProperties(ctx, memReqs.memoryTypeBits,
-                                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-                                              &memAlloc.memoryTypeIndex));
+private:
+    VulkanContext* m_ctx;
+    VkBuffer m_ringBuf = VK_NULL_HANDLE;
+    VkDeviceMemory m_ringMem = VK_NULL_HANDLE;
+    uint8_t* m_ringMap = nullptr;
+    VkDeviceSize m_alignment = 16;
+    VkCommandPool m_cmdPool = VK_NULL_HANDLE;
+    std::mutex m_recordMt; /* Guards m_cmdPool for recording */
+    std::mutex m_mt;
+
+    /* Ring ranges in allocation order; the oldest live one marks the ring head */
+    struct Region
+    {
+        VkDeviceSize m_begin, m_end;
+        bool m_done;
+    };
+    std::deque<Region> m_regions;
+    uint64_t m_frontRegion = 0; /* Serial of m_regions.front() */
 
-        /* allocate memory */
-        ThrowIfFailed(vk::AllocateMemory(ctx->m_dev, &memAlloc, nullptr, &m_cpuMem));
+    struct Submission
+    {
+        uint64_t m_serial;
+        VkFence m_fence;
+        VkCommandBuffer m_cmdBuf;
+        std::vector<uint64_t> m_regions;
+        std::vector<Dedicated> m_dedicated;
+    };
+    std::deque<Submission> m_inFlight;
+    uint64_t m_submitSerial = 0;
+    uint64_t m_completedSerial = 0;
+    std::vector<VkFence> m_freeFences;
+    std::vector<VkCommandBuffer> m_freeCmdBufs;
+
+    /* stage() waits on fences without holding m_mt; fences retired meanwhile
+     * are only reset and reused once no thread is waiting */
+    uint32_t m_fenceWaiters = 0;
+    std::vector<VkFence> m_retiredFences;
+
+    void freeFence(VkFence fence)
+    {
+        ThrowIfFailed(vk::ResetFences(m_ctx->m_dev, 1, &fence));
+        m_freeFences.push_back(fence);
+    }
 
-        /* bind memory */
-        ThrowIfFailed(vk::BindBufferMemory(ctx->m_dev, m_cpuBuf, m_cpuMem, 0));
+    bool allocRing(VkDeviceSize sz, VkDeviceSize& offsetOut)
+    {
+        sz = std::max(sz, VkDeviceSize(1));
+        if (m_regions.empty())
+        {
+            if (sz > RingSize)
+                return false;
+            offsetOut = 0;
+        }
+        else
+        {
+            const Region& front = m_regions.front();
+            const Region& back = m_regions.back();
+            VkDeviceSize begin = (back.m_end + m_alignment - 1) & ~(m_alignment - 1);
+            if (back.m_begin >= front.m_begin)
+            {
+                /* Live ranges are contiguous; try the tail, then wrap */
+                if (begin + sz <= RingSize)
+                    offsetOut = begin;
+                else if (sz <= front.m_begin)
+                    offsetOut = 0;
+                else
+                    return false;
+            }
+            else
+            {
+                /* Already wrapped; the gap ends at the head */
+                if (begin + sz <= front.m_begin)
+                    offsetOut = begin;
+                else
+                    return false;
+            }
+        }
+        m_regions.push_back({offsetOut, offsetOut + sz, false});
+        return true;
+    }
+
+    void releaseRegions(const std::vector<uint64_t>& regions)
+    {
+        for (uint64_t r : regions)
+            m_regions[r - m_frontRegion].m_done = true;
+        while (m_regions.size() && m_regions.front().m_done)
+        {
+            m_regions.pop_front();
+            ++m_frontRegion;
+        }
+    }
+
+    void destroyDedicated(const std::vector<Dedicated>& dedicated)
+    {
+        for (const Dedicated& d : dedicated)
+        {
+            vk::DestroyBuffer(m_ctx->m_dev, d.m_buf, nullptr);
+            vk::FreeMemory(m_ctx->m_dev, d.m_mem, nullptr);
+        }
+    }
 
-        /* map memory and copy data */
+    /* Retires the oldest submission; fences on one queue signal in submission order */
+    void retireFront()
+    {
+        Submission& sub = m_inFlight.front();
+        releaseRegions(sub.m_regions);
+        destroyDedicated(sub.m_dedicated);
+        if (m_fenceWaiters)
+            m_retiredFences.push_back(sub.m_fence);
+        else
+            freeFence(sub.m_fence);
+        m_freeCmdBufs.push_back(sub.m_cmdBuf);
+        m_completedSerial = sub.m_serial;
+        m_inFlight.pop_front();
+    }
+
+    void reclaim()
+    {
+        while (m_inFlight.size() &&
+               vk::GetFenceStatus(m_ctx->m_dev, m_inFlight.front().m_fence) == VK_SUCCESS)
+            retireFront();
+    }
+
+    Dedicated createDedicated(VkDeviceSize sz)
+    {
+        Dedicated ret;
+        VkBufferCreateInfo bufCreateInfo = {};
+        bufCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufCreateInfo.size = sz;
+        bufCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        ThrowIfFailed(vk::CreateBuffer(m_ctx->m_dev, &bufCreateInfo, nullptr, &ret.m_buf));
+
+        VkMemoryRequirements memReqs;
+        vk::GetBufferMemoryRequirements(m_ctx->m_dev, ret.m_buf, &memReqs);
+
+        VkMemoryAllocateInfo memAlloc = {};
+        memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        memAlloc.pNext = nullptr;
+        memAlloc.allocationSize = memReqs.size;
+        ThrowIfFalse(MemoryTypeFromProperties(m_ctx, memReqs.memoryTypeBits,
+                                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                              &memAlloc.memoryTypeIndex));
+        ThrowIfFailed(vk::AllocateMemory(m_ctx->m_dev, &memAlloc, nullptr, &ret.m_mem));
+        ThrowIfFailed(vk::BindBufferMemory(m_ctx->m_dev, ret.m_buf, ret.m_mem, 0));
+        return ret;
+    }
+
+public:
+    VulkanUploadManager(VulkanContext* ctx) : m_ctx(ctx)
+    {
+        m_alignment = std::max(VkDeviceSize(16), ctx->m_gpuProps.limits.optimalBufferCopyOffsetAlignment);
+
+        Dedicated ring = createDedicated(RingSize);
+        m_ringBuf = ring.m_buf;
+        m_ringMem = ring.m_mem;
+        ThrowIfFailed(vk::MapMemory(ctx->m_dev, m_ringMem, 0, RingSize, 0, reinterpret_cast<void**>(&m_ringMap)));
+
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = ctx->m_graphicsQueueFamilyIndex;
+        ThrowIfFailed(vk::CreateCommandPool(ctx->m_dev, &poolInfo, nullptr, &m_cmdPool));
+    }
+
+    ~VulkanUploadManager()
+    {
+        while (m_inFlight.size())
+        {
+            ThrowIfFailed(vk::WaitForFences(m_ctx->m_dev, 1, &m_inFlight.front().m_fence, VK_FALSE, -1));
+            retireFront();
+        }
+        for (VkFence fence : m_freeFences)
+            vk::DestroyFence(m_ctx->m_dev, fence, nullptr);
+        vk::DestroyCommandPool(m_ctx->m_dev, m_cmdPool, nullptr);
+        vk::UnmapMemory(m_ctx->m_dev, m_ringMem);
+        vk::DestroyBuffer(m_ctx->m_dev, m_ringBuf, nullptr);
+        vk::FreeMemory(m_ctx->m_dev, m_ringMem, nullptr);
+    }
+
+    /** Copies data into staging memory owned by batch until its submission completes */
+    Staging stage(Batch& batch, const void* data, size_t sz)
+    {
+        return stage(batch, sz, [data, sz](void* dst) { memmove(dst, data, sz); });
+    }
+
+    /** Reserves sz bytes of staging for batch and lets fill write them in place */
+    Staging stage(Batch& batch, size_t sz, const std::function<void(void*)>& fill)
+    {
+        std::unique_lock<std::mutex> lk(m_mt);
+        Staging ret;
+        reclaim();
+        bool fits = allocRing(sz, ret.m_offset);
+
+        /* Stall only on loads that outrun the ring; older uploads finish first.
+         * The wait runs unlocked so isComplete() and other loaders proceed */
+        while (!fits && m_inFlight.size())
+        {
+            VkFence fence = m_inFlight.front().m_fence;
+            ++m_fenceWaiters;
+            lk.unlock();
+            VkResult res = vk::WaitForFences(m_ctx->m_dev, 1, &fence, VK_FALSE, -1);
+            lk.lock();
+            if (!--m_fenceWaiters)
+            {
+                for (VkFence retired : m_retiredFences)
+                    freeFence(retired);
+                m_retiredFences.clear();
+            }
+            ThrowIfFailed(res);
+            reclaim();
+            fits = allocRing(sz, ret.m_offset);
+        }
+
+        if (fits)
+        {
+            /* The region stays reserved until retired, so fill may run unlocked */
+            batch.m_regions.push_back(m_frontRegion + m_regions.size() - 1);
+            lk.unlock();
+            ret.m_buf = m_ringBuf;
+            fill(m_ringMap + ret.m_offset);
+            return ret;
+        }
+        lk.unlock();
+
+        Dedicated d = createDedicated(sz);
         uint8_t* mappedData;
-        ThrowIfFailed(vk::MapMemory(ctx->m_dev, m_cpuMem, 0, memReqs.size, 0, reinterpret_cast<void**>(&mappedData)));
-        memmove(mappedData, data, sz);
-        vk::UnmapMemory(ctx->m_dev, m_cpuMem);
+        ThrowIfFailed(vk::MapMemory(m_ctx->m_dev, d.m_mem, 0, sz, 0, reinterpret_cast<void**>(&mappedData)));
+        fill(mappedData);
+        vk::UnmapMemory(m_ctx->m_dev, d.m_mem);
+        batch.m_dedicated.push_back(d);
+        ret.m_buf = d.m_buf;
+        ret.m_offset = 0;
+        return ret;
+    }
+
+    /** Opens batch's command buffer; hold the returned lock until submit() */
+    std::unique_lock<std::mutex> beginRecording(Batch& batch)
+    {
+        std::unique_lock<std::mutex> reclk(m_recordMt);
+        std::unique_lock<std::mutex> lk(m_mt);
+        if (m_freeCmdBufs.size())
+        {
+            batch.m_cmdBuf = m_freeCmdBufs.back();
+            m_freeCmdBufs.pop_back();
+        }
+        lk.unlock();
+
+        if (!batch.m_cmdBuf)
+        {
+            VkCommandBufferAllocateInfo cmd = {};
+            cmd.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            cmd.pNext = nullptr;
+            cmd.commandPool = m_cmdPool;
+            cmd.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            cmd.commandBufferCount = 1;
+            ThrowIfFailed(vk::AllocateCommandBuffers(m_ctx->m_dev, &cmd, &batch.m_cmdBuf));
+        }
+
+        VkCommandBufferBeginInfo cmdBufBeginInfo = {};
+        cmdBufBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        cmdBufBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        ThrowIfFailed(vk::BeginCommandBuffer(batch.m_cmdBuf, &cmdBufBeginInfo));
+        return reclk;
+    }
+
+    /** Queues batch's copies behind everything already submitted; never waits on the GPU */
+    void submit(Batch& batch, std::unique_lock<std::mutex>& reclk)
+    {
+        ThrowIfFailed(vk::EndCommandBuffer(batch.m_cmdBuf));
+        reclk.unlock();
+
+        std::unique_lock<std::mutex> lk(m_mt);
+        VkFence fence;
+        if (m_freeFences.size())
+        {
+            fence = m_freeFences.back();
+            m_freeFences.pop_back();
+        }
+        else
+        {
+            VkFenceCreateInfo fenceInfo = {};
+            fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            ThrowIfFailed(vk::CreateFence(m_ctx->m_dev, &fenceInfo, nullptr, &fence));
+        }
+        lk.unlock();
+
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &batch.m_cmdBuf;
+
+        /* Serials are handed out under the queue lock so they follow submission order */
+        std::unique_lock<std::mutex> qlk(m_ctx->m_queueLock);
+        ThrowIfFailed(vk::QueueSubmit(m_ctx->m_queue, 1, &submitInfo, fence));
+        lk.lock();
+        batch.m_serial = ++m_submitSerial;
+        m_inFlight.push_back({batch.m_serial, fence, batch.m_cmdBuf,
+                              std::move(batch.m_regions), std::move(batch.m_dedicated)});
+        batch.m_regions.clear();
+        batch.m_dedicated.clear();
+        batch.m_cmdBuf = VK_NULL_HANDLE;
+    }
+
+    /** Returns staging of a batch that was never submitted */
+    void release(Batch& batch)
+    {
+        if (batch.m_serial)
+            return;
+        std::unique_lock<std::mutex> lk(m_mt);
+        releaseRegions(batch.m_regions);
+        destroyDedicated(batch.m_dedicated);
+        if (batch.m_cmdBuf)
+            m_freeCmdBufs.push_back(batch.m_cmdBuf);
+        batch.m_regions.clear();
+        batch.m_dedicated.clear();
+        batch.m_cmdBuf = VK_NULL_HANDLE;
+    }
+
+    bool isComplete(const Batch& batch)
+    {
+        std::unique_lock<std::mutex> lk(m_mt);
+        reclaim();
+        return batch.m_serial <= m_completedSerial;
+    }
+};
+
+struct VulkanData : IGraphicsData
+{
+    VulkanContext* m_ctx;
+    VulkanDeviceAllocator* m_allocator;
+    VulkanDeviceAllocation m_bufAlloc;
+    VulkanDeviceAllocation m_sbufAlloc;
+    VulkanDeviceAllocation m_texAlloc;
+    VulkanDescriptorAllocator* m_descAllocator;
+    VulkanDescriptorAllocator::Batch m_descBatch;
+    VulkanUploadManager* m_uploader;
+    VulkanUploadManager::Batch m_uploadBatch;
+    std::vector<std::unique_ptr<class VulkanShaderPipeline>> m_SPs;
+    std::vector<std::unique_ptr<struct VulkanShaderDataBinding>> m_SBinds;
+    std::vector<std::unique_ptr<class VulkanGraphicsBufferS>> m_SBufs;
+    std::vector<std::unique_ptr<class VulkanGraphicsBufferD>> m_DBufs;
+    std::vector<std::unique_ptr<class VulkanTextureS>> m_STexs;
+    std::vector<std::unique_ptr<class VulkanTextureSA>> m_SATexs;
+    std::vector<std::unique_ptr<class VulkanTextureD>> m_DTexs;
+    std::vector<std::unique_ptr<class VulkanTextureR>> m_RTexs;
+    std::vector<std::unique_ptr<struct VulkanVertexFormat>> m_VFmts;
+    VulkanData(VulkanContext* ctx, VulkanDeviceAllocator* allocator,
+               VulkanDescriptorAllocator* descAllocator, VulkanUploadManager* uploader)
+    : m_ctx(ctx), m_allocator(allocator), m_descAllocator(descAllocator), m_uploader(uploader) {}
+    ~VulkanData();
+};
+
+static const VkBufferUsageFlagBits USE_TABLE[] =
+{
+    VkBufferUsageFlagBits(0),
+    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+    VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+    VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+};
+
+/* Reads a static buffer of each use may see once its upload lands */
+static const VkAccessFlags USE_ACCESS_TABLE[] =
+{
+    0,
+    VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+    VK_ACCESS_INDEX_READ_BIT,
+    VK_ACCESS_UNIFORM_READ_BIT,
+    VK_ACCESS_INDIRECT_COMMAND_READ_BIT
+};
+
+class VulkanGraphicsBufferS : public IGraphicsBufferS
+{
+    friend class VulkanDataFactory;
+    friend struct VulkanCommandQueue;
+    VulkanContext* m_ctx;
+    size_t m_sz;
+    VulkanUploadManager::Staging m_staging; /* Owned by the transaction's upload batch */
+    VkAccessFlags m_readAccess;
+    VulkanGraphicsBufferS(BufferUse use, VulkanContext* ctx, VulkanUploadManager* uploader,
+                          VulkanUploadManager::Batch& batch, size_t stride, size_t count,
+                          const std::function<void(void*)>& fill)
+    : m_ctx(ctx), m_stride(stride), m_count(count), m_sz(stride * count),
+      m_readAccess(USE_ACCESS_TABLE[int(use)]), m_uniform(use == BufferUse::Uniform)
+    {
+        m_staging = uploader->stage(batch, m_sz, fill);
+
+        VkBufferCreateInfo bufInfo = {};
+        bufInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufInfo.pNext = nullptr;
+        bufInfo.usage = USE_TABLE[int(use)] | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufInfo.size = m_sz;
+        bufInfo.queueFamilyIndexCount = 0;
+        bufInfo.pQueueFamilyIndices = nullptr;
+        bufInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        bufInfo.flags = 0;
+        ThrowIfFailed(vk::CreateBuffer(ctx->m_dev, &bufInfo, nullptr, &m_bufferInfo.buffer));
+        m_bufferInfo.offset = 0;
+        m_bufferInfo.range = m_sz;
+    }
+public:
+    size_t size() const {return m_sz;}
+    size_t m_stride;
+    size_t m_count;
+    VkDescriptorBufferInfo m_bufferInfo;
+    VkDeviceSize m_memOffset;
+    bool m_uniform = false;
+    ~VulkanGraphicsBufferS()
+    {
+        vk::DestroyBuffer(m_ctx->m_dev, m_bufferInfo.buffer, nullptr);
+    }
+
+    VkDeviceSize sizeForGPU(VulkanContext* ctx, uint32_t& memTypeBits, VkDeviceSize& alignment, VkDeviceSize offset)
+    {
+        if (m_uniform)
+        {
+            size_t minOffset = std::max(VkDeviceSize(256),
+                ctx->m_gpuProps.limits.minUniformBufferOffsetAlignment);
+            offset = (offset + minOffset - 1) & ~(minOffset - 1);
+            alignment = std::max(alignment, VkDeviceSize(minOffset));
+        }
+
+        VkMemoryRequirements memReqs;
+        vk::GetBufferMemoryRequirements(ctx->m_dev, m_bufferInfo.buffer, &memReqs);
+        memTypeBits &= memReqs.memoryTypeBits;
+        alignment = std::max(alignment, memReqs.alignment);
+        m_memOffset = offset;
+
+        offset += m_sz;
+        offset = (offset + memReqs.alignment - 1) & ~(memReqs.alignment - 1);
+
+        return offset;
+    }
+
+    void placeForGPU(VulkanContext* ctx, VkDeviceMemory mem, VkCommandBuffer uploadCmdBuf)
+    {
+        ThrowIfFailed(vk::BindBufferMemory(ctx->m_dev, m_bufferInfo.buffer, mem, m_memOffset));
+
+        VkBufferCopy copy = {};
+        copy.srcOffset = m_staging.m_offset;
+        copy.dstOffset = 0;
+        copy.size = m_sz;
+        vk::CmdCopyBuffer(uploadCmdBuf, m_staging.m_buf, m_bufferInfo.buffer, 1, &copy);
+
+        VkBufferMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = m_readAccess;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = m_bufferInfo.buffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        vk::CmdPipelineBarrier(uploadCmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                               0, 0, nullptr, 1, &barrier, 0, nullptr);
+    }
+};
+
+class VulkanGraphicsBufferD : public IGraphicsBufferD
+{
+    friend class VulkanDataFactory;
+    friend struct VulkanCommandQueue;
+    struct VulkanCommandQueue* m_q;
+    size_t m_cpuSz;
+    std::unique_ptr<uint8_t[]> m_cpuBuf;
+    size_t m_slotCount;
+    int m_validSlots = 0;
+    bool m_dirty = false;
+    VulkanGraphicsBufferD(VulkanCommandQueue* q, BufferUse use, VulkanContext* ctx, size_t stride, size_t count)
+    : m_q(q), m_stride(stride), m_count(count), m_cpuSz(stride * count), m_cpuBuf(new uint8_t[m_cpuSz]),
+      m_slotCount(ctx->m_framesInFlight), m_uniform(use == BufferUse::Uniform)
+    {
+        VkBufferCreateInfo bufInfo = {};
+        bufInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufInfo.pNext = nullptr;
+        bufInfo.usage = USE_TABLE[int(use)];
+        bufInfo.size = m_cpuSz;
+        bufInfo.queueFamilyIndexCount = 0;
+        bufInfo.pQueueFamilyIndices = nullptr;
+        bufInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        bufInfo.flags = 0;
+        for (size_t i=0 ; i<m_slotCount ; ++i)
+        {
+            ThrowIfFailed(vk::CreateBuffer(ctx->m_dev, &bufInfo, nullptr, &m_bufferInfo[i].buffer));
+            m_bufferInfo[i].offset = 0;
+            m_bufferInfo[i].range = m_cpuSz;
+        }
+    }
+    void update(int b);
+
+public:
+    size_t m_stride;
+    size_t m_count;
+    uint8_t* m_mappedBase = nullptr; /* Persistent mapping of the memory block holding every slot */
+    VkDeviceSize m_memOffset[VulkanContext::MaxFramesInFlight];
+    VkDescriptorBufferInfo m_bufferInfo[VulkanContext::MaxFramesInFlight] = {};
+    bool m_uniform = false;
+    ~VulkanGraphicsBufferD();
+    void load(const void* data, size_t sz);
+    void* map(size_t sz);
+    void unmap();
+
+    VkDeviceSize sizeForGPU(VulkanContext* ctx, uint32_t& memTypeBits, VkDeviceSize& alignment, VkDeviceSize offset)
+    {
+        for (size_t i=0 ; i<m_slotCount ; ++i)
+        {
+            if (m_uniform)
+            {
+                size_t minOffset = std::max(VkDeviceSize(256),
+                    ctx->m_gpuProps.limits.minUniformBufferOffsetAlignment);
+                offset = (offset + minOffset - 1) & ~(minOffset - 1);
+                alignment = std::max(alignment, VkDeviceSize(minOffset));
+            }
+
+            VkMemoryRequirements memReqs;
+            vk::GetBufferMemoryRequirements(ctx->m_dev, m_bufferInfo[i].buffer, &memReqs);
+            memTypeBits &= memReqs.memoryTypeBits;
+            alignment = std::max(alignment, memReqs.alignment);
+            m_memOffset[i] = offset;
+
+            offset += memReqs.size;
+            offset = (offset + memReqs.alignment - 1) & ~(memReqs.alignment - 1);
+        }
+
+        return offset;
+    }
+
+    void placeForGPU(VulkanContext* ctx, VkDeviceMemory mem, uint8_t* mappedBase)
+    {
+        m_mappedBase = mappedBase;
+        for (size_t i=0 ; i<m_slotCount ; ++i)
+            ThrowIfFailed(vk::BindBufferMemory(ctx->m_dev, m_bufferInfo[i].buffer, mem, m_memOffset[i]));
+    }
+};
+
+class VulkanTextureS : public ITextureS
+{
+    friend class VulkanDataFactory;
+    VulkanContext* m_ctx;
+    TextureFormat m_fmt;
+    size_t m_sz;
+    size_t m_width, m_height, m_mips;
+    VkFormat m_vkFmt;
+    int m_pixelPitchNum = 1;
+    int m_pixelPitchDenom = 1;
+
+    VulkanTextureS(VulkanContext* ctx, VulkanUploadManager* uploader, VulkanUploadManager::Batch& batch,
+                   size_t width, size_t height, size_t mips,
+                   TextureFormat fmt, const void* data, size_t sz)
+    : m_ctx(ctx), m_fmt(fmt), m_sz(sz), m_width(width), m_height(height), m_mips(mips)
+    {
+        VkFormat pfmt;
+        switch (fmt)
+        {
+        case TextureFormat::RGBA8:
+            pfmt = VK_FORMAT_R8G8B8A8_UNORM;
+            m_pixelPitchNum = 4;
+            break;
+        case TextureFormat::I8:
+            pfmt = VK_FORMAT_R8_UNORM;
+            break;
+        case TextureFormat::DXT1:
+            pfmt = VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+            m_pixelPitchNum = 1;
+            m_pixelPitchDenom = 2;
+            break;
+        default:
+            Log.report(logvisor::Fatal, "unsupported tex format");
+        }
+        m_vkFmt = pfmt;
+
+        /* stage image data for the transaction's upload */
+        m_staging = uploader->stage(batch, data, sz);
 
         /* create gpu image */
         VkImageCreateInfo texCreateInfo = {};
@@ -904,8 +1677,7 @@ class VulkanTextureS : public ITextureS
         m_descInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     }
 public:
-    VkBuffer m_cpuBuf;
-    VkDeviceMemory m_cpuMem;
+    VulkanUploadManager::Staging m_staging; /* Owned by the transaction's upload batch */
     VkImage m_gpuTex;
     VkImageView m_gpuView = VK_NULL_HANDLE;
     VkDescriptorImageInfo m_descInfo;
@@ -914,25 +1686,14 @@ public:
     {
         vk::DestroyImageView(m_ctx->m_dev, m_gpuView, nullptr);
         vk::DestroyImage(m_ctx->m_dev, m_gpuTex, nullptr);
-        if (m_cpuBuf)
-            vk::DestroyBuffer(m_ctx->m_dev, m_cpuBuf, nullptr);
-        if (m_cpuMem)
-            vk::FreeMemory(m_ctx->m_dev, m_cpuMem, nullptr);
     }
 
-    void deleteUploadObjects()
-    {
-        vk::DestroyBuffer(m_ctx->m_dev, m_cpuBuf, nullptr);
-        m_cpuBuf = VK_NULL_HANDLE;
-        vk::FreeMemory(m_ctx->m_dev, m_cpuMem, nullptr);
-        m_cpuMem = VK_NULL_HANDLE;
-    }
-
-    VkDeviceSize sizeForGPU(VulkanContext* ctx, uint32_t& memTypeBits, VkDeviceSize offset)
+    VkDeviceSize sizeForGPU(VulkanContext* ctx, uint32_t& memTypeBits, VkDeviceSize& alignment, VkDeviceSize offset)
     {
         VkMemoryRequirements memReqs;
         vk::GetImageMemoryRequirements(ctx->m_dev, m_gpuTex, &memReqs);
         memTypeBits &= memReqs.memoryTypeBits;
+        alignment = std::max(alignment, memReqs.alignment);
 
         m_gpuOffset = offset;
         offset += memReqs.size;
@@ -941,7 +1702,7 @@ public:
         return offset;
     }
 
-    void placeForGPU(VulkanContext* ctx, VkDeviceMemory mem)
+    void placeForGPU(VulkanContext* ctx, VkDeviceMemory mem, VkCommandBuffer uploadCmdBuf)
     {
         /* bind memory */
         ThrowIfFailed(vk::BindImageMemory(ctx->m_dev, m_gpuTex, mem, m_gpuOffset));
@@ -968,7 +1729,7 @@ public:
 
         /* Since we're going to blit to the texture image, set its layout to
          * DESTINATION_OPTIMAL */
-        SetImageLayout(ctx->m_loadCmdBuf, m_gpuTex, VK_IMAGE_ASPECT_COLOR_BIT,
+        SetImageLayout(uploadCmdBuf, m_gpuTex, VK_IMAGE_ASPECT_COLOR_BIT,
                        VK_IMAGE_LAYOUT_UNDEFINED,
                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, m_mips, 1);
 
@@ -976,7 +1737,7 @@ public:
         size_t width = m_width;
         size_t height = m_height;
         size_t regionCount = std::min(size_t(16), m_mips);
-        size_t offset = 0;
+        size_t offset = m_staging.m_offset;
         for (int i=0 ; i<regionCount ; ++i)
         {
             size_t srcRowPitch = width * m_pixelPitchNum / m_pixelPitchDenom;
@@ -998,8 +1759,8 @@ public:
         }
 
         /* Put the copy command into the command buffer */
-        vk::CmdCopyBufferToImage(ctx->m_loadCmdBuf,
-                                 m_cpuBuf,
+        vk::CmdCopyBufferToImage(uploadCmdBuf,
+                                 m_staging.m_buf,
                                  m_gpuTex,
                                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                                  regionCount,
@@ -1007,7 +1768,7 @@ public:
 
         /* Set the layout for the texture image from DESTINATION_OPTIMAL to
          * SHADER_READ_ONLY */
-        SetImageLayout(ctx->m_loadCmdBuf, m_gpuTex, VK_IMAGE_ASPECT_COLOR_BIT,
+        SetImageLayout(uploadCmdBuf, m_gpuTex, VK_IMAGE_ASPECT_COLOR_BIT,
                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_mips, 1);
     }
@@ -1026,8 +1787,9 @@ class VulkanTextureSA : public ITextureSA
     int m_pixelPitchNum = 1;
     int m_pixelPitchDenom = 1;
 
-    VulkanTextureSA(VulkanContext* ctx, size_t width, size_t height, size_t layers,
-                   TextureFormat fmt, const void* data, size_t sz)
+    VulkanTextureSA(VulkanContext* ctx, VulkanUploadManager* uploader, VulkanUploadManager::Batch& batch,
+                    size_t width, size_t height, size_t layers,
+                    TextureFormat fmt, const void* data, size_t sz)
     : m_ctx(ctx), m_fmt(fmt), m_width(width), m_height(height), m_layers(layers), m_sz(sz)
     {
         VkFormat pfmt;
@@ -1045,37 +1807,8 @@ class VulkanTextureSA : public ITextureSA
         }
         m_vkFmt = pfmt;
 
-        /* create cpu image buffer */
-        VkBufferCreateInfo bufCreateInfo = {};
-        bufCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufCreateInfo.size = sz;
-        bufCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-        bufCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        ThrowIfFailed(vk::CreateBuffer(ctx->m_dev, &bufCreateInfo, nullptr, &m_cpuBuf));
-
-        VkMemoryRequirements memReqs;
-        vk::GetBufferMemoryRequirements(ctx->m_dev, m_cpuBuf, &memReqs);
-
-        VkMemoryAllocateInfo memAlloc = {};
-        memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        memAlloc.pNext = nullptr;
-        memAlloc.memoryTypeIndex = 0;
-        memAlloc.allocationSize = memReqs.size;
-        ThrowIfFalse(MemoryTypeFromProperties(ctx, memReqs.memoryTypeBits,
-                                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-                                              &memAlloc.memoryTypeIndex));
-
-        /* allocate memory */
-        ThrowIfFailed(vk::AllocateMemory(ctx->m_dev, &memAlloc, nullptr, &m_cpuMem));
-
-        /* bind memory */
-        ThrowIfFailed(vk::BindBufferMemory(ctx->m_dev, m_cpuBuf, m_cpuMem, 0));
-
-        /* map memory and copy data */
-        uint8_t* mappedData;
-        ThrowIfFailed(vk::MapMemory(ctx->m_dev, m_cpuMem, 0, memReqs.size, 0, reinterpret_cast<void**>(&mappedData)));
-        memmove(mappedData, data, sz);
-        vk::UnmapMemory(ctx->m_dev, m_cpuMem);
+        /* stage image data for the transaction's upload */
+        m_staging = uploader->stage(batch, data, sz);
 
         /* create gpu image */
         VkImageCreateInfo texCreateInfo = {};
@@ -1097,8 +1830,7 @@ class VulkanTextureSA : public ITextureSA
         m_descInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     }
 public:
-    VkBuffer m_cpuBuf;
-    VkDeviceMemory m_cpuMem;
+    VulkanUploadManager::Staging m_staging; /* Owned by the transaction's upload batch */
     VkImage m_gpuTex;
     VkImageView m_gpuView = VK_NULL_HANDLE;
     VkDescriptorImageInfo m_descInfo;
@@ -1107,25 +1839,14 @@ public:
     {
         vk::DestroyImageView(m_ctx->m_dev, m_gpuView, nullptr);
         vk::DestroyImage(m_ctx->m_dev, m_gpuTex, nullptr);
-        if (m_cpuBuf)
-            vk::DestroyBuffer(m_ctx->m_dev, m_cpuBuf, nullptr);
-        if (m_cpuMem)
-            vk::FreeMemory(m_ctx->m_dev, m_cpuMem, nullptr);
     }
 
-    void deleteUploadObjects()
-    {
-        vk::DestroyBuffer(m_ctx->m_dev, m_cpuBuf, nullptr);
-        m_cpuBuf = VK_NULL_HANDLE;
-        vk::FreeMemory(m_ctx->m_dev, m_cpuMem, nullptr);
-        m_cpuMem = VK_NULL_HANDLE;
-    }
-
-    VkDeviceSize sizeForGPU(VulkanContext* ctx, uint32_t& memTypeBits, VkDeviceSize offset)
+    VkDeviceSize sizeForGPU(VulkanContext* ctx, uint32_t& memTypeBits, VkDeviceSize& alignment, VkDeviceSize offset)
     {
         VkMemoryRequirements memReqs;
         vk::GetImageMemoryRequirements(ctx->m_dev, m_gpuTex, &memReqs);
         memTypeBits &= memReqs.memoryTypeBits;
+        alignment = std::max(alignment, memReqs.alignment);
 
         m_gpuOffset = offset;
         offset += memReqs.size;
@@ -1134,7 +1855,7 @@ public:
         return offset;
     }
 
-    void placeForGPU(VulkanContext* ctx, VkDeviceMemory mem)
+    void placeForGPU(VulkanContext* ctx, VkDeviceMemory mem, VkCommandBuffer uploadCmdBuf)
     {
         /* bind memory */
         ThrowIfFailed(vk::BindImageMemory(ctx->m_dev, m_gpuTex, mem, m_gpuOffset));
@@ -1161,7 +1882,7 @@ public:
 
         /* Since we're going to blit to the texture image, set its layout to
          * DESTINATION_OPTIMAL */
-        SetImageLayout(ctx->m_loadCmdBuf, m_gpuTex, VK_IMAGE_ASPECT_COLOR_BIT,
+        SetImageLayout(uploadCmdBuf, m_gpuTex, VK_IMAGE_ASPECT_COLOR_BIT,
                        VK_IMAGE_LAYOUT_UNDEFINED,
                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, m_layers);
 
@@ -1173,11 +1894,11 @@ public:
         copyRegion.imageExtent.width = m_width;
         copyRegion.imageExtent.height = m_height;
         copyRegion.imageExtent.depth = 1;
-        copyRegion.bufferOffset = 0;
+        copyRegion.bufferOffset = m_staging.m_offset;
 
         /* Put the copy command into the command buffer */
-        vk::CmdCopyBufferToImage(ctx->m_loadCmdBuf,
-                                 m_cpuBuf,
+        vk::CmdCopyBufferToImage(uploadCmdBuf,
+                                 m_staging.m_buf,
                                  m_gpuTex,
                                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                                  1,
@@ -1185,7 +1906,7 @@ public:
 
         /* Set the layout for the texture image from DESTINATION_OPTIMAL to
          * SHADER_READ_ONLY */
-        SetImageLayout(ctx->m_loadCmdBuf, m_gpuTex, VK_IMAGE_ASPECT_COLOR_BIT,
+        SetImageLayout(uploadCmdBuf, m_gpuTex, VK_IMAGE_ASPECT_COLOR_BIT,
                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1, m_layers);
     }
@@ -1205,11 +1926,13 @@ class VulkanTextureD : public ITextureD
     std::unique_ptr<uint8_t[]> m_stagingBuf;
     size_t m_cpuSz;
     VkDeviceSize m_srcRowPitch;
-    VkDeviceSize m_cpuOffsets[2];
+    VkDeviceSize m_cpuOffsets[VulkanContext::MaxFramesInFlight];
     VkFormat m_vkFmt;
+    size_t m_slotCount;
     int m_validSlots = 0;
+    bool m_dirty = false;
     VulkanTextureD(VulkanCommandQueue* q, VulkanContext* ctx, size_t width, size_t height, TextureFormat fmt)
-    : m_width(width), m_height(height), m_fmt(fmt), m_q(q)
+    : m_width(width), m_height(height), m_fmt(fmt), m_q(q), m_slotCount(ctx->m_framesInFlight)
     {
         VkFormat pfmt;
         switch (fmt)
@@ -1244,7 +1967,7 @@ class VulkanTextureD : public ITextureD
         memAlloc.memoryTypeIndex = 0;
         memAlloc.allocationSize = 0;
         uint32_t memTypeBits = ~0;
-        for (int i=0 ; i<2 ; ++i)
+        for (size_t i=0 ; i<m_slotCount ; ++i)
         {
             m_cpuOffsets[i] = memAlloc.allocationSize;
 
@@ -1284,7 +2007,7 @@ class VulkanTextureD : public ITextureD
         texCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
         texCreateInfo.flags = 0;
 
-        for (int i=0 ; i<2 ; ++i)
+        for (size_t i=0 ; i<m_slotCount ; ++i)
         {
             /* bind cpu memory */
             ThrowIfFailed(vk::BindBufferMemory(ctx->m_dev, m_cpuBuf[i], m_cpuMem, m_cpuOffsets[i]));
@@ -1298,25 +2021,26 @@ class VulkanTextureD : public ITextureD
     }
     void update(int b);
 public:
-    VkBuffer m_cpuBuf[2];
+    VkBuffer m_cpuBuf[VulkanContext::MaxFramesInFlight] = {};
     VkDeviceMemory m_cpuMem;
-    VkImage m_gpuTex[2];
-    VkImageView m_gpuView[2];
-    VkDeviceSize m_gpuOffset[2];
-    VkDescriptorImageInfo m_descInfo[2];
+    VkImage m_gpuTex[VulkanContext::MaxFramesInFlight] = {};
+    VkImageView m_gpuView[VulkanContext::MaxFramesInFlight] = {};
+    VkDeviceSize m_gpuOffset[VulkanContext::MaxFramesInFlight];
+    VkDescriptorImageInfo m_descInfo[VulkanContext::MaxFramesInFlight] = {};
     ~VulkanTextureD();
 
     void load(const void* data, size_t sz);
     void* map(size_t sz);
     void unmap();
 
-    VkDeviceSize sizeForGPU(VulkanContext* ctx, uint32_t& memTypeBits, VkDeviceSize offset)
+    VkDeviceSize sizeForGPU(VulkanContext* ctx, uint32_t& memTypeBits, VkDeviceSize& alignment, VkDeviceSize offset)
     {
-        for (int i=0 ; i<2 ; ++i)
+        for (size_t i=0 ; i<m_slotCount ; ++i)
         {
             VkMemoryRequirements memReqs;
             vk::GetImageMemoryRequirements(ctx->m_dev, m_gpuTex[i], &memReqs);
             memTypeBits &= memReqs.memoryTypeBits;
+            alignment = std::max(alignment, memReqs.alignment);
 
             m_gpuOffset[i] = offset;
             offset += memReqs.size;
@@ -1344,7 +2068,7 @@ public:
         viewInfo.subresourceRange.baseArrayLayer = 0;
         viewInfo.subresourceRange.layerCount = 1;
 
-        for (int i=0 ; i<2 ; ++i)
+        for (size_t i=0 ; i<m_slotCount ; ++i)
         {
             /* bind memory */
             ThrowIfFailed(vk::BindImageMemory(ctx->m_dev, m_gpuTex[i], mem, m_gpuOffset[i]));
@@ -1701,15 +2425,29 @@ class VulkanShaderPipeline : public IShaderPipeline
 {
     friend class VulkanDataFactory;
     VulkanContext* m_ctx;
-    VkPipelineCache m_pipelineCache;
+    const VulkanVertexFormat* m_vtxFmt;
+    BlendFactor m_srcFac;
+    BlendFactor m_dstFac;
+    Primitive m_prim;
+    bool m_depthTest;
+    bool m_depthWrite;
+    bool m_backfaceCulling;
+    std::shared_future<void> m_ready; /* Valid for pipelines built on the compile queue */
+    std::string m_buildError; /* Written by the compile queue before m_ready is set */
+    mutable std::atomic_bool m_errorReported = {false};
     VulkanShaderPipeline(VulkanContext* ctx,
-                         VkShaderModule vert,
-                         VkShaderModule frag,
-                         VkPipelineCache pipelineCache,
                          const VulkanVertexFormat* vtxFmt,
                          BlendFactor srcFac, BlendFactor dstFac, Primitive prim,
                          bool depthTest, bool depthWrite, bool backfaceCulling)
-    : m_ctx(ctx), m_pipelineCache(pipelineCache)
+    : m_ctx(ctx), m_vtxFmt(vtxFmt),
+      m_srcFac(srcFac), m_dstFac(dstFac), m_prim(prim), m_depthTest(depthTest),
+      m_depthWrite(depthWrite), m_backfaceCulling(backfaceCulling) {}
+
+    bool build(VulkanDataFactory& factory, const char* vertSource, const char* fragSource,
+               std::vector<unsigned int>& vertBlobOut, std::vector<unsigned int>& fragBlobOut,
+               const std::vector<unsigned char>& pipelineBlob, std::string& errorOut);
+
+    void createPipeline(VkShaderModule vert, VkShaderModule frag, VkPipelineCache pipelineCache)
     {
         VkDynamicState dynamicStateEnables[VK_DYNAMIC_STATE_RANGE_SIZE] = {};
         VkPipelineDynamicStateCreateInfo dynamicState = {};
@@ -1740,7 +2478,7 @@ class VulkanShaderPipeline : public IShaderPipeline
         assemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
         assemblyInfo.pNext = nullptr;
         assemblyInfo.flags = 0;
-        assemblyInfo.topology = PRIMITIVE_TABLE[int(prim)];
+        assemblyInfo.topology = PRIMITIVE_TABLE[int(m_prim)];
         assemblyInfo.primitiveRestartEnable = VK_FALSE;
 
         VkPipelineViewportStateCreateInfo viewportInfo = {};
@@ -1761,7 +2499,7 @@ class VulkanShaderPipeline : public IShaderPipeline
         rasterizationInfo.depthClampEnable = VK_FALSE;
         rasterizationInfo.rasterizerDiscardEnable = VK_FALSE;
         rasterizationInfo.polygonMode = VK_POLYGON_MODE_FILL;
-        rasterizationInfo.cullMode = backfaceCulling ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE;
+        rasterizationInfo.cullMode = m_backfaceCulling ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE;
         rasterizationInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
         rasterizationInfo.depthBiasEnable = VK_FALSE;
         rasterizationInfo.lineWidth = 1.f;
@@ -1776,16 +2514,16 @@ class VulkanShaderPipeline : public IShaderPipeline
         depthStencilInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
         depthStencilInfo.pNext = nullptr;
         depthStencilInfo.flags = 0;
-        depthStencilInfo.depthTestEnable = depthTest;
-        depthStencilInfo.depthWriteEnable = depthWrite;
+        depthStencilInfo.depthTestEnable = m_depthTest;
+        depthStencilInfo.depthWriteEnable = m_depthWrite;
         depthStencilInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
         depthStencilInfo.front.compareOp = VK_COMPARE_OP_ALWAYS;
         depthStencilInfo.back.compareOp = VK_COMPARE_OP_ALWAYS;
 
         VkPipelineColorBlendAttachmentState colorAttachment = {};
-        colorAttachment.blendEnable = dstFac != BlendFactor::Zero;
-        colorAttachment.srcColorBlendFactor = BLEND_FACTOR_TABLE[int(srcFac)];
-        colorAttachment.dstColorBlendFactor = BLEND_FACTOR_TABLE[int(dstFac)];
+        colorAttachment.blendEnable = m_dstFac != BlendFactor::Zero;
+        colorAttachment.srcColorBlendFactor = BLEND_FACTOR_TABLE[int(m_srcFac)];
+        colorAttachment.dstColorBlendFactor = BLEND_FACTOR_TABLE[int(m_dstFac)];
         colorAttachment.colorBlendOp = VK_BLEND_OP_ADD;
         colorAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
         colorAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
@@ -1806,7 +2544,7 @@ class VulkanShaderPipeline : public IShaderPipeline
         pipelineCreateInfo.flags = 0;
         pipelineCreateInfo.stageCount = 2;
         pipelineCreateInfo.pStages = stages;
-        pipelineCreateInfo.pVertexInputState = &vtxFmt->m_info;
+        pipelineCreateInfo.pVertexInputState = &m_vtxFmt->m_info;
         pipelineCreateInfo.pInputAssemblyState = &assemblyInfo;
         pipelineCreateInfo.pViewportState = &viewportInfo;
         pipelineCreateInfo.pRasterizationState = &rasterizationInfo;
@@ -1814,49 +2552,82 @@ class VulkanShaderPipeline : public IShaderPipeline
         pipelineCreateInfo.pDepthStencilState = &depthStencilInfo;
         pipelineCreateInfo.pColorBlendState = &colorBlendInfo;
         pipelineCreateInfo.pDynamicState = &dynamicState;
-        pipelineCreateInfo.layout = ctx->m_pipelinelayout;
-        pipelineCreateInfo.renderPass = ctx->m_pass;
+        pipelineCreateInfo.layout = m_ctx->m_pipelinelayout;
+        pipelineCreateInfo.renderPass = m_ctx->m_pass;
 
-        ThrowIfFailed(vk::CreateGraphicsPipelines(ctx->m_dev, pipelineCache, 1, &pipelineCreateInfo,
+        ThrowIfFailed(vk::CreateGraphicsPipelines(m_ctx->m_dev, pipelineCache, 1, &pipelineCreateInfo,
                                                   nullptr, &m_pipeline));
     }
 public:
-    VkPipeline m_pipeline;
+    VkPipeline m_pipeline = VK_NULL_HANDLE;
     ~VulkanShaderPipeline()
     {
+        waitReady();
         vk::DestroyPipeline(m_ctx->m_dev, m_pipeline, nullptr);
-        vk::DestroyPipelineCache(m_ctx->m_dev, m_pipelineCache, nullptr);
+    }
+    bool isReady() const
+    {
+        return !m_ready.valid() ||
+               m_ready.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+    void waitReady() const
+    {
+        if (m_ready.valid())
+            m_ready.wait();
+    }
+    /* Waits out a compile-queue build; a failed one is reported on the calling
+     * thread (once) and leaves no pipeline to bind */
+    bool finishBuild() const
+    {
+        waitReady();
+        if (m_pipeline != VK_NULL_HANDLE)
+            return true;
+        if (!m_errorReported.exchange(true))
+            Log.report(logvisor::Fatal, "%s", m_buildError.c_str());
+        return false;
     }
     VulkanShaderPipeline& operator=(const VulkanShaderPipeline&) = delete;
     VulkanShaderPipeline(const VulkanShaderPipeline&) = delete;
 };
 
+VulkanData::~VulkanData()
+{
+    /* Pipelines still compiling reference vertex formats destroyed ahead of them */
+    for (std::unique_ptr<VulkanShaderPipeline>& sp : m_SPs)
+        sp->waitReady();
+    m_allocator->free(m_bufAlloc);
+    m_allocator->free(m_sbufAlloc);
+    m_allocator->free(m_texAlloc);
+    m_descAllocator->release(m_descBatch);
+    m_uploader->release(m_uploadBatch);
+}
+
 static VkDeviceSize SizeBufferForGPU(IGraphicsBuffer* buf, VulkanContext* ctx,
-                                     uint32_t& memTypeBits, VkDeviceSize offset)
+                                     uint32_t& memTypeBits, VkDeviceSize& alignment, VkDeviceSize offset)
 {
     if (buf->dynamic())
-        return static_cast<VulkanGraphicsBufferD*>(buf)->sizeForGPU(ctx, memTypeBits, offset);
+        return static_cast<VulkanGraphicsBufferD*>(buf)->sizeForGPU(ctx, memTypeBits, alignment, offset);
     else
-        return static_cast<VulkanGraphicsBufferS*>(buf)->sizeForGPU(ctx, memTypeBits, offset);
+        return static_cast<VulkanGraphicsBufferS*>(buf)->sizeForGPU(ctx, memTypeBits, alignment, offset);
 }
 
 static VkDeviceSize SizeTextureForGPU(ITexture* tex, VulkanContext* ctx,
-                                      uint32_t& memTypeBits, VkDeviceSize offset)
+                                      uint32_t& memTypeBits, VkDeviceSize& alignment, VkDeviceSize offset)
 {
     switch (tex->type())
     {
     case TextureType::Dynamic:
-        return static_cast<VulkanTextureD*>(tex)->sizeForGPU(ctx, memTypeBits, offset);
+        return static_cast<VulkanTextureD*>(tex)->sizeForGPU(ctx, memTypeBits, alignment, offset);
     case TextureType::Static:
-        return static_cast<VulkanTextureS*>(tex)->sizeForGPU(ctx, memTypeBits, offset);
+        return static_cast<VulkanTextureS*>(tex)->sizeForGPU(ctx, memTypeBits, alignment, offset);
     case TextureType::StaticArray:
-        return static_cast<VulkanTextureSA*>(tex)->sizeForGPU(ctx, memTypeBits, offset);
+        return static_cast<VulkanTextureSA*>(tex)->sizeForGPU(ctx, memTypeBits, alignment, offset);
     default: break;
     }
     return offset;
 }
 
-static void PlaceTextureForGPU(ITexture* tex, VulkanContext* ctx, VkDeviceMemory mem)
+static void PlaceTextureForGPU(ITexture* tex, VulkanContext* ctx, VkDeviceMemory mem, VkCommandBuffer uploadCmdBuf)
 {
     switch (tex->type())
     {
@@ -1864,10 +2635,10 @@ static void PlaceTextureForGPU(ITexture* tex, VulkanContext* ctx, VkDeviceMemory
         static_cast<VulkanTextureD*>(tex)->placeForGPU(ctx, mem);
         break;
     case TextureType::Static:
-        static_cast<VulkanTextureS*>(tex)->placeForGPU(ctx, mem);
+        static_cast<VulkanTextureS*>(tex)->placeForGPU(ctx, mem, uploadCmdBuf);
         break;
     case TextureType::StaticArray:
-        static_cast<VulkanTextureSA*>(tex)->placeForGPU(ctx, mem);
+        static_cast<VulkanTextureSA*>(tex)->placeForGPU(ctx, mem, uploadCmdBuf);
         break;
     default: break;
     }
@@ -1925,18 +2696,19 @@ struct VulkanShaderDataBinding : IShaderDataBinding
     IGraphicsBuffer* m_ibuf;
     size_t m_ubufCount;
     std::unique_ptr<IGraphicsBuffer*[]> m_ubufs;
-    std::vector<std::array<VkDescriptorBufferInfo, 2>> m_ubufOffs;
+    std::vector<std::array<VkDescriptorBufferInfo, VulkanContext::MaxFramesInFlight>> m_ubufOffs;
     size_t m_texCount;
-    VkImageView m_knownViewHandles[2][8] = {};
+    VkImageView m_knownViewHandles[VulkanContext::MaxFramesInFlight][8] = {};
+    std::mutex m_knownViewMt; /* Command lists may bind from several threads */
     std::unique_ptr<ITexture*[]> m_texs;
 
-    VkBuffer m_vboBufs[2][2] = {{},{}};
-    VkDeviceSize m_vboOffs[2][2] = {{},{}};
-    VkBuffer m_iboBufs[2] = {};
-    VkDeviceSize m_iboOffs[2] = {};
+    VkBuffer m_vboBufs[VulkanContext::MaxFramesInFlight][2] = {};
+    VkDeviceSize m_vboOffs[VulkanContext::MaxFramesInFlight][2] = {};
+    VkBuffer m_iboBufs[VulkanContext::MaxFramesInFlight] = {};
+    VkDeviceSize m_iboOffs[VulkanContext::MaxFramesInFlight] = {};
 
-    VkDescriptorPool m_descPool = VK_NULL_HANDLE;
-    VkDescriptorSet m_descSets[2];
+    /* One set per frame slot; owned by the transaction's descriptor batch */
+    VkDescriptorSet m_descSets[VulkanContext::MaxFramesInFlight] = {};
 
 #ifndef NDEBUG
     /* Debugging aids */
@@ -1968,7 +2740,7 @@ struct VulkanShaderDataBinding : IShaderDataBinding
                 if (ubufOffs[i] % 256)
                     Log.report(logvisor::Fatal, "non-256-byte-aligned uniform-offset %d provided to newShaderDataBinding", int(i));
 #endif
-                std::array<VkDescriptorBufferInfo, 2> fillArr;
+                std::array<VkDescriptorBufferInfo, VulkanContext::MaxFramesInFlight> fillArr;
                 fillArr.fill({VK_NULL_HANDLE, ubufOffs[i], (ubufSizes[i] + 255) & ~255});
                 m_ubufOffs.push_back(fillArr);
             }
@@ -1983,47 +2755,16 @@ struct VulkanShaderDataBinding : IShaderDataBinding
         }
         for (size_t i=0 ; i<texCount ; ++i)
             m_texs[i] = texs[i];
-
-        size_t totalDescs = ubufCount + texCount;
-        if (totalDescs > 0)
-        {
-            VkDescriptorPoolSize poolSizes[2] = {};
-            VkDescriptorPoolCreateInfo descriptorPoolInfo = {};
-            descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-            descriptorPoolInfo.pNext = nullptr;
-            descriptorPoolInfo.maxSets = 2;
-            descriptorPoolInfo.poolSizeCount = 2;
-            descriptorPoolInfo.pPoolSizes = poolSizes;
-
-            poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            poolSizes[0].descriptorCount = BOO_GLSL_MAX_UNIFORM_COUNT * 2;
-
-            poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            poolSizes[1].descriptorCount = BOO_GLSL_MAX_TEXTURE_COUNT * 2;
-
-            ThrowIfFailed(vk::CreateDescriptorPool(ctx->m_dev, &descriptorPoolInfo, nullptr, &m_descPool));
-
-            VkDescriptorSetLayout layouts[] = {ctx->m_descSetLayout, ctx->m_descSetLayout};
-            VkDescriptorSetAllocateInfo descAllocInfo;
-            descAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-            descAllocInfo.pNext = nullptr;
-            descAllocInfo.descriptorPool = m_descPool;
-            descAllocInfo.descriptorSetCount = 2;
-            descAllocInfo.pSetLayouts = layouts;
-            ThrowIfFailed(vk::AllocateDescriptorSets(ctx->m_dev, &descAllocInfo, m_descSets));
-        }
     }
 
-    ~VulkanShaderDataBinding()
-    {
-        vk::DestroyDescriptorPool(m_ctx->m_dev, m_descPool, nullptr);
-    }
+    bool needsDescriptorSets() const {return m_ubufCount + m_texCount > 0;}
 
     void commit(VulkanContext* ctx)
     {
-        VkWriteDescriptorSet writes[(BOO_GLSL_MAX_UNIFORM_COUNT + BOO_GLSL_MAX_TEXTURE_COUNT) * 2] = {};
+        VkWriteDescriptorSet writes[(BOO_GLSL_MAX_UNIFORM_COUNT + BOO_GLSL_MAX_TEXTURE_COUNT) *
+                                    VulkanContext::MaxFramesInFlight] = {};
         size_t totalWrites = 0;
-        for (int b=0 ; b<2 ; ++b)
+        for (int b=0 ; b<int(ctx->m_framesInFlight) ; ++b)
         {
             if (m_vbuf)
             {
@@ -2126,6 +2867,7 @@ struct VulkanShaderDataBinding : IShaderDataBinding
 #endif
 
         /* Ensure resized texture bindings are re-bound */
+        std::unique_lock<std::mutex> lk(m_knownViewMt);
         size_t binding = BOO_GLSL_MAX_UNIFORM_COUNT;
         VkWriteDescriptorSet writes[BOO_GLSL_MAX_TEXTURE_COUNT] = {};
         size_t totalWrites = 0;
@@ -2152,7 +2894,10 @@ struct VulkanShaderDataBinding : IShaderDataBinding
         }
         if (totalWrites)
             vk::UpdateDescriptorSets(m_ctx->m_dev, totalWrites, writes, 0, nullptr);
+        lk.unlock();
 
+        if (!m_pipeline->finishBuild())
+            return;
         vk::CmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline->m_pipeline);
         vk::CmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_ctx->m_pipelinelayout, 0, 1, &m_descSets[b], 0, nullptr);
 
@@ -2168,102 +2913,386 @@ struct VulkanShaderDataBinding : IShaderDataBinding
     }
 };
 
+/* Whether the 8-bit components of fmt are laid out blue first, whatever the encoding */
+static bool IsBGRAFormat(VkFormat fmt)
+{
+    switch (fmt)
+    {
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SNORM:
+    case VK_FORMAT_B8G8R8A8_USCALED:
+    case VK_FORMAT_B8G8R8A8_SSCALED:
+    case VK_FORMAT_B8G8R8A8_UINT:
+    case VK_FORMAT_B8G8R8A8_SINT:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+        return true;
+    default:
+        return false;
+    }
+}
+
 struct VulkanCommandQueue : IGraphicsCommandQueue
 {
     Platform platform() const {return IGraphicsDataFactory::Platform::Vulkan;}
     const SystemChar* platformName() const {return _S("Vulkan");}
     VulkanContext* m_ctx;
-    VulkanContext::Window* m_windowCtx;
+    VulkanContext::Window* m_windowCtx; /* Null on headless devices */
     IGraphicsContext* m_parent;
 
-    VkCommandPool m_cmdPool;
-    VkCommandBuffer m_cmdBufs[2];
+    /* Headless only: resolveDisplay() reads the source back to this instead */
+    ReadbackFunc m_displayReadback;
+    bool m_displayResolved = false;
+
+    /* Per-frame slots; a slot is recycled once its fence signals */
+    size_t m_frameCount;
+    VkCommandPool m_cmdPools[VulkanContext::MaxFramesInFlight] = {};
+    VkCommandBuffer m_cmdBufs[VulkanContext::MaxFramesInFlight] = {};
+    VkCommandBuffer m_dynamicCmdBufs[VulkanContext::MaxFramesInFlight] = {};
+    VkFence m_frameFences[VulkanContext::MaxFramesInFlight] = {};
+    uint64_t m_frameSerials[VulkanContext::MaxFramesInFlight] = {};
+    uint64_t m_submitSerial = 0;
+    uint64_t m_completedSerial = 0;
     VkSemaphore m_swapChainReadySem = VK_NULL_HANDLE;
     VkSemaphore m_drawCompleteSem = VK_NULL_HANDLE;
-    VkFence m_drawCompleteFence;
 
-    VkCommandPool m_dynamicCmdPool;
-    VkCommandBuffer m_dynamicCmdBufs[2];
-    VkFence m_dynamicBufFence;
+    /* Dynamic resources touched by load()/unmap() since their last full upload;
+     * execute() stages only these instead of every committed resource */
+    std::mutex m_dirtyMt;
+    std::unordered_set<VulkanGraphicsBufferD*> m_dirtyBufs;
+    std::unordered_set<VulkanTextureD*> m_dirtyTexs;
+
+    FrameCounters m_frameCounters;
+    size_t m_throttledFrames = 0;
+    PacingMode m_pacingMode = PacingMode::Throughput;
+
+    uint64_t m_recordStart = 0;
+    FrameStatsRing<FrameStats> m_frameStats;
+
+    /* GPU timing: each slot's marks are stamped into its own query pool (created
+     * on first use) and read back when the slot is recycled, after its fence */
+    bool m_gpuTiming = false;
+    bool m_timerActive[VulkanContext::MaxFramesInFlight] = {};
+    VkQueryPool m_timerPools[VulkanContext::MaxFramesInFlight] = {};
+    GPUTimerMarks m_timerMarks[VulkanContext::MaxFramesInFlight];
+    std::vector<uint64_t> m_timerStamps;
+
+    /* Newest resolved GPU timings, read by any thread */
+    mutable std::mutex m_gpuTimingsMt;
+    GPUFrameTimings m_gpuTimings;
+    bool m_hasGPUTimings = false;
 
     bool m_running = true;
-    bool m_dynamicNeedsReset = false;
-    bool m_submitted = false;
 
     size_t m_fillBuf = 0;
     size_t m_drawBuf = 0;
 
-    void resetCommandBuffer()
+    /* Readbacks land in persistently-mapped host buffers; an entry is recorded
+     * into the fill slot, in flight until its frame serial completes, then idle */
+    struct Readback
     {
-        ThrowIfFailed(vk::ResetCommandBuffer(m_cmdBufs[m_fillBuf], 0));
+        VkBuffer m_buf = VK_NULL_HANDLE;
+        VkDeviceMemory m_mem = VK_NULL_HANDLE;
+        uint8_t* m_mapped = nullptr;
+        VkDeviceSize m_capacity = 0;
+        bool m_coherent = true;
+        VkImage m_resolveImg = VK_NULL_HANDLE; /* Single-sample copy of MSAA sources */
+        VkDeviceMemory m_resolveMem = VK_NULL_HANDLE;
+        size_t m_resolveWidth = 0;
+        size_t m_resolveHeight = 0;
+        size_t m_width = 0;
+        size_t m_height = 0;
+        uint64_t m_serial = 0;
+        ReadbackFunc m_func;
+    };
+    std::vector<Readback> m_recordedReadbacks;
+    std::deque<Readback> m_readbacks;
+    std::vector<Readback> m_idleReadbacks;
+
+    void reserveReadback(Readback& rb, VkDeviceSize size)
+    {
+        if (rb.m_capacity >= size)
+            return;
+        if (rb.m_buf)
+        {
+            vk::DestroyBuffer(m_ctx->m_dev, rb.m_buf, nullptr);
+            vk::FreeMemory(m_ctx->m_dev, rb.m_mem, nullptr);
+        }
+
+        VkBufferCreateInfo bufInfo = {};
+        bufInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufInfo.size = size;
+        bufInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        ThrowIfFailed(vk::CreateBuffer(m_ctx->m_dev, &bufInfo, nullptr, &rb.m_buf));
+
+        VkMemoryRequirements memReqs;
+        vk::GetBufferMemoryRequirements(m_ctx->m_dev, rb.m_buf, &memReqs);
+        VkMemoryAllocateInfo memAlloc = {};
+        memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        memAlloc.allocationSize = memReqs.size;
+
+        /* Cached memory keeps CPU reads fast; fall back to plain coherent memory */
+        if (!MemoryTypeFromProperties(m_ctx, memReqs.memoryTypeBits,
+                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                                      &memAlloc.memoryTypeIndex))
+            ThrowIfFalse(MemoryTypeFromProperties(m_ctx, memReqs.memoryTypeBits,
+                                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                  &memAlloc.memoryTypeIndex));
+        rb.m_coherent = (m_ctx->m_memoryProperties.memoryTypes[memAlloc.memoryTypeIndex].propertyFlags &
+                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+        ThrowIfFailed(vk::AllocateMemory(m_ctx->m_dev, &memAlloc, nullptr, &rb.m_mem));
+        ThrowIfFailed(vk::BindBufferMemory(m_ctx->m_dev, rb.m_buf, rb.m_mem, 0));
+        ThrowIfFailed(vk::MapMemory(m_ctx->m_dev, rb.m_mem, 0, VK_WHOLE_SIZE, 0,
+                                    reinterpret_cast<void**>(&rb.m_mapped)));
+        rb.m_capacity = size;
+    }
+
+    void reserveResolveImage(Readback& rb, size_t width, size_t height)
+    {
+        if (rb.m_resolveImg && rb.m_resolveWidth >= width && rb.m_resolveHeight >= height)
+            return;
+        if (rb.m_resolveImg)
+        {
+            width = std::max(width, rb.m_resolveWidth);
+            height = std::max(height, rb.m_resolveHeight);
+            vk::DestroyImage(m_ctx->m_dev, rb.m_resolveImg, nullptr);
+            vk::FreeMemory(m_ctx->m_dev, rb.m_resolveMem, nullptr);
+        }
+
+        VkImageCreateInfo imgInfo = {};
+        imgInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imgInfo.imageType = VK_IMAGE_TYPE_2D;
+        imgInfo.format = m_ctx->m_displayFormat;
+        imgInfo.extent.width = width;
+        imgInfo.extent.height = height;
+        imgInfo.extent.depth = 1;
+        imgInfo.mipLevels = 1;
+        imgInfo.arrayLayers = 1;
+        imgInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imgInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imgInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imgInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imgInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        ThrowIfFailed(vk::CreateImage(m_ctx->m_dev, &imgInfo, nullptr, &rb.m_resolveImg));
+
+        VkMemoryRequirements memReqs;
+        vk::GetImageMemoryRequirements(m_ctx->m_dev, rb.m_resolveImg, &memReqs);
+        VkMemoryAllocateInfo memAlloc = {};
+        memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        memAlloc.allocationSize = memReqs.size;
+        ThrowIfFalse(MemoryTypeFromProperties(m_ctx, memReqs.memoryTypeBits,
+                                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                              &memAlloc.memoryTypeIndex));
+        ThrowIfFailed(vk::AllocateMemory(m_ctx->m_dev, &memAlloc, nullptr, &rb.m_resolveMem));
+        ThrowIfFailed(vk::BindImageMemory(m_ctx->m_dev, rb.m_resolveImg, rb.m_resolveMem, 0));
+        rb.m_resolveWidth = width;
+        rb.m_resolveHeight = height;
+    }
+
+    void destroyReadback(Readback& rb)
+    {
+        /* Freeing mapped memory implicitly unmaps it */
+        if (rb.m_buf)
+        {
+            vk::DestroyBuffer(m_ctx->m_dev, rb.m_buf, nullptr);
+            vk::FreeMemory(m_ctx->m_dev, rb.m_mem, nullptr);
+        }
+        if (rb.m_resolveImg)
+        {
+            vk::DestroyImage(m_ctx->m_dev, rb.m_resolveImg, nullptr);
+            vk::FreeMemory(m_ctx->m_dev, rb.m_resolveMem, nullptr);
+        }
+    }
+
+    /* Deliver every readback whose frame has retired; never waits on the GPU */
+    void pollReadbacks()
+    {
+        if (m_readbacks.empty())
+            return;
+        for (size_t i=0 ; i<m_frameCount ; ++i)
+            if (m_frameSerials[i] > m_completedSerial &&
+                vk::GetFenceStatus(m_ctx->m_dev, m_frameFences[i]) == VK_SUCCESS)
+                m_completedSerial = std::max(m_completedSerial, m_frameSerials[i]);
+
+        while (m_readbacks.size() && m_readbacks.front().m_serial <= m_completedSerial)
+        {
+            Readback& rb = m_readbacks.front();
+            if (!rb.m_width)
+            {
+                ReadbackData data = {nullptr, 0, 0, 0, false};
+                rb.m_func(data);
+                rb.m_func = {};
+                m_idleReadbacks.push_back(std::move(rb));
+                m_readbacks.pop_front();
+                continue;
+            }
+            if (!rb.m_coherent)
+            {
+                VkMappedMemoryRange range = {};
+                range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+                range.memory = rb.m_mem;
+                range.offset = 0;
+                range.size = VK_WHOLE_SIZE;
+                ThrowIfFailed(vk::InvalidateMappedMemoryRanges(m_ctx->m_dev, 1, &range));
+            }
+
+            /* Rows were copied top-down; hand out the bottom one with a negative pitch */
+            ptrdiff_t pitch = ptrdiff_t(rb.m_width * 4);
+            ReadbackData data;
+            data.pixels = rb.m_mapped + pitch * ptrdiff_t(rb.m_height - 1);
+            data.rowPitch = -pitch;
+            data.width = rb.m_width;
+            data.height = rb.m_height;
+            data.bgra = IsBGRAFormat(m_ctx->m_displayFormat);
+            rb.m_func(data);
+
+            rb.m_func = {};
+            m_idleReadbacks.push_back(std::move(rb));
+            m_readbacks.pop_front();
+        }
+    }
+
+    /* Reset the slot's pool and open both of its primary buffers for recording */
+    void beginFrame(size_t slot)
+    {
+        ThrowIfFailed(vk::ResetCommandPool(m_ctx->m_dev, m_cmdPools[slot], 0));
         VkCommandBufferBeginInfo cmdBufBeginInfo = {};
         cmdBufBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        cmdBufBeginInfo.flags = 0;
-        ThrowIfFailed(vk::BeginCommandBuffer(m_cmdBufs[m_fillBuf], &cmdBufBeginInfo));
+        cmdBufBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        ThrowIfFailed(vk::BeginCommandBuffer(m_cmdBufs[slot], &cmdBufBeginInfo));
+        ThrowIfFailed(vk::BeginCommandBuffer(m_dynamicCmdBufs[slot], &cmdBufBeginInfo));
+
+        m_timerActive[slot] = m_gpuTiming &&
+            m_ctx->m_queueProps[m_ctx->m_graphicsQueueFamilyIndex].timestampValidBits;
+        if (m_timerActive[slot])
+            beginTimerFrame(slot);
+    }
+
+    /* The pool is reset from the dynamic buffer, which is submitted ahead of the draws */
+    void beginTimerFrame(size_t slot)
+    {
+        GPUTimerMarks& marks = m_timerMarks[slot];
+        if (!m_timerPools[slot])
+        {
+            VkQueryPoolCreateInfo poolInfo = {};
+            poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            poolInfo.queryCount = marks.maxMarks();
+            ThrowIfFailed(vk::CreateQueryPool(m_ctx->m_dev, &poolInfo, nullptr, &m_timerPools[slot]));
+        }
+        vk::CmdResetQueryPool(m_dynamicCmdBufs[slot], m_timerPools[slot], 0, marks.maxMarks());
+        stampTimer(slot, marks.beginFrame(m_submitSerial + 1, nullptr));
+    }
+
+    void stampTimer(size_t slot, int idx)
+    {
+        if (idx >= 0)
+            vk::CmdWriteTimestamp(m_cmdBufs[slot], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                  m_timerPools[slot], uint32_t(idx));
+    }
+
+    /* Called once the slot's fence has signalled, so results are ready without waiting */
+    void collectTimers(size_t slot)
+    {
+        GPUTimerMarks& marks = m_timerMarks[slot];
+        if (!m_timerActive[slot] || !marks.ended())
+            return;
+        m_timerActive[slot] = false;
+
+        uint32_t count = marks.count();
+        m_timerStamps.resize(count);
+        if (vk::GetQueryPoolResults(m_ctx->m_dev, m_timerPools[slot], 0, count, count * sizeof(uint64_t),
+                                    m_timerStamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+            return;
+
+        /* Ticks to nanoseconds from the frame start, honoring the counter width */
+        uint32_t validBits = m_ctx->m_queueProps[m_ctx->m_graphicsQueueFamilyIndex].timestampValidBits;
+        uint64_t mask = validBits >= 64 ? ~uint64_t(0) : (uint64_t(1) << validBits) - 1;
+        double period = m_ctx->m_gpuProps.limits.timestampPeriod;
+        uint64_t base = m_timerStamps[0];
+        for (uint64_t& stamp : m_timerStamps)
+            stamp = uint64_t(double((stamp - base) & mask) * period);
+
+        std::unique_lock<std::mutex> lk(m_gpuTimingsMt);
+        marks.resolve(m_timerStamps.data(), m_gpuTimings);
+        m_hasGPUTimings = true;
     }
 
-    void resetDynamicCommandBuffer()
+    /* Re-open only the draw buffer of the fill slot; staged dynamic uploads are kept */
+    void resetCommandBuffer()
     {
-        ThrowIfFailed(vk::ResetCommandBuffer(m_dynamicCmdBufs[m_fillBuf], 0));
+        ThrowIfFailed(vk::ResetCommandBuffer(m_cmdBufs[m_fillBuf], 0));
         VkCommandBufferBeginInfo cmdBufBeginInfo = {};
         cmdBufBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        cmdBufBeginInfo.flags = 0;
-        ThrowIfFailed(vk::BeginCommandBuffer(m_dynamicCmdBufs[m_fillBuf], &cmdBufBeginInfo));
-        m_dynamicNeedsReset = false;
+        cmdBufBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        ThrowIfFailed(vk::BeginCommandBuffer(m_cmdBufs[m_fillBuf], &cmdBufBeginInfo));
     }
 
-    void stallDynamicUpload()
+    /* Block until the frame last submitted from slot has retired. Waits are
+     * bounded so a hung GPU is reported instead of silently stalling */
+    void waitFrame(size_t slot)
     {
-        if (m_dynamicNeedsReset)
+        uint64_t serial = m_frameSerials[slot];
+        if (serial <= m_completedSerial)
+            return;
+        if (vk::GetFenceStatus(m_ctx->m_dev, m_frameFences[slot]) == VK_NOT_READY)
         {
-            ThrowIfFailed(vk::WaitForFences(m_ctx->m_dev, 1, &m_dynamicBufFence, VK_FALSE, -1));
-            resetDynamicCommandBuffer();
+            ++m_throttledFrames;
+            VkResult res;
+            while ((res = vk::WaitForFences(m_ctx->m_dev, 1, &m_frameFences[slot],
+                                            VK_TRUE, 1000000000)) == VK_TIMEOUT)
+                Log.report(logvisor::Warning, "GPU has not retired frame %llu after 1s", (unsigned long long)serial);
+            ThrowIfFailed(res);
         }
+        m_completedSerial = std::max(m_completedSerial, serial);
+    }
+
+    void waitAllFrames()
+    {
+        for (size_t i=0 ; i<m_frameCount ; ++i)
+            waitFrame(i);
     }
 
     VulkanCommandQueue(VulkanContext* ctx, VulkanContext::Window* windowCtx, IGraphicsContext* parent)
-    : m_ctx(ctx), m_windowCtx(windowCtx), m_parent(parent)
+    : m_ctx(ctx), m_windowCtx(windowCtx), m_parent(parent), m_frameCount(ctx->m_framesInFlight)
     {
         VkCommandPoolCreateInfo poolInfo = {};
         poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT |
+                         VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
         poolInfo.queueFamilyIndex = m_ctx->m_graphicsQueueFamilyIndex;
-        ThrowIfFailed(vk::CreateCommandPool(ctx->m_dev, &poolInfo, nullptr, &m_cmdPool));
-        ThrowIfFailed(vk::CreateCommandPool(ctx->m_dev, &poolInfo, nullptr, &m_dynamicCmdPool));
 
         VkCommandBufferAllocateInfo allocInfo = {};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.commandPool = m_cmdPool;
         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandBufferCount = 2;
-
-        VkCommandBufferBeginInfo cmdBufBeginInfo = {};
-        cmdBufBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        cmdBufBeginInfo.flags = 0;
+        allocInfo.commandBufferCount = 1;
 
-        ThrowIfFailed(vk::AllocateCommandBuffers(m_ctx->m_dev, &allocInfo, m_cmdBufs));
-        ThrowIfFailed(vk::BeginCommandBuffer(m_cmdBufs[0], &cmdBufBeginInfo));
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-        allocInfo.commandPool = m_dynamicCmdPool;
-        ThrowIfFailed(vk::AllocateCommandBuffers(m_ctx->m_dev, &allocInfo, m_dynamicCmdBufs));
-        ThrowIfFailed(vk::BeginCommandBuffer(m_dynamicCmdBufs[0], &cmdBufBeginInfo));
+        for (size_t i=0 ; i<m_frameCount ; ++i)
+        {
+            ThrowIfFailed(vk::CreateCommandPool(ctx->m_dev, &poolInfo, nullptr, &m_cmdPools[i]));
+            allocInfo.commandPool = m_cmdPools[i];
+            ThrowIfFailed(vk::AllocateCommandBuffers(m_ctx->m_dev, &allocInfo, &m_cmdBufs[i]));
+            ThrowIfFailed(vk::AllocateCommandBuffers(m_ctx->m_dev, &allocInfo, &m_dynamicCmdBufs[i]));
+            ThrowIfFailed(vk::CreateFence(m_ctx->m_dev, &fenceInfo, nullptr, &m_frameFences[i]));
+        }
+        beginFrame(0);
+        m_recordStart = FrameStatsNow();
 
         VkSemaphoreCreateInfo semInfo = {};
         semInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
         ThrowIfFailed(vk::CreateSemaphore(ctx->m_dev, &semInfo, nullptr, &m_swapChainReadySem));
         ThrowIfFailed(vk::CreateSemaphore(ctx->m_dev, &semInfo, nullptr, &m_drawCompleteSem));
-
-        VkFenceCreateInfo fenceInfo = {};
-        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-        ThrowIfFailed(vk::CreateFence(m_ctx->m_dev, &fenceInfo, nullptr, &m_drawCompleteFence));
-        ThrowIfFailed(vk::CreateFence(m_ctx->m_dev, &fenceInfo, nullptr, &m_dynamicBufFence));
     }
 
     void stopRenderer()
     {
         m_running = false;
-        vk::WaitForFences(m_ctx->m_dev, 1, &m_drawCompleteFence, VK_FALSE, -1);
+        vk::WaitForFences(m_ctx->m_dev, m_frameCount, m_frameFences, VK_TRUE, -1);
     }
 
     ~VulkanCommandQueue()
@@ -2271,12 +3300,55 @@ struct VulkanCommandQueue : IGraphicsCommandQueue
         if (m_running)
             stopRenderer();
 
-        vk::DestroyFence(m_ctx->m_dev, m_dynamicBufFence, nullptr);
-        vk::DestroyFence(m_ctx->m_dev, m_drawCompleteFence, nullptr);
+        /* Pending readbacks never fire once the queue is torn down */
+        for (Readback& rb : m_recordedReadbacks)
+            destroyReadback(rb);
+        for (Readback& rb : m_readbacks)
+            destroyReadback(rb);
+        for (Readback& rb : m_idleReadbacks)
+            destroyReadback(rb);
+
         vk::DestroySemaphore(m_ctx->m_dev, m_drawCompleteSem, nullptr);
         vk::DestroySemaphore(m_ctx->m_dev, m_swapChainReadySem, nullptr);
-        vk::DestroyCommandPool(m_ctx->m_dev, m_dynamicCmdPool, nullptr);
-        vk::DestroyCommandPool(m_ctx->m_dev, m_cmdPool, nullptr);
+        for (size_t i=0 ; i<m_frameCount ; ++i)
+        {
+            vk::DestroyFence(m_ctx->m_dev, m_frameFences[i], nullptr);
+            vk::DestroyCommandPool(m_ctx->m_dev, m_cmdPools[i], nullptr);
+            if (m_timerPools[i])
+                vk::DestroyQueryPool(m_ctx->m_dev, m_timerPools[i], nullptr);
+        }
+    }
+
+    void setPacingMode(PacingMode mode) {m_pacingMode = mode;}
+    PacingMode pacingMode() const {return m_pacingMode;}
+
+    size_t getFrameStats(FrameStats* out, size_t maxCount) const
+    {
+        return m_frameStats.copy(out, maxCount);
+    }
+
+    void setGPUTimingEnabled(bool enabled) {m_gpuTiming = enabled;}
+    bool gpuTimingEnabled() const {return m_gpuTiming;}
+
+    void beginTimer(const char* name)
+    {
+        if (m_timerActive[m_fillBuf])
+            stampTimer(m_fillBuf, m_timerMarks[m_fillBuf].beginScope(name));
+    }
+
+    void endTimer()
+    {
+        if (m_timerActive[m_fillBuf])
+            stampTimer(m_fillBuf, m_timerMarks[m_fillBuf].endScope());
+    }
+
+    bool getGPUTimings(GPUFrameTimings& out) const
+    {
+        std::unique_lock<std::mutex> lk(m_gpuTimingsMt);
+        if (!m_hasGPUTimings)
+            return false;
+        out = m_gpuTimings;
+        return true;
     }
 
     void setShaderDataBinding(IShaderDataBinding* binding)
@@ -2290,6 +3362,8 @@ struct VulkanCommandQueue : IGraphicsCommandQueue
     {
         VulkanTextureR* ctarget = static_cast<VulkanTextureR*>(target);
         VkCommandBuffer cmdBuf = m_cmdBufs[m_fillBuf];
+        if (m_timerActive[m_fillBuf])
+            stampTimer(m_fillBuf, m_timerMarks[m_fillBuf].target(ctarget));
 
         if (m_boundTarget != target)
         {
@@ -2398,32 +3472,85 @@ struct VulkanCommandQueue : IGraphicsCommandQueue
     void draw(size_t start, size_t count)
     {
         vk::CmdDraw(m_cmdBufs[m_fillBuf], count, 1, start, 0);
+        m_timerMarks[m_fillBuf].countDraws();
     }
 
     void drawIndexed(size_t start, size_t count)
     {
         vk::CmdDrawIndexed(m_cmdBufs[m_fillBuf], count, 1, start, 0, 0);
+        m_timerMarks[m_fillBuf].countDraws();
     }
 
     void drawInstances(size_t start, size_t count, size_t instCount)
     {
         vk::CmdDraw(m_cmdBufs[m_fillBuf], count, instCount, start, 0);
+        m_timerMarks[m_fillBuf].countDraws();
     }
 
     void drawInstancesIndexed(size_t start, size_t count, size_t instCount)
     {
         vk::CmdDrawIndexed(m_cmdBufs[m_fillBuf], count, instCount, start, 0, 0);
+        m_timerMarks[m_fillBuf].countDraws();
+    }
+
+    void _drawIndirect(IGraphicsBuffer* buf, size_t offset, size_t drawCount, bool indexed)
+    {
+        VkBuffer vkbuf;
+        if (buf->dynamic())
+            vkbuf = static_cast<VulkanGraphicsBufferD*>(buf)->m_bufferInfo[m_fillBuf].buffer;
+        else
+            vkbuf = static_cast<VulkanGraphicsBufferS*>(buf)->m_bufferInfo.buffer;
+
+        VkCommandBuffer cmdBuf = m_cmdBufs[m_fillBuf];
+        uint32_t stride = indexed ? sizeof(DrawIndexedIndirectArgs) : sizeof(DrawIndirectArgs);
+        m_timerMarks[m_fillBuf].countDraws(drawCount);
+        if (drawCount > 1 && !m_ctx->m_features.multiDrawIndirect)
+        {
+            /* Without the feature each draw must be issued separately */
+            for (size_t i=0 ; i<drawCount ; ++i, offset += stride)
+            {
+                if (indexed)
+                    vk::CmdDrawIndexedIndirect(cmdBuf, vkbuf, offset, 1, stride);
+                else
+                    vk::CmdDrawIndirect(cmdBuf, vkbuf, offset, 1, stride);
+            }
+            return;
+        }
+        if (indexed)
+            vk::CmdDrawIndexedIndirect(cmdBuf, vkbuf, offset, drawCount, stride);
+        else
+            vk::CmdDrawIndirect(cmdBuf, vkbuf, offset, drawCount, stride);
+    }
+
+    void drawIndirect(IGraphicsBuffer* buf, size_t offset, size_t drawCount)
+    {
+        _drawIndirect(buf, offset, drawCount, false);
+    }
+
+    void drawIndexedIndirect(IGraphicsBuffer* buf, size_t offset, size_t drawCount)
+    {
+        _drawIndirect(buf, offset, drawCount, true);
     }
 
     ITextureR* m_resolveDispSource = nullptr;
     void resolveDisplay(ITextureR* source)
     {
+        if (!m_windowCtx)
+        {
+            /* No swapchain; the frame counts as presented either way */
+            VulkanTextureR* csource = static_cast<VulkanTextureR*>(source);
+            if (m_displayReadback)
+                readback(source, SWindowRect(0, 0, csource->m_width, csource->m_height),
+                         ReadbackFunc(m_displayReadback));
+            m_displayResolved = true;
+            return;
+        }
         m_resolveDispSource = source;
     }
 
     bool _resolveDisplay()
     {
-        if (!m_resolveDispSource)
+        if (!m_resolveDispSource || !m_windowCtx)
             return false;
         VulkanContext::Window::SwapChain& sc = m_windowCtx->m_swapChains[m_windowCtx->m_activeSwapChain];
         if (!sc.m_swapChain)
@@ -2547,45 +3674,340 @@ struct VulkanCommandQueue : IGraphicsCommandQueue
                 SetImageLayout(cmdBuf, ctexture->m_depthTex, VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,
                                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 1, 1);
 
-            SetImageLayout(cmdBuf, ctexture->m_depthBindTex, VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,
-                           VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, 1);
+            SetImageLayout(cmdBuf, ctexture->m_depthBindTex, VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,
+                           VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, 1);
+
+            copyInfo.srcSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+            copyInfo.dstSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+
+            vk::CmdCopyImage(cmdBuf,
+                             ctexture->m_depthTex, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                             ctexture->m_depthBindTex, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                             1, &copyInfo);
+
+            if (ctexture == m_boundTarget)
+                SetImageLayout(cmdBuf, ctexture->m_depthTex, VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,
+                               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1, 1);
+
+            SetImageLayout(cmdBuf, ctexture->m_depthBindTex, VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1, 1);
+        }
+
+        vk::CmdBeginRenderPass(cmdBuf, &m_boundTarget->m_passBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    }
+
+    void readback(ITextureR* texture, const SWindowRect& rect, ReadbackFunc&& callback)
+    {
+        VulkanTextureR* ctexture = static_cast<VulkanTextureR*>(texture);
+        bool bound = ctexture == m_boundTarget;
+        SWindowRect intersectRect = rect.intersect(SWindowRect(0, 0, ctexture->m_width, ctexture->m_height));
+
+        Readback rb;
+        if (m_idleReadbacks.size())
+        {
+            rb = std::move(m_idleReadbacks.back());
+            m_idleReadbacks.pop_back();
+        }
+
+        /* Never rendered to, or nothing to copy: fires with empty data alongside the frame */
+        if ((!bound && ctexture->m_layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) ||
+            intersectRect.size[0] <= 0 || intersectRect.size[1] <= 0)
+        {
+            rb.m_width = 0;
+            rb.m_height = 0;
+            rb.m_func = std::move(callback);
+            m_recordedReadbacks.push_back(std::move(rb));
+            return;
+        }
+
+        rb.m_width = intersectRect.size[0];
+        rb.m_height = intersectRect.size[1];
+        rb.m_func = std::move(callback);
+        reserveReadback(rb, rb.m_width * rb.m_height * 4);
+
+        VkCommandBuffer cmdBuf = m_cmdBufs[m_fillBuf];
+        if (m_boundTarget)
+            vk::CmdEndRenderPass(cmdBuf);
+        if (bound)
+            SetImageLayout(cmdBuf, ctexture->m_colorTex, VK_IMAGE_ASPECT_COLOR_BIT,
+                           VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 1, 1);
+
+        VkOffset3D srcOffset;
+        srcOffset.x = intersectRect.location[0];
+        srcOffset.y = ctexture->m_height - intersectRect.size[1] - intersectRect.location[1];
+        srcOffset.z = 0;
+        VkImage srcImage = ctexture->m_colorTex;
+
+        if (ctexture->m_samples > 1)
+        {
+            reserveResolveImage(rb, rb.m_width, rb.m_height);
+            SetImageLayout(cmdBuf, rb.m_resolveImg, VK_IMAGE_ASPECT_COLOR_BIT,
+                           VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, 1);
+
+            VkImageResolve resolveInfo = {};
+            resolveInfo.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            resolveInfo.srcSubresource.mipLevel = 0;
+            resolveInfo.srcSubresource.baseArrayLayer = 0;
+            resolveInfo.srcSubresource.layerCount = 1;
+            resolveInfo.srcOffset = srcOffset;
+            resolveInfo.dstSubresource = resolveInfo.srcSubresource;
+            resolveInfo.extent.width = rb.m_width;
+            resolveInfo.extent.height = rb.m_height;
+            resolveInfo.extent.depth = 1;
+            vk::CmdResolveImage(cmdBuf,
+                                ctexture->m_colorTex, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                rb.m_resolveImg, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                1, &resolveInfo);
+
+            SetImageLayout(cmdBuf, rb.m_resolveImg, VK_IMAGE_ASPECT_COLOR_BIT,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 1, 1);
+            srcImage = rb.m_resolveImg;
+            srcOffset = {};
+        }
+
+        VkBufferImageCopy copyInfo = {};
+        copyInfo.bufferOffset = 0;
+        copyInfo.bufferRowLength = 0; /* Tightly packed */
+        copyInfo.bufferImageHeight = 0;
+        copyInfo.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copyInfo.imageSubresource.mipLevel = 0;
+        copyInfo.imageSubresource.baseArrayLayer = 0;
+        copyInfo.imageSubresource.layerCount = 1;
+        copyInfo.imageOffset = srcOffset;
+        copyInfo.imageExtent.width = rb.m_width;
+        copyInfo.imageExtent.height = rb.m_height;
+        copyInfo.imageExtent.depth = 1;
+        vk::CmdCopyImageToBuffer(cmdBuf, srcImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                 rb.m_buf, 1, &copyInfo);
+
+        /* Make the copy visible to host reads once the frame's fence signals */
+        VkBufferMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = rb.m_buf;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        vk::CmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                               0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+        if (bound)
+            SetImageLayout(cmdBuf, ctexture->m_colorTex, VK_IMAGE_ASPECT_COLOR_BIT,
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, 1, 1);
+        if (m_boundTarget)
+            vk::CmdBeginRenderPass(cmdBuf, &m_boundTarget->m_passBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+        m_recordedReadbacks.push_back(std::move(rb));
+    }
+
+    template <class T>
+    static void _markDirty(std::mutex& mt, std::unordered_set<T*>& set, T* res)
+    {
+        std::unique_lock<std::mutex> lk(mt);
+        if (!res->m_dirty)
+        {
+            res->m_dirty = true;
+            set.insert(res);
+        }
+    }
+    template <class T>
+    static void _clearDirty(std::mutex& mt, std::unordered_set<T*>& set, T* res)
+    {
+        std::unique_lock<std::mutex> lk(mt);
+        if (res->m_dirty)
+        {
+            res->m_dirty = false;
+            set.erase(res);
+        }
+    }
+
+    void markDirty(VulkanGraphicsBufferD* buf) {_markDirty(m_dirtyMt, m_dirtyBufs, buf);}
+    void markDirty(VulkanTextureD* tex) {_markDirty(m_dirtyMt, m_dirtyTexs, tex);}
+    void clearDirty(VulkanGraphicsBufferD* buf) {_clearDirty(m_dirtyMt, m_dirtyBufs, buf);}
+    void clearDirty(VulkanTextureD* tex) {_clearDirty(m_dirtyMt, m_dirtyTexs, tex);}
+
+    void execute();
+
+    FrameCounters getFrameCounters() const
+    {
+        FrameCounters ret = m_frameCounters;
+        ret.throttledFrames = m_throttledFrames;
+        return ret;
+    }
+
+    std::unique_ptr<IGraphicsCommandList> newCommandList();
+    void executeCommandLists(IGraphicsCommandList* const* lists, size_t count);
+};
+
+/* Worker-thread command list recorded into secondary command buffers.
+ * Each list owns its pool so lists may be recorded concurrently */
+struct VulkanCommandList : IGraphicsCommandList
+{
+    VulkanCommandQueue* m_q;
+    VkCommandPool m_cmdPool;
+    VkCommandBuffer m_cmdBufs[VulkanContext::MaxFramesInFlight];
+    VulkanTextureR* m_target = nullptr;
+    size_t m_slot = 0;
+    size_t m_drawCount = 0;
+
+    VulkanCommandList(VulkanCommandQueue* q)
+    : m_q(q)
+    {
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = q->m_ctx->m_graphicsQueueFamilyIndex;
+        ThrowIfFailed(vk::CreateCommandPool(q->m_ctx->m_dev, &poolInfo, nullptr, &m_cmdPool));
+
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = m_cmdPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandBufferCount = q->m_frameCount;
+        ThrowIfFailed(vk::AllocateCommandBuffers(q->m_ctx->m_dev, &allocInfo, m_cmdBufs));
+    }
+
+    ~VulkanCommandList()
+    {
+        vk::DestroyCommandPool(m_q->m_ctx->m_dev, m_cmdPool, nullptr);
+    }
+
+    void begin(ITextureR* target)
+    {
+        /* The queue's previous use of this slot has retired by the time
+         * execute() hands the slot back for filling */
+        m_target = static_cast<VulkanTextureR*>(target);
+        m_slot = m_q->m_fillBuf;
+        m_drawCount = 0;
+        VkCommandBuffer cmdBuf = m_cmdBufs[m_slot];
+        ThrowIfFailed(vk::ResetCommandBuffer(cmdBuf, 0));
+
+        VkCommandBufferInheritanceInfo inheritInfo = {};
+        inheritInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritInfo.renderPass = m_q->m_ctx->m_pass;
+        inheritInfo.subpass = 0;
+        inheritInfo.framebuffer = m_target ? m_target->m_framebuffer : VK_NULL_HANDLE;
+
+        VkCommandBufferBeginInfo cmdBufBeginInfo = {};
+        cmdBufBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        cmdBufBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        cmdBufBeginInfo.pInheritanceInfo = &inheritInfo;
+        ThrowIfFailed(vk::BeginCommandBuffer(cmdBuf, &cmdBufBeginInfo));
+    }
+
+    void end()
+    {
+        ThrowIfFailed(vk::EndCommandBuffer(m_cmdBufs[m_slot]));
+    }
+
+    void setShaderDataBinding(IShaderDataBinding* binding)
+    {
+        VulkanShaderDataBinding* cbind = static_cast<VulkanShaderDataBinding*>(binding);
+        cbind->bind(m_cmdBufs[m_slot], m_slot);
+    }
+
+    void setViewport(const SWindowRect& rect, float znear, float zfar)
+    {
+        if (m_target)
+        {
+            VkViewport vp = {float(rect.location[0]), float(m_target->m_height - rect.location[1] - rect.size[1]),
+                             float(rect.size[0]), float(rect.size[1]), znear, zfar};
+            vk::CmdSetViewport(m_cmdBufs[m_slot], 0, 1, &vp);
+        }
+    }
+
+    void setScissor(const SWindowRect& rect)
+    {
+        if (m_target)
+        {
+            VkRect2D vkrect =
+            {
+                {int32_t(rect.location[0]), int32_t(m_target->m_height - rect.location[1] - rect.size[1])},
+                {uint32_t(rect.size[0]), uint32_t(rect.size[1])}
+            };
+            vk::CmdSetScissor(m_cmdBufs[m_slot], 0, 1, &vkrect);
+        }
+    }
+
+    void draw(size_t start, size_t count)
+    {
+        vk::CmdDraw(m_cmdBufs[m_slot], count, 1, start, 0);
+        ++m_drawCount;
+    }
 
-            copyInfo.srcSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
-            copyInfo.dstSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    void drawIndexed(size_t start, size_t count)
+    {
+        vk::CmdDrawIndexed(m_cmdBufs[m_slot], count, 1, start, 0, 0);
+        ++m_drawCount;
+    }
 
-            vk::CmdCopyImage(cmdBuf,
-                             ctexture->m_depthTex, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                             ctexture->m_depthBindTex, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                             1, &copyInfo);
+    void drawInstances(size_t start, size_t count, size_t instCount)
+    {
+        vk::CmdDraw(m_cmdBufs[m_slot], count, instCount, start, 0);
+        ++m_drawCount;
+    }
 
-            if (ctexture == m_boundTarget)
-                SetImageLayout(cmdBuf, ctexture->m_depthTex, VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,
-                               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1, 1);
+    void drawInstancesIndexed(size_t start, size_t count, size_t instCount)
+    {
+        vk::CmdDrawIndexed(m_cmdBufs[m_slot], count, instCount, start, 0, 0);
+        ++m_drawCount;
+    }
+};
 
-            SetImageLayout(cmdBuf, ctexture->m_depthBindTex, VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,
-                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1, 1);
-        }
+std::unique_ptr<IGraphicsCommandList> VulkanCommandQueue::newCommandList()
+{
+    return std::unique_ptr<IGraphicsCommandList>(new VulkanCommandList(this));
+}
 
-        vk::CmdBeginRenderPass(cmdBuf, &m_boundTarget->m_passBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+void VulkanCommandQueue::executeCommandLists(IGraphicsCommandList* const* lists, size_t count)
+{
+    if (!count)
+        return;
+    if (!m_boundTarget)
+    {
+        Log.report(logvisor::Error, "executeCommandLists requires a bound render target");
+        return;
     }
 
-    void execute();
-};
+    std::vector<VkCommandBuffer> secondaries;
+    secondaries.reserve(count);
+    for (size_t i=0 ; i<count ; ++i)
+    {
+        VulkanCommandList* list = static_cast<VulkanCommandList*>(lists[i]);
+        if (list->m_slot != m_fillBuf)
+            Log.report(logvisor::Fatal, "command list was recorded for a previous frame");
+        secondaries.push_back(list->m_cmdBufs[list->m_slot]);
+        m_timerMarks[m_fillBuf].countDraws(list->m_drawCount);
+    }
+
+    /* Secondary buffers may only be executed from a pass begun for them;
+     * the attachments load their contents so the split is invisible */
+    VkCommandBuffer cmdBuf = m_cmdBufs[m_fillBuf];
+    vk::CmdEndRenderPass(cmdBuf);
+    vk::CmdBeginRenderPass(cmdBuf, &m_boundTarget->m_passBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    vk::CmdExecuteCommands(cmdBuf, secondaries.size(), secondaries.data());
+    vk::CmdEndRenderPass(cmdBuf);
+    vk::CmdBeginRenderPass(cmdBuf, &m_boundTarget->m_passBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+}
 
 VulkanGraphicsBufferD::~VulkanGraphicsBufferD()
 {
-    vk::DestroyBuffer(m_q->m_ctx->m_dev, m_bufferInfo[0].buffer, nullptr);
-    vk::DestroyBuffer(m_q->m_ctx->m_dev, m_bufferInfo[1].buffer, nullptr);
+    m_q->clearDirty(this);
+    for (size_t i=0 ; i<m_slotCount ; ++i)
+        vk::DestroyBuffer(m_q->m_ctx->m_dev, m_bufferInfo[i].buffer, nullptr);
 }
 
 VulkanTextureD::~VulkanTextureD()
 {
-    vk::DestroyImageView(m_q->m_ctx->m_dev, m_gpuView[0], nullptr);
-    vk::DestroyImageView(m_q->m_ctx->m_dev, m_gpuView[1], nullptr);
-    vk::DestroyBuffer(m_q->m_ctx->m_dev, m_cpuBuf[0], nullptr);
-    vk::DestroyBuffer(m_q->m_ctx->m_dev, m_cpuBuf[1], nullptr);
-    vk::DestroyImage(m_q->m_ctx->m_dev, m_gpuTex[0], nullptr);
-    vk::DestroyImage(m_q->m_ctx->m_dev, m_gpuTex[1], nullptr);
+    m_q->clearDirty(this);
+    for (size_t i=0 ; i<m_slotCount ; ++i)
+    {
+        vk::DestroyImageView(m_q->m_ctx->m_dev, m_gpuView[i], nullptr);
+        vk::DestroyBuffer(m_q->m_ctx->m_dev, m_cpuBuf[i], nullptr);
+        vk::DestroyImage(m_q->m_ctx->m_dev, m_gpuTex[i], nullptr);
+    }
     vk::FreeMemory(m_q->m_ctx->m_dev, m_cpuMem, nullptr);
 }
 
@@ -2668,11 +4090,7 @@ void VulkanGraphicsBufferD::update(int b)
     int slot = 1 << b;
     if ((slot & m_validSlots) == 0)
     {
-        void* ptr;
-        ThrowIfFailed(vk::MapMemory(m_q->m_ctx->m_dev, m_mem,
-                                    m_memOffset[b], m_cpuSz, 0, &ptr));
-        memmove(ptr, m_cpuBuf.get(), m_cpuSz);
-        vk::UnmapMemory(m_q->m_ctx->m_dev, m_mem);
+        memmove(m_mappedBase + m_memOffset[b], m_cpuBuf.get(), m_cpuSz);
         m_validSlots |= slot;
     }
 }
@@ -2682,6 +4100,7 @@ void VulkanGraphicsBufferD::load(const void* data, size_t sz)
     size_t bufSz = std::min(sz, m_cpuSz);
     memmove(m_cpuBuf.get(), data, bufSz);
     m_validSlots = 0;
+    m_q->markDirty(this);
 }
 void* VulkanGraphicsBufferD::map(size_t sz)
 {
@@ -2692,6 +4111,7 @@ void* VulkanGraphicsBufferD::map(size_t sz)
 void VulkanGraphicsBufferD::unmap()
 {
     m_validSlots = 0;
+    m_q->markDirty(this);
 }
 
 void VulkanTextureD::update(int b)
@@ -2699,7 +4119,6 @@ void VulkanTextureD::update(int b)
     int slot = 1 << b;
     if ((slot & m_validSlots) == 0)
     {
-        m_q->stallDynamicUpload();
         VkCommandBuffer cmdBuf = m_q->m_dynamicCmdBufs[b];
 
         /* map memory and copy staging data */
@@ -2744,6 +4163,7 @@ void VulkanTextureD::load(const void* data, size_t sz)
     size_t bufSz = std::min(sz, m_cpuSz);
     memmove(m_stagingBuf.get(), data, bufSz);
     m_validSlots = 0;
+    m_q->markDirty(this);
 }
 void* VulkanTextureD::map(size_t sz)
 {
@@ -2754,24 +4174,26 @@ void* VulkanTextureD::map(size_t sz)
 void VulkanTextureD::unmap()
 {
     m_validSlots = 0;
+    m_q->markDirty(this);
 }
 
 void VulkanDataFactory::destroyData(IGraphicsData* d)
 {
-    VulkanData* data = static_cast<VulkanData*>(d);
-    data->m_dead = true;
+    m_deadData.push(d);
 }
 
 void VulkanDataFactory::destroyAllData()
 {
     std::unique_lock<std::mutex> lk(m_committedMutex);
+    m_deadData.clear();
     for (IGraphicsData* data : m_committedData)
         delete static_cast<VulkanData*>(data);
     m_committedData.clear();
 }
 
 VulkanDataFactory::VulkanDataFactory(IGraphicsContext* parent, VulkanContext* ctx, uint32_t drawSamples)
-: m_parent(parent), m_ctx(ctx), m_drawSamples(drawSamples)
+: m_parent(parent), m_ctx(ctx), m_drawSamples(drawSamples), m_allocator(new VulkanDeviceAllocator(ctx)),
+  m_descAllocator(new VulkanDescriptorAllocator(ctx)), m_uploader(new VulkanUploadManager(ctx))
 {
     VkDescriptorSetLayoutBinding layoutBindings[BOO_GLSL_MAX_UNIFORM_COUNT + BOO_GLSL_MAX_TEXTURE_COUNT];
     for (int i=0 ; i<BOO_GLSL_MAX_UNIFORM_COUNT ; ++i)
@@ -2845,59 +4267,253 @@ VulkanDataFactory::VulkanDataFactory(IGraphicsContext* parent, VulkanContext* ct
     renderPass.subpassCount = 1;
     renderPass.pSubpasses = &subpass;
     ThrowIfFailed(vk::CreateRenderPass(ctx->m_dev, &renderPass, nullptr, &ctx->m_pass));
+
+    VkPipelineCacheCreateInfo cacheDataInfo = {};
+    cacheDataInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheDataInfo.pNext = nullptr;
+    ThrowIfFailed(vk::CreatePipelineCache(ctx->m_dev, &cacheDataInfo, nullptr, &m_pipelineCache));
 }
 
-IShaderPipeline* VulkanDataFactory::Context::newShaderPipeline
-(const char* vertSource, const char* fragSource,
- std::vector<unsigned int>& vertBlobOut, std::vector<unsigned int>& fragBlobOut,
- std::vector<unsigned char>& pipelineBlob, IVertexFormat* vtxFmt,
- BlendFactor srcFac, BlendFactor dstFac, Primitive prim,
- bool depthTest, bool depthWrite, bool backfaceCulling)
+VulkanDataFactory::~VulkanDataFactory()
+{
+    destroyAllData();
+    if (m_pipelineCachePath.size())
+        savePipelineCache();
+    vk::DestroyPipelineCache(m_ctx->m_dev, m_pipelineCache, nullptr);
+}
+
+VulkanDataFactory::MemoryStats VulkanDataFactory::getMemoryStats() const
+{
+    return m_allocator->getStats();
+}
+
+VulkanDataFactory::DescriptorStats VulkanDataFactory::getDescriptorStats() const
+{
+    return m_descAllocator->getStats();
+}
+
+bool VulkanDataFactory::isDataReady(IGraphicsData* d)
+{
+    return m_uploader->isComplete(static_cast<VulkanData*>(d)->m_uploadBatch);
+}
+
+/* Drivers reject foreign cache data on their own, but not all of them do it
+ * gracefully; only accept blobs written for this exact device */
+static bool ValidatePipelineCacheData(const VulkanContext* ctx, const unsigned char* data, size_t sz)
+{
+    if (sz < 16 + VK_UUID_SIZE)
+        return false;
+    uint32_t header[4];
+    memcpy(header, data, sizeof(header));
+    if (header[0] < 16 + VK_UUID_SIZE || header[0] > sz ||
+        header[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+        return false;
+    if (header[2] != ctx->m_gpuProps.vendorID || header[3] != ctx->m_gpuProps.deviceID)
+        return false;
+    return memcmp(data + 16, ctx->m_gpuProps.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+bool VulkanDataFactory::mergePipelineCacheData(const unsigned char* data, size_t sz)
+{
+    if (!ValidatePipelineCacheData(m_ctx, data, sz))
+        return false;
+
+    VkPipelineCacheCreateInfo cacheDataInfo = {};
+    cacheDataInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheDataInfo.pNext = nullptr;
+    cacheDataInfo.initialDataSize = sz;
+    cacheDataInfo.pInitialData = data;
+    VkPipelineCache srcCache;
+    if (vk::CreatePipelineCache(m_ctx->m_dev, &cacheDataInfo, nullptr, &srcCache) != VK_SUCCESS)
+        return false;
+
+    std::unique_lock<std::shared_timed_mutex> lk(m_pipelineCacheMt);
+    VkResult res = vk::MergePipelineCaches(m_ctx->m_dev, m_pipelineCache, 1, &srcCache);
+    lk.unlock();
+    vk::DestroyPipelineCache(m_ctx->m_dev, srcCache, nullptr);
+    return res == VK_SUCCESS;
+}
+
+/* Callers typically hand the same blob to every pipeline they create; merging
+ * takes the cache exclusively, so each distinct blob is merged only once */
+void VulkanDataFactory::mergePipelineBlob(const std::vector<unsigned char>& blob)
 {
-    if (vertBlobOut.empty() || fragBlobOut.empty())
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (unsigned char c : blob)
+    {
+        hash ^= c;
+        hash *= 0x100000001b3ull;
+    }
     {
-        const EShMessages messages = EShMessages(EShMsgSpvRules | EShMsgVulkanRules);
+        std::unique_lock<std::mutex> lk(m_mergedBlobsMt);
+        if (!m_mergedBlobs.insert(hash).second)
+            return;
+    }
+    mergePipelineCacheData(blob.data(), blob.size());
+}
 
-        //printf("%s\n", vertSource);
-        //printf("%s\n", fragSource);
+std::vector<unsigned char> VulkanDataFactory::getPipelineCacheData()
+{
+    std::vector<unsigned char> ret;
+    std::shared_lock<std::shared_timed_mutex> lk(m_pipelineCacheMt);
+    size_t cacheSz = 0;
+    ThrowIfFailed(vk::GetPipelineCacheData(m_ctx->m_dev, m_pipelineCache, &cacheSz, nullptr));
+    if (cacheSz)
+    {
+        ret.resize(cacheSz);
+        ThrowIfFailed(vk::GetPipelineCacheData(m_ctx->m_dev, m_pipelineCache, &cacheSz, ret.data()));
+        ret.resize(cacheSz);
+    }
+    return ret;
+}
 
-        glslang::TShader vs(EShLangVertex);
-        vs.setStrings(&vertSource, 1);
-        if (!vs.parse(&glslang::DefaultTBuiltInResource, 110, false, messages))
-        {
-            printf("%s\n", vertSource);
-            Log.report(logvisor::Fatal, "unable to compile vertex shader\n%s", vs.getInfoLog());
-            return nullptr;
-        }
+static FILE* OpenPipelineCacheFile(const SystemString& path, const SystemChar* mode)
+{
+#if _WIN32
+    return _wfopen(path.c_str(), mode);
+#else
+    return fopen(path.c_str(), mode);
+#endif
+}
 
-        glslang::TShader fs(EShLangFragment);
-        fs.setStrings(&fragSource, 1);
-        if (!fs.parse(&glslang::DefaultTBuiltInResource, 110, false, messages))
+bool VulkanDataFactory::loadPipelineCache(const SystemString& path)
+{
+    m_pipelineCachePath = path;
+    std::vector<unsigned char> data;
+    if (FILE* fp = OpenPipelineCacheFile(path, _S("rb")))
+    {
+        fseek(fp, 0, SEEK_END);
+        long sz = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        if (sz > 0)
         {
-            printf("%s\n", fragSource);
-            Log.report(logvisor::Fatal, "unable to compile fragment shader\n%s", fs.getInfoLog());
-            return nullptr;
+            data.resize(sz);
+            if (fread(data.data(), 1, sz, fp) != size_t(sz))
+                data.clear();
         }
+        fclose(fp);
+    }
+    if (data.empty())
+        return false;
+    if (!mergePipelineCacheData(data.data(), data.size()))
+    {
+        Log.report(logvisor::Warning, "discarding pipeline cache built for another device or driver");
+        return false;
+    }
+    return true;
+}
 
-        glslang::TProgram prog;
-        prog.addShader(&vs);
-        prog.addShader(&fs);
-        if (!prog.link(messages))
-        {
-            Log.report(logvisor::Fatal, "unable to link shader program\n%s", prog.getInfoLog());
-            return nullptr;
-        }
-        if (vertBlobOut.empty())
-        {
-            glslang::GlslangToSpv(*prog.getIntermediate(EShLangVertex), vertBlobOut);
-            //spv::Disassemble(std::cerr, vertBlobOut);
-        }
-        if (fragBlobOut.empty())
+bool VulkanDataFactory::savePipelineCache()
+{
+    if (m_pipelineCachePath.empty())
+        return false;
+    std::vector<unsigned char> data = getPipelineCacheData();
+    if (data.empty())
+        return false;
+
+    /* Replace the file atomically so a crash mid-write can't leave a torn cache;
+     * the temporary name is unique per process and write, as processes may share the path */
+    static std::atomic_uint TmpSerial(0);
+    unsigned serial = TmpSerial++;
+    SystemChar suffix[48];
+#if _WIN32
+    _snwprintf(suffix, 48, L".%lu.%u.tmp", GetCurrentProcessId(), serial);
+#else
+    snprintf(suffix, 48, ".%ld.%u.tmp", long(getpid()), serial);
+#endif
+    SystemString tmpPath = m_pipelineCachePath + suffix;
+    FILE* fp = OpenPipelineCacheFile(tmpPath, _S("wb"));
+    if (!fp)
+    {
+        Log.report(logvisor::Warning, "unable to open pipeline cache for writing");
+        return false;
+    }
+    bool ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+    ok &= fclose(fp) == 0;
+#if _WIN32
+    ok = ok && MoveFileExW(tmpPath.c_str(), m_pipelineCachePath.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+    ok = ok && rename(tmpPath.c_str(), m_pipelineCachePath.c_str()) == 0;
+#endif
+    if (!ok)
+    {
+#if _WIN32
+        _wremove(tmpPath.c_str());
+#else
+        remove(tmpPath.c_str());
+#endif
+        Log.report(logvisor::Warning, "unable to write pipeline cache");
+    }
+    return ok;
+}
+
+/* Front-end configuration folded into SPIR-V cache keys; bump when it changes */
+static const char* SPIRVCompileOptions = "glslang-110-spvrules-vulkanrules";
+
+static bool CompileSPIRV(const char* vertSource, const char* fragSource,
+                         std::vector<unsigned int>& vertBlobOut, std::vector<unsigned int>& fragBlobOut,
+                         std::string& errorOut)
+{
+    const EShMessages messages = EShMessages(EShMsgSpvRules | EShMsgVulkanRules);
+
+    //printf("%s\n", vertSource);
+    //printf("%s\n", fragSource);
+
+    /* May run on a compile-queue thread; the caller reports errorOut */
+    glslang::TShader vs(EShLangVertex);
+    vs.setStrings(&vertSource, 1);
+    if (!vs.parse(&glslang::DefaultTBuiltInResource, 110, false, messages))
+    {
+        errorOut = std::string(vertSource) + "\nunable to compile vertex shader\n" + vs.getInfoLog();
+        return false;
+    }
+
+    glslang::TShader fs(EShLangFragment);
+    fs.setStrings(&fragSource, 1);
+    if (!fs.parse(&glslang::DefaultTBuiltInResource, 110, false, messages))
+    {
+        errorOut = std::string(fragSource) + "\nunable to compile fragment shader\n" + fs.getInfoLog();
+        return false;
+    }
+
+    glslang::TProgram prog;
+    prog.addShader(&vs);
+    prog.addShader(&fs);
+    if (!prog.link(messages))
+    {
+        errorOut = std::string("unable to link shader program\n") + prog.getInfoLog();
+        return false;
+    }
+    if (vertBlobOut.empty())
+    {
+        glslang::GlslangToSpv(*prog.getIntermediate(EShLangVertex), vertBlobOut);
+        //spv::Disassemble(std::cerr, vertBlobOut);
+    }
+    if (fragBlobOut.empty())
+    {
+        glslang::GlslangToSpv(*prog.getIntermediate(EShLangFragment), fragBlobOut);
+        //spv::Disassemble(std::cerr, fragBlobOut);
+    }
+    return true;
+}
+
+bool VulkanShaderPipeline::build(VulkanDataFactory& factory, const char* vertSource, const char* fragSource,
+                                 std::vector<unsigned int>& vertBlobOut, std::vector<unsigned int>& fragBlobOut,
+                                 const std::vector<unsigned char>& pipelineBlob, std::string& errorOut)
+{
+    if (vertBlobOut.empty() && fragBlobOut.empty() && factory.m_spirvCache.enabled())
+    {
+        SPIRVCache::Key key = SPIRVCache::MakeKey(vertSource, fragSource, SPIRVCompileOptions);
+        if (!factory.m_spirvCache.load(key, vertBlobOut, fragBlobOut))
         {
-            glslang::GlslangToSpv(*prog.getIntermediate(EShLangFragment), fragBlobOut);
-            //spv::Disassemble(std::cerr, fragBlobOut);
+            if (!CompileSPIRV(vertSource, fragSource, vertBlobOut, fragBlobOut, errorOut))
+                return false;
+            factory.m_spirvCache.store(key, vertBlobOut, fragBlobOut);
         }
     }
+    else if (vertBlobOut.empty() || fragBlobOut.empty())
+        if (!CompileSPIRV(vertSource, fragSource, vertBlobOut, fragBlobOut, errorOut))
+            return false;
 
     VkShaderModuleCreateInfo smCreateInfo = {};
     smCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
@@ -2907,50 +4523,93 @@ IShaderPipeline* VulkanDataFactory::Context::newShaderPipeline
     smCreateInfo.codeSize = vertBlobOut.size() * sizeof(unsigned int);
     smCreateInfo.pCode = vertBlobOut.data();
     VkShaderModule vertModule;
-    ThrowIfFailed(vk::CreateShaderModule(m_parent.m_ctx->m_dev, &smCreateInfo, nullptr, &vertModule));
+    ThrowIfFailed(vk::CreateShaderModule(m_ctx->m_dev, &smCreateInfo, nullptr, &vertModule));
 
     smCreateInfo.codeSize = fragBlobOut.size() * sizeof(unsigned int);
     smCreateInfo.pCode = fragBlobOut.data();
     VkShaderModule fragModule;
-    ThrowIfFailed(vk::CreateShaderModule(m_parent.m_ctx->m_dev, &smCreateInfo, nullptr, &fragModule));
+    ThrowIfFailed(vk::CreateShaderModule(m_ctx->m_dev, &smCreateInfo, nullptr, &fragModule));
 
-    VkPipelineCacheCreateInfo cacheDataInfo = {};
-    cacheDataInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-    cacheDataInfo.pNext = nullptr;
-    cacheDataInfo.initialDataSize = pipelineBlob.size();
-    if (cacheDataInfo.initialDataSize)
-        cacheDataInfo.pInitialData = pipelineBlob.data();
+    if (pipelineBlob.size())
+        factory.mergePipelineBlob(pipelineBlob);
 
-    VkPipelineCache pipelineCache;
-    ThrowIfFailed(vk::CreatePipelineCache(m_parent.m_ctx->m_dev, &cacheDataInfo, nullptr, &pipelineCache));
+    {
+        /* Pipeline creation synchronizes on the cache internally; only merges need exclusivity */
+        std::shared_lock<std::shared_timed_mutex> lk(factory.m_pipelineCacheMt);
+        createPipeline(vertModule, fragModule, factory.m_pipelineCache);
+    }
 
-    VulkanShaderPipeline* retval = new VulkanShaderPipeline(m_parent.m_ctx, vertModule, fragModule, pipelineCache,
-                                                            static_cast<const VulkanVertexFormat*>(vtxFmt),
-                                                            srcFac, dstFac, prim, depthTest, depthWrite, backfaceCulling);
+    vk::DestroyShaderModule(m_ctx->m_dev, fragModule, nullptr);
+    vk::DestroyShaderModule(m_ctx->m_dev, vertModule, nullptr);
+    return true;
+}
 
-    if (pipelineBlob.empty())
+IShaderPipeline* VulkanDataFactory::Context::newShaderPipeline
+(const char* vertSource, const char* fragSource,
+ std::vector<unsigned int>& vertBlobOut, std::vector<unsigned int>& fragBlobOut,
+ const std::vector<unsigned char>& pipelineBlob, IVertexFormat* vtxFmt,
+ BlendFactor srcFac, BlendFactor dstFac, Primitive prim,
+ bool depthTest, bool depthWrite, bool backfaceCulling)
+{
+    std::unique_ptr<VulkanShaderPipeline> retval(
+        new VulkanShaderPipeline(m_parent.m_ctx, static_cast<const VulkanVertexFormat*>(vtxFmt),
+                                 srcFac, dstFac, prim, depthTest, depthWrite, backfaceCulling));
+    std::string error;
+    if (!retval->build(m_parent, vertSource, fragSource, vertBlobOut, fragBlobOut, pipelineBlob, error))
     {
-        size_t cacheSz = 0;
-        ThrowIfFailed(vk::GetPipelineCacheData(m_parent.m_ctx->m_dev, pipelineCache, &cacheSz, nullptr));
-        if (cacheSz)
-        {
-            pipelineBlob.resize(cacheSz);
-            ThrowIfFailed(vk::GetPipelineCacheData(m_parent.m_ctx->m_dev, pipelineCache, &cacheSz, pipelineBlob.data()));
-            pipelineBlob.resize(cacheSz);
-        }
+        Log.report(logvisor::Fatal, "%s", error.c_str());
+        return nullptr;
     }
 
-    vk::DestroyShaderModule(m_parent.m_ctx->m_dev, fragModule, nullptr);
-    vk::DestroyShaderModule(m_parent.m_ctx->m_dev, vertModule, nullptr);
+    VulkanShaderPipeline* ret = retval.get();
+    static_cast<VulkanData*>(m_deferredData.get())->m_SPs.push_back(std::move(retval));
+    return ret;
+}
 
+IShaderPipeline* VulkanDataFactory::Context::newShaderPipelineAsync
+(const char* vertSource, const char* fragSource, IVertexFormat* vtxFmt,
+ BlendFactor srcFac, BlendFactor dstFac, Primitive prim,
+ bool depthTest, bool depthWrite, bool backfaceCulling)
+{
+    VulkanShaderPipeline* retval =
+        new VulkanShaderPipeline(m_parent.m_ctx, static_cast<const VulkanVertexFormat*>(vtxFmt),
+                                 srcFac, dstFac, prim, depthTest, depthWrite, backfaceCulling);
+    std::string vert(vertSource);
+    std::string frag(fragSource);
+    VulkanDataFactory& factory = m_parent;
+    retval->m_ready = m_parent.m_compileQueue.post([retval, &factory, vert, frag]()
+    {
+        std::vector<unsigned int> vertBlob;
+        std::vector<unsigned int> fragBlob;
+        /* Failures are handed to the thread that binds the pipeline */
+        try
+        {
+            retval->build(factory, vert.c_str(), frag.c_str(), vertBlob, fragBlob, {}, retval->m_buildError);
+        }
+        catch (const std::exception& e)
+        {
+            retval->m_buildError = e.what();
+        }
+        if (retval->m_pipeline == VK_NULL_HANDLE && retval->m_buildError.empty())
+            retval->m_buildError = "unable to create shader pipeline";
+    });
     static_cast<VulkanData*>(m_deferredData.get())->m_SPs.emplace_back(retval);
     return retval;
 }
 
 IGraphicsBufferS* VulkanDataFactory::Context::newStaticBuffer(BufferUse use, const void* data, size_t stride, size_t count)
 {
-    VulkanGraphicsBufferS* retval = new VulkanGraphicsBufferS(use, m_parent.m_ctx, data, stride, count);
-    static_cast<VulkanData*>(m_deferredData.get())->m_SBufs.emplace_back(retval);
+    size_t sz = stride * count;
+    return newStaticBufferInPlace(use, stride, count, [data, sz](void* dst) { memmove(dst, data, sz); });
+}
+
+IGraphicsBufferS* VulkanDataFactory::Context::newStaticBufferInPlace(BufferUse use, size_t stride, size_t count,
+                                                                     const std::function<void(void*)>& fill)
+{
+    VulkanData* d = static_cast<VulkanData*>(m_deferredData.get());
+    VulkanGraphicsBufferS* retval = new VulkanGraphicsBufferS(use, m_parent.m_ctx, m_parent.m_uploader.get(),
+                                                              d->m_uploadBatch, stride, count, fill);
+    d->m_SBufs.emplace_back(retval);
     return retval;
 }
 
@@ -2965,16 +4624,20 @@ IGraphicsBufferD* VulkanDataFactory::Context::newDynamicBuffer(BufferUse use, si
 ITextureS* VulkanDataFactory::Context::newStaticTexture(size_t width, size_t height, size_t mips,
                                                         TextureFormat fmt, const void* data, size_t sz)
 {
-    VulkanTextureS* retval = new VulkanTextureS(m_parent.m_ctx, width, height, mips, fmt, data, sz);
-    static_cast<VulkanData*>(m_deferredData.get())->m_STexs.emplace_back(retval);
+    VulkanData* d = static_cast<VulkanData*>(m_deferredData.get());
+    VulkanTextureS* retval = new VulkanTextureS(m_parent.m_ctx, m_parent.m_uploader.get(), d->m_uploadBatch,
+                                                width, height, mips, fmt, data, sz);
+    d->m_STexs.emplace_back(retval);
     return retval;
 }
 
 ITextureSA* VulkanDataFactory::Context::newStaticArrayTexture(size_t width, size_t height, size_t layers,
                                                               TextureFormat fmt, const void* data, size_t sz)
 {
-    VulkanTextureSA* retval = new VulkanTextureSA(m_parent.m_ctx, width, height, layers, fmt, data, sz);
-    static_cast<VulkanData*>(m_deferredData.get())->m_SATexs.emplace_back(retval);
+    VulkanData* d = static_cast<VulkanData*>(m_deferredData.get());
+    VulkanTextureSA* retval = new VulkanTextureSA(m_parent.m_ctx, m_parent.m_uploader.get(), d->m_uploadBatch,
+                                                  width, height, layers, fmt, data, sz);
+    d->m_SATexs.emplace_back(retval);
     return retval;
 }
 
@@ -3022,7 +4685,7 @@ GraphicsDataToken VulkanDataFactory::commitTransaction
 {
     if (m_deferredData.get())
         Log.report(logvisor::Fatal, "nested commitTransaction usage detected");
-    m_deferredData.reset(new VulkanData(m_ctx));
+    m_deferredData.reset(new VulkanData(m_ctx, m_allocator.get(), m_descAllocator.get(), m_uploader.get()));
 
     Context ctx(*this);
     if (!trans(ctx))
@@ -3035,104 +4698,127 @@ GraphicsDataToken VulkanDataFactory::commitTransaction
     VulkanData* retval = static_cast<VulkanData*>(m_deferredData.get());
 
     /* size up resources */
+    uint32_t sbufMemTypeBits = ~0;
+    VkDeviceSize sbufMemSize = 0;
+    VkDeviceSize sbufAlign = 1;
     uint32_t bufMemTypeBits = ~0;
     VkDeviceSize bufMemSize = 0;
+    VkDeviceSize bufAlign = 1;
     uint32_t texMemTypeBits = ~0;
     VkDeviceSize texMemSize = 0;
+    VkDeviceSize texAlign = 1;
 
     for (std::unique_ptr<VulkanGraphicsBufferS>& buf : retval->m_SBufs)
-        bufMemSize = buf->sizeForGPU(m_ctx, bufMemTypeBits, bufMemSize);
+        sbufMemSize = buf->sizeForGPU(m_ctx, sbufMemTypeBits, sbufAlign, sbufMemSize);
 
     for (std::unique_ptr<VulkanGraphicsBufferD>& buf : retval->m_DBufs)
-        bufMemSize = buf->sizeForGPU(m_ctx, bufMemTypeBits, bufMemSize);
+        bufMemSize = buf->sizeForGPU(m_ctx, bufMemTypeBits, bufAlign, bufMemSize);
 
     for (std::unique_ptr<VulkanTextureS>& tex : retval->m_STexs)
-        texMemSize = tex->sizeForGPU(m_ctx, texMemTypeBits, texMemSize);
+        texMemSize = tex->sizeForGPU(m_ctx, texMemTypeBits, texAlign, texMemSize);
 
     for (std::unique_ptr<VulkanTextureSA>& tex : retval->m_SATexs)
-        texMemSize = tex->sizeForGPU(m_ctx, texMemTypeBits, texMemSize);
+        texMemSize = tex->sizeForGPU(m_ctx, texMemTypeBits, texAlign, texMemSize);
 
     for (std::unique_ptr<VulkanTextureD>& tex : retval->m_DTexs)
-        texMemSize = tex->sizeForGPU(m_ctx, texMemTypeBits, texMemSize);
+        texMemSize = tex->sizeForGPU(m_ctx, texMemTypeBits, texAlign, texMemSize);
+
+    /* Static data arrives through the upload ring */
+    std::unique_lock<std::mutex> uploadlk;
+    bool uploads = retval->m_SBufs.size() || retval->m_STexs.size() || retval->m_SATexs.size();
+    if (uploads)
+        uploadlk = m_uploader->beginRecording(retval->m_uploadBatch);
+
+    /* sub-allocate device-local memory and place static buffers */
+    if (sbufMemSize)
+    {
+        uint32_t memTypeIdx;
+        ThrowIfFalse(MemoryTypeFromProperties(m_ctx, sbufMemTypeBits,
+                                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memTypeIdx));
+        retval->m_sbufAlloc = m_allocator->allocate(memTypeIdx, false, sbufMemSize, sbufAlign);
+
+        VkDeviceSize offset = retval->m_sbufAlloc.m_offset;
+        for (std::unique_ptr<VulkanGraphicsBufferS>& buf : retval->m_SBufs)
+            offset = buf->sizeForGPU(m_ctx, sbufMemTypeBits, sbufAlign, offset);
+
+        for (std::unique_ptr<VulkanGraphicsBufferS>& buf : retval->m_SBufs)
+            buf->placeForGPU(m_ctx, retval->m_sbufAlloc.m_mem, retval->m_uploadBatch.m_cmdBuf);
+    }
 
-    /* allocate memory and place textures */
+    /* sub-allocate host-visible memory and place dynamic buffers */
     if (bufMemSize)
     {
-        VkMemoryAllocateInfo memAlloc = {};
-        memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        memAlloc.allocationSize = bufMemSize;
+        uint32_t memTypeIdx;
         ThrowIfFalse(MemoryTypeFromProperties(m_ctx, bufMemTypeBits,
                                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
                                               VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                                              &memAlloc.memoryTypeIndex));
-        ThrowIfFailed(vk::AllocateMemory(m_ctx->m_dev, &memAlloc, nullptr, &retval->m_bufMem));
-
-        /* place resources */
-        uint8_t* mappedData;
-        ThrowIfFailed(vk::MapMemory(m_ctx->m_dev, retval->m_bufMem, 0, bufMemSize, 0, reinterpret_cast<void**>(&mappedData)));
-
-        for (std::unique_ptr<VulkanGraphicsBufferS>& buf : retval->m_SBufs)
-            buf->placeForGPU(m_ctx, retval->m_bufMem, mappedData);
+                                              &memTypeIdx));
+        retval->m_bufAlloc = m_allocator->allocate(memTypeIdx, false, bufMemSize, bufAlign);
 
-        vk::UnmapMemory(m_ctx->m_dev, retval->m_bufMem);
+        /* Lay resources out again at the range's offset; the range is aligned
+         * to every resource's requirement, so the layout (and its size) doesn't change */
+        VkDeviceSize offset = retval->m_bufAlloc.m_offset;
+        for (std::unique_ptr<VulkanGraphicsBufferD>& buf : retval->m_DBufs)
+            offset = buf->sizeForGPU(m_ctx, bufMemTypeBits, bufAlign, offset);
 
         for (std::unique_ptr<VulkanGraphicsBufferD>& buf : retval->m_DBufs)
-            buf->placeForGPU(m_ctx, retval->m_bufMem);
+            buf->placeForGPU(m_ctx, retval->m_bufAlloc.m_mem, retval->m_bufAlloc.m_blockMap);
     }
 
-    /* allocate memory and place textures */
+    /* sub-allocate memory and place textures */
     if (texMemSize)
     {
-        VkMemoryAllocateInfo memAlloc = {};
-        memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        memAlloc.allocationSize = texMemSize;
-        ThrowIfFalse(MemoryTypeFromProperties(m_ctx, texMemTypeBits, 0, &memAlloc.memoryTypeIndex));
-        ThrowIfFailed(vk::AllocateMemory(m_ctx->m_dev, &memAlloc, nullptr, &retval->m_texMem));
+        uint32_t memTypeIdx;
+        ThrowIfFalse(MemoryTypeFromProperties(m_ctx, texMemTypeBits, 0, &memTypeIdx));
+        retval->m_texAlloc = m_allocator->allocate(memTypeIdx, true, texMemSize, texAlign);
+
+        VkDeviceSize offset = retval->m_texAlloc.m_offset;
+        for (std::unique_ptr<VulkanTextureS>& tex : retval->m_STexs)
+            offset = tex->sizeForGPU(m_ctx, texMemTypeBits, texAlign, offset);
+        for (std::unique_ptr<VulkanTextureSA>& tex : retval->m_SATexs)
+            offset = tex->sizeForGPU(m_ctx, texMemTypeBits, texAlign, offset);
+        for (std::unique_ptr<VulkanTextureD>& tex : retval->m_DTexs)
+            offset = tex->sizeForGPU(m_ctx, texMemTypeBits, texAlign, offset);
 
         for (std::unique_ptr<VulkanTextureS>& tex : retval->m_STexs)
-            tex->placeForGPU(m_ctx, retval->m_texMem);
+            tex->placeForGPU(m_ctx, retval->m_texAlloc.m_mem, retval->m_uploadBatch.m_cmdBuf);
 
         for (std::unique_ptr<VulkanTextureSA>& tex : retval->m_SATexs)
-            tex->placeForGPU(m_ctx, retval->m_texMem);
+            tex->placeForGPU(m_ctx, retval->m_texAlloc.m_mem, retval->m_uploadBatch.m_cmdBuf);
 
         for (std::unique_ptr<VulkanTextureD>& tex : retval->m_DTexs)
-            tex->placeForGPU(m_ctx, retval->m_texMem);
+            tex->placeForGPU(m_ctx, retval->m_texAlloc.m_mem);
     }
 
-    /* Execute static uploads */
-    ThrowIfFailed(vk::EndCommandBuffer(m_ctx->m_loadCmdBuf));
-    VkSubmitInfo submitInfo = {};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &m_ctx->m_loadCmdBuf;
+    /* Allocate descriptor sets for every binding of the transaction in one batch */
+    {
+        std::vector<VkDescriptorSet> sets;
+        for (std::unique_ptr<VulkanShaderDataBinding>& bind : retval->m_SBinds)
+            if (bind->needsDescriptorSets())
+                sets.resize(sets.size() + m_ctx->m_framesInFlight);
+        if (sets.size())
+        {
+            m_descAllocator->allocate(retval->m_descBatch, sets.size(), sets.data());
+            size_t idx = 0;
+            for (std::unique_ptr<VulkanShaderDataBinding>& bind : retval->m_SBinds)
+            {
+                if (!bind->needsDescriptorSets())
+                    continue;
+                for (uint32_t b=0 ; b<m_ctx->m_framesInFlight ; ++b)
+                    bind->m_descSets[b] = sets[idx++];
+            }
+        }
+    }
 
-    /* Take exclusive lock here and submit queue */
-    std::unique_lock<std::mutex> qlk(m_ctx->m_queueLock);
-    ThrowIfFailed(vk::QueueWaitIdle(m_ctx->m_queue));
-    ThrowIfFailed(vk::QueueSubmit(m_ctx->m_queue, 1, &submitInfo, VK_NULL_HANDLE));
+    /* Queue static uploads; frames submitted later execute after them, so
+     * nothing needs to wait here. Staging is reclaimed once the fence signals */
+    if (uploads)
+        m_uploader->submit(retval->m_uploadBatch, uploadlk);
 
-    /* Commit data bindings (create descriptor sets) */
+    /* Commit data bindings (write descriptor sets) */
     for (std::unique_ptr<VulkanShaderDataBinding>& bind : retval->m_SBinds)
         bind->commit(m_ctx);
 
-    /* Wait for uploads to complete */
-    ThrowIfFailed(vk::QueueWaitIdle(m_ctx->m_queue));
-    qlk.unlock();
-
-    /* Reset command buffer */
-    ThrowIfFailed(vk::ResetCommandBuffer(m_ctx->m_loadCmdBuf, 0));
-    VkCommandBufferBeginInfo cmdBufBeginInfo = {};
-    cmdBufBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    cmdBufBeginInfo.flags = 0;
-    ThrowIfFailed(vk::BeginCommandBuffer(m_ctx->m_loadCmdBuf, &cmdBufBeginInfo));
-
-    /* Delete upload objects */
-    for (std::unique_ptr<VulkanTextureS>& tex : retval->m_STexs)
-        tex->deleteUploadObjects();
-
-    for (std::unique_ptr<VulkanTextureSA>& tex : retval->m_SATexs)
-        tex->deleteUploadObjects();
-
     /* All set! */
     m_deferredData.reset();
     std::unique_lock<std::mutex> lk(m_committedMutex);
@@ -3147,67 +4833,71 @@ void VulkanCommandQueue::execute()
     if (!m_running)
         return;
 
-    /* Stage dynamic uploads */
-    VulkanDataFactory* gfxF = static_cast<VulkanDataFactory*>(m_parent->getDataFactory());
-    std::unique_lock<std::mutex> datalk(gfxF->m_committedMutex);
-    for (VulkanData* d : gfxF->m_committedData)
+    FrameStats stats;
+    stats.frame = m_submitSerial + 1;
+    stats.recordStart = m_recordStart;
+    stats.execute = FrameStatsNow();
+
+    /* Stage dynamic uploads; resources stay listed until every
+     * frame slot has received the latest contents */
+    int allSlots = (1 << m_frameCount) - 1;
+    std::unique_lock<std::mutex> dirtylk(m_dirtyMt);
+    size_t uploads = 0;
+    for (auto it = m_dirtyBufs.begin() ; it != m_dirtyBufs.end() ;)
     {
-        for (std::unique_ptr<VulkanGraphicsBufferD>& b : d->m_DBufs)
-            b->update(m_fillBuf);
-        for (std::unique_ptr<VulkanTextureD>& t : d->m_DTexs)
-            t->update(m_fillBuf);
+        VulkanGraphicsBufferD* b = *it;
+        if ((b->m_validSlots & (1 << m_fillBuf)) == 0)
+            ++uploads;
+        b->update(m_fillBuf);
+        if (b->m_validSlots == allSlots)
+        {
+            b->m_dirty = false;
+            it = m_dirtyBufs.erase(it);
+            continue;
+        }
+        ++it;
     }
-    datalk.unlock();
-
-    /* Perform dynamic uploads */
-    std::unique_lock<std::mutex> lk(m_ctx->m_queueLock);
-    if (!m_dynamicNeedsReset)
+    for (auto it = m_dirtyTexs.begin() ; it != m_dirtyTexs.end() ;)
     {
-        vk::EndCommandBuffer(m_dynamicCmdBufs[m_fillBuf]);
-
-        vk::WaitForFences(m_ctx->m_dev, 1, &m_dynamicBufFence, VK_FALSE, -1);
-        vk::ResetFences(m_ctx->m_dev, 1, &m_dynamicBufFence);
-
-        VkSubmitInfo submitInfo = {};
-        submitInfo.pNext = nullptr;
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.waitSemaphoreCount = 0;
-        submitInfo.pWaitSemaphores = nullptr;
-        submitInfo.pWaitDstStageMask = nullptr;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &m_dynamicCmdBufs[m_fillBuf];
-        submitInfo.signalSemaphoreCount = 0;
-        submitInfo.pSignalSemaphores = nullptr;
-        ThrowIfFailed(vk::QueueSubmit(m_ctx->m_queue, 1, &submitInfo, m_dynamicBufFence));
+        VulkanTextureD* t = *it;
+        if ((t->m_validSlots & (1 << m_fillBuf)) == 0)
+            ++uploads;
+        t->update(m_fillBuf);
+        if (t->m_validSlots == allSlots)
+        {
+            t->m_dirty = false;
+            it = m_dirtyTexs.erase(it);
+            continue;
+        }
+        ++it;
     }
+    dirtylk.unlock();
+    m_frameCounters.dynamicUploads = uploads;
 
-    /* Check on fence */
-    if (m_submitted && vk::GetFenceStatus(m_ctx->m_dev, m_drawCompleteFence) == VK_NOT_READY)
-    {
-        /* Abandon this list (renderer too slow) */
-        resetCommandBuffer();
-        m_dynamicNeedsReset = true;
-        m_resolveDispSource = nullptr;
-        return;
-    }
+    std::unique_lock<std::mutex> lk(m_ctx->m_queueLock);
+    stats.renderBegin = FrameStatsNow();
 
-    /* Clear dead data */
-    datalk.lock();
-    for (auto it = gfxF->m_committedData.begin() ; it != gfxF->m_committedData.end() ;)
+    /* Clear dead data once every frame that may have referenced it has retired */
+    VulkanDataFactory* gfxF = static_cast<VulkanDataFactory*>(m_parent->getDataFactory());
+    gfxF->m_deadData.collect(m_submitSerial + 1);
+    gfxF->m_deadData.retire(m_completedSerial, [gfxF](IGraphicsData* d)
     {
-        if ((*it)->m_dead)
+        VulkanData* data = static_cast<VulkanData*>(d);
+        if (!gfxF->m_uploader->isComplete(data->m_uploadBatch))
+            return false;
         {
-            delete *it;
-            it = gfxF->m_committedData.erase(it);
-            continue;
+            std::unique_lock<std::mutex> lk(gfxF->m_committedMutex);
+            gfxF->m_committedData.erase(data);
         }
-        ++it;
-    }
-    datalk.unlock();
+        delete data;
+        return true;
+    });
 
     /* Perform texture resizes */
     if (m_texResizes.size())
     {
+        /* Render targets may still be sampled by frames in flight */
+        waitAllFrames();
         for (const auto& resize : m_texResizes)
         {
             if (m_boundTarget == resize.first)
@@ -3215,10 +4905,22 @@ void VulkanCommandQueue::execute()
             resize.first->resize(m_ctx, resize.second.first, resize.second.second);
         }
         m_texResizes.clear();
+
+        /* Drop this frame's draws; its dynamic uploads ride along with the next one */
         resetCommandBuffer();
-        m_dynamicNeedsReset = true;
         m_resolveDispSource = nullptr;
+        if (m_timerActive[m_fillBuf])
+            stampTimer(m_fillBuf, m_timerMarks[m_fillBuf].beginFrame(m_submitSerial + 1, nullptr));
+        for (Readback& rb : m_recordedReadbacks)
+        {
+            rb.m_func = {};
+            m_idleReadbacks.push_back(std::move(rb));
+        }
+        m_recordedReadbacks.clear();
+        m_displayResolved = false;
 
+        if (!m_windowCtx)
+            return;
         VulkanContext::Window::SwapChain& otherSc = m_windowCtx->m_swapChains[m_windowCtx->m_activeSwapChain ^ 1];
         if (otherSc.m_swapChain)
         {
@@ -3229,13 +4931,12 @@ void VulkanCommandQueue::execute()
         return;
     }
 
-    vk::ResetFences(m_ctx->m_dev, 1, &m_drawCompleteFence);
     vk::CmdEndRenderPass(m_cmdBufs[m_fillBuf]);
 
     m_drawBuf = m_fillBuf;
-    m_fillBuf ^= 1;
 
-    /* Queue the command buffer for execution */
+    /* Queue the slot's uploads and draws together; the fence retires both */
+    VkCommandBuffer cmdBufs[] = {m_dynamicCmdBufs[m_drawBuf], m_cmdBufs[m_drawBuf]};
     VkPipelineStageFlags pipeStageFlags = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
     VkSubmitInfo submitInfo = {};
     submitInfo.pNext = nullptr;
@@ -3243,8 +4944,8 @@ void VulkanCommandQueue::execute()
     submitInfo.waitSemaphoreCount = 0;
     submitInfo.pWaitSemaphores = nullptr;
     submitInfo.pWaitDstStageMask = &pipeStageFlags;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &m_cmdBufs[m_drawBuf];
+    submitInfo.commandBufferCount = 2;
+    submitInfo.pCommandBuffers = cmdBufs;
     submitInfo.signalSemaphoreCount = 0;
     submitInfo.pSignalSemaphores = nullptr;
     if (_resolveDisplay())
@@ -3254,9 +4955,20 @@ void VulkanCommandQueue::execute()
         submitInfo.signalSemaphoreCount = 1;
         submitInfo.pSignalSemaphores = &m_drawCompleteSem;
     }
+    if (m_timerActive[m_drawBuf])
+        stampTimer(m_drawBuf, m_timerMarks[m_drawBuf].endFrame());
+    ThrowIfFailed(vk::EndCommandBuffer(m_dynamicCmdBufs[m_drawBuf]));
     ThrowIfFailed(vk::EndCommandBuffer(m_cmdBufs[m_drawBuf]));
-    ThrowIfFailed(vk::QueueSubmit(m_ctx->m_queue, 1, &submitInfo, m_drawCompleteFence));
-    m_submitted = true;
+    ThrowIfFailed(vk::ResetFences(m_ctx->m_dev, 1, &m_frameFences[m_drawBuf]));
+    ThrowIfFailed(vk::QueueSubmit(m_ctx->m_queue, 1, &submitInfo, m_frameFences[m_drawBuf]));
+    m_frameSerials[m_drawBuf] = ++m_submitSerial;
+    stats.renderEnd = FrameStatsNow();
+    for (Readback& rb : m_recordedReadbacks)
+    {
+        rb.m_serial = m_submitSerial;
+        m_readbacks.push_back(std::move(rb));
+    }
+    m_recordedReadbacks.clear();
 
     if (submitInfo.signalSemaphoreCount)
     {
@@ -3273,10 +4985,30 @@ void VulkanCommandQueue::execute()
         present.pResults = nullptr;
 
         ThrowIfFailed(vk::QueuePresentKHR(m_ctx->m_queue, &present));
+        stats.present = FrameStatsNow();
     }
-
-    resetCommandBuffer();
-    resetDynamicCommandBuffer();
+    else if (m_displayResolved)
+    {
+        stats.present = FrameStatsNow();
+        m_displayResolved = false;
+    }
+    lk.unlock();
+    m_frameStats.push(stats);
+
+    /* Back-pressure: the next slot is only reused once the GPU retires it.
+     * Latency mode additionally drains everything but the frame just queued,
+     * so input sampled for the next frame is at most one frame old on screen */
+    m_fillBuf = (m_fillBuf + 1) % m_frameCount;
+    waitFrame(m_fillBuf);
+    if (m_pacingMode == PacingMode::Latency)
+        for (size_t i=0 ; i<m_frameCount ; ++i)
+            if (i != m_drawBuf)
+                waitFrame(i);
+    pollReadbacks();
+    collectTimers(m_fillBuf);
+
+    beginFrame(m_fillBuf);
+    m_recordStart = FrameStatsNow();
 }
 
 IGraphicsCommandQueue* _NewVulkanCommandQueue(VulkanContext* ctx, VulkanContext::Window* windowCtx,
@@ -3285,5 +5017,13 @@ IGraphicsCommandQueue* _NewVulkanCommandQueue(VulkanContext* ctx, VulkanContext:
     return new struct VulkanCommandQueue(ctx, windowCtx, parent);
 }
 
+IGraphicsCommandQueue* _NewVulkanHeadlessCommandQueue(VulkanContext* ctx, IGraphicsContext* parent,
+                                                      ReadbackFunc&& displayReadback)
+{
+    VulkanCommandQueue* q = new struct VulkanCommandQueue(ctx, nullptr, parent);
+    q->m_displayReadback = std::move(displayReadback);
+    return q;
+}
+
 
 }
@@ -0,0 +1,175 @@
+#include "boo/graphicsdev/VulkanHeadless.hpp"
+#include "boo/graphicsdev/Vulkan.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#include "logvisor/logvisor.hpp"
+
+namespace boo
+{
+static logvisor::Module Log("boo::VulkanHeadless");
+
+IGraphicsCommandQueue* _NewVulkanHeadlessCommandQueue(VulkanContext* ctx, IGraphicsContext* parent,
+                                                      ReadbackFunc&& displayReadback);
+
+static PFN_vkGetInstanceProcAddr LoadVulkanLoader()
+{
+#ifdef _WIN32
+    HMODULE handle = LoadLibraryW(L"vulkan-1.dll");
+    if (!handle)
+        return nullptr;
+    return reinterpret_cast<PFN_vkGetInstanceProcAddr>(GetProcAddress(handle, "vkGetInstanceProcAddr"));
+#else
+    void* handle = dlopen("libvulkan.so.1", RTLD_LAZY);
+    if (!handle)
+        handle = dlopen("libvulkan.so", RTLD_LAZY);
+    if (!handle)
+        return nullptr;
+    /* The dispatch table is global, so the loader stays resident */
+    return reinterpret_cast<PFN_vkGetInstanceProcAddr>(dlsym(handle, "vkGetInstanceProcAddr"));
+#endif
+}
+
+class GraphicsContextVulkanHeadless : public IGraphicsContext
+{
+    EPixelFormat m_pf = EPixelFormat::RGBA8;
+    VulkanContext* m_ctx;
+    uint32_t m_drawSamples;
+    ReadbackFunc m_displayReadback;
+
+    IGraphicsCommandQueue* m_commandQueue = nullptr;
+    IGraphicsDataFactory* m_dataFactory = nullptr;
+
+public:
+    GraphicsContextVulkanHeadless(VulkanContext* ctx, uint32_t drawSamples, ReadbackFunc&& displayReadback)
+    : m_ctx(ctx), m_drawSamples(drawSamples), m_displayReadback(std::move(displayReadback)) {}
+
+    ~GraphicsContextVulkanHeadless()
+    {
+        /* Waits out every frame in flight before the data goes */
+        delete m_commandQueue;
+        delete m_dataFactory;
+    }
+
+    EGraphicsAPI getAPI() const
+    {
+        return EGraphicsAPI::Vulkan;
+    }
+
+    EPixelFormat getPixelFormat() const
+    {
+        return m_pf;
+    }
+
+    void setPixelFormat(EPixelFormat pf)
+    {
+        if (pf > EPixelFormat::RGBAF32_Z24)
+            return;
+        m_pf = pf;
+    }
+
+    bool initializeContext(void* getVkProc)
+    {
+        if (m_ctx->m_instance != VK_NULL_HANDLE && !m_ctx->m_headless)
+        {
+            Log.report(logvisor::Error, "Vulkan instance was already created for windows");
+            return false;
+        }
+
+        vk::init_dispatch_table_top(PFN_vkGetInstanceProcAddr(getVkProc));
+        if (m_ctx->m_instance == VK_NULL_HANDLE)
+        {
+            m_ctx->m_headless = true;
+            m_ctx->initVulkan("boo-headless");
+        }
+
+        vk::init_dispatch_table_middle(m_ctx->m_instance, false);
+        if (!m_ctx->enumerateDevices())
+        {
+            Log.report(logvisor::Error, "no Vulkan devices available");
+            return false;
+        }
+
+        if (m_ctx->m_graphicsQueueFamilyIndex == UINT32_MAX)
+        {
+            /* First context, init device; any graphics queue will do without present */
+            for (uint32_t i=0 ; i<m_ctx->m_queueCount ; ++i)
+            {
+                if ((m_ctx->m_queueProps[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0)
+                {
+                    m_ctx->m_graphicsQueueFamilyIndex = i;
+                    break;
+                }
+            }
+            if (m_ctx->m_graphicsQueueFamilyIndex == UINT32_MAX)
+            {
+                Log.report(logvisor::Error, "Could not find a queue that supports graphics");
+                return false;
+            }
+
+            m_ctx->initDevice();
+            vk::init_dispatch_table_bottom(m_ctx->m_instance, m_ctx->m_dev);
+            m_ctx->initHeadless();
+        }
+        else
+            vk::init_dispatch_table_bottom(m_ctx->m_instance, m_ctx->m_dev);
+
+        Log.report(logvisor::Info, "Vulkan device: %s", m_ctx->m_gpuProps.deviceName);
+
+        m_dataFactory = new class VulkanDataFactory(this, m_ctx, m_drawSamples);
+        m_commandQueue = _NewVulkanHeadlessCommandQueue(m_ctx, this, std::move(m_displayReadback));
+        return true;
+    }
+
+    void makeCurrent() {}
+
+    void postInit() {}
+
+    IGraphicsCommandQueue* getCommandQueue()
+    {
+        return m_commandQueue;
+    }
+
+    IGraphicsDataFactory* getDataFactory()
+    {
+        return m_dataFactory;
+    }
+
+    IGraphicsDataFactory* getMainContextDataFactory()
+    {
+        return getDataFactory();
+    }
+
+    IGraphicsDataFactory* getLoadContextDataFactory()
+    {
+        return getDataFactory();
+    }
+
+    void present() {}
+};
+
+std::unique_ptr<IGraphicsContext> NewVulkanHeadlessContext(VulkanContext* ctx,
+                                                           PFN_vkGetInstanceProcAddr getVkProc,
+                                                           uint32_t drawSamples,
+                                                           ReadbackFunc&& displayReadback)
+{
+    if (!getVkProc)
+        getVkProc = LoadVulkanLoader();
+    if (!getVkProc)
+    {
+        Log.report(logvisor::Error, "unable to load the Vulkan loader");
+        return {};
+    }
+
+    std::unique_ptr<IGraphicsContext> gfxCtx(
+        new GraphicsContextVulkanHeadless(ctx, drawSamples, std::move(displayReadback)));
+    if (!gfxCtx->initializeContext(reinterpret_cast<void*>(getVkProc)))
+        return {};
+    return gfxCtx;
+}
+
+}
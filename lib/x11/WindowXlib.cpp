@@ -288,6 +288,7 @@ struct GraphicsContextXlib : IGraphicsContext
 
     std::mutex m_vsyncmt;
     std::condition_variable m_vsynccv;
+    uint64_t m_lastVsync = 0; /* FrameStatsNow() of the latest retrace; guarded by m_vsyncmt */
 
     GraphicsContextXlib(EGraphicsAPI api, EPixelFormat pf, IWindow* parentWindow, Display* disp, uint32_t drawSamples)
     : m_api(api),
@@ -509,6 +510,10 @@ public:
                     if (err)
                         Log.report(logvisor::Fatal, "wait err");
                 }
+                {
+                    std::unique_lock<std::mutex> lk(m_vsyncmt);
+                    m_lastVsync = FrameStatsNow();
+                }
                 m_vsynccv.notify_one();
             }
 
@@ -808,6 +813,10 @@ public:
                 int err = glXWaitVideoSyncSGI(1, 0, &sync);
                 if (err)
                     Log.report(logvisor::Fatal, "wait err");
+                {
+                    std::unique_lock<std::mutex> lk(m_vsyncmt);
+                    m_lastVsync = FrameStatsNow();
+                }
                 m_vsynccv.notify_one();
             }
 
@@ -863,6 +872,7 @@ class WindowXlib : public IWindow
     XIC m_xIC = nullptr;
     std::unique_ptr<GraphicsContextXlib> m_gfxCtx;
     uint32_t m_visualId;
+    FrameStatsRing<RetraceStats> m_retraceStats;
 
     /* Key state trackers (for auto-repeat detection) */
     std::unordered_set<unsigned long> m_charKeys;
@@ -1420,8 +1430,20 @@ public:
 
     void waitForRetrace()
     {
-        std::unique_lock<std::mutex> lk(m_gfxCtx->m_vsyncmt);
-        m_gfxCtx->m_vsynccv.wait(lk);
+        RetraceStats stats;
+        stats.waitBegin = FrameStatsNow();
+        {
+            std::unique_lock<std::mutex> lk(m_gfxCtx->m_vsyncmt);
+            m_gfxCtx->m_vsynccv.wait(lk);
+            stats.vsync = m_gfxCtx->m_lastVsync;
+        }
+        stats.wake = FrameStatsNow();
+        m_retraceStats.push(stats);
+    }
+
+    size_t getRetraceStats(RetraceStats* out, size_t maxCount) const
+    {
+        return m_retraceStats.copy(out, maxCount);
     }
 
     uintptr_t getPlatformHandle() const
@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <boo/IWindow.hpp>
+#include <boo/FrameStats.hpp>
+#include <boo/graphicsdev/CommandStream.hpp>
+#include "../lib/graphicsdev/GLCommands.hpp"
+
+/* Record and playback throughput of the GL backend's packed CommandStream
+ * against the fixed-size command structs it replaced. Both encodings carry the
+ * GL queue's ops; playback folds payloads into a checksum in place of GL calls */
+
+namespace boo
+{
+
+using Op = GLCommandOp;
+
+/* Previous GLCommandQueue::Command layout, stored in a std::vector */
+struct FixedCommand
+{
+    Op m_op;
+    union
+    {
+        const void* binding;
+        const void* target;
+        struct
+        {
+            SWindowRect rect;
+            float znear, zfar;
+        } viewport;
+        float rgba[4];
+        uint32_t flags;
+        const char* timerName;
+        struct
+        {
+            size_t start;
+            size_t count;
+            size_t instCount;
+        };
+        struct
+        {
+            const void* buf;
+            size_t offset;
+            size_t drawCount;
+        } indirect;
+    };
+    const void* resolveTex;
+    bool resolveColor : 1;
+    bool resolveDepth : 1;
+    FixedCommand(Op op) : m_op(op) {}
+};
+
+static int s_target; /* Stands in for the render texture */
+
+/* A binding change every few draws and a mix of draw kinds, bracketed by the
+ * per-frame target, viewport and clear setup */
+struct FixedRecorder
+{
+    std::vector<FixedCommand> m_cmds;
+
+    void frame(size_t draws)
+    {
+        m_cmds.emplace_back(Op::SetRenderTarget);
+        m_cmds.back().target = &s_target;
+        m_cmds.emplace_back(Op::SetViewport);
+        m_cmds.back().viewport.rect = SWindowRect(0, 0, 1280, 720);
+        m_cmds.back().viewport.znear = 0.f;
+        m_cmds.back().viewport.zfar = 1.f;
+        m_cmds.emplace_back(Op::ClearTarget);
+        m_cmds.back().flags = 3;
+        for (size_t i=0 ; i<draws ; ++i)
+        {
+            if ((i & 3) == 0)
+            {
+                m_cmds.emplace_back(Op::SetShaderDataBinding);
+                m_cmds.back().binding = reinterpret_cast<const void*>(i);
+            }
+            switch (i % 3)
+            {
+            case 0:
+                m_cmds.emplace_back(Op::Draw);
+                m_cmds.back().start = i;
+                m_cmds.back().count = 6;
+                break;
+            case 1:
+                m_cmds.emplace_back(Op::DrawIndexed);
+                m_cmds.back().start = i;
+                m_cmds.back().count = 36;
+                break;
+            default:
+                m_cmds.emplace_back(Op::DrawInstances);
+                m_cmds.back().start = i;
+                m_cmds.back().count = 4;
+                m_cmds.back().instCount = 16;
+                break;
+            }
+        }
+        m_cmds.emplace_back(Op::Present);
+        m_cmds.back().target = &s_target;
+    }
+
+    size_t play() const
+    {
+        size_t sum = 0;
+        for (const FixedCommand& cmd : m_cmds)
+        {
+            switch (cmd.m_op)
+            {
+            case Op::SetShaderDataBinding:
+                sum += reinterpret_cast<size_t>(cmd.binding);
+                break;
+            case Op::SetRenderTarget:
+            case Op::Present:
+                sum ^= reinterpret_cast<size_t>(cmd.target);
+                break;
+            case Op::SetViewport:
+                sum += cmd.viewport.rect.size[0] + size_t(cmd.viewport.zfar);
+                break;
+            case Op::ClearTarget:
+                sum += cmd.flags;
+                break;
+            case Op::Draw:
+            case Op::DrawIndexed:
+                sum += cmd.start + cmd.count;
+                break;
+            case Op::DrawInstances:
+                sum += cmd.start + cmd.count * cmd.instCount;
+                break;
+            default: break;
+            }
+        }
+        return sum;
+    }
+
+    void clear() {m_cmds.clear();}
+    size_t bytes() const {return m_cmds.size() * sizeof(FixedCommand);}
+};
+
+struct PackedRecorder
+{
+    CommandStream m_cmds;
+
+    void frame(size_t draws)
+    {
+        m_cmds.push<const void*>(Op::SetRenderTarget) = &s_target;
+        m_cmds.push<GLViewportCmd>(Op::SetViewport) = {SWindowRect(0, 0, 1280, 720), 0.f, 1.f};
+        m_cmds.push<uint32_t>(Op::ClearTarget) = 3;
+        for (size_t i=0 ; i<draws ; ++i)
+        {
+            if ((i & 3) == 0)
+                m_cmds.push<const void*>(Op::SetShaderDataBinding) = reinterpret_cast<const void*>(i);
+            switch (i % 3)
+            {
+            case 0:
+                m_cmds.push<GLDrawCmd>(Op::Draw) = {i, 6};
+                break;
+            case 1:
+                m_cmds.push<GLDrawCmd>(Op::DrawIndexed) = {i, 36};
+                break;
+            default:
+                m_cmds.push<GLDrawInstancesCmd>(Op::DrawInstances) = {i, 4, 16};
+                break;
+            }
+        }
+        m_cmds.push<const void*>(Op::Present) = &s_target;
+    }
+
+    size_t play() const
+    {
+        size_t sum = 0;
+        for (const CommandStream::Command& cmd : m_cmds)
+        {
+            switch (cmd.op<Op>())
+            {
+            case Op::SetShaderDataBinding:
+                sum += reinterpret_cast<size_t>(cmd.get<const void*>());
+                break;
+            case Op::SetRenderTarget:
+            case Op::Present:
+                sum ^= reinterpret_cast<size_t>(cmd.get<const void*>());
+                break;
+            case Op::SetViewport:
+            {
+                const GLViewportCmd& vp = cmd.get<GLViewportCmd>();
+                sum += vp.rect.size[0] + size_t(vp.zfar);
+                break;
+            }
+            case Op::ClearTarget:
+                sum += cmd.get<uint32_t>();
+                break;
+            case Op::Draw:
+            case Op::DrawIndexed:
+            {
+                const GLDrawCmd& draw = cmd.get<GLDrawCmd>();
+                sum += draw.start + draw.count;
+                break;
+            }
+            case Op::DrawInstances:
+            {
+                const GLDrawInstancesCmd& draw = cmd.get<GLDrawInstancesCmd>();
+                sum += draw.start + draw.count * draw.instCount;
+                break;
+            }
+            default: break;
+            }
+        }
+        return sum;
+    }
+
+    void clear() {m_cmds.clear();}
+    size_t bytes() const {return m_cmds.size();}
+};
+
+struct BenchResult
+{
+    std::vector<double> recordMs;
+    std::vector<double> playMs;
+    size_t bytes = 0;
+    size_t checksum = 0;
+};
+
+/* The first frame grows the storage and is left out, as a running queue's
+ * buffers are already at size */
+template <class Recorder>
+static BenchResult RunBench(size_t draws, size_t frames)
+{
+    BenchResult res;
+    Recorder rec;
+    for (size_t f=0 ; f<=frames ; ++f)
+    {
+        rec.clear();
+        uint64_t start = FrameStatsNow();
+        rec.frame(draws);
+        uint64_t recorded = FrameStatsNow();
+        res.checksum += rec.play();
+        uint64_t played = FrameStatsNow();
+        if (!f)
+            continue;
+        res.recordMs.push_back(FrameStatsMs(start, recorded));
+        res.playMs.push_back(FrameStatsMs(recorded, played));
+        res.bytes = rec.bytes();
+    }
+    return res;
+}
+
+static void PrintResult(const char* label, BenchResult& res, size_t draws)
+{
+    FrameStatsSummary rec = SummarizeFrameStats(res.recordMs);
+    FrameStatsSummary play = SummarizeFrameStats(res.playMs);
+    printf("%-7s %6.2f MiB/frame  record p50 %7.3f ms (%6.1f Mdraws/s)  playback p50 %7.3f ms (%6.1f Mdraws/s)\n",
+           label, res.bytes / (1024.0 * 1024.0),
+           rec.p50, draws / (rec.p50 * 1000.0), play.p50, draws / (play.p50 * 1000.0));
+}
+
+static int BenchMain(int argc, char** argv)
+{
+    size_t draws = 100000;
+    size_t frames = 200;
+    for (int i=1 ; i<argc ; ++i)
+    {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--draws") && hasValue)
+            draws = strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--frames") && hasValue)
+            frames = strtoul(argv[++i], nullptr, 10);
+        else
+        {
+            fprintf(stderr, "usage: boo-cmdbench [--draws N] [--frames N]\n"
+                            "  --draws   draws recorded per frame (default 100000)\n"
+                            "  --frames  timed frames per encoding (default 200)\n");
+            return 1;
+        }
+    }
+    if (!draws || !frames)
+        return 1;
+
+    BenchResult fixed = RunBench<FixedRecorder>(draws, frames);
+    BenchResult packed = RunBench<PackedRecorder>(draws, frames);
+    if (fixed.checksum != packed.checksum)
+    {
+        fprintf(stderr, "encodings disagree\n");
+        return 2;
+    }
+
+    printf("%zu draws/frame, %zu frames\n", draws, frames);
+    PrintResult("fixed", fixed, draws);
+    PrintResult("packed", packed, draws);
+    return 0;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    return boo::BenchMain(argc, argv);
+}
@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory>
+#include <numeric>
+#include <boo/boo.hpp>
+#include <boo/FrameStats.hpp>
+#include <boo/graphicsdev/Capture.hpp>
+#include <boo/graphicsdev/Null.hpp>
+#include <boo/graphicsdev/GLHeadless.hpp>
+#include <boo/graphicsdev/Vulkan.hpp>
+#include <boo/graphicsdev/VulkanHeadless.hpp>
+#include "logvisor/logvisor.hpp"
+
+namespace boo
+{
+
+enum class ReplayBackend
+{
+    Null,
+    OpenGL,
+    Vulkan
+};
+
+static const char* ReplayBackendNames[] = {"null", "gl", "vulkan"};
+
+static void PrintUsage()
+{
+    fprintf(stderr,
+            "usage: boo-replay [--backend null|gl|vulkan] [--repeat N] [--gpu-timing]\n"
+            "                  [--width W] [--height H] <capture>\n"
+            "  --backend     replay target (default null); gl and vulkan run headless\n"
+            "  --repeat      replay the whole capture N times (default 1)\n"
+            "  --gpu-timing  also report GPU frame time where the backend supports it\n"
+            "  --width/height  gl pbuffer size for resolveDisplay (default 1280x720)\n");
+}
+
+static unsigned long ParseCount(const SystemChar* str)
+{
+#if _WIN32
+    return wcstoul(str, nullptr, 10);
+#else
+    return strtoul(str, nullptr, 10);
+#endif
+}
+
+static void PrintSummary(const char* label, std::vector<double>& samples)
+{
+    if (samples.empty())
+        return;
+    double total = std::accumulate(samples.begin(), samples.end(), 0.0);
+    FrameStatsSummary sum = SummarizeFrameStats(samples);
+    printf("%-9s mean %8.3f  p50 %8.3f  p90 %8.3f  p99 %8.3f  max %8.3f ms\n", label,
+           total / sum.count, sum.p50, sum.p90, sum.p99, sum.max);
+}
+
+static int ReplayMain(int argc, const SystemChar** argv)
+{
+    ReplayBackend backend = ReplayBackend::Null;
+    unsigned long repeat = 1;
+    bool gpuTiming = false;
+    size_t width = 1280;
+    size_t height = 720;
+    const SystemChar* path = nullptr;
+
+    for (int i=1 ; i<argc ; ++i)
+    {
+        SystemString arg(argv[i]);
+        bool hasValue = i + 1 < argc;
+        if (arg == _S("--backend") && hasValue)
+        {
+            SystemString name(argv[++i]);
+            if (name == _S("null"))
+                backend = ReplayBackend::Null;
+            else if (name == _S("gl"))
+                backend = ReplayBackend::OpenGL;
+            else if (name == _S("vulkan"))
+                backend = ReplayBackend::Vulkan;
+            else
+                return PrintUsage(), 1;
+        }
+        else if (arg == _S("--repeat") && hasValue)
+            repeat = ParseCount(argv[++i]);
+        else if (arg == _S("--width") && hasValue)
+            width = ParseCount(argv[++i]);
+        else if (arg == _S("--height") && hasValue)
+            height = ParseCount(argv[++i]);
+        else if (arg == _S("--gpu-timing"))
+            gpuTiming = true;
+        else if (!path && arg[0] != _S('-'))
+            path = argv[i];
+        else
+            return PrintUsage(), 1;
+    }
+    if (!path || !repeat || !width || !height)
+        return PrintUsage(), 1;
+
+    CaptureReplay replay;
+    if (!replay.open(path))
+    {
+        fprintf(stderr, "unable to open capture\n");
+        return 1;
+    }
+
+    /* Declared so the queue goes before its factory */
+    std::unique_ptr<NullDataFactory> nullFactory;
+    std::unique_ptr<NullCommandQueue> nullQueue;
+    std::unique_ptr<IGraphicsContext> gfxCtx;
+    IGraphicsDataFactory* factory = nullptr;
+    IGraphicsCommandQueue* queue = nullptr;
+    switch (backend)
+    {
+    case ReplayBackend::Null:
+        nullFactory.reset(new NullDataFactory());
+        nullQueue.reset(new NullCommandQueue(nullFactory.get()));
+        factory = nullFactory.get();
+        queue = nullQueue.get();
+        break;
+    case ReplayBackend::OpenGL:
+#if BOO_HAS_EGL
+        gfxCtx = NewGLHeadlessContext(width, height);
+#endif
+        break;
+    case ReplayBackend::Vulkan:
+#if BOO_HAS_VULKAN
+        gfxCtx = NewVulkanHeadlessContext(&g_VulkanContext);
+#endif
+        break;
+    }
+    if (gfxCtx)
+    {
+        /* Makes a GL context current on this thread for transactions */
+        factory = gfxCtx->getMainContextDataFactory();
+        queue = gfxCtx->getCommandQueue();
+    }
+    if (!factory || !queue)
+    {
+        fprintf(stderr, "%s backend is unavailable\n", ReplayBackendNames[int(backend)]);
+        return 1;
+    }
+    queue->setGPUTimingEnabled(gpuTiming);
+
+    CaptureReplayStats stats;
+    std::vector<double> gpuMs;
+    uint64_t lastGPUFrame = 0;
+    bool complete = true;
+    for (unsigned long pass=0 ; pass<repeat && complete ; ++pass)
+    {
+        complete = replay.run(factory, queue, stats, [&](size_t)
+        {
+            GPUFrameTimings timings;
+            if (gpuTiming && queue->getGPUTimings(timings) && timings.frame != lastGPUFrame)
+            {
+                gpuMs.push_back(timings.totalMs);
+                lastGPUFrame = timings.frame;
+            }
+        });
+    }
+
+    printf("%s: %zu frames, %zu transactions, %zu draws, %.2f MiB uploaded%s\n",
+           ReplayBackendNames[int(backend)], stats.frames, stats.transactions, stats.draws,
+           stats.uploadBytes / (1024.0 * 1024.0), complete ? "" : " (capture ended early)");
+    double totalMs = std::accumulate(stats.frameMs.begin(), stats.frameMs.end(), 0.0);
+    if (totalMs > 0.0)
+        printf("%.1f ms total, %.1f frames/s\n", totalMs, stats.frames * 1000.0 / totalMs);
+    PrintSummary("CPU", stats.frameMs);
+    PrintSummary("GPU", gpuMs);
+    if (nullQueue)
+    {
+        const NullCommandCounts& counts = nullQueue->totalCounts();
+        printf("%zu vertices, %zu binding changes (%zu redundant), %zu target changes\n",
+               counts.vertices, counts.bindingChanges, counts.redundantBindings, counts.targetChanges);
+    }
+
+    return complete ? 0 : 2;
+}
+
+}
+
+#if _WIN32
+int wmain(int argc, const boo::SystemChar** argv)
+#else
+int main(int argc, const boo::SystemChar** argv)
+#endif
+{
+    logvisor::RegisterStandardExceptions();
+    logvisor::RegisterConsoleLogger();
+    return boo::ReplayMain(argc, argv);
+}